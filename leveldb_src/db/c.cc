@@ -6,10 +6,12 @@
 
 #include <stdlib.h>
 #include <unistd.h>
+#include <vector>
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 #include "leveldb/status.h"
@@ -21,8 +23,10 @@ using leveldb::CompressionType;
 using leveldb::DB;
 using leveldb::Env;
 using leveldb::FileLock;
+using leveldb::FilterPolicy;
 using leveldb::Iterator;
 using leveldb::Logger;
+using leveldb::NewClockCache;
 using leveldb::NewLRUCache;
 using leveldb::Options;
 using leveldb::RandomAccessFile;
@@ -121,6 +125,53 @@ extern "C" {
         virtual void FindShortSuccessor(std::string* key) const { }
     };
 
+    struct leveldb_filterpolicy_t : public FilterPolicy
+    {
+        void* state_;
+        void (*destructor_)(void*);
+        const char* (*name_)(void*);
+        char* (*create_)(
+            void*,
+            const char* const* key_array, const size_t* key_length_array,
+            int num_keys,
+            size_t* filter_length);
+        unsigned char (*key_match_)(
+            void*,
+            const char* key, size_t length,
+            const char* filter, size_t filter_length);
+
+        virtual ~leveldb_filterpolicy_t()
+        {
+            (*destructor_)(state_);
+        }
+
+        virtual const char* Name() const
+        {
+            return (*name_)(state_);
+        }
+
+        virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const
+        {
+            std::vector<const char*> key_pointers(n);
+            std::vector<size_t> key_sizes(n);
+            for (int i = 0; i < n; i++)
+            {
+                key_pointers[i] = keys[i].data();
+                key_sizes[i] = keys[i].size();
+            }
+            size_t len;
+            char* filter = (*create_)(state_, &key_pointers[0], &key_sizes[0], n, &len);
+            dst->append(filter, len);
+            free(filter);
+        }
+
+        virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const
+        {
+            return (*key_match_)(state_, key.data(), key.size(),
+                                 filter.data(), filter.size());
+        }
+    };
+
     struct leveldb_env_t
     {
         Env* rep;
@@ -231,6 +282,44 @@ extern "C" {
         return result;
     }
 
+    void leveldb_multi_get(
+        leveldb_t* db,
+        const leveldb_readoptions_t* options,
+        int num_keys,
+        const char* const* keys, const size_t* keylens,
+        char** values, size_t* vallens,
+        char** errs)
+    {
+        Slice* key_slices = new Slice[num_keys];
+        std::string* tmp = new std::string[num_keys];
+        Status* statuses = new Status[num_keys];
+        for (int i = 0; i < num_keys; i++)
+        {
+            key_slices[i] = Slice(keys[i], keylens[i]);
+        }
+        db->rep->MultiGet(options->rep, key_slices, num_keys, tmp, statuses);
+        for (int i = 0; i < num_keys; i++)
+        {
+            if (statuses[i].ok())
+            {
+                vallens[i] = tmp[i].size();
+                values[i] = CopyString(tmp[i]);
+            }
+            else
+            {
+                vallens[i] = 0;
+                values[i] = NULL;
+                if (!statuses[i].IsNotFound())
+                {
+                    SaveError(&errs[i], statuses[i]);
+                }
+            }
+        }
+        delete[] statuses;
+        delete[] tmp;
+        delete[] key_slices;
+    }
+
     leveldb_iterator_t* leveldb_create_iterator(
         leveldb_t* db,
         const leveldb_readoptions_t* options)
@@ -289,6 +378,18 @@ extern "C" {
         delete[] ranges;
     }
 
+    void leveldb_compact_range(
+        leveldb_t* db,
+        const char* start_key, size_t start_key_len,
+        const char* limit_key, size_t limit_key_len)
+    {
+        Slice a, b;
+        db->rep->CompactRange(
+            // Pass NULL Slice if corresponding "const char*" is NULL
+            (start_key ? (a = Slice(start_key, start_key_len), &a) : NULL),
+            (limit_key ? (b = Slice(limit_key, limit_key_len), &b) : NULL));
+    }
+
     void leveldb_destroy_db(
         const leveldb_options_t* options,
         const char* name,
@@ -435,6 +536,13 @@ extern "C" {
         opt->rep.comparator = cmp;
     }
 
+    void leveldb_options_set_filter_policy(
+        leveldb_options_t* opt,
+        leveldb_filterpolicy_t* policy)
+    {
+        opt->rep.filter_policy = policy;
+    }
+
     void leveldb_options_set_create_if_missing(
         leveldb_options_t* opt, unsigned char v)
     {
@@ -515,6 +623,67 @@ extern "C" {
         delete cmp;
     }
 
+    leveldb_filterpolicy_t* leveldb_filterpolicy_create(
+        void* state,
+        void (*destructor)(void*),
+        char* (*create_filter)(
+            void*,
+            const char* const* key_array, const size_t* key_length_array,
+            int num_keys,
+            size_t* filter_length),
+        unsigned char (*key_may_match)(
+            void*,
+            const char* key, size_t length,
+            const char* filter, size_t filter_length),
+        const char* (*name)(void*))
+    {
+        leveldb_filterpolicy_t* result = new leveldb_filterpolicy_t;
+        result->state_ = state;
+        result->destructor_ = destructor;
+        result->create_ = create_filter;
+        result->key_match_ = key_may_match;
+        result->name_ = name;
+        return result;
+    }
+
+    void leveldb_filterpolicy_destroy(leveldb_filterpolicy_t* filter)
+    {
+        delete filter;
+    }
+
+    leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(int bits_per_key)
+    {
+        // Make a leveldb_filterpolicy_t, but override all of its methods so
+        // they delegate to a NewBloomFilterPolicy() instead of user
+        // supplied C functions.
+        struct Wrapper : public leveldb_filterpolicy_t
+        {
+            const FilterPolicy* rep_;
+            ~Wrapper()
+            {
+                delete rep_;
+            }
+            const char* Name() const
+            {
+                return rep_->Name();
+            }
+            void CreateFilter(const Slice* keys, int n, std::string* dst) const
+            {
+                return rep_->CreateFilter(keys, n, dst);
+            }
+            bool KeyMayMatch(const Slice& key, const Slice& filter) const
+            {
+                return rep_->KeyMayMatch(key, filter);
+            }
+            static void DoNothing(void*) { }
+        };
+        Wrapper* wrapper = new Wrapper;
+        wrapper->rep_ = leveldb::NewBloomFilterPolicy(bits_per_key);
+        wrapper->state_ = NULL;
+        wrapper->destructor_ = &Wrapper::DoNothing;
+        return wrapper;
+    }
+
     leveldb_readoptions_t* leveldb_readoptions_create()
     {
         return new leveldb_readoptions_t;
@@ -568,6 +737,13 @@ extern "C" {
         return c;
     }
 
+    leveldb_cache_t* leveldb_cache_create_clock(size_t capacity)
+    {
+        leveldb_cache_t* c = new leveldb_cache_t;
+        c->rep = NewClockCache(capacity);
+        return c;
+    }
+
     void leveldb_cache_destroy(leveldb_cache_t* cache)
     {
         delete cache->rep;
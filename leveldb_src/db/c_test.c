@@ -139,6 +139,35 @@ static const char* CmpName(void* arg)
     return "foo";
 }
 
+// Custom filter policy
+static unsigned char fake_filter_result = 1;
+static void FilterDestroy(void* arg) { }
+static const char* FilterName(void* arg)
+{
+    return "TestFilter";
+}
+static char* FilterCreate(
+    void* arg,
+    const char* const* key_array, const size_t* key_length_array,
+    int num_keys,
+    size_t* filter_length)
+{
+    char* result;
+    *filter_length = 4;
+    result = malloc(4);
+    memcpy(result, "fake", 4);
+    return result;
+}
+static unsigned char FilterKeyMatch(
+    void* arg,
+    const char* key, size_t length,
+    const char* filter, size_t filter_length)
+{
+    CheckCondition(filter_length == 4);
+    CheckCondition(memcmp(filter, "fake", 4) == 0);
+    return fake_filter_result;
+}
+
 int main(int argc, char** argv)
 {
     leveldb_t* db;
@@ -149,6 +178,7 @@ int main(int argc, char** argv)
     leveldb_readoptions_t* roptions;
     leveldb_writeoptions_t* woptions;
     char* err = NULL;
+    int run = -1;
 
     snprintf(dbname, sizeof(dbname), "/tmp/leveldb_c_test-%d",
              ((int) geteuid()));
@@ -239,6 +269,28 @@ int main(int argc, char** argv)
         leveldb_iter_destroy(iter);
     }
 
+    StartPhase("multi_get");
+    {
+        const char* keys[3] = { "foo", "bar", "box" };
+        size_t keylens[3] = { 3, 3, 3 };
+        char* vals[3];
+        size_t vallens[3];
+        char* errs[3] = { NULL, NULL, NULL };
+        int i;
+        leveldb_multi_get(db, roptions, 3, keys, keylens, vals, vallens, errs);
+        for (i = 0; i < 3; i++)
+        {
+            CheckNoError(errs[i]);
+        }
+        CheckEqual("hello", vals[0], vallens[0]);
+        CheckEqual(NULL, vals[1], vallens[1]);
+        CheckEqual("c", vals[2], vallens[2]);
+        for (i = 0; i < 3; i++)
+        {
+            Free(&vals[i]);
+        }
+    }
+
     StartPhase("approximate_sizes");
     {
         int i;
@@ -264,6 +316,14 @@ int main(int argc, char** argv)
         CheckCondition(sizes[1] > 0);
     }
 
+    StartPhase("compactall");
+    leveldb_compact_range(db, NULL, 0, NULL, 0);
+    CheckGet(db, roptions, "k00000000000000000000", "v00000000000000000000");
+
+    StartPhase("compactrange");
+    leveldb_compact_range(db, "k00000000000000010000", 21, "k00000000000000015000", 21);
+    CheckGet(db, roptions, "k00000000000000012345", "v00000000000000012345");
+
     StartPhase("property");
     {
         char* prop = leveldb_property_value(db, "nosuchprop");
@@ -300,6 +360,74 @@ int main(int argc, char** argv)
         CheckGet(db, roptions, "box", "c");
     }
 
+    StartPhase("filter");
+    for (run = 0; run < 2; run++)
+    {
+        // First run uses custom filter, second run uses bloom filter
+        leveldb_filterpolicy_t* policy;
+        CheckNoError(err);
+        if (run == 0)
+        {
+            policy = leveldb_filterpolicy_create(
+                         NULL, FilterDestroy, FilterCreate, FilterKeyMatch, FilterName);
+        }
+        else
+        {
+            policy = leveldb_filterpolicy_create_bloom(10);
+        }
+
+        // Create new database
+        leveldb_close(db);
+        leveldb_destroy_db(options, dbname, &err);
+        leveldb_options_set_create_if_missing(options, 1);
+        leveldb_options_set_filter_policy(options, policy);
+        db = leveldb_open(options, dbname, &err);
+        CheckNoError(err);
+        leveldb_put(db, woptions, "foo", 3, "foovalue", 8, &err);
+        CheckNoError(err);
+        leveldb_put(db, woptions, "bar", 3, "barvalue", 8, &err);
+        CheckNoError(err);
+
+        // Reopen so that recovery writes the log out as a filtered table
+        leveldb_close(db);
+        db = leveldb_open(options, dbname, &err);
+        CheckNoError(err);
+
+        fake_filter_result = 1;
+        CheckGet(db, roptions, "foo", "foovalue");
+        CheckGet(db, roptions, "bar", "barvalue");
+        if (run == 0)
+        {
+            // Must not find value when custom filter returns false
+            fake_filter_result = 0;
+            CheckGet(db, roptions, "foo", NULL);
+            CheckGet(db, roptions, "bar", NULL);
+            fake_filter_result = 1;
+
+            CheckGet(db, roptions, "foo", "foovalue");
+            CheckGet(db, roptions, "bar", "barvalue");
+        }
+        leveldb_options_set_filter_policy(options, NULL);
+        leveldb_filterpolicy_destroy(policy);
+    }
+
+    StartPhase("clock_cache");
+    {
+        leveldb_cache_t* clock = leveldb_cache_create_clock(100000);
+        leveldb_close(db);
+        leveldb_options_set_cache(options, clock);
+        db = leveldb_open(options, dbname, &err);
+        CheckNoError(err);
+        CheckGet(db, roptions, "foo", "foovalue");
+        CheckGet(db, roptions, "bar", "barvalue");
+        CheckGet(db, roptions, "foo", "foovalue");  // From the cache
+        leveldb_close(db);
+        leveldb_options_set_cache(options, cache);
+        leveldb_cache_destroy(clock);
+        db = leveldb_open(options, dbname, &err);
+        CheckNoError(err);
+    }
+
     StartPhase("cleanup");
     leveldb_close(db);
     leveldb_options_destroy(options);
@@ -8,8 +8,13 @@
 #include "db/db_impl.h"
 #include "db/version_set.h"
 #include "leveldb/cache.h"
+#include "leveldb/compressor.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -21,6 +26,8 @@
 // Comma-separated list of operations to run in the specified order
 //   Actual benchmarks:
 //      fillseq       -- write N values in sequential key order in async mode
+//      fillingest    -- write N values in sequential key order into table
+//                       files of write_buffer_size bytes and ingest them
 //      fillrandom    -- write N values in random key order in async mode
 //      overwrite     -- overwrite N values in random key order in async mode
 //      fillsync      -- write N/100 values in random key order in sync mode
@@ -28,8 +35,18 @@
 //      readseq       -- read N times sequentially
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
+//      multireadrandom -- read N times in random order, using MultiGet on
+//                         batches of --multiget_batch_size keys
 //      readhot       -- read N times in random order from 1% section of DB
+//      seekprefix    -- seek N times to a random run of 100 keys sharing a
+//                       14-byte prefix and read the run; half of the runs
+//                       sought are not in the DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      crc32cportable -- the same without the crc32 instruction of SSE4.2
+//      snappycomp    -- repeated Snappy compression of a 4K block
+//      snappyuncomp  -- repeated Snappy uncompression of a 4K block
+//      lz4comp, lz4uncomp, lz4hccomp -- the same for LZ4 and LZ4HC
+//      zstdcomp, zstduncomp -- the same for zstd
 //      acquireload   -- load N*1000 times
 //   Meta operations:
 //      compact     -- Compact the entire DB
@@ -50,8 +67,14 @@ static const char* FLAGS_benchmarks =
     "readreverse,"
     "fill100K,"
     "crc32c,"
+    "crc32cportable,"
     "snappycomp,"
     "snappyuncomp,"
+    "lz4comp,"
+    "lz4uncomp,"
+    "lz4hccomp,"
+    "zstdcomp,"
+    "zstduncomp,"
     "acquireload,"
     ;
 
@@ -82,9 +105,82 @@ static int FLAGS_write_buffer_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// If true, the cache of --cache_size bytes is a CLOCK cache instead of LRU
+static bool FLAGS_clock_cache = false;
+
+// Fraction of the LRU cache set aside for index and filter blocks and for
+// blocks that are hit again after being inserted
+static double FLAGS_cache_high_pri_pool_ratio = 0.0;
+
+// If true, index and filter blocks are kept in the block cache
+static bool FLAGS_cache_index_and_filter_blocks = false;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// Number of background compactions that may run concurrently
+static int FLAGS_max_background_compactions = 0;
+
+// Number of threads that may work on a single compaction
+static int FLAGS_max_subcompactions = 0;
+
+// If true, level targets are derived from the size of the last level
+static bool FLAGS_dynamic_level_bytes = false;
+
+// Megabytes per second that writes are let through at while compaction
+// falls behind (negative means use default settings)
+static int FLAGS_delayed_write_rate_mb = -1;
+
+// Megabytes left to compact at which writes are delayed and stopped
+// (0 disables the limit; negative means use default settings)
+static int FLAGS_soft_pending_compaction_mb = -1;
+static int FLAGS_hard_pending_compaction_mb = -1;
+
+// Megabytes of table files that may be read through mappings
+// (0 reads all tables with ordinary reads)
+static int FLAGS_mmap_read_mb = 0;
+
+// If true, data blocks end in a hash index for point lookups
+static bool FLAGS_data_block_hash_index = false;
+
+// If non-zero, table indexes are split into partitions of this many bytes
+static int FLAGS_index_partition_size = 0;
+
+// Bytes read from the end of a table file when it is opened
+// (negative means use default settings)
+static int FLAGS_tail_prefetch_size = -1;
+
+// If true, writers grouped together insert into the memtable in parallel
+static bool FLAGS_concurrent_memtable_write = false;
+
+// Bloom filter bits per key.
+// Negative means use default settings.
+static int FLAGS_bloom_bits = -1;
+
+// If true, the DB gets a prefix extractor for the first 14 bytes of keys,
+// and seekprefix uses ReadOptions::prefix_same_as_start.
+static bool FLAGS_prefix_seek = false;
+
+// Memtable representation: "skiplist", "hash" (buckets by the first
+// 14 bytes of the key, i.e. runs of 100 keys) or "vector"
+static const char* FLAGS_memtablerep = "skiplist";
+
+// Compression of table blocks: "none", "snappy", "lz4", "lz4hc" or "zstd"
+static const char* FLAGS_compression = "snappy";
+
+// If non-empty, a comma-separated list of the compressions for levels
+// 0, 1, ... (deeper levels use the last one), overriding --compression
+static const char* FLAGS_compression_per_level = "";
+
+// Number of threads compressing the data blocks of each table written
+static int FLAGS_compression_threads = 1;
+
+// Size of the compression dictionary of each table; 0 for none
+static int FLAGS_compression_dictionary_size = 0;
+
+// Number of keys looked up per MultiGet call by multireadrandom
+static int FLAGS_multiget_batch_size = 64;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -321,10 +417,26 @@ struct ThreadState
 
 }
 
+static CompressionType CompressionTypeFromName(const Slice& name)
+{
+    if (name == Slice("none")) return kNoCompression;
+    if (name == Slice("snappy")) return kSnappyCompression;
+    if (name == Slice("lz4")) return kLZ4Compression;
+    if (name == Slice("lz4hc")) return kLZ4HCCompression;
+    if (name == Slice("zstd")) return kZstdCompression;
+    fprintf(stderr, "unknown compression '%s'\n", name.ToString().c_str());
+    exit(1);
+}
+
 class Benchmark
 {
 private:
     Cache* cache_;
+    const FilterPolicy* filter_policy_;
+    const SliceTransform* prefix_extractor_;
+    MemTableRepFactory* memtable_factory_;
+    CompressionType compression_;
+    std::vector<CompressionType> compression_per_level_;
     DB* db_;
     int num_;
     int value_size_;
@@ -421,7 +533,16 @@ private:
 
 public:
     Benchmark()
-        : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : NULL),
+        : cache_(FLAGS_cache_size < 0 ? NULL
+                 : FLAGS_clock_cache ? NewClockCache(FLAGS_cache_size)
+                 : NewLRUCache(FLAGS_cache_size,
+                               FLAGS_cache_high_pri_pool_ratio)),
+          filter_policy_(FLAGS_bloom_bits >= 0
+                         ? NewBloomFilterPolicy(FLAGS_bloom_bits)
+                         : NULL),
+          prefix_extractor_(NewFixedPrefixTransform(14)),
+          memtable_factory_(NULL),
+          compression_(CompressionTypeFromName(FLAGS_compression)),
           db_(NULL),
           num_(FLAGS_num),
           value_size_(FLAGS_value_size),
@@ -429,6 +550,23 @@ public:
           reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
           heap_counter_(0)
     {
+        if (strcmp(FLAGS_memtablerep, "hash") == 0)
+        {
+            memtable_factory_ =
+                NewHashSkipListMemTableRepFactory(prefix_extractor_, 100000);
+        }
+        else if (strcmp(FLAGS_memtablerep, "vector") == 0)
+        {
+            memtable_factory_ = NewVectorMemTableRepFactory();
+        }
+        for (const char* p = FLAGS_compression_per_level; *p != '\0'; )
+        {
+            const char* comma = strchr(p, ',');
+            const size_t n = (comma != NULL) ? comma - p : strlen(p);
+            compression_per_level_.push_back(
+                CompressionTypeFromName(Slice(p, n)));
+            p += (comma != NULL) ? n + 1 : n;
+        }
         std::vector<std::string> files;
         Env::Default()->GetChildren(FLAGS_db, &files);
         for (int i = 0; i < files.size(); i++)
@@ -448,6 +586,9 @@ public:
     {
         delete db_;
         delete cache_;
+        delete filter_policy_;
+        delete memtable_factory_;
+        delete prefix_extractor_;
     }
 
     void Run()
@@ -487,6 +628,11 @@ public:
                 fresh_db = true;
                 method = &Benchmark::WriteSeq;
             }
+            else if (name == Slice("fillingest"))
+            {
+                fresh_db = true;
+                method = &Benchmark::FillIngest;
+            }
             else if (name == Slice("fillbatch"))
             {
                 fresh_db = true;
@@ -529,6 +675,14 @@ public:
             {
                 method = &Benchmark::ReadRandom;
             }
+            else if (name == Slice("multireadrandom"))
+            {
+                method = &Benchmark::MultiReadRandom;
+            }
+            else if (name == Slice("seekprefix"))
+            {
+                method = &Benchmark::SeekPrefix;
+            }
             else if (name == Slice("readhot"))
             {
                 method = &Benchmark::ReadHot;
@@ -551,6 +705,10 @@ public:
             {
                 method = &Benchmark::Crc32c;
             }
+            else if (name == Slice("crc32cportable"))
+            {
+                method = &Benchmark::Crc32cPortable;
+            }
             else if (name == Slice("acquireload"))
             {
                 method = &Benchmark::AcquireLoad;
@@ -563,6 +721,26 @@ public:
             {
                 method = &Benchmark::SnappyUncompress;
             }
+            else if (name == Slice("lz4comp"))
+            {
+                method = &Benchmark::LZ4Compress;
+            }
+            else if (name == Slice("lz4uncomp"))
+            {
+                method = &Benchmark::LZ4Uncompress;
+            }
+            else if (name == Slice("lz4hccomp"))
+            {
+                method = &Benchmark::LZ4HCCompress;
+            }
+            else if (name == Slice("zstdcomp"))
+            {
+                method = &Benchmark::ZstdCompress;
+            }
+            else if (name == Slice("zstduncomp"))
+            {
+                method = &Benchmark::ZstdUncompress;
+            }
             else if (name == Slice("heapprofile"))
             {
                 HeapProfile();
@@ -692,16 +870,29 @@ private:
     }
 
     void Crc32c(ThreadState* thread)
+    {
+        Crc32c(thread, crc32c::Extend,
+               crc32c::IsHardwareAccelerated() ? "(4K per op, sse4.2)"
+               : "(4K per op, portable)");
+    }
+
+    void Crc32cPortable(ThreadState* thread)
+    {
+        Crc32c(thread, crc32c::ExtendPortable, "(4K per op, portable)");
+    }
+
+    void Crc32c(ThreadState* thread,
+                uint32_t (*extend)(uint32_t, const char*, size_t),
+                const char* label)
     {
         // Checksum about 500MB of data total
         const int size = 4096;
-        const char* label = "(4K per op)";
         std::string data(size, 'x');
         int64_t bytes = 0;
         uint32_t crc = 0;
         while (bytes < 500 * 1048576)
         {
-            crc = crc32c::Value(data.data(), size);
+            crc = (*extend)(0, data.data(), size);
             thread->stats.FinishedSingleOp();
             bytes += size;
         }
@@ -733,6 +924,42 @@ private:
 
     void SnappyCompress(ThreadState* thread)
     {
+        Compress(thread, kSnappyCompression);
+    }
+
+    void SnappyUncompress(ThreadState* thread)
+    {
+        Uncompress(thread, kSnappyCompression);
+    }
+
+    void LZ4Compress(ThreadState* thread)
+    {
+        Compress(thread, kLZ4Compression);
+    }
+
+    void LZ4Uncompress(ThreadState* thread)
+    {
+        Uncompress(thread, kLZ4Compression);
+    }
+
+    void LZ4HCCompress(ThreadState* thread)
+    {
+        Compress(thread, kLZ4HCCompression);
+    }
+
+    void ZstdCompress(ThreadState* thread)
+    {
+        Compress(thread, kZstdCompression);
+    }
+
+    void ZstdUncompress(ThreadState* thread)
+    {
+        Uncompress(thread, kZstdCompression);
+    }
+
+    void Compress(ThreadState* thread, CompressionType type)
+    {
+        const Compressor* compressor = GetCompressor(type);
         RandomGenerator gen;
         Slice input = gen.Generate(Options().block_size);
         int64_t bytes = 0;
@@ -741,7 +968,7 @@ private:
         std::string compressed;
         while (ok && bytes < 1024 * 1048576)    // Compress 1G
         {
-            ok = port::Snappy_Compress(input.data(), input.size(), &compressed);
+            ok = compressor->Compress(input.data(), input.size(), &compressed);
             produced += compressed.size();
             bytes += input.size();
             thread->stats.FinishedSingleOp();
@@ -749,7 +976,7 @@ private:
 
         if (!ok)
         {
-            thread->stats.AddMessage("(snappy failure)");
+            thread->stats.AddMessage("(compression failure)");
         }
         else
         {
@@ -761,18 +988,19 @@ private:
         }
     }
 
-    void SnappyUncompress(ThreadState* thread)
+    void Uncompress(ThreadState* thread, CompressionType type)
     {
+        const Compressor* compressor = GetCompressor(type);
         RandomGenerator gen;
         Slice input = gen.Generate(Options().block_size);
         std::string compressed;
-        bool ok = port::Snappy_Compress(input.data(), input.size(), &compressed);
+        bool ok = compressor->Compress(input.data(), input.size(), &compressed);
         int64_t bytes = 0;
         char* uncompressed = new char[input.size()];
         while (ok && bytes < 1024 * 1048576)    // Compress 1G
         {
-            ok =  port::Snappy_Uncompress(compressed.data(), compressed.size(),
-                                          uncompressed);
+            ok = compressor->Uncompress(compressed.data(), compressed.size(),
+                                        uncompressed);
             bytes += input.size();
             thread->stats.FinishedSingleOp();
         }
@@ -780,7 +1008,7 @@ private:
 
         if (!ok)
         {
-            thread->stats.AddMessage("(snappy failure)");
+            thread->stats.AddMessage("(compression failure)");
         }
         else
         {
@@ -794,7 +1022,52 @@ private:
         Options options;
         options.create_if_missing = !FLAGS_use_existing_db;
         options.block_cache = cache_;
+        options.data_block_hash_index = FLAGS_data_block_hash_index;
+        options.index_partition_size = FLAGS_index_partition_size;
+        if (FLAGS_tail_prefetch_size >= 0)
+        {
+            options.tail_prefetch_size = FLAGS_tail_prefetch_size;
+        }
+        options.cache_index_and_filter_blocks =
+            FLAGS_cache_index_and_filter_blocks;
         options.write_buffer_size = FLAGS_write_buffer_size;
+        options.max_background_compactions = FLAGS_max_background_compactions;
+        options.max_subcompactions = FLAGS_max_subcompactions;
+        options.level_compaction_dynamic_level_bytes = FLAGS_dynamic_level_bytes;
+        if (FLAGS_delayed_write_rate_mb >= 0)
+        {
+            options.delayed_write_rate =
+                static_cast<uint64_t>(FLAGS_delayed_write_rate_mb) << 20;
+        }
+        if (FLAGS_soft_pending_compaction_mb >= 0)
+        {
+            options.soft_pending_compaction_bytes_limit =
+                static_cast<uint64_t>(FLAGS_soft_pending_compaction_mb) << 20;
+        }
+        if (FLAGS_hard_pending_compaction_mb >= 0)
+        {
+            options.hard_pending_compaction_bytes_limit =
+                static_cast<uint64_t>(FLAGS_hard_pending_compaction_mb) << 20;
+        }
+        options.max_mmap_read_bytes =
+            static_cast<uint64_t>(FLAGS_mmap_read_mb) << 20;
+        options.allow_concurrent_memtable_write =
+            FLAGS_concurrent_memtable_write;
+        options.filter_policy = filter_policy_;
+        options.memtable_factory = memtable_factory_;
+        options.compression = compression_;
+        options.compression_threads = FLAGS_compression_threads;
+        options.compression_dictionary_size =
+            FLAGS_compression_dictionary_size;
+        if (!compression_per_level_.empty())
+        {
+            options.compression_per_level = &compression_per_level_[0];
+            options.compression_per_level_size = compression_per_level_.size();
+        }
+        if (FLAGS_prefix_seek)
+        {
+            options.prefix_extractor = prefix_extractor_;
+        }
         Status s = DB::Open(options, FLAGS_db, &db_);
         if (!s.ok())
         {
@@ -848,6 +1121,49 @@ private:
         thread->stats.AddBytes(bytes);
     }
 
+    void FillIngest(ThreadState* thread)
+    {
+        Options options;
+        options.filter_policy = filter_policy_;
+        options.compression = compression_;
+        if (FLAGS_prefix_seek)
+        {
+            options.prefix_extractor = prefix_extractor_;
+        }
+        const std::string fname = std::string(FLAGS_db) + ".ingest.sst";
+        RandomGenerator gen;
+        Status s;
+        int64_t bytes = 0;
+        for (int i = 0; i < num_; )
+        {
+            SstFileWriter writer(options);
+            s = writer.Open(fname);
+            for (; s.ok() && i < num_ &&
+                    writer.FileSize() < FLAGS_write_buffer_size; i++)
+            {
+                char key[100];
+                snprintf(key, sizeof(key), "%016d", i);
+                s = writer.Put(key, gen.Generate(value_size_));
+                bytes += value_size_ + strlen(key);
+                thread->stats.FinishedSingleOp();
+            }
+            if (s.ok())
+            {
+                s = writer.Finish();
+            }
+            if (s.ok())
+            {
+                s = db_->IngestExternalFile(fname);
+            }
+            if (!s.ok())
+            {
+                fprintf(stderr, "ingest error: %s\n", s.ToString().c_str());
+                exit(1);
+            }
+        }
+        thread->stats.AddBytes(bytes);
+    }
+
     void ReadSequential(ThreadState* thread)
     {
         Iterator* iter = db_->NewIterator(ReadOptions());
@@ -892,6 +1208,57 @@ private:
         }
     }
 
+    void SeekPrefix(ThreadState* thread)
+    {
+        ReadOptions options;
+        options.prefix_same_as_start = FLAGS_prefix_seek;
+        Iterator* iter = db_->NewIterator(options);
+        int64_t bytes = 0;
+        for (int i = 0; i < reads_; i++)
+        {
+            char key[100];
+            const int k = thread->rand.Next() % (2 * FLAGS_num);
+            snprintf(key, sizeof(key), "%016d", k - k % 100);
+            const Slice prefix(key, 14);
+            for (iter->Seek(key);
+                    iter->Valid() && iter->key().starts_with(prefix);
+                    iter->Next())
+            {
+                bytes += iter->key().size() + iter->value().size();
+            }
+            thread->stats.FinishedSingleOp();
+        }
+        delete iter;
+        thread->stats.AddBytes(bytes);
+    }
+
+    void MultiReadRandom(ThreadState* thread)
+    {
+        ReadOptions options;
+        const int batch = FLAGS_multiget_batch_size;
+        std::vector<std::string> key_strings(batch);
+        std::vector<Slice> keys(batch);
+        std::vector<std::string> values(batch);
+        std::vector<Status> statuses(batch);
+        for (int i = 0; i < reads_; i += batch)
+        {
+            const int n = (reads_ - i < batch) ? reads_ - i : batch;
+            for (int j = 0; j < n; j++)
+            {
+                char key[100];
+                const int k = thread->rand.Next() % FLAGS_num;
+                snprintf(key, sizeof(key), "%016d", k);
+                key_strings[j] = key;
+                keys[j] = key_strings[j];
+            }
+            db_->MultiGet(options, &keys[0], n, &values[0], &statuses[0]);
+            for (int j = 0; j < n; j++)
+            {
+                thread->stats.FinishedSingleOp();
+            }
+        }
+    }
+
     void ReadHot(ThreadState* thread)
     {
         ReadOptions options;
@@ -946,23 +1313,7 @@ private:
 
     void Compact(ThreadState* thread)
     {
-        DBImpl* dbi = reinterpret_cast<DBImpl*>(db_);
-        dbi->TEST_CompactMemTable();
-        int max_level_with_files = 1;
-        for (int level = 1; level < config::kNumLevels; level++)
-        {
-            std::string property;
-            char name[100];
-            snprintf(name, sizeof(name), "leveldb.num-files-at-level%d", level);
-            if (db_->GetProperty(name, &property) && atoi(property.c_str()) > 0)
-            {
-                max_level_with_files = level;
-            }
-        }
-        for (int level = 0; level < max_level_with_files; level++)
-        {
-            dbi->TEST_CompactRange(level, "", "~");
-        }
+        db_->CompactRange(NULL, NULL);
     }
 
     void PrintStats()
@@ -1007,6 +1358,9 @@ int main(int argc, char** argv)
 {
     FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
     FLAGS_open_files = leveldb::Options().max_open_files;
+    FLAGS_max_background_compactions =
+        leveldb::Options().max_background_compactions;
+    FLAGS_max_subcompactions = leveldb::Options().max_subcompactions;
 
     for (int i = 1; i < argc; i++)
     {
@@ -1055,10 +1409,117 @@ int main(int argc, char** argv)
         {
             FLAGS_cache_size = n;
         }
+        else if (sscanf(argv[i], "--clock_cache=%d%c", &n, &junk) == 1 &&
+                 (n == 0 || n == 1))
+        {
+            FLAGS_clock_cache = n;
+        }
+        else if (sscanf(argv[i], "--cache_high_pri_pool_ratio=%lf%c",
+                        &d, &junk) == 1 && d >= 0.0 && d <= 1.0)
+        {
+            FLAGS_cache_high_pri_pool_ratio = d;
+        }
+        else if (sscanf(argv[i], "--cache_index_and_filter_blocks=%d%c",
+                        &n, &junk) == 1 &&
+                 (n == 0 || n == 1))
+        {
+            FLAGS_cache_index_and_filter_blocks = n;
+        }
+        else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1)
+        {
+            FLAGS_bloom_bits = n;
+        }
+        else if (sscanf(argv[i], "--multiget_batch_size=%d%c",
+                        &n, &junk) == 1 && n > 0)
+        {
+            FLAGS_multiget_batch_size = n;
+        }
         else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1)
         {
             FLAGS_open_files = n;
         }
+        else if (sscanf(argv[i], "--max_background_compactions=%d%c",
+                        &n, &junk) == 1)
+        {
+            FLAGS_max_background_compactions = n;
+        }
+        else if (sscanf(argv[i], "--max_subcompactions=%d%c", &n, &junk) == 1)
+        {
+            FLAGS_max_subcompactions = n;
+        }
+        else if (sscanf(argv[i], "--dynamic_level_bytes=%d%c",
+                        &n, &junk) == 1 &&
+                 (n == 0 || n == 1))
+        {
+            FLAGS_dynamic_level_bytes = n;
+        }
+        else if (sscanf(argv[i], "--delayed_write_rate_mb=%d%c",
+                        &n, &junk) == 1 && n > 0)
+        {
+            FLAGS_delayed_write_rate_mb = n;
+        }
+        else if (sscanf(argv[i], "--soft_pending_compaction_mb=%d%c",
+                        &n, &junk) == 1 && n >= 0)
+        {
+            FLAGS_soft_pending_compaction_mb = n;
+        }
+        else if (sscanf(argv[i], "--hard_pending_compaction_mb=%d%c",
+                        &n, &junk) == 1 && n >= 0)
+        {
+            FLAGS_hard_pending_compaction_mb = n;
+        }
+        else if (sscanf(argv[i], "--compression_threads=%d%c", &n, &junk) == 1)
+        {
+            FLAGS_compression_threads = n;
+        }
+        else if (sscanf(argv[i], "--compression_dictionary_size=%d%c",
+                        &n, &junk) == 1 && n >= 0)
+        {
+            FLAGS_compression_dictionary_size = n;
+        }
+        else if (sscanf(argv[i], "--mmap_read_mb=%d%c", &n, &junk) == 1 &&
+                 n >= 0)
+        {
+            FLAGS_mmap_read_mb = n;
+        }
+        else if (sscanf(argv[i], "--data_block_hash_index=%d%c",
+                        &n, &junk) == 1 &&
+                 (n == 0 || n == 1))
+        {
+            FLAGS_data_block_hash_index = n;
+        }
+        else if (sscanf(argv[i], "--index_partition_size=%d%c",
+                        &n, &junk) == 1 && n >= 0)
+        {
+            FLAGS_index_partition_size = n;
+        }
+        else if (sscanf(argv[i], "--tail_prefetch_size=%d%c", &n, &junk) == 1)
+        {
+            FLAGS_tail_prefetch_size = n;
+        }
+        else if (sscanf(argv[i], "--concurrent_memtable_write=%d%c",
+                        &n, &junk) == 1 &&
+                 (n == 0 || n == 1))
+        {
+            FLAGS_concurrent_memtable_write = n;
+        }
+        else if (sscanf(argv[i], "--prefix_seek=%d%c", &n, &junk) == 1 &&
+                 (n == 0 || n == 1))
+        {
+            FLAGS_prefix_seek = n;
+        }
+        else if (strncmp(argv[i], "--memtablerep=", 14) == 0)
+        {
+            FLAGS_memtablerep = argv[i] + 14;
+        }
+        else if (strncmp(argv[i], "--compression=", 14) == 0)
+        {
+            FLAGS_compression = argv[i] + 14;
+        }
+        else if (strncmp(argv[i], "--compression_per_level=", 24) == 0)
+        {
+            FLAGS_compression_per_level = argv[i] + 24;
+        }
         else if (strncmp(argv[i], "--db=", 5) == 0)
         {
             FLAGS_db = argv[i] + 5;
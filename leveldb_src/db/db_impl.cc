@@ -30,8 +30,10 @@
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/worker_pool.h"
 
 namespace leveldb
 {
@@ -61,6 +63,12 @@ struct DBImpl::CompactionState
 
     uint64_t total_bytes;
 
+    // Inputs with user keys in [*begin, *end) are compacted using this
+    // state.  NULL means the range is unbounded on that side.
+    const std::string* begin;
+    const std::string* end;
+    Compaction::Cursor cursor;
+
     Output* current_output()
     {
         return &outputs[outputs.size()-1];
@@ -70,7 +78,9 @@ struct DBImpl::CompactionState
         : compaction(c),
           outfile(NULL),
           builder(NULL),
-          total_bytes(0)
+          total_bytes(0),
+          begin(NULL),
+          end(NULL)
     {
     }
 };
@@ -84,13 +94,24 @@ static void ClipToRange(T* ptr, V minvalue, V maxvalue)
 }
 Options SanitizeOptions(const std::string& dbname,
                         const InternalKeyComparator* icmp,
+                        const InternalFilterPolicy* ipolicy,
+                        const InternalKeySliceTransform* iprefix,
                         const Options& src)
 {
     Options result = src;
     result.comparator = icmp;
+    result.filter_policy = (src.filter_policy != NULL) ? ipolicy : NULL;
+    result.prefix_extractor = (src.prefix_extractor != NULL) ? iprefix : NULL;
     ClipToRange(&result.max_open_files,           20,     50000);
+    ClipToRange(&result.max_background_compactions, 1,    64);
+    ClipToRange(&result.max_subcompactions,       1,      64);
     ClipToRange(&result.write_buffer_size,        64<<10, 1<<30);
     ClipToRange(&result.block_size,               1<<10,  4<<20);
+    if (result.memtable_factory != NULL &&
+            !result.memtable_factory->IsInsertConcurrentlySupported())
+    {
+        result.allow_concurrent_memtable_write = false;
+    }
     if (result.info_log == NULL)
     {
         // Open a log file in the same directory as the db
@@ -107,31 +128,70 @@ Options SanitizeOptions(const std::string& dbname,
     {
         result.block_cache = NewLRUCache(8 << 20);
     }
+    if (result.compression_per_level_size <= 0)
+    {
+        result.compression_per_level = NULL;
+    }
+    return result;
+}
+
+// The options for table files written to "level", which use the
+// compression configured for that level
+static Options TableOptionsForLevel(const Options& options, int level)
+{
+    Options result = options;
+    if (options.compression_per_level != NULL)
+    {
+        const int i = std::min(level, options.compression_per_level_size - 1);
+        result.compression = options.compression_per_level[i];
+    }
     return result;
 }
 
 DBImpl::DBImpl(const Options& options, const std::string& dbname)
     : env_(options.env),
       internal_comparator_(options.comparator),
-      options_(SanitizeOptions(dbname, &internal_comparator_, options)),
+      internal_filter_policy_(options.filter_policy),
+      internal_prefix_extractor_(options.prefix_extractor),
+      options_(SanitizeOptions(dbname, &internal_comparator_,
+                               &internal_filter_policy_,
+                               &internal_prefix_extractor_, options)),
       owns_info_log_(options_.info_log != options.info_log),
       owns_cache_(options_.block_cache != options.block_cache),
       dbname_(dbname),
       db_lock_(NULL),
       shutting_down_(NULL),
       bg_cv_(&mutex_),
-      mem_(new MemTable(internal_comparator_)),
+      mem_(new MemTable(internal_comparator_, options_.memtable_factory)),
       imm_(NULL),
       logfile_(NULL),
       logfile_number_(0),
       log_(NULL),
-      logger_(NULL),
-      logger_cv_(&mutex_),
-      bg_compaction_scheduled_(false),
-      manual_compaction_(NULL)
+      tmp_batch_(new WriteBatch),
+      bg_compactions_scheduled_(0),
+      bg_compactions_running_(0),
+      subcompaction_pool_(NULL),
+      bg_memtable_compacting_(false),
+      logging_manifest_(false),
+      last_compaction_manual_(false),
+      read_view_(NULL),
+      manual_compaction_(NULL),
+      write_controller_(options_.delayed_write_rate)
 {
     mem_->Ref();
     has_imm_.Release_Store(NULL);
+    for (int i = 0; i < kNumReadViewSlots; i++)
+    {
+        read_view_slots_[i].view.NoBarrier_Store(NULL);
+    }
+    env_->SetBackgroundThreads(options_.max_background_compactions);
+    if (options_.max_subcompactions > 1)
+    {
+        // Enough for every background compaction to run all its ranges
+        subcompaction_pool_ = new WorkerPool(
+            env_, (options_.max_subcompactions - 1) *
+            options_.max_background_compactions);
+    }
 
     // Reserve ten files or so for other uses and give the rest to TableCache.
     const int table_cache_size = options.max_open_files - 10;
@@ -146,11 +206,18 @@ DBImpl::~DBImpl()
     // Wait for background work to finish
     mutex_.Lock();
     shutting_down_.Release_Store(this);  // Any non-NULL value is ok
-    while (bg_compaction_scheduled_)
+    while (bg_compactions_scheduled_ > 0)
     {
         bg_cv_.Wait();
     }
+    ClearReadViewSlots();
+    if (read_view_.NoBarrier_Load() != NULL)
+    {
+        UnrefReadView(reinterpret_cast<ReadView*>(read_view_.NoBarrier_Load()));
+        read_view_.Release_Store(NULL);
+    }
     mutex_.Unlock();
+    delete subcompaction_pool_;
 
     if (db_lock_ != NULL)
     {
@@ -160,6 +227,7 @@ DBImpl::~DBImpl()
     delete versions_;
     if (mem_ != NULL) mem_->Unref();
     if (imm_ != NULL) imm_->Unref();
+    delete tmp_batch_;
     delete log_;
     delete logfile_;
     delete table_cache_;
@@ -442,7 +510,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
 
         if (mem == NULL)
         {
-            mem = new MemTable(internal_comparator_);
+            mem = new MemTable(internal_comparator_, options_.memtable_factory);
             mem->Ref();
         }
         status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -461,7 +529,9 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
 
         if (mem->ApproximateMemoryUsage() > options_.write_buffer_size)
         {
-            status = WriteLevel0Table(mem, edit, NULL);
+            uint64_t number;
+            status = WriteLevel0Table(mem, edit, NULL, &number);
+            pending_outputs_.erase(number);
             if (!status.ok())
             {
                 // Reflect errors immediately so that conditions like full
@@ -475,7 +545,9 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
 
     if (status.ok() && mem != NULL)
     {
-        status = WriteLevel0Table(mem, edit, NULL);
+        uint64_t number;
+        status = WriteLevel0Table(mem, edit, NULL, &number);
+        pending_outputs_.erase(number);
         // Reflect errors immediately so that conditions like full
         // file-systems cause the DB::Open() to fail.
     }
@@ -486,13 +558,15 @@ Status DBImpl::RecoverLogFile(uint64_t log_number,
 }
 
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base)
+                                Version* base, uint64_t* number)
 {
     mutex_.AssertHeld();
     const uint64_t start_micros = env_->NowMicros();
     FileMetaData meta;
     meta.number = versions_->NewFileNumber();
     pending_outputs_.insert(meta.number);
+    *number = meta.number;
+    mem->MarkReadOnly();    // Nothing is added to a memtable being flushed
     Iterator* iter = mem->NewIterator();
     Log(options_.info_log, "Level-0 table #%llu: started",
         (unsigned long long) meta.number);
@@ -500,7 +574,8 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     Status s;
     {
         mutex_.Unlock();
-        s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+        s = BuildTable(dbname_, env_, TableOptionsForLevel(options_, 0),
+                       table_cache_, iter, &meta);
         mutex_.Lock();
     }
 
@@ -509,8 +584,6 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
         (unsigned long long) meta.file_size,
         s.ToString().c_str());
     delete iter;
-    pending_outputs_.erase(meta.number);
-
 
     // Note that if file_size is zero, the file has been deleted and
     // should not be added to the manifest.
@@ -519,12 +592,20 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     {
         const Slice min_user_key = meta.smallest.user_key();
         const Slice max_user_key = meta.largest.user_key();
-        if (base != NULL && !base->OverlapInLevel(0, min_user_key, max_user_key))
+        // Push the new sstable to a higher level if possible to reduce
+        // expensive manifest file ops.  Only do so while no table
+        // compaction is running or has been installed since "base" was
+        // current: such a compaction may be writing files into the levels
+        // that are checked here.
+        // With dynamic level targets the levels above the base level have
+        // to stay empty.
+        if (base != NULL && base == versions_->current() &&
+                !options_.level_compaction_dynamic_level_bytes &&
+                bg_compactions_running_ == 0 && !logging_manifest_ &&
+                !base->OverlapInLevel(0, &min_user_key, &max_user_key))
         {
-            // Push the new sstable to a higher level if possible to reduce
-            // expensive manifest file ops.
             while (level < config::kMaxMemCompactLevel &&
-                    !base->OverlapInLevel(level + 1, min_user_key, max_user_key))
+                    !base->OverlapInLevel(level + 1, &min_user_key, &max_user_key))
             {
                 level++;
             }
@@ -544,12 +625,15 @@ Status DBImpl::CompactMemTable()
 {
     mutex_.AssertHeld();
     assert(imm_ != NULL);
+    assert(!bg_memtable_compacting_);
+    bg_memtable_compacting_ = true;
 
     // Save the contents of the memtable as a new Table
     VersionEdit edit;
     Version* base = versions_->current();
     base->Ref();
-    Status s = WriteLevel0Table(imm_, &edit, base);
+    uint64_t number;
+    Status s = WriteLevel0Table(imm_, &edit, base, &number);
     base->Unref();
 
     if (s.ok() && shutting_down_.Acquire_Load())
@@ -562,8 +646,9 @@ Status DBImpl::CompactMemTable()
     {
         edit.SetPrevLogNumber(0);
         edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-        s = versions_->LogAndApply(&edit, &mutex_);
+        s = InstallVersionEdit(&edit);
     }
+    pending_outputs_.erase(number);
 
     if (s.ok())
     {
@@ -571,47 +656,173 @@ Status DBImpl::CompactMemTable()
         imm_->Unref();
         imm_ = NULL;
         has_imm_.Release_Store(NULL);
+        InstallReadView();
         DeleteObsoleteFiles();
     }
 
+    bg_memtable_compacting_ = false;
     return s;
 }
 
-void DBImpl::TEST_CompactRange(
+Status DBImpl::InstallVersionEdit(VersionEdit* edit)
+{
+    mutex_.AssertHeld();
+    while (logging_manifest_)
+    {
+        bg_cv_.Wait();
+    }
+    logging_manifest_ = true;
+    Status s = versions_->LogAndApply(edit, &mutex_);
+    if (s.ok())
+    {
+        InstallReadView();
+    }
+    logging_manifest_ = false;
+    bg_cv_.SignalAll();
+    return s;
+}
+
+void DBImpl::InstallReadView()
+{
+    mutex_.AssertHeld();
+    ReadView* view = new ReadView;
+    view->mem = mem_;
+    view->imm = imm_;
+    view->current = versions_->current();
+    view->refs = 1;     // Held by read_view_
+    view->mem->Ref();
+    if (view->imm != NULL) view->imm->Ref();
+    view->current->Ref();
+
+    ReadView* old = reinterpret_cast<ReadView*>(read_view_.NoBarrier_Load());
+    read_view_.Release_Store(view);
+    ClearReadViewSlots();
+    if (old != NULL)
+    {
+        UnrefReadView(old);
+    }
+}
+
+void DBImpl::UnrefReadView(ReadView* view)
+{
+    mutex_.AssertHeld();
+    assert(view->refs > 0);
+    if (--view->refs == 0)
+    {
+        view->mem->Unref();
+        if (view->imm != NULL) view->imm->Unref();
+        view->current->Unref();
+        delete view;
+    }
+}
+
+// Marks a read view slot whose view is borrowed by a reader
+static char read_view_in_use;
+static void* const kReadViewInUse = &read_view_in_use;
+
+void DBImpl::ClearReadViewSlots()
+{
+    mutex_.AssertHeld();
+    // Dropping the cached views here, rather than when a reader next
+    // notices they are stale, lets obsolete memtables and files go away
+    // even if the threads that cached them never read again.
+    for (int i = 0; i < kNumReadViewSlots; i++)
+    {
+        void* cached = read_view_slots_[i].view.Exchange(NULL);
+        if (cached != NULL && cached != kReadViewInUse)
+        {
+            UnrefReadView(reinterpret_cast<ReadView*>(cached));
+        }
+    }
+}
+
+void DBImpl::CompactRange(const Slice* begin, const Slice* end)
+{
+    int max_level_with_files = 1;
+    {
+        MutexLock l(&mutex_);
+        Version* base = versions_->current();
+        for (int level = 1; level < config::kNumLevels; level++)
+        {
+            if (base->OverlapInLevel(level, begin, end))
+            {
+                max_level_with_files = level;
+            }
+        }
+    }
+    TEST_CompactMemTable();
+    for (int level = 0; level < max_level_with_files; level++)
+    {
+        RunManualCompaction(level, begin, end);
+    }
+}
+
+void DBImpl::RunManualCompaction(
     int level,
-    const std::string& begin,
-    const std::string& end)
+    const Slice* begin,
+    const Slice* end)
 {
     assert(level >= 0);
     assert(level + 1 < config::kNumLevels);
 
+    InternalKey begin_storage, end_storage;
+
+    ManualCompaction manual;
+    manual.level = level;
+    manual.done = false;
+    manual.running = 0;
+    if (begin == NULL)
+    {
+        manual.begin = NULL;
+    }
+    else
+    {
+        begin_storage = InternalKey(*begin, kMaxSequenceNumber, kValueTypeForSeek);
+        manual.begin = &begin_storage;
+    }
+    if (end == NULL)
+    {
+        manual.end = NULL;
+    }
+    else
+    {
+        end_storage = InternalKey(*end, 0, static_cast<ValueType>(0));
+        manual.end = &end_storage;
+    }
+
     MutexLock l(&mutex_);
     while (manual_compaction_ != NULL)
     {
         bg_cv_.Wait();
     }
-    ManualCompaction manual;
-    manual.level = level;
-    manual.begin = begin;
-    manual.end = end;
     manual_compaction_ = &manual;
     MaybeScheduleCompaction();
-    while (manual_compaction_ == &manual)
+    while (manual.running > 0 ||
+            (!manual.done && bg_error_.ok() && !shutting_down_.Acquire_Load()))
     {
         bg_cv_.Wait();
     }
+    manual_compaction_ = NULL;
+    bg_cv_.SignalAll();
+}
+
+void DBImpl::TEST_CompactRange(
+    int level,
+    const std::string& begin,
+    const std::string& end)
+{
+    Slice b(begin), e(end);
+    RunManualCompaction(level, &b, &e);
 }
 
 Status DBImpl::TEST_CompactMemTable()
 {
-    MutexLock l(&mutex_);
-    LoggerId self;
-    AcquireLoggingResponsibility(&self);
-    Status s = MakeRoomForWrite(true /* force compaction */);
-    ReleaseLoggingResponsibility(&self);
+    // A NULL batch forces a memtable switch once earlier writes are done
+    Status s = Write(WriteOptions(), NULL);
     if (s.ok())
     {
         // Wait until the compaction completes
+        MutexLock l(&mutex_);
         while (imm_ != NULL && bg_error_.ok())
         {
             bg_cv_.Wait();
@@ -627,23 +838,23 @@ Status DBImpl::TEST_CompactMemTable()
 void DBImpl::MaybeScheduleCompaction()
 {
     mutex_.AssertHeld();
-    if (bg_compaction_scheduled_)
+    if (bg_compactions_scheduled_ >= options_.max_background_compactions)
     {
-        // Already scheduled
+        // Already scheduled as many as allowed
     }
     else if (shutting_down_.Acquire_Load())
     {
         // DB is being deleted; no more background compactions
     }
-    else if (imm_ == NULL &&
-             manual_compaction_ == NULL &&
+    else if ((imm_ == NULL || bg_memtable_compacting_) &&
+             (manual_compaction_ == NULL || manual_compaction_->done) &&
              !versions_->NeedsCompaction())
     {
         // No work to be done
     }
     else
     {
-        bg_compaction_scheduled_ = true;
+        bg_compactions_scheduled_++;
         env_->Schedule(&DBImpl::BGWork, this);
     }
 }
@@ -656,62 +867,104 @@ void DBImpl::BGWork(void* db)
 void DBImpl::BackgroundCall()
 {
     MutexLock l(&mutex_);
-    assert(bg_compaction_scheduled_);
+    assert(bg_compactions_scheduled_ > 0);
+    bool did_work = false;
     if (!shutting_down_.Acquire_Load())
     {
-        BackgroundCompaction();
+        did_work = BackgroundCompaction();
     }
-    bg_compaction_scheduled_ = false;
+    bg_compactions_scheduled_--;
 
     // Previous compaction may have produced too many files in a level,
-    // so reschedule another compaction if needed.
-    MaybeScheduleCompaction();
+    // so reschedule another compaction if needed.  A call that found all
+    // remaining work busy does not reschedule, since it would only spin;
+    // the jobs it conflicted with reschedule when they finish.
+    if (did_work)
+    {
+        MaybeScheduleCompaction();
+    }
     bg_cv_.SignalAll();
 }
 
-void DBImpl::BackgroundCompaction()
+bool DBImpl::BackgroundCompaction()
 {
     mutex_.AssertHeld();
 
-    if (imm_ != NULL)
+    if (imm_ != NULL && !bg_memtable_compacting_)
     {
+        // Let another thread work on table compactions meanwhile
+        MaybeScheduleCompaction();
         CompactMemTable();
-        return;
+        return true;
     }
 
-    Compaction* c;
-    bool is_manual = (manual_compaction_ != NULL);
-    if (is_manual)
+    // The current version does not reflect an edit that is being logged
+    // yet, so wait for it before picking input files.
+    while (logging_manifest_)
     {
-        const ManualCompaction* m = manual_compaction_;
-        c = versions_->CompactRange(
-                m->level,
-                InternalKey(m->begin, kMaxSequenceNumber, kValueTypeForSeek),
-                InternalKey(m->end, 0, static_cast<ValueType>(0)));
+        bg_cv_.Wait();
     }
-    else
+
+    // Pieces of a manual compaction alternate with the compactions the
+    // version set asks for, so that neither starves the other.
+    Compaction* c = NULL;
+    ManualCompaction* m = NULL;
+    bool tried_automatic = false;
+    const bool manual_pending =
+        (manual_compaction_ != NULL && !manual_compaction_->done);
+    if (manual_pending && last_compaction_manual_ &&
+            versions_->NeedsCompaction())
+    {
+        c = versions_->PickCompaction();
+        tried_automatic = true;
+    }
+    if (c == NULL && manual_pending)
+    {
+        m = manual_compaction_;
+        c = versions_->CompactRange(m->level, m->begin, m->end, &m->done);
+        if (c != NULL)
+        {
+            // The next piece starts after the last key handed out here
+            const FileMetaData* last = c->input(0, c->num_input_files(0) - 1);
+            m->tmp_storage = InternalKey(last->largest.user_key(), 0,
+                                         static_cast<ValueType>(0));
+            m->begin = &m->tmp_storage;
+            m->running++;
+        }
+        else
+        {
+            m = NULL;
+        }
+    }
+    if (c == NULL && !tried_automatic)
     {
         c = versions_->PickCompaction();
     }
-
-    Status status;
     if (c == NULL)
     {
-        // Nothing to do
+        // Nothing to do, or all candidates are being compacted
+        return false;
     }
-    else if (!is_manual && c->IsTrivialMove())
+    last_compaction_manual_ = (m != NULL);
+
+    // Remaining work may be picked up by other threads
+    bg_compactions_running_++;
+    MaybeScheduleCompaction();
+
+    Status status;
+    if (m == NULL && c->IsTrivialMove())
     {
         // Move file to next level
         assert(c->num_input_files(0) == 1);
         FileMetaData* f = c->input(0, 0);
         c->edit()->DeleteFile(c->level(), f->number);
-        c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
+        c->edit()->AddFile(c->output_level(), f->number, f->file_size,
                            f->smallest, f->largest);
-        status = versions_->LogAndApply(c->edit(), &mutex_);
+        status = InstallVersionEdit(c->edit());
         VersionSet::LevelSummaryStorage tmp;
         Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
             static_cast<unsigned long long>(f->number),
-            c->level() + 1,
+            c->output_level(),
             static_cast<unsigned long long>(f->file_size),
             status.ToString().c_str(),
             versions_->LevelSummary(&tmp));
@@ -723,6 +976,7 @@ void DBImpl::BackgroundCompaction()
         CleanupCompaction(compact);
     }
     delete c;
+    bg_compactions_running_--;
 
     if (status.ok())
     {
@@ -742,11 +996,12 @@ void DBImpl::BackgroundCompaction()
         }
     }
 
-    if (is_manual)
+    if (m != NULL)
     {
-        // Mark it as done
-        manual_compaction_ = NULL;
+        // RunManualCompaction() waits for all of its pieces to finish
+        m->running--;
     }
+    return true;
 }
 
 void DBImpl::CleanupCompaction(CompactionState* compact)
@@ -793,7 +1048,9 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact)
     Status s = env_->NewWritableFile(fname, &compact->outfile);
     if (s.ok())
     {
-        compact->builder = new TableBuilder(options_, compact->outfile);
+        compact->builder = new TableBuilder(
+            TableOptionsForLevel(options_, compact->compaction->output_level()),
+            compact->outfile);
     }
     return s;
 }
@@ -865,23 +1122,23 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact)
         compact->compaction->num_input_files(0),
         compact->compaction->level(),
         compact->compaction->num_input_files(1),
-        compact->compaction->level() + 1,
+        compact->compaction->output_level(),
         static_cast<long long>(compact->total_bytes));
 
     // Add compaction outputs
     compact->compaction->AddInputDeletions(compact->compaction->edit());
-    const int level = compact->compaction->level();
+    const int level = compact->compaction->output_level();
     for (size_t i = 0; i < compact->outputs.size(); i++)
     {
         const CompactionState::Output& out = compact->outputs[i];
         compact->compaction->edit()->AddFile(
-            level + 1,
+            level,
             out.number, out.file_size, out.smallest, out.largest);
-        pending_outputs_.erase(out.number);
     }
-    compact->outputs.clear();
 
-    Status s = versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+    // The outputs stay in pending_outputs_ until CleanupCompaction(), since
+    // another thread may delete obsolete files while we wait to log.
+    Status s = InstallVersionEdit(compact->compaction->edit());
     if (s.ok())
     {
         compact->compaction->ReleaseInputs();
@@ -898,6 +1155,34 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact)
     return s;
 }
 
+// A key range of a compaction that is compacted by subcompaction_pool_
+struct DBImpl::SubcompactionTask
+{
+    DBImpl* const db;
+    CompactionState* const compact;
+    Status status;
+    bool done;       // Protected by db->mutex_
+
+    SubcompactionTask(DBImpl* d, CompactionState* parent)
+        : db(d),
+          compact(new CompactionState(parent->compaction)),
+          done(false)
+    {
+        compact->smallest_snapshot = parent->smallest_snapshot;
+    }
+};
+
+void DBImpl::BGSubcompaction(void* arg)
+{
+    SubcompactionTask* task = reinterpret_cast<SubcompactionTask*>(arg);
+    DBImpl* db = task->db;
+    Status s = db->DoSubcompactionWork(task->compact, NULL);
+    MutexLock l(&db->mutex_);
+    task->status = s;
+    task->done = true;
+    db->bg_cv_.SignalAll();
+}
+
 Status DBImpl::DoCompactionWork(CompactionState* compact)
 {
     const uint64_t start_micros = env_->NowMicros();
@@ -907,7 +1192,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
         compact->compaction->num_input_files(0),
         compact->compaction->level(),
         compact->compaction->num_input_files(1),
-        compact->compaction->level() + 1);
+        compact->compaction->output_level());
 
     assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
     assert(compact->builder == NULL);
@@ -924,8 +1209,114 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
     // Release mutex while we're actually doing the compaction work
     mutex_.Unlock();
 
+    // Split a large compaction into key ranges.  This thread compacts the
+    // first range and the others are handed to subcompaction_pool_.
+    std::vector<std::string> boundaries;
+    if (subcompaction_pool_ != NULL)
+    {
+        versions_->GetCompactionBoundaries(compact->compaction,
+                                           options_.max_subcompactions,
+                                           &boundaries);
+    }
+    std::vector<SubcompactionTask*> tasks;
+    for (size_t i = 0; i < boundaries.size(); i++)
+    {
+        SubcompactionTask* task = new SubcompactionTask(this, compact);
+        task->compact->begin = &boundaries[i];
+        if (i + 1 < boundaries.size())
+        {
+            task->compact->end = &boundaries[i + 1];
+        }
+        tasks.push_back(task);
+        subcompaction_pool_->Schedule(&DBImpl::BGSubcompaction, task);
+    }
+    if (!boundaries.empty())
+    {
+        compact->end = &boundaries[0];
+        Log(options_.info_log, "Compacting in %d key ranges",
+            static_cast<int>(boundaries.size() + 1));
+    }
+
+    Status status = DoSubcompactionWork(compact, &imm_micros);
+
+    mutex_.Lock();
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        SubcompactionTask* task = tasks[i];
+        while (!task->done)
+        {
+            if (imm_ != NULL && !bg_memtable_compacting_)
+            {
+                const uint64_t imm_start = env_->NowMicros();
+                CompactMemTable();
+                bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
+                imm_micros += (env_->NowMicros() - imm_start);
+            }
+            else
+            {
+                bg_cv_.Wait();
+            }
+        }
+        if (status.ok())
+        {
+            status = task->status;
+        }
+
+        // Take over the outputs of the range so that they are installed,
+        // or released from pending_outputs_, together with our own.
+        CompactionState* sub = task->compact;
+        compact->outputs.insert(compact->outputs.end(),
+                                sub->outputs.begin(), sub->outputs.end());
+        compact->total_bytes += sub->total_bytes;
+        sub->outputs.clear();
+        CleanupCompaction(sub);
+        delete task;
+    }
+
+    CompactionStats stats;
+    stats.micros = env_->NowMicros() - start_micros - imm_micros;
+    for (int which = 0; which < 2; which++)
+    {
+        for (int i = 0; i < compact->compaction->num_input_files(which); i++)
+        {
+            stats.bytes_read += compact->compaction->input(which, i)->file_size;
+        }
+    }
+    for (size_t i = 0; i < compact->outputs.size(); i++)
+    {
+        stats.bytes_written += compact->outputs[i].file_size;
+    }
+
+    stats_[compact->compaction->output_level()].Add(stats);
+
+    if (status.ok())
+    {
+        status = InstallCompactionResults(compact);
+    }
+    VersionSet::LevelSummaryStorage tmp;
+    Log(options_.info_log,
+        "compacted to: %s", versions_->LevelSummary(&tmp));
+    return status;
+}
+
+Status DBImpl::DoSubcompactionWork(CompactionState* compact,
+                                   int64_t* imm_micros)
+{
     Iterator* input = versions_->MakeInputIterator(compact->compaction);
-    input->SeekToFirst();
+    if (compact->begin != NULL)
+    {
+        InternalKey start(*compact->begin, kMaxSequenceNumber, kValueTypeForSeek);
+        input->Seek(start.Encode());
+    }
+    else
+    {
+        input->SeekToFirst();
+    }
+    InternalKey limit;
+    if (compact->end != NULL)
+    {
+        limit = InternalKey(*compact->end, kMaxSequenceNumber, kValueTypeForSeek);
+    }
     Status status;
     ParsedInternalKey ikey;
     std::string current_user_key;
@@ -934,21 +1325,27 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
     for (; input->Valid() && !shutting_down_.Acquire_Load(); )
     {
         // Prioritize immutable compaction work
-        if (has_imm_.NoBarrier_Load() != NULL)
+        if (imm_micros != NULL && has_imm_.NoBarrier_Load() != NULL)
         {
             const uint64_t imm_start = env_->NowMicros();
             mutex_.Lock();
-            if (imm_ != NULL)
+            if (imm_ != NULL && !bg_memtable_compacting_)
             {
                 CompactMemTable();
                 bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
             }
             mutex_.Unlock();
-            imm_micros += (env_->NowMicros() - imm_start);
+            *imm_micros += (env_->NowMicros() - imm_start);
         }
 
         Slice key = input->key();
-        if (compact->compaction->ShouldStopBefore(key) &&
+        if (compact->end != NULL &&
+                internal_comparator_.Compare(key, limit.Encode()) >= 0)
+        {
+            // The rest belongs to the next key range
+            break;
+        }
+        if (compact->compaction->ShouldStopBefore(&compact->cursor, key) &&
                 compact->builder != NULL)
         {
             status = FinishCompactionOutputFile(compact, input);
@@ -986,7 +1383,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
             }
             else if (ikey.type == kTypeDeletion &&
                      ikey.sequence <= compact->smallest_snapshot &&
-                     compact->compaction->IsBaseLevelForKey(ikey.user_key))
+                     compact->compaction->IsBaseLevelForKey(&compact->cursor,
+                                                    ikey.user_key))
             {
                 // For this user key:
                 // (1) there is no data in higher levels
@@ -1006,7 +1404,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
             "%d smallest_snapshot: %d",
             ikey.user_key.ToString().c_str(),
             (int)ikey.sequence, ikey.type, kTypeValue, drop,
-            compact->compaction->IsBaseLevelForKey(ikey.user_key),
+            compact->compaction->IsBaseLevelForKey(&compact->cursor,
+                    ikey.user_key),
             (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
@@ -1056,85 +1455,84 @@ Status DBImpl::DoCompactionWork(CompactionState* compact)
         status = input->status();
     }
     delete input;
-    input = NULL;
+    return status;
+}
 
-    CompactionStats stats;
-    stats.micros = env_->NowMicros() - start_micros - imm_micros;
-    for (int which = 0; which < 2; which++)
-    {
-        for (int i = 0; i < compact->compaction->num_input_files(which); i++)
-        {
-            stats.bytes_read += compact->compaction->input(which, i)->file_size;
-        }
-    }
-    for (size_t i = 0; i < compact->outputs.size(); i++)
+DBImpl::ReadView* DBImpl::AcquireReadView(port::AtomicPointer** slot)
+{
+    const uint64_t tid = port::ThreadIdentifier();
+    const uint32_t index = Hash(reinterpret_cast<const char*>(&tid),
+                                sizeof(tid), 0) % kNumReadViewSlots;
+    *slot = &read_view_slots_[index].view;
+
+    // Borrow the cached view.  It is only usable if it is still current;
+    // since its reference keeps it alive, it cannot be confused with a
+    // newer view that happens to reuse its address.
+    void* cached = (*slot)->Exchange(kReadViewInUse);
+    if (cached != NULL && cached == read_view_.Acquire_Load())
     {
-        stats.bytes_written += compact->outputs[i].file_size;
+        return reinterpret_cast<ReadView*>(cached);
     }
 
-    mutex_.Lock();
-    stats_[compact->compaction->level() + 1].Add(stats);
-
-    if (status.ok())
+    // The slot was empty, stale, or borrowed by another thread that hashes
+    // to the same slot.
+    MutexLock l(&mutex_);
+    if (cached != NULL && cached != kReadViewInUse)
     {
-        status = InstallCompactionResults(compact);
+        UnrefReadView(reinterpret_cast<ReadView*>(cached));
     }
-    VersionSet::LevelSummaryStorage tmp;
-    Log(options_.info_log,
-        "compacted to: %s", versions_->LevelSummary(&tmp));
-    return status;
+    ReadView* view = reinterpret_cast<ReadView*>(read_view_.NoBarrier_Load());
+    view->refs++;
+    return view;
 }
 
-namespace
+void DBImpl::ReleaseReadView(ReadView* view, port::AtomicPointer* slot)
 {
-struct IterState
-{
-    port::Mutex* mu;
-    Version* version;
-    MemTable* mem;
-    MemTable* imm;
-};
+    // Cache the reference for the next read on this thread, unless the
+    // view has been replaced or the slot was cleared while we held it.
+    if (view != read_view_.Acquire_Load() ||
+        !slot->CompareAndSwap(kReadViewInUse, view))
+    {
+        MutexLock l(&mutex_);
+        UnrefReadView(view);
+    }
+}
 
-static void CleanupIteratorState(void* arg1, void* arg2)
+void DBImpl::CleanupReadView(void* arg1, void* arg2)
 {
-    IterState* state = reinterpret_cast<IterState*>(arg1);
-    state->mu->Lock();
-    state->mem->Unref();
-    if (state->imm != NULL) state->imm->Unref();
-    state->version->Unref();
-    state->mu->Unlock();
-    delete state;
-}
+    DBImpl* db = reinterpret_cast<DBImpl*>(arg1);
+    MutexLock l(&db->mutex_);
+    db->UnrefReadView(reinterpret_cast<ReadView*>(arg2));
 }
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot)
 {
-    IterState* cleanup = new IterState;
-    mutex_.Lock();
+    port::AtomicPointer* slot;
+    ReadView* view = AcquireReadView(&slot);
+
+    // Read the sequence after acquiring the view.  Compactions installed in
+    // the view dropped entries that newer writes hide from any sequence up
+    // to the latest one when they started, so an older sequence could see
+    // through to stale values.  Writes past the view's memtables that the
+    // sequence covers raced with this call and may be left out.
     *latest_snapshot = versions_->LastSequence();
 
     // Collect together all needed child iterators
     std::vector<Iterator*> list;
-    list.push_back(mem_->NewIterator());
-    mem_->Ref();
-    if (imm_ != NULL)
+    list.push_back(view->mem->NewIterator());
+    if (view->imm != NULL)
     {
-        list.push_back(imm_->NewIterator());
-        imm_->Ref();
+        list.push_back(view->imm->NewIterator());
     }
-    versions_->current()->AddIterators(options, &list);
+    view->current->AddIterators(options, &list);
     Iterator* internal_iter =
         NewMergingIterator(&internal_comparator_, &list[0], list.size());
-    versions_->current()->Ref();
 
-    cleanup->mu = &mutex_;
-    cleanup->mem = mem_;
-    cleanup->imm = imm_;
-    cleanup->version = versions_->current();
-    internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, NULL);
-
-    mutex_.Unlock();
+    // The iterator takes over the reference instead of returning it to
+    // the slot.
+    internal_iter->RegisterCleanup(CleanupReadView, this, view);
+    slot->CompareAndSwap(kReadViewInUse, NULL);
     return internal_iter;
 }
 
@@ -1155,7 +1553,11 @@ Status DBImpl::Get(const ReadOptions& options,
                    std::string* value)
 {
     Status s;
-    MutexLock l(&mutex_);
+    port::AtomicPointer* slot;
+    ReadView* view = AcquireReadView(&slot);
+
+    // Without a snapshot, read the sequence after acquiring the view; see
+    // NewInternalIterator().
     SequenceNumber snapshot;
     if (options.snapshot != NULL)
     {
@@ -1166,56 +1568,151 @@ Status DBImpl::Get(const ReadOptions& options,
         snapshot = versions_->LastSequence();
     }
 
-    MemTable* mem = mem_;
-    MemTable* imm = imm_;
-    Version* current = versions_->current();
-    mem->Ref();
-    if (imm != NULL) imm->Ref();
-    current->Ref();
-
-    bool have_stat_update = false;
     Version::GetStats stats;
+    stats.seek_file = NULL;
 
-    // Unlock while reading from files and memtables
+    // First look in the memtable, then in the immutable memtable (if any).
+    LookupKey lkey(key, snapshot);
+    if (view->mem->Get(lkey, value, &s))
     {
-        mutex_.Unlock();
-        // First look in the memtable, then in the immutable memtable (if any).
-        LookupKey lkey(key, snapshot);
-        if (mem->Get(lkey, value, &s))
-        {
-            // Done
-        }
-        else if (imm != NULL && imm->Get(lkey, value, &s))
-        {
-            // Done
-        }
-        else
-        {
-            s = current->Get(options, lkey, value, &stats);
-            have_stat_update = true;
-        }
-        mutex_.Lock();
+        // Done
+    }
+    else if (view->imm != NULL && view->imm->Get(lkey, value, &s))
+    {
+        // Done
+    }
+    else
+    {
+        s = view->current->Get(options, lkey, value, &stats);
     }
 
-    if (have_stat_update && current->UpdateStats(stats))
+    // Only a lookup that used up a file's allowed seeks needs the mutex
+    if (Version::ChargeSeek(stats))
     {
-        MaybeScheduleCompaction();
+        MutexLock l(&mutex_);
+        if (view->current->UpdateStats(stats))
+        {
+            MaybeScheduleCompaction();
+        }
     }
-    mem->Unref();
-    if (imm != NULL) imm->Unref();
-    current->Unref();
+    ReleaseReadView(view, slot);
     return s;
 }
 
-Iterator* DBImpl::NewIterator(const ReadOptions& options)
+namespace
 {
-    SequenceNumber latest_snapshot;
-    Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot);
+// Orders indexes into an array of keys by the keys they refer to
+struct KeyIndexLess
+{
+    const Comparator* cmp;
+    const Slice* keys;
+
+    bool operator()(int a, int b) const
+    {
+        return cmp->Compare(keys[a], keys[b]) < 0;
+    }
+};
+}
+
+void DBImpl::MultiGet(const ReadOptions& options,
+                      const Slice* keys, int n,
+                      std::string* values, Status* statuses)
+{
+    port::AtomicPointer* slot;
+    ReadView* view = AcquireReadView(&slot);
+
+    // As in Get(), the sequence must not be older than the view
+    SequenceNumber snapshot;
+    if (options.snapshot != NULL)
+    {
+        snapshot = reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_;
+    }
+    else
+    {
+        snapshot = versions_->LastSequence();
+    }
+
+    // Visit the keys in sorted order so that the lookups in each table
+    // file move forward through its index and data blocks.
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    KeyIndexLess less;
+    less.cmp = user_comparator();
+    less.keys = keys;
+    std::sort(order.begin(), order.end(), less);
+
+    // Answer what we can from the memtables and collect the rest
+    std::vector<LookupKey*> lkeys;
+    std::vector<std::string*> table_values;
+    std::vector<int> table_index;
+    for (int j = 0; j < n; j++)
+    {
+        const int i = order[j];
+        LookupKey* lkey = new LookupKey(keys[i], snapshot);
+        statuses[i] = Status::OK();
+        if (view->mem->Get(*lkey, &values[i], &statuses[i]) ||
+                (view->imm != NULL && view->imm->Get(*lkey, &values[i], &statuses[i])))
+        {
+            delete lkey;
+        }
+        else
+        {
+            lkeys.push_back(lkey);
+            table_values.push_back(&values[i]);
+            table_index.push_back(i);
+        }
+    }
+
+    const int m = lkeys.size();
+    if (m > 0)
+    {
+        std::vector<Status> table_statuses(m);
+        std::vector<Version::GetStats> stats(m);
+        view->current->MultiGet(options, m, &lkeys[0], &table_values[0],
+                                &table_statuses[0], &stats[0]);
+
+        bool have_stat_update = false;
+        for (int k = 0; k < m; k++)
+        {
+            statuses[table_index[k]] = table_statuses[k];
+            if (Version::ChargeSeek(stats[k])) have_stat_update = true;
+            delete lkeys[k];
+        }
+        if (have_stat_update)
+        {
+            MutexLock l(&mutex_);
+            bool schedule = false;
+            for (int k = 0; k < m; k++)
+            {
+                if (stats[k].seek_file != NULL &&
+                        view->current->UpdateStats(stats[k]))
+                {
+                    schedule = true;
+                }
+            }
+            if (schedule)
+            {
+                MaybeScheduleCompaction();
+            }
+        }
+    }
+    ReleaseReadView(view, slot);
+}
+
+Iterator* DBImpl::NewIterator(const ReadOptions& options)
+{
+    SequenceNumber latest_snapshot;
+    Iterator* internal_iter = NewInternalIterator(options, &latest_snapshot);
     return NewDBIterator(
                &dbname_, env_, user_comparator(), internal_iter,
                (options.snapshot != NULL
                 ? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_
-                : latest_snapshot));
+                : latest_snapshot),
+               (options.prefix_same_as_start
+                ? internal_prefix_extractor_.user_transform() : NULL));
 }
 
 const Snapshot* DBImpl::GetSnapshot()
@@ -1241,98 +1738,289 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key)
     return DB::Delete(options, key);
 }
 
-// There is at most one thread that is the current logger.  This call
-// waits until preceding logger(s) have finished and becomes the
-// current logger.
-void DBImpl::AcquireLoggingResponsibility(LoggerId* self)
+// A group of writers inserting their batches into the memtable in
+// parallel (see Options::allow_concurrent_memtable_write).  Guarded by
+// DBImpl::mutex_.
+struct DBImpl::InsertGroup
 {
-    while (logger_ != NULL)
-    {
-        logger_cv_.Wait();
-    }
-    logger_ = self;
-}
+    MemTable* mem;
+    Writer* leader;
+    int pending;        // Followers that have not finished inserting
+    Status status;      // First insertion error, if any
+};
 
-void DBImpl::ReleaseLoggingResponsibility(LoggerId* self)
+// Information kept for every waiting writer
+struct DBImpl::Writer
 {
-    assert(logger_ == self);
-    logger_ = NULL;
-    logger_cv_.SignalAll();
-}
+    Status status;
+    WriteBatch* batch;
+    bool sync;
+    bool done;
+    const Snapshot** post_write_snapshot;
+    InsertGroup* insert_group;  // Non-NULL while our batch awaits insertion
+    port::CondVar cv;
+
+    explicit Writer(port::Mutex* mu) : insert_group(NULL), cv(mu) { }
+};
 
-Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates)
+Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch)
 {
-    Status status;
+    Writer w(&mutex_);
+    w.batch = my_batch;
+    w.sync = options.sync;
+    w.done = false;
+    w.post_write_snapshot = options.post_write_snapshot;
+
     MutexLock l(&mutex_);
-    LoggerId self;
-    AcquireLoggingResponsibility(&self);
-    status = MakeRoomForWrite(false);  // May temporarily release lock and wait
-    uint64_t last_sequence = versions_->LastSequence();
-    if (status.ok())
+    writers_.push_back(&w);
+    while (!w.done && &w != writers_.front())
     {
-        WriteBatchInternal::SetSequence(updates, last_sequence + 1);
+        if (w.insert_group == NULL)
+        {
+            w.cv.Wait();
+        }
+        else
+        {
+            // The group leader has logged our batch and wants us to
+            // insert it into the memtable ourselves.
+            InsertGroup* group = w.insert_group;
+            w.insert_group = NULL;
+            mutex_.Unlock();
+            Status s = WriteBatchInternal::InsertIntoConcurrently(my_batch,
+                                                                  group->mem);
+            mutex_.Lock();
+            if (!s.ok() && group->status.ok())
+            {
+                group->status = s;
+            }
+            if (--group->pending == 0)
+            {
+                group->leader->cv.Signal();
+            }
+        }
+    }
+    if (w.done)
+    {
+        // A preceding writer committed our batch as part of its group
+        return w.status;
+    }
+
+    // May temporarily unlock and wait.
+    Status status = MakeRoomForWrite(my_batch == NULL);
+    const uint64_t first_sequence = versions_->LastSequence() + 1;
+    uint64_t last_sequence = first_sequence - 1;
+    Writer* last_writer = &w;
+    if (status.ok() && my_batch != NULL)    // NULL batch is for compactions
+    {
+        WriteBatch* updates = BuildBatchGroup(&last_writer);
+        if (write_controller_.IsDelayed())
+        {
+            write_controller_.Charge(env_->NowMicros(),
+                                     WriteBatchInternal::ByteSize(updates));
+        }
+        WriteBatchInternal::SetSequence(updates, first_sequence);
         last_sequence += WriteBatchInternal::Count(updates);
 
-        // Add to log and apply to memtable.  We can release the lock during
-        // this phase since the "logger_" flag protects against concurrent
-        // loggers and concurrent writes into mem_.
+        // Add to log and apply to memtable.  We can release the lock
+        // during this phase since &w is currently responsible for logging
+        // and protects against concurrent loggers and concurrent writes
+        // into mem_.
         {
-            assert(logger_ == &self);
             mutex_.Unlock();
             status = log_->AddRecord(WriteBatchInternal::Contents(updates));
             if (status.ok() && options.sync)
             {
                 status = logfile_->Sync();
             }
-            if (status.ok())
+            if (status.ok() &&
+                (last_writer == &w || !options_.allow_concurrent_memtable_write))
             {
                 status = WriteBatchInternal::InsertInto(updates, mem_);
             }
             mutex_.Lock();
-            assert(logger_ == &self);
         }
+        if (status.ok() && last_writer != &w &&
+            options_.allow_concurrent_memtable_write)
+        {
+            status = InsertGroupConcurrently(&w, last_writer, first_sequence);
+        }
+        if (updates == tmp_batch_) tmp_batch_->Clear();
 
         versions_->SetLastSequence(last_sequence);
     }
-    if (options.post_write_snapshot != NULL)
+
+    // Hand every writer in the group its status (and the snapshot it
+    // asked for, taken just after its own updates) and wake it up.
+    SequenceNumber writer_sequence = first_sequence - 1;
+    while (true)
+    {
+        Writer* ready = writers_.front();
+        writers_.pop_front();
+        if (ready->batch != NULL)
+        {
+            writer_sequence += WriteBatchInternal::Count(ready->batch);
+        }
+        if (ready->post_write_snapshot != NULL)
+        {
+            *ready->post_write_snapshot =
+                status.ok() ? snapshots_.New(writer_sequence) : NULL;
+        }
+        if (ready != &w)
+        {
+            ready->status = status;
+            ready->done = true;
+            ready->cv.Signal();
+        }
+        if (ready == last_writer) break;
+    }
+
+    // Notify new head of write queue
+    if (!writers_.empty())
     {
-        *options.post_write_snapshot =
-            status.ok() ? snapshots_.New(last_sequence) : NULL;
+        writers_.front()->cv.Signal();
     }
-    ReleaseLoggingResponsibility(&self);
+
     return status;
 }
 
+// Has every writer from the front of the queue through "last_writer"
+// insert its own batch into mem_, the leader included, and waits until
+// they are all done.  Their batches are numbered from "first_sequence" in
+// queue order, just as in the combined batch that was logged.
 // REQUIRES: mutex_ is held
-// REQUIRES: this thread is the current logger
+// REQUIRES: "leader" is at the front of the writer queue
+Status DBImpl::InsertGroupConcurrently(Writer* leader, Writer* last_writer,
+                                       SequenceNumber first_sequence)
+{
+    mutex_.AssertHeld();
+    assert(leader == writers_.front());
+    InsertGroup group;
+    group.mem = mem_;
+    group.leader = leader;
+    group.pending = 0;
+
+    SequenceNumber sequence = first_sequence;
+    std::deque<Writer*>::iterator iter = writers_.begin();
+    while (true)
+    {
+        Writer* w = *iter;
+        WriteBatchInternal::SetSequence(w->batch, sequence);
+        sequence += WriteBatchInternal::Count(w->batch);
+        if (w != leader)
+        {
+            w->insert_group = &group;
+            group.pending++;
+            w->cv.Signal();
+        }
+        if (w == last_writer) break;
+        ++iter;
+    }
+
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertIntoConcurrently(leader->batch,
+                                                          group.mem);
+    mutex_.Lock();
+    while (group.pending > 0)
+    {
+        leader->cv.Wait();
+    }
+    return s.ok() ? group.status : s;
+}
+
+// REQUIRES: Writer list must be non-empty
+// REQUIRES: First writer must have a non-NULL batch
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer)
+{
+    assert(!writers_.empty());
+    Writer* first = writers_.front();
+    WriteBatch* result = first->batch;
+    assert(result != NULL);
+
+    size_t size = WriteBatchInternal::ByteSize(first->batch);
+
+    // Allow the group to grow up to a maximum size, but if the
+    // original write is small, limit the growth so we do not slow
+    // down the small write too much.
+    size_t max_size = 1 << 20;
+    if (size <= (128<<10))
+    {
+        max_size = size + (128<<10);
+    }
+
+    *last_writer = first;
+    std::deque<Writer*>::iterator iter = writers_.begin();
+    ++iter;  // Advance past "first"
+    for (; iter != writers_.end(); ++iter)
+    {
+        Writer* w = *iter;
+        if (w->sync && !first->sync)
+        {
+            // Do not include a sync write into a batch handled by a non-sync write.
+            break;
+        }
+
+        if (w->batch == NULL)
+        {
+            // A forced memtable compaction must lead its own group
+            break;
+        }
+
+        size += WriteBatchInternal::ByteSize(w->batch);
+        if (size > max_size)
+        {
+            // Do not make batch too big
+            break;
+        }
+
+        // Append to *result
+        if (result == first->batch)
+        {
+            // Switch to temporary batch instead of disturbing caller's batch
+            result = tmp_batch_;
+            assert(WriteBatchInternal::Count(result) == 0);
+            WriteBatchInternal::Append(result, first->batch);
+        }
+        WriteBatchInternal::Append(result, w->batch);
+        *last_writer = w;
+    }
+    return result;
+}
+
+// REQUIRES: mutex_ is held
+// REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force)
 {
     mutex_.AssertHeld();
-    assert(logger_ != NULL);
+    assert(!writers_.empty());
     bool allow_delay = !force;
     Status s;
     while (true)
     {
+        const WriteStallCause cause = UpdateWriteController();
         if (!bg_error_.ok())
         {
             // Yield previous error
             s = bg_error_;
             break;
         }
-        else if (
-            allow_delay &&
-            versions_->NumLevelFiles(0) >= config::kL0_SlowdownWritesTrigger)
+        else if (allow_delay && write_controller_.IsDelayed())
         {
-            // We are getting close to hitting a hard limit on the number of
-            // L0 files.  Rather than delaying a single write by several
-            // seconds when we hit the hard limit, start delaying each
-            // individual write by 1ms to reduce latency variance.  Also,
-            // this delay hands over some CPU to the compaction thread in
-            // case it is sharing the same core as the writer.
-            mutex_.Unlock();
-            env_->SleepForMicroseconds(1000);
+            // We are getting close to a hard limit on the number of L0
+            // files or on the compaction backlog.  Rather than delaying a
+            // single write by several seconds when we hit the limit, let
+            // writes through at a rate that falls as the limit gets closer
+            // to reduce latency variance.  Also, this delay hands over some
+            // CPU to the compaction thread in case it is sharing the same
+            // core as the writer.
             allow_delay = false;  // Do not delay a single write more than once
-            mutex_.Lock();
+            const uint64_t delay = write_controller_.GetDelay(env_->NowMicros());
+            if (delay > 0)
+            {
+                mutex_.Unlock();
+                env_->SleepForMicroseconds(static_cast<int>(delay));
+                mutex_.Lock();
+                stall_stats_[cause].Add(delay);
+            }
         }
         else if (!force &&
                  (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size))
@@ -1344,13 +2032,19 @@ Status DBImpl::MakeRoomForWrite(bool force)
         {
             // We have filled up the current memtable, but the previous
             // one is still being compacted, so we wait.
+            const uint64_t start = env_->NowMicros();
             bg_cv_.Wait();
+            stall_stats_[kStallMemtableFull].Add(env_->NowMicros() - start);
         }
-        else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger)
+        else if (cause == kStallLevel0Stop ||
+                 cause == kStallPendingCompactionStop)
         {
-            // There are too many level-0 files.
+            // There are too many level-0 files or too much data waiting
+            // to be compacted.
             Log(options_.info_log, "waiting...\n");
+            const uint64_t start = env_->NowMicros();
             bg_cv_.Wait();
+            stall_stats_[cause].Add(env_->NowMicros() - start);
         }
         else
         {
@@ -1370,8 +2064,9 @@ Status DBImpl::MakeRoomForWrite(bool force)
             log_ = new log::Writer(lfile);
             imm_ = mem_;
             has_imm_.Release_Store(imm_);
-            mem_ = new MemTable(internal_comparator_);
+            mem_ = new MemTable(internal_comparator_, options_.memtable_factory);
             mem_->Ref();
+            InstallReadView();
             force = false;   // Do not force another compaction if have room
             MaybeScheduleCompaction();
         }
@@ -1379,6 +2074,396 @@ Status DBImpl::MakeRoomForWrite(bool force)
     return s;
 }
 
+DBImpl::WriteStallCause DBImpl::UpdateWriteController()
+{
+    mutex_.AssertHeld();
+
+    // How far each measure has got from where writes are delayed (0)
+    // towards where they stop (1)
+    double pressure = 0;
+    WriteStallCause cause = kNumStallCauses;
+    const int level0 = versions_->NumLevelFiles(0);
+    if (level0 >= config::kL0_SlowdownWritesTrigger)
+    {
+        pressure = (level0 - config::kL0_SlowdownWritesTrigger) /
+                   static_cast<double>(config::kL0_StopWritesTrigger -
+                                       config::kL0_SlowdownWritesTrigger);
+        cause = (level0 >= config::kL0_StopWritesTrigger) ?
+                kStallLevel0Stop : kStallLevel0Slowdown;
+    }
+
+    const uint64_t pending = versions_->PendingCompactionBytes();
+    const uint64_t soft = options_.soft_pending_compaction_bytes_limit;
+    const uint64_t hard = options_.hard_pending_compaction_bytes_limit;
+    const bool stop = (hard > 0 && pending >= hard);
+    if (stop || (soft > 0 && pending >= soft))
+    {
+        double p = 1;
+        if (hard == 0)
+        {
+            p = 0;   // Writes never stop, so keep to the maximum delayed rate
+        }
+        else if (!stop && hard > soft)
+        {
+            p = static_cast<double>(pending - soft) / (hard - soft);
+        }
+        if (stop && cause != kStallLevel0Stop)
+        {
+            cause = kStallPendingCompactionStop;
+        }
+        else if (!stop && (cause == kNumStallCauses ||
+                           (cause == kStallLevel0Slowdown && p > pressure)))
+        {
+            cause = kStallPendingCompactionSlowdown;
+        }
+        if (p > pressure)
+        {
+            pressure = p;
+        }
+    }
+
+    if (cause == kNumStallCauses)
+    {
+        write_controller_.SetNormal();
+    }
+    else
+    {
+        write_controller_.SetDelayed(pressure);
+    }
+    return cause;
+}
+
+namespace
+{
+// Presents the entries of an ingested file with the sequence number that
+// DBImpl::IngestExternalFile() assigned to them.
+class SequenceRewritingIterator : public Iterator
+{
+public:
+    SequenceRewritingIterator(Iterator* iter, SequenceNumber sequence)
+        : iter_(iter),
+          sequence_(sequence)
+    {
+    }
+    virtual ~SequenceRewritingIterator()
+    {
+        delete iter_;
+    }
+    virtual bool Valid() const
+    {
+        return iter_->Valid();
+    }
+    virtual void Seek(const Slice& target)
+    {
+        iter_->Seek(target);
+        Update();
+    }
+    virtual void SeekToFirst()
+    {
+        iter_->SeekToFirst();
+        Update();
+    }
+    virtual void SeekToLast()
+    {
+        iter_->SeekToLast();
+        Update();
+    }
+    virtual void Next()
+    {
+        iter_->Next();
+        Update();
+    }
+    virtual void Prev()
+    {
+        iter_->Prev();
+        Update();
+    }
+    virtual Slice key() const
+    {
+        return key_;
+    }
+    virtual Slice value() const
+    {
+        return iter_->value();
+    }
+    virtual Status status() const
+    {
+        return status_.ok() ? iter_->status() : status_;
+    }
+
+private:
+    void Update()
+    {
+        key_.clear();
+        ParsedInternalKey ikey;
+        if (!iter_->Valid())
+        {
+            return;
+        }
+        if (ParseInternalKey(iter_->key(), &ikey))
+        {
+            ikey.sequence = sequence_;
+            AppendInternalKey(&key_, ikey);
+        }
+        else
+        {
+            status_ = Status::Corruption("corrupted internal key in ingested file");
+            key_.assign(iter_->key().data(), iter_->key().size());
+        }
+    }
+
+    Iterator* const iter_;
+    const SequenceNumber sequence_;
+    std::string key_;
+    Status status_;
+};
+}
+
+// Return true if "mem" holds an entry for a user key in [smallest,largest]
+static bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+                             const Slice& smallest, const Slice& largest)
+{
+    Iterator* iter = mem->NewIterator();
+    InternalKey start(smallest, kMaxSequenceNumber, kValueTypeForSeek);
+    iter->Seek(start.Encode());
+    const bool result = iter->Valid() &&
+                        ucmp->Compare(ExtractUserKey(iter->key()), largest) <= 0;
+    delete iter;
+    return result;
+}
+
+int DBImpl::PickIngestionLevel(const Slice& smallest, const Slice& largest)
+{
+    mutex_.AssertHeld();
+    while (logging_manifest_)
+    {
+        bg_cv_.Wait();
+    }
+    int level = 0;
+    Version* v = versions_->current();
+    if (bg_compactions_running_ == 0 &&
+            !v->OverlapInLevel(0, &smallest, &largest))
+    {
+        while (level < config::kNumLevels - 1 &&
+                !v->OverlapInLevel(level + 1, &smallest, &largest))
+        {
+            level++;
+        }
+    }
+    return level;
+}
+
+// Open the table file "fname" and copy its smallest and largest internal
+// keys into *smallest and *largest.
+static Status ReadTableKeyRange(Env* env, const Options& options,
+                                const std::string& fname,
+                                std::string* smallest, std::string* largest)
+{
+    uint64_t file_size;
+    Status s = env->GetFileSize(fname, &file_size);
+    RandomAccessFile* file = NULL;
+    if (s.ok())
+    {
+        s = env->NewRandomAccessFile(fname, &file);
+    }
+    Table* table = NULL;
+    if (s.ok())
+    {
+        s = Table::Open(options, file, file_size, &table);
+    }
+    if (s.ok())
+    {
+        Iterator* iter = table->NewIterator(ReadOptions());
+        iter->SeekToFirst();
+        if (iter->Valid())
+        {
+            smallest->assign(iter->key().data(), iter->key().size());
+            iter->SeekToLast();
+        }
+        if (iter->Valid())
+        {
+            largest->assign(iter->key().data(), iter->key().size());
+        }
+        else if (iter->status().ok())
+        {
+            s = Status::InvalidArgument(fname, "file has no entries");
+        }
+        else
+        {
+            s = iter->status();
+        }
+        delete iter;
+    }
+    delete table;
+    delete file;
+    return s;
+}
+
+Status DBImpl::IngestExternalFile(const std::string& fname)
+{
+    std::string smallest, largest;
+    Status s = ReadTableKeyRange(env_, options_, fname, &smallest, &largest);
+    ParsedInternalKey first, last;
+    if (s.ok() &&
+            (!ParseInternalKey(smallest, &first) || first.sequence != 0 ||
+             !ParseInternalKey(largest, &last) || last.sequence != 0))
+    {
+        s = Status::InvalidArgument(fname, "not written by SstFileWriter");
+    }
+    if (!s.ok())
+    {
+        return s;
+    }
+    const Slice smallest_user_key = first.user_key;
+    const Slice largest_user_key = last.user_key;
+
+    // Queue up like a writer, so that no write overlaps the file while
+    // it is added
+    Writer w(&mutex_);
+    w.batch = NULL;
+    w.sync = false;
+    w.done = false;
+    w.post_write_snapshot = NULL;
+    MutexLock l(&mutex_);
+    writers_.push_back(&w);
+    while (&w != writers_.front())
+    {
+        w.cv.Wait();
+    }
+
+    // Entries of the memtables in the file's range are older than the
+    // file and must not be read before it, so write them out first.
+    if (MemTableOverlaps(mem_, user_comparator(),
+                         smallest_user_key, largest_user_key))
+    {
+        s = MakeRoomForWrite(true /* force memtable switch */);
+    }
+    while (s.ok() && imm_ != NULL &&
+            MemTableOverlaps(imm_, user_comparator(),
+                             smallest_user_key, largest_user_key))
+    {
+        if (!bg_error_.ok())
+        {
+            s = bg_error_;
+        }
+        else
+        {
+            bg_cv_.Wait();
+        }
+    }
+
+    FileMetaData meta;
+    meta.number = versions_->NewFileNumber();
+    pending_outputs_.insert(meta.number);
+    const std::string table_name = TableFileName(dbname_, meta.number);
+    int level = PickIngestionLevel(smallest_user_key, largest_user_key);
+    bool moved = false;
+    SequenceNumber sequence = 0;   // Of the rewritten entries; 0 if moved
+    if (s.ok() && level == config::kNumLevels - 1 && snapshots_.empty())
+    {
+        // No other entries for these keys exist and nobody reads at an
+        // older sequence number, so the file can be used as it is.
+        moved = env_->RenameFile(fname, table_name).ok();
+        if (moved)
+        {
+            meta.file_size = 0;
+            env_->GetFileSize(table_name, &meta.file_size);
+            meta.smallest.DecodeFrom(smallest);
+            meta.largest.DecodeFrom(largest);
+        }
+    }
+    if (s.ok() && !moved)
+    {
+        // Rewrite the file with a sequence number after every entry in
+        // the DB.  The file's table settings are those of options_.
+        sequence = versions_->LastSequence() + 1;
+        uint64_t file_size = 0;
+        RandomAccessFile* file = NULL;
+        Table* table = NULL;
+        mutex_.Unlock();
+        s = env_->GetFileSize(fname, &file_size);
+        if (s.ok())
+        {
+            s = env_->NewRandomAccessFile(fname, &file);
+        }
+        if (s.ok())
+        {
+            s = Table::Open(options_, file, file_size, &table);
+        }
+        if (s.ok())
+        {
+            ReadOptions ro;
+            ro.fill_cache = false;
+            SequenceRewritingIterator iter(table->NewIterator(ro), sequence);
+            s = BuildTable(dbname_, env_, TableOptionsForLevel(options_, 0),
+                           table_cache_, &iter, &meta);
+        }
+        delete table;
+        delete file;
+        mutex_.Lock();
+        if (s.ok())
+        {
+            // Compactions may have moved files in the meantime
+            level = PickIngestionLevel(smallest_user_key, largest_user_key);
+        }
+    }
+
+    if (s.ok())
+    {
+        // mutex_ is not released between the pick of "level" and the
+        // install, since PickIngestionLevel() waited for the manifest.
+        // The last sequence only covers the file's entries once it is
+        // part of the current version, or a snapshot taken while the
+        // manifest is written would see them appear later.  No writer
+        // can take the sequence meanwhile: we are at the front of writers_.
+        VersionEdit edit;
+        edit.AddFile(level, meta.number, meta.file_size,
+                     meta.smallest, meta.largest);
+        if (!moved)
+        {
+            edit.SetLastSequence(sequence);
+        }
+        s = InstallVersionEdit(&edit);
+        if (s.ok() && !moved)
+        {
+            versions_->SetLastSequence(sequence);
+        }
+    }
+    pending_outputs_.erase(meta.number);
+    Log(options_.info_log, "Ingested table #%llu at level %d: %lld bytes %s",
+        (unsigned long long) meta.number, level,
+        (unsigned long long) meta.file_size, s.ToString().c_str());
+    if (s.ok())
+    {
+        if (!moved)
+        {
+            env_->DeleteFile(fname);
+        }
+        MaybeScheduleCompaction();
+    }
+    else if (moved)
+    {
+        env_->RenameFile(table_name, fname);
+    }
+
+    writers_.pop_front();
+    if (!writers_.empty())
+    {
+        writers_.front()->cv.Signal();
+    }
+    return s;
+}
+
+// Names of the DBImpl::WriteStallCause values in properties
+static const char* kStallCauseNames[] =
+{
+    "level0-slowdown",
+    "pending-compaction-slowdown",
+    "memtable-full",
+    "level0-stop",
+    "pending-compaction-stop"
+};
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value)
 {
     value->clear();
@@ -1433,6 +2518,57 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value)
                 value->append(buf);
             }
         }
+
+        snprintf(buf, sizeof(buf),
+                 "\n"
+                 "                  Write stalls\n"
+                 "Cause                          Count Time(sec)\n"
+                 "----------------------------------------------\n"
+                );
+        value->append(buf);
+        for (int c = 0; c < kNumStallCauses; c++)
+        {
+            snprintf(buf, sizeof(buf), "%-27s %9lld %9.3f\n",
+                     kStallCauseNames[c],
+                     static_cast<long long>(stall_stats_[c].count),
+                     stall_stats_[c].micros / 1e6);
+            value->append(buf);
+        }
+        return true;
+    }
+    else if (in.starts_with("write-stall-micros."))
+    {
+        in.remove_prefix(strlen("write-stall-micros."));
+        for (int c = 0; c < kNumStallCauses; c++)
+        {
+            if (in == kStallCauseNames[c])
+            {
+                char buf[50];
+                snprintf(buf, sizeof(buf), "%llu",
+                         static_cast<unsigned long long>(
+                             stall_stats_[c].micros));
+                *value = buf;
+                return true;
+            }
+        }
+        return false;
+    }
+    else if (in == "delayed-write-rate")
+    {
+        UpdateWriteController();
+        char buf[50];
+        snprintf(buf, sizeof(buf), "%llu",
+                 static_cast<unsigned long long>(write_controller_.rate()));
+        *value = buf;
+        return true;
+    }
+    else if (in == "pending-compaction-bytes")
+    {
+        char buf[50];
+        snprintf(buf, sizeof(buf), "%llu",
+                 static_cast<unsigned long long>(
+                     versions_->PendingCompactionBytes()));
+        *value = buf;
         return true;
     }
 
@@ -1483,6 +2619,32 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key)
     return Write(opt, &batch);
 }
 
+void DB::MultiGet(const ReadOptions& options,
+                  const Slice* keys, int n,
+                  std::string* values, Status* statuses)
+{
+    ReadOptions opt = options;
+    const Snapshot* snapshot = NULL;
+    if (opt.snapshot == NULL)
+    {
+        snapshot = GetSnapshot();
+        opt.snapshot = snapshot;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        statuses[i] = Get(opt, keys[i], &values[i]);
+    }
+    if (snapshot != NULL)
+    {
+        ReleaseSnapshot(snapshot);
+    }
+}
+
+Status DB::IngestExternalFile(const std::string& fname)
+{
+    return Status::NotSupported("IngestExternalFile", fname);
+}
+
 DB::~DB() { }
 
 Status DB::Open(const Options& options, const std::string& dbname,
@@ -1510,6 +2672,7 @@ Status DB::Open(const Options& options, const std::string& dbname,
         }
         if (s.ok())
         {
+            impl->InstallReadView();
             impl->DeleteObsoleteFiles();
             impl->MaybeScheduleCompaction();
         }
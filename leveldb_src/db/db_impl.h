@@ -5,10 +5,12 @@
 #ifndef STORAGE_LEVELDB_DB_DB_IMPL_H_
 #define STORAGE_LEVELDB_DB_DB_IMPL_H_
 
+#include <deque>
 #include <set>
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -21,6 +23,7 @@ class TableCache;
 class Version;
 class VersionEdit;
 class VersionSet;
+class WorkerPool;
 
 class DBImpl : public DB
 {
@@ -35,11 +38,16 @@ public:
     virtual Status Get(const ReadOptions& options,
                        const Slice& key,
                        std::string* value);
+    virtual void MultiGet(const ReadOptions& options,
+                          const Slice* keys, int n,
+                          std::string* values, Status* statuses);
     virtual Iterator* NewIterator(const ReadOptions&);
     virtual const Snapshot* GetSnapshot();
     virtual void ReleaseSnapshot(const Snapshot* snapshot);
     virtual bool GetProperty(const Slice& property, std::string* value);
     virtual void GetApproximateSizes(const Range* range, int n, uint64_t* sizes);
+    virtual void CompactRange(const Slice* begin, const Slice* end);
+    virtual Status IngestExternalFile(const std::string& fname);
 
     // Extra methods (for testing) that are not in the public DB interface
 
@@ -67,6 +75,33 @@ private:
     Iterator* NewInternalIterator(const ReadOptions&,
                                   SequenceNumber* latest_snapshot);
 
+    // The memtables and Version a read works against, bundled so that a
+    // reader pins all three with a single reference.  A new ReadView is
+    // installed whenever mem_, imm_ or the current Version changes.
+    struct ReadView
+    {
+        MemTable* mem;
+        MemTable* imm;      // NULL if there is no immutable memtable
+        Version* current;
+        int refs;           // Protected by mutex_
+    };
+
+    // Return the current ReadView, usually without taking mutex_, and
+    // store in *slot where it must be returned by ReleaseReadView().
+    ReadView* AcquireReadView(port::AtomicPointer** slot);
+    void ReleaseReadView(ReadView* view, port::AtomicPointer* slot);
+
+    // Replace read_view_ with one built from mem_, imm_ and the current
+    // Version, and drop the views cached in read_view_slots_.
+    // REQUIRES: mutex_ held
+    void InstallReadView();
+
+    // REQUIRES: mutex_ held
+    void UnrefReadView(ReadView* view);
+    void ClearReadViewSlots();
+
+    static void CleanupReadView(void* db, void* view);
+
     Status NewDB();
 
     // Recover the descriptor from persistent storage.  May do a significant
@@ -87,23 +122,75 @@ private:
                           VersionEdit* edit,
                           SequenceNumber* max_sequence);
 
-    Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base);
+    // Write the contents of "mem" to a new table and add it to *edit.
+    // The table number is stored in *number and is left in
+    // pending_outputs_; the caller removes it once *edit is installed.
+    Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+                            uint64_t* number);
+
+    // Apply *edit to the current version and log it to the MANIFEST.
+    // Waits for any other thread doing the same, since concurrent calls
+    // to VersionSet::LogAndApply() would lose edits.
+    Status InstallVersionEdit(VersionEdit* edit);
+
+    // Queued state of a caller blocked in Write()
+    struct Writer;
 
-    // Only thread is allowed to log at a time.
-    struct LoggerId { };          // Opaque identifier for logging thread
-    void AcquireLoggingResponsibility(LoggerId* self);
-    void ReleaseLoggingResponsibility(LoggerId* self);
+    // Writers inserting their batches into the memtable in parallel
+    struct InsertGroup;
 
     Status MakeRoomForWrite(bool force /* compact even if there is room? */);
 
+    // The deepest level that no file at or above it overlaps the user key
+    // range [smallest,largest] with, or 0 if level-0 files overlap it.
+    // Level 0 as well while a table compaction is running, since it may
+    // be writing an output file over the range into the level picked
+    // here.  Waits for any edit being logged, so that InstallVersionEdit()
+    // applies the next edit without releasing mutex_ first.
+    // REQUIRES: mutex_ held
+    int PickIngestionLevel(const Slice& smallest, const Slice& largest);
+
+    // Why MakeRoomForWrite() held up a write
+    enum WriteStallCause
+    {
+        kStallLevel0Slowdown,
+        kStallPendingCompactionSlowdown,
+        kStallMemtableFull,
+        kStallLevel0Stop,
+        kStallPendingCompactionStop,
+        kNumStallCauses
+    };
+
+    // Work out how far compaction has fallen behind and delay writes in
+    // write_controller_ accordingly.  Returns the most severe reason writes
+    // have to be delayed or stopped, or kNumStallCauses if there is none.
+    // REQUIRES: mutex_ held
+    WriteStallCause UpdateWriteController();
+    WriteBatch* BuildBatchGroup(Writer** last_writer);
+    Status InsertGroupConcurrently(Writer* leader, Writer* last_writer,
+                                   SequenceNumber first_sequence);
+
     struct CompactionState;
+    struct SubcompactionTask;
+
+    // Compact the files in "level" that overlap [*begin,*end] into the
+    // compaction's output level and wait until it is done.  NULL leaves a
+    // side open.
+    void RunManualCompaction(int level, const Slice* begin, const Slice* end);
 
     void MaybeScheduleCompaction();
     static void BGWork(void* db);
     void BackgroundCall();
-    void BackgroundCompaction();
+    bool BackgroundCompaction();
     void CleanupCompaction(CompactionState* compact);
     Status DoCompactionWork(CompactionState* compact);
+    static void BGSubcompaction(void* task);
+
+    // Merge the inputs of compact->compaction that fall in the key range
+    // of *compact into new output files.  Compacts the immutable memtable
+    // on the way if "imm_micros" is non-NULL, adding the time spent doing
+    // so to *imm_micros.
+    Status DoSubcompactionWork(CompactionState* compact, int64_t* imm_micros);
 
     Status OpenCompactionOutputFile(CompactionState* compact);
     Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
@@ -112,6 +199,8 @@ private:
     // Constant after construction
     Env* const env_;
     const InternalKeyComparator internal_comparator_;
+    const InternalFilterPolicy internal_filter_policy_;
+    const InternalKeySliceTransform internal_prefix_extractor_;
     const Options options_;  // options_.comparator == &internal_comparator_
     bool owns_info_log_;
     bool owns_cache_;
@@ -133,23 +222,65 @@ private:
     WritableFile* logfile_;
     uint64_t logfile_number_;
     log::Writer* log_;
-    LoggerId* logger_;            // NULL, or the id of the current logging thread
-    port::CondVar logger_cv_;     // For threads waiting to log
+
+    // Queue of writers.  The writer at the front is the only one allowed
+    // to touch the log and mem_; it commits on behalf of the writers
+    // queued behind it (see BuildBatchGroup).
+    std::deque<Writer*> writers_;
+    WriteBatch* tmp_batch_;
     SnapshotList snapshots_;
 
     // Set of table files to protect from deletion because they are
     // part of ongoing compactions.
     std::set<uint64_t> pending_outputs_;
 
-    // Has a background compaction been scheduled or is running?
-    bool bg_compaction_scheduled_;
+    // Number of background compactions that are scheduled or running.
+    // At most options_.max_background_compactions.
+    int bg_compactions_scheduled_;
+
+    // Number of background jobs that are compacting tables (as opposed
+    // to flushing the immutable memtable).
+    int bg_compactions_running_;
 
-    // Information for a manual compaction
+    // Threads that compact the key ranges a compaction is split into,
+    // other than the first.  NULL if options_.max_subcompactions is 1.
+    WorkerPool* subcompaction_pool_;
+
+    // Is some thread writing imm_ to a table?
+    bool bg_memtable_compacting_;
+
+    // Is some thread inside InstallVersionEdit()?
+    bool logging_manifest_;
+
+    // Was the last table compaction picked a piece of manual_compaction_?
+    bool last_compaction_manual_;
+
+    // The current ReadView.  Only changed with mutex_ held, but readers
+    // load it without the lock to validate their cached view.
+    port::AtomicPointer read_view_;
+
+    // Readers keep a referenced ReadView in the slot picked by their
+    // thread id, so that a read only takes mutex_ after the view changes.
+    // A slot holds NULL, a ReadView that owns one reference, or a marker
+    // while a reader has borrowed the view.
+    enum { kNumReadViewSlots = 64 };
+    struct ReadViewSlot
+    {
+        port::AtomicPointer view;
+        char padding[64 - sizeof(port::AtomicPointer)];  // No false sharing
+    };
+    ReadViewSlot read_view_slots_[kNumReadViewSlots];
+
+    // Information for a manual compaction.  Pieces of the range are
+    // handed to background threads in key order; begin moves past each.
     struct ManualCompaction
     {
         int level;
-        std::string begin;
-        std::string end;
+        bool done;                  // No piece of the range is left to pick
+        int running;                // Pieces picked but not yet finished
+        const InternalKey* begin;   // NULL means beginning of key range
+        const InternalKey* end;     // NULL means end of key range
+        InternalKey tmp_storage;    // Used to keep track of progress
     };
     ManualCompaction* manual_compaction_;
 
@@ -177,6 +308,25 @@ private:
     };
     CompactionStats stats_[config::kNumLevels];
 
+    // Paces writes while compaction falls behind
+    WriteController write_controller_;
+
+    // Number of writes held up and time spent waiting, per stall cause
+    struct StallStats
+    {
+        int64_t count;
+        int64_t micros;
+
+        StallStats() : count(0), micros(0) { }
+
+        void Add(uint64_t m)
+        {
+            this->count++;
+            this->micros += m;
+        }
+    };
+    StallStats stall_stats_[kNumStallCauses];
+
     // No copying allowed
     DBImpl(const DBImpl&);
     void operator=(const DBImpl&);
@@ -191,6 +341,8 @@ private:
 // it is not equal to src.info_log.
 extern Options SanitizeOptions(const std::string& db,
                                const InternalKeyComparator* icmp,
+                               const InternalFilterPolicy* ipolicy,
+                               const InternalKeySliceTransform* iprefix,
                                const Options& src);
 
 }
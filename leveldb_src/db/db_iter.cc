@@ -56,14 +56,17 @@ public:
     };
 
     DBIter(const std::string* dbname, Env* env,
-           const Comparator* cmp, Iterator* iter, SequenceNumber s)
+           const Comparator* cmp, Iterator* iter, SequenceNumber s,
+           const SliceTransform* prefix_extractor)
         : dbname_(dbname),
           env_(env),
           user_comparator_(cmp),
           iter_(iter),
           sequence_(s),
+          prefix_extractor_(prefix_extractor),
           direction_(kForward),
-          valid_(false)
+          valid_(false),
+          prefix_bounded_(false)
     {
     }
     virtual ~DBIter()
@@ -106,6 +109,7 @@ private:
     void FindNextUserEntry(bool skipping, std::string* skip);
     void FindPrevUserEntry();
     bool ParseKey(ParsedInternalKey* key);
+    void CheckPrefix();
 
     inline void SaveKey(const Slice& k, std::string* dst)
     {
@@ -130,12 +134,15 @@ private:
     const Comparator* const user_comparator_;
     Iterator* const iter_;
     SequenceNumber const sequence_;
+    const SliceTransform* const prefix_extractor_;
 
     Status status_;
     std::string saved_key_;     // == current key when direction_==kReverse
     std::string saved_value_;   // == current raw value when direction_==kReverse
     Direction direction_;
     bool valid_;
+    bool prefix_bounded_;       // Only keys with prefix_ are yielded
+    std::string prefix_;
 
     // No copying allowed
     DBIter(const DBIter&);
@@ -155,6 +162,21 @@ inline bool DBIter::ParseKey(ParsedInternalKey* ikey)
     }
 }
 
+// End the iteration if the current key has left the prefix of the
+// last Seek() target.
+inline void DBIter::CheckPrefix()
+{
+    if (valid_ && prefix_bounded_)
+    {
+        Slice k = ExtractUserKey(iter_->key());
+        if (!prefix_extractor_->InDomain(k) ||
+                prefix_extractor_->Transform(k) != Slice(prefix_))
+        {
+            valid_ = false;
+        }
+    }
+}
+
 void DBIter::Next()
 {
     assert(valid_);
@@ -185,6 +207,7 @@ void DBIter::Next()
     std::string* skip = &saved_key_;
     SaveKey(ExtractUserKey(iter_->key()), skip);
     FindNextUserEntry(true, skip);
+    CheckPrefix();
 }
 
 void DBIter::FindNextUserEntry(bool skipping, std::string* skip)
@@ -231,6 +254,15 @@ void DBIter::Prev()
 {
     assert(valid_);
 
+    if (prefix_bounded_)
+    {
+        // Tables without the prefix were skipped, so the entries before
+        // the current one are not known.
+        valid_ = false;
+        status_ = Status::NotSupported("Prev() in prefix seek mode");
+        return;
+    }
+
     if (direction_ == kForward)    // Switch directions?
     {
         // iter_ is pointing at the current entry.  Scan backwards until
@@ -318,6 +350,13 @@ void DBIter::Seek(const Slice& target)
 {
     direction_ = kForward;
     ClearSavedValue();
+    prefix_bounded_ = (prefix_extractor_ != NULL &&
+                       prefix_extractor_->InDomain(target));
+    if (prefix_bounded_)
+    {
+        Slice prefix = prefix_extractor_->Transform(target);
+        prefix_.assign(prefix.data(), prefix.size());
+    }
     saved_key_.clear();
     AppendInternalKey(
         &saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
@@ -325,6 +364,7 @@ void DBIter::Seek(const Slice& target)
     if (iter_->Valid())
     {
         FindNextUserEntry(false, &saved_key_ /* temporary storage */);
+        CheckPrefix();
     }
     else
     {
@@ -335,6 +375,7 @@ void DBIter::Seek(const Slice& target)
 void DBIter::SeekToFirst()
 {
     direction_ = kForward;
+    prefix_bounded_ = false;
     ClearSavedValue();
     iter_->SeekToFirst();
     if (iter_->Valid())
@@ -350,6 +391,7 @@ void DBIter::SeekToFirst()
 void DBIter::SeekToLast()
 {
     direction_ = kReverse;
+    prefix_bounded_ = false;
     ClearSavedValue();
     iter_->SeekToLast();
     FindPrevUserEntry();
@@ -362,9 +404,11 @@ Iterator* NewDBIterator(
     Env* env,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
-    const SequenceNumber& sequence)
+    const SequenceNumber& sequence,
+    const SliceTransform* prefix_extractor)
 {
-    return new DBIter(dbname, env, user_key_comparator, internal_iter, sequence);
+    return new DBIter(dbname, env, user_key_comparator, internal_iter, sequence,
+                      prefix_extractor);
 }
 
 }
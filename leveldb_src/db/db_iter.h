@@ -14,13 +14,16 @@ namespace leveldb
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  If "prefix_extractor" is non-NULL, the
+// iterator stops at the first user key whose prefix differs from that of
+// the target of the last Seek() (see ReadOptions::prefix_same_as_start).
 extern Iterator* NewDBIterator(
     const std::string* dbname,
     Env* env,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
-    const SequenceNumber& sequence);
+    const SequenceNumber& sequence,
+    const SliceTransform* prefix_extractor = NULL);
 
 }
 
@@ -7,7 +7,13 @@
 #include "db/filename.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
+#include "leveldb/compressor.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/table.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -24,6 +30,30 @@ static std::string RandomString(Random* rnd, int len)
     return r;
 }
 
+class AtomicCounter
+{
+private:
+    port::Mutex mu_;
+    int count_;
+public:
+    AtomicCounter() : count_(0) { }
+    void Increment()
+    {
+        MutexLock l(&mu_);
+        count_++;
+    }
+    int Read()
+    {
+        MutexLock l(&mu_);
+        return count_;
+    }
+    void Reset()
+    {
+        MutexLock l(&mu_);
+        count_ = 0;
+    }
+};
+
 // Special Env used to delay background operations
 class SpecialEnv : public EnvWrapper
 {
@@ -31,9 +61,15 @@ public:
     // sstable Sync() calls are blocked while this pointer is non-NULL.
     port::AtomicPointer delay_sstable_sync_;
 
+    bool count_random_reads_;
+    AtomicCounter random_read_counter_;
+
+    AtomicCounter started_threads_;
+
     explicit SpecialEnv(Env* base) : EnvWrapper(base)
     {
         delay_sstable_sync_.Release_Store(NULL);
+        count_random_reads_ = false;
     }
 
     Status NewWritableFile(const std::string& f, WritableFile** r)
@@ -86,6 +122,44 @@ public:
         }
         return s;
     }
+
+    Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r)
+    {
+        class CountingFile : public RandomAccessFile
+        {
+        private:
+            RandomAccessFile* target_;
+            AtomicCounter* counter_;
+        public:
+            CountingFile(RandomAccessFile* target, AtomicCounter* counter)
+                : target_(target), counter_(counter)
+            {
+            }
+            virtual ~CountingFile()
+            {
+                delete target_;
+            }
+            virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                                char* scratch) const
+            {
+                counter_->Increment();
+                return target_->Read(offset, n, result, scratch);
+            }
+        };
+
+        Status s = target()->NewRandomAccessFile(f, r);
+        if (s.ok() && count_random_reads_)
+        {
+            *r = new CountingFile(*r, &random_read_counter_);
+        }
+        return s;
+    }
+
+    void StartThread(void (*function)(void* arg), void* arg)
+    {
+        started_threads_.Increment();
+        target()->StartThread(function, arg);
+    }
 };
 
 class DBTest
@@ -259,19 +333,7 @@ public:
 
     void Compact(const Slice& start, const Slice& limit)
     {
-        dbfull()->TEST_CompactMemTable();
-        int max_level_with_files = 1;
-        for (int level = 1; level < config::kNumLevels; level++)
-        {
-            if (NumTableFilesAtLevel(level) > 0)
-            {
-                max_level_with_files = level;
-            }
-        }
-        for (int level = 0; level < max_level_with_files; level++)
-        {
-            dbfull()->TEST_CompactRange(level, "", "~");
-        }
+        db_->CompactRange(&start, &limit);
     }
 
     // Prevent pushing of new sstables into deeper levels by adding
@@ -360,6 +422,46 @@ TEST(DBTest, GetFromImmutableLayer)
     env_->delay_sstable_sync_.Release_Store(NULL);   // Release sync calls
 }
 
+static void ReleaseSyncAfterDelay(void* arg)
+{
+    SpecialEnv* env = reinterpret_cast<SpecialEnv*>(arg);
+    env->SleepForMicroseconds(200000);
+    env->delay_sstable_sync_.Release_Store(NULL);
+}
+
+TEST(DBTest, WriteStallStats)
+{
+    Options options;
+    options.env = env_;
+    options.write_buffer_size = 100000;  // Small write buffer
+    Reopen(&options);
+
+    std::string value;
+    ASSERT_TRUE(db_->GetProperty("leveldb.delayed-write-rate", &value));
+    ASSERT_EQ("0", value);
+    ASSERT_TRUE(db_->GetProperty("leveldb.pending-compaction-bytes", &value));
+    ASSERT_EQ("0", value);
+    ASSERT_TRUE(db_->GetProperty("leveldb.write-stall-micros.memtable-full",
+                                 &value));
+    ASSERT_EQ("0", value);
+    ASSERT_TRUE(!db_->GetProperty("leveldb.write-stall-micros.bogus", &value));
+
+    // The third write waits for the first memtable to be compacted
+    env_->delay_sstable_sync_.Release_Store(env_);   // Block sync calls
+    env_->StartThread(ReleaseSyncAfterDelay, env_);
+    ASSERT_OK(Put("k1", std::string(100000, 'x')));  // Fill memtable
+    ASSERT_OK(Put("k2", std::string(100000, 'y')));  // Trigger compaction
+    ASSERT_OK(Put("k3", std::string(100000, 'z')));
+    ASSERT_TRUE(env_->delay_sstable_sync_.Acquire_Load() == NULL);
+
+    ASSERT_TRUE(db_->GetProperty("leveldb.write-stall-micros.memtable-full",
+                                 &value));
+    ASSERT_NE("0", value);
+    ASSERT_TRUE(db_->GetProperty("leveldb.stats", &value));
+    ASSERT_TRUE(value.find("Write stalls") != std::string::npos);
+    ASSERT_TRUE(value.find("memtable-full") != std::string::npos);
+}
+
 TEST(DBTest, GetFromVersions)
 {
     ASSERT_OK(Put("foo", "v1"));
@@ -717,6 +819,167 @@ static std::string Key(int i)
     return std::string(buf);
 }
 
+TEST(DBTest, MemTableRepresentations)
+{
+    const SliceTransform* prefix = NewFixedPrefixTransform(3);
+    MemTableRepFactory* factories[] =
+    {
+        NewSkipListMemTableRepFactory(),
+        NewHashSkipListMemTableRepFactory(prefix, 101),
+        NewVectorMemTableRepFactory(),
+    };
+    const int kFactories = sizeof(factories) / sizeof(factories[0]);
+    for (int f = 0; f < kFactories; f++)
+    {
+        Options options;
+        options.env = env_;
+        options.create_if_missing = true;
+        options.memtable_factory = factories[f];
+        options.write_buffer_size = 100 << 10;
+        options.allow_concurrent_memtable_write = true;
+        DestroyAndReopen(&options);
+
+        // Keys with shared prefixes, some shorter than the prefix
+        Random rnd(301);
+        std::map<std::string, std::string> model;
+        for (int i = 0; i < 3000; i++)
+        {
+            char buf[20];
+            snprintf(buf, sizeof(buf), "%c%d", 'a' + rnd.Uniform(3),
+                     rnd.Uniform(1000));
+            std::string k = buf;
+            if (rnd.OneIn(4))
+            {
+                ASSERT_OK(Delete(k));
+                model.erase(k);
+            }
+            else
+            {
+                std::string v = RandomString(&rnd, rnd.Uniform(100));
+                ASSERT_OK(Put(k, v));
+                model[k] = v;
+            }
+            if (i == 1500)
+            {
+                ASSERT_OK(dbfull()->TEST_CompactMemTable());
+            }
+        }
+        ASSERT_GT(TotalTableFiles(), 0) << factories[f]->Name();
+
+        // Check every read path before and after recovery from the log
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = 0; i < 1000; i++)
+            {
+                char buf[20];
+                snprintf(buf, sizeof(buf), "b%d", i);
+                std::map<std::string, std::string>::iterator it =
+                    model.find(buf);
+                ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second,
+                          Get(buf));
+            }
+            Iterator* iter = db_->NewIterator(ReadOptions());
+            std::map<std::string, std::string>::iterator it = model.begin();
+            for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++it)
+            {
+                ASSERT_TRUE(it != model.end());
+                ASSERT_EQ(it->first, iter->key().ToString());
+                ASSERT_EQ(it->second, iter->value().ToString());
+            }
+            ASSERT_TRUE(it == model.end());
+            iter->Seek("b5");
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ(model.lower_bound("b5")->first, iter->key().ToString());
+            iter->Prev();
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ((--model.lower_bound("b5"))->first,
+                      iter->key().ToString());
+            delete iter;
+            Reopen(&options);
+        }
+    }
+    delete db_;     // Before the factories it uses
+    db_ = NULL;
+    for (int f = 0; f < kFactories; f++)
+    {
+        delete factories[f];
+    }
+    delete prefix;
+}
+
+TEST(DBTest, MultiGet)
+{
+    Options options;
+    options.env = env_;
+    options.block_size = 1024;  // Several keys per block, several blocks per file
+    Reopen(&options);
+
+    // Spread overlapping generations of keys over level-0 files, deeper
+    // levels and the memtable, deleting some on the way.
+    Random rnd(301);
+    const int kKeys = 2000;
+    for (int round = 0; round < 4; round++)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            const int k = rnd.Uniform(kKeys);
+            if (rnd.OneIn(5))
+            {
+                ASSERT_OK(Delete(Key(k)));
+            }
+            else
+            {
+                ASSERT_OK(Put(Key(k), RandomString(&rnd, 100)));
+            }
+        }
+        if (round == 0)
+        {
+            Compact(Key(0), Key(kKeys));
+        }
+        else if (round < 3)
+        {
+            dbfull()->TEST_CompactMemTable();
+        }
+    }
+    const Snapshot* snapshot = db_->GetSnapshot();
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_OK(Put(Key(rnd.Uniform(kKeys)), "after snapshot"));
+    }
+
+    // Unsorted keys, with duplicates and keys past either end
+    std::vector<std::string> key_strings;
+    for (int i = 0; i < 3000; i++)
+    {
+        key_strings.push_back(Key(rnd.Uniform(kKeys + 20) - 10));
+    }
+    std::vector<Slice> keys(key_strings.begin(), key_strings.end());
+    const int n = keys.size();
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        ReadOptions roptions;
+        roptions.snapshot = (pass == 0) ? NULL : snapshot;
+        std::vector<std::string> values(n);
+        std::vector<Status> statuses(n);
+        db_->MultiGet(roptions, &keys[0], n, &values[0], &statuses[0]);
+        for (int i = 0; i < n; i++)
+        {
+            std::string result = values[i];
+            if (statuses[i].IsNotFound())
+            {
+                result = "NOT_FOUND";
+            }
+            else if (!statuses[i].ok())
+            {
+                result = statuses[i].ToString();
+            }
+            ASSERT_EQ(Get(key_strings[i], roptions.snapshot), result);
+        }
+    }
+    db_->ReleaseSnapshot(snapshot);
+}
+
 TEST(DBTest, MinorCompactionsHappen)
 {
     Options options;
@@ -821,133 +1084,931 @@ TEST(DBTest, RepeatedWritesToSameKey)
     }
 }
 
-TEST(DBTest, SparseMerge)
+TEST(DBTest, ParallelCompactions)
 {
     Options options;
-    options.compression = kNoCompression;
+    options.env = env_;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.max_background_compactions = 4;
     Reopen(&options);
 
-    FillLevels("A", "Z");
-
-    // Suppose there is:
-    //    small amount of data with prefix A
-    //    large amount of data with prefix B
-    //    small amount of data with prefix C
-    // and that recent updates have made small changes to all three prefixes.
-    // Check that we do not do a compaction that merges all of B in one shot.
-    const std::string value(1000, 'x');
-    Put("A", "va");
-    // Write approximately 100MB of "B" values
-    for (int i = 0; i < 100000; i++)
+    // Overwrite and delete keys spread over the key space so that several
+    // levels need compaction at the same time.
+    Random rnd(301);
+    std::map<std::string, std::string> expected;
+    for (int i = 0; i < 30000; i++)
     {
-        char key[100];
-        snprintf(key, sizeof(key), "B%010d", i);
-        Put(key, value);
+        const std::string k = Key(rnd.Uniform(5000));
+        if (rnd.OneIn(10))
+        {
+            ASSERT_OK(Delete(k));
+            expected.erase(k);
+        }
+        else
+        {
+            const std::string v = RandomString(&rnd, 100 + rnd.Uniform(200));
+            ASSERT_OK(Put(k, v));
+            expected[k] = v;
+        }
     }
-    Put("C", "vc");
-    dbfull()->TEST_CompactMemTable();
-    dbfull()->TEST_CompactRange(0, "A", "Z");
-
-    // Make sparse update
-    Put("A",    "va2");
-    Put("B100", "bvalue2");
-    Put("C",    "vc2");
-    dbfull()->TEST_CompactMemTable();
-
-    // Compactions should not cause us to create a situation where
-    // a file overlaps too much data at the next level.
-    ASSERT_LE(dbfull()->TEST_MaxNextLevelOverlappingBytes(), 20*1048576);
-    dbfull()->TEST_CompactRange(0, "", "z");
-    ASSERT_LE(dbfull()->TEST_MaxNextLevelOverlappingBytes(), 20*1048576);
-    dbfull()->TEST_CompactRange(1, "", "z");
-    ASSERT_LE(dbfull()->TEST_MaxNextLevelOverlappingBytes(), 20*1048576);
-}
 
-static bool Between(uint64_t val, uint64_t low, uint64_t high)
-{
-    bool result = (val >= low) && (val <= high);
-    if (!result)
+    for (int pass = 0; pass < 2; pass++)
     {
-        fprintf(stderr, "Value %llu is not in range [%llu, %llu]\n",
-                (unsigned long long)(val),
-                (unsigned long long)(low),
-                (unsigned long long)(high));
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        iter->SeekToFirst();
+        std::map<std::string, std::string>::const_iterator it;
+        for (it = expected.begin(); it != expected.end(); ++it)
+        {
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ(it->first, iter->key().ToString());
+            ASSERT_EQ(it->second, iter->value().ToString());
+            ASSERT_EQ(it->second, Get(it->first));
+            iter->Next();
+        }
+        ASSERT_TRUE(!iter->Valid());
+        delete iter;
+
+        // Check the recovered state as well
+        Reopen(&options);
     }
-    return result;
 }
 
-TEST(DBTest, ApproximateSizes)
+TEST(DBTest, Subcompactions)
 {
     Options options;
+    options.env = env_;
     options.write_buffer_size = 100000000;        // Large write buffer
     options.compression = kNoCompression;
-    DestroyAndReopen();
-
-    ASSERT_TRUE(Between(Size("", "xyz"), 0, 0));
+    options.max_subcompactions = 4;
     Reopen(&options);
-    ASSERT_TRUE(Between(Size("", "xyz"), 0, 0));
 
-    // Write 8MB (80 values, each 100K)
-    ASSERT_EQ(NumTableFilesAtLevel(0), 0);
-    const int N = 80;
+    // Write two overlapping level-0 files of about 6MB each, with some
+    // keys deleted in the newer one.
     Random rnd(301);
-    for (int i = 0; i < N; i++)
+    std::vector<std::string> values;
+    for (int i = 0; i < 600; i++)
     {
-        ASSERT_OK(Put(Key(i), RandomString(&rnd, 100000)));
+        values.push_back(RandomString(&rnd, 10000));
+        ASSERT_OK(Put(Key(i), values[i]));
+    }
+    Reopen(&options);  // Reopening moves updates to level-0
+    for (int i = 0; i < 600; i += 2)
+    {
+        if (i % 10 == 0)
+        {
+            ASSERT_OK(Delete(Key(i)));
+            values[i].clear();
+        }
+        else
+        {
+            values[i] = RandomString(&rnd, 10000);
+            ASSERT_OK(Put(Key(i), values[i]));
+        }
     }
+    Reopen(&options);
+    ASSERT_EQ(NumTableFilesAtLevel(0), 2);
 
-    // 0 because GetApproximateSizes() does not account for memtable space
-    ASSERT_TRUE(Between(Size("", Key(50)), 0, 0));
+    // The level-0 compaction is large enough to be split into key ranges
+    dbfull()->TEST_CompactRange(0, "", Key(100000));
+    ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+    ASSERT_GT(NumTableFilesAtLevel(1), 1);
 
-    // Check sizes across recovery by reopening a few times
-    for (int run = 0; run < 3; run++)
+    for (int pass = 0; pass < 2; pass++)
     {
-        Reopen(&options);
-
-        for (int compact_start = 0; compact_start < N; compact_start += 10)
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        iter->SeekToFirst();
+        for (int i = 0; i < 600; i++)
         {
-            for (int i = 0; i < N; i += 10)
+            if (values[i].empty())
             {
-                ASSERT_TRUE(Between(Size("", Key(i)), 100000*i, 100000*i + 10000));
-                ASSERT_TRUE(Between(Size("", Key(i)+".suffix"),
-                                    100000 * (i+1), 100000 * (i+1) + 10000));
-                ASSERT_TRUE(Between(Size(Key(i), Key(i+10)),
-                                    100000 * 10, 100000 * 10 + 10000));
+                ASSERT_EQ("NOT_FOUND", Get(Key(i)));
+                continue;
             }
-            ASSERT_TRUE(Between(Size("", Key(50)), 5000000, 5010000));
-            ASSERT_TRUE(Between(Size("", Key(50)+".suffix"), 5100000, 5110000));
-
-            dbfull()->TEST_CompactRange(0,
-                                        Key(compact_start),
-                                        Key(compact_start + 9));
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ(Key(i), iter->key().ToString());
+            ASSERT_EQ(values[i], iter->value().ToString());
+            ASSERT_EQ(values[i], Get(Key(i)));
+            iter->Next();
         }
+        ASSERT_TRUE(!iter->Valid());
+        delete iter;
 
+        // Check the recovered state as well
+        Reopen(&options);
+    }
+
+    // Later compactions reuse the threads of the first
+    env_->started_threads_.Reset();
+    for (int round = 0; round < 10; round++)
+    {
+        for (int i = 0; i < 600; i++)
+        {
+            ASSERT_OK(Put(Key(i), RandomString(&rnd, 10000)));
+        }
+        ASSERT_OK(dbfull()->TEST_CompactMemTable());
+        dbfull()->TEST_CompactRange(0, "", Key(100000));
         ASSERT_EQ(NumTableFilesAtLevel(0), 0);
-        ASSERT_GT(NumTableFilesAtLevel(1), 0);
     }
+    ASSERT_GT(env_->started_threads_.Read(), 0);
+    ASSERT_LE(env_->started_threads_.Read(), options.max_subcompactions - 1);
 }
 
-TEST(DBTest, ApproximateSizes_MixOfSmallAndLarge)
+TEST(DBTest, BloomFilter)
 {
+    env_->count_random_reads_ = true;
     Options options;
-    options.compression = kNoCompression;
-    Reopen();
+    options.env = env_;
+    options.block_cache = NewLRUCache(0);  // Prevent cache hits
+    options.filter_policy = NewBloomFilterPolicy(10);
+    Reopen(&options);
 
-    Random rnd(301);
-    std::string big1 = RandomString(&rnd, 100000);
-    ASSERT_OK(Put(Key(0), RandomString(&rnd, 10000)));
-    ASSERT_OK(Put(Key(1), RandomString(&rnd, 10000)));
-    ASSERT_OK(Put(Key(2), big1));
-    ASSERT_OK(Put(Key(3), RandomString(&rnd, 10000)));
-    ASSERT_OK(Put(Key(4), big1));
-    ASSERT_OK(Put(Key(5), RandomString(&rnd, 10000)));
-    ASSERT_OK(Put(Key(6), RandomString(&rnd, 300000)));
-    ASSERT_OK(Put(Key(7), RandomString(&rnd, 10000)));
+    // Populate multiple layers
+    const int N = 10000;
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_OK(Put(Key(i), Key(i)));
+    }
+    Compact("a", "z");
+    for (int i = 0; i < N; i += 100)
+    {
+        ASSERT_OK(Put(Key(i), Key(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
 
-    // Check sizes across recovery by reopening a few times
-    for (int run = 0; run < 3; run++)
+    // Prevent auto compactions triggered by seeks
+    env_->delay_sstable_sync_.Release_Store(env_);
+
+    // Lookup present keys.  Should rarely read from small sstable.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++)
     {
-        Reopen(&options);
+        ASSERT_EQ(Key(i), Get(Key(i)));
+    }
+    int reads = env_->random_read_counter_.Read();
+    fprintf(stderr, "%d present => %d reads\n", N, reads);
+    ASSERT_GE(reads, N);
+    ASSERT_LE(reads, N + 2*N/100);
+
+    // Lookup missing keys.  Should rarely read from either sstable.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+    reads = env_->random_read_counter_.Read();
+    fprintf(stderr, "%d missing => %d reads\n", N, reads);
+    ASSERT_LE(reads, 3*N/100);
+
+    env_->delay_sstable_sync_.Release_Store(NULL);
+    delete db_;
+    db_ = NULL;
+    delete options.block_cache;
+    delete options.filter_policy;
+}
+
+TEST(DBTest, DataBlockHashIndex)
+{
+    Options options;
+    options.env = env_;
+    options.block_restart_interval = 4;
+    options.data_block_hash_index = true;
+    Reopen(&options);
+
+    const int N = 2000;
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_OK(Put(Key(i), "v1"));
+    }
+    const Snapshot* snapshot = db_->GetSnapshot();
+    for (int i = 0; i < N; i += 3)
+    {
+        ASSERT_OK(Put(Key(i), "v2"));
+    }
+    for (int i = 1; i < N; i += 7)
+    {
+        ASSERT_OK(Delete(Key(i)));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_EQ(i % 7 == 1 ? "NOT_FOUND" : i % 3 == 0 ? "v2" : "v1",
+                  Get(Key(i)));
+        ASSERT_EQ("v1", Get(Key(i), snapshot));
+        ASSERT_EQ("NOT_FOUND", Get(Key(i) + "x"));
+    }
+    db_->ReleaseSnapshot(snapshot);
+
+    // Tables with hash indexes read the same without the option
+    options.data_block_hash_index = false;
+    Reopen(&options);
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_EQ(i % 7 == 1 ? "NOT_FOUND" : i % 3 == 0 ? "v2" : "v1",
+                  Get(Key(i)));
+    }
+}
+
+static std::string TenantKey(int tenant, int entity)
+{
+    char buf[30];
+    snprintf(buf, sizeof(buf), "t%02d/e%04d", tenant, entity);
+    return std::string(buf);
+}
+
+TEST(DBTest, PrefixSeek)
+{
+    env_->count_random_reads_ = true;
+    Options options;
+    options.env = env_;
+    options.block_cache = NewLRUCache(0);  // Prevent cache hits
+    options.block_size = 256;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    options.prefix_extractor = NewFixedPrefixTransform(4);
+    Reopen(&options);
+
+    // Even tenants in a compacted level, two odd tenants in a table file
+    // above it, and some deletions in the memtable
+    const int N = 200;
+    for (int t = 0; t < 20; t += 2)
+    {
+        for (int e = 0; e < N; e++)
+        {
+            ASSERT_OK(Put(TenantKey(t, e), "v"));
+        }
+    }
+    Compact("a", "z");
+    for (int e = 0; e < N; e++)
+    {
+        ASSERT_OK(Put(TenantKey(1, e), "v"));
+        ASSERT_OK(Put(TenantKey(3, e), "v"));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int e = 0; e < N; e += 2)
+    {
+        ASSERT_OK(Delete(TenantKey(4, e)));
+    }
+
+    // Prevent auto compactions triggered by seeks
+    env_->delay_sstable_sync_.Release_Store(env_);
+
+    ReadOptions prefix_mode;
+    prefix_mode.prefix_same_as_start = true;
+    for (int t = 0; t < 22; t++)
+    {
+        const int expected = (t == 4) ? N / 2 :
+                             (t % 2 == 0 && t < 20) || t == 1 || t == 3 ? N : 0;
+        Iterator* iter = db_->NewIterator(prefix_mode);
+        int count = 0;
+        std::string last;
+        for (iter->Seek(TenantKey(t, 0)); iter->Valid(); iter->Next())
+        {
+            ASSERT_TRUE(iter->key().starts_with(TenantKey(t, 0).substr(0, 4)));
+            ASSERT_TRUE(last < iter->key().ToString());
+            last = iter->key().ToString();
+            count++;
+        }
+        ASSERT_OK(iter->status());
+        ASSERT_EQ(expected, count);
+        delete iter;
+    }
+
+    // Seeks to missing tenants rarely read a block
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(prefix_mode);
+    for (int t = 5; t < 20; t += 2)
+    {
+        iter->Seek(TenantKey(t, 0));
+        ASSERT_TRUE(!iter->Valid());
+    }
+    int reads = env_->random_read_counter_.Read();
+    fprintf(stderr, "8 missing prefixes => %d reads\n", reads);
+    ASSERT_LE(reads, 2);
+    delete iter;
+
+    env_->random_read_counter_.Reset();
+    iter = db_->NewIterator(ReadOptions());
+    for (int t = 5; t < 19; t += 2)
+    {
+        iter->Seek(TenantKey(t, 0));
+        ASSERT_TRUE(iter->Valid());
+    }
+    ASSERT_GE(env_->random_read_counter_.Read(), 7);
+    delete iter;
+
+    // Prev() is not supported after a prefix seek, while full scans work
+    iter = db_->NewIterator(prefix_mode);
+    iter->Seek(TenantKey(2, 10));
+    ASSERT_TRUE(iter->Valid());
+    iter->Prev();
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_TRUE(!iter->status().ok());
+    delete iter;
+    iter = db_->NewIterator(prefix_mode);
+    int count = 0;
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev())
+    {
+        count++;
+    }
+    ASSERT_EQ(12 * N - N / 2, count);
+    delete iter;
+
+    env_->delay_sstable_sync_.Release_Store(NULL);
+    delete db_;
+    db_ = NULL;
+    delete options.block_cache;
+    delete options.filter_policy;
+    delete options.prefix_extractor;
+}
+
+TEST(DBTest, PartitionedIndex)
+{
+    Options options;
+    options.env = env_;
+    options.block_size = 256;
+    options.index_partition_size = 128;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    Reopen(&options);
+
+    const int N = 5000;
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_OK(Put(Key(i), Key(i) + "v"));
+    }
+    Compact("a", "z");
+    for (int i = 0; i < N; i += 10)
+    {
+        ASSERT_OK(Put(Key(i), Key(i) + "w"));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    // Tables remember their index layout, so they read the same way
+    // whatever the current setting is.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            ASSERT_EQ(Key(i) + (i % 10 == 0 ? "w" : "v"), Get(Key(i)));
+            ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+        }
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        int count = 0;
+        for (iter->SeekToLast(); iter->Valid(); iter->Prev())
+        {
+            ASSERT_EQ(Key(N - 1 - count), iter->key().ToString());
+            count++;
+        }
+        ASSERT_EQ(N, count);
+        iter->Seek(Key(1234) + ".");
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(Key(1235), iter->key().ToString());
+        delete iter;
+        ASSERT_GT(Size(Key(1000), Key(4000)), 0);
+
+        options.index_partition_size = 0;
+        Reopen(&options);
+    }
+
+    delete db_;
+    db_ = NULL;
+    delete options.filter_policy;
+}
+
+TEST(DBTest, IngestExternalFile)
+{
+    Options options;
+    options.env = env_;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    Reopen(&options);
+    const std::string sst = dbname_ + ".sst";
+
+    // Into an empty DB the file is moved to the last level
+    {
+        SstFileWriter writer(options);
+        ASSERT_OK(writer.Open(sst));
+        for (int i = 0; i < 1000; i++)
+        {
+            ASSERT_OK(writer.Put(Key(i), "a"));
+        }
+        ASSERT_TRUE(!writer.Put(Key(5), "x").ok());  // Out of order
+        ASSERT_OK(writer.Finish());
+        ASSERT_GT(writer.FileSize(), 0);
+    }
+    ASSERT_OK(db_->IngestExternalFile(sst));
+    ASSERT_TRUE(!env_->FileExists(sst));
+    ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 1));
+    ASSERT_EQ(1, TotalTableFiles());
+    for (int i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ("a", Get(Key(i)));
+    }
+
+    // Older entries for the file's keys, in the memtable and in the file
+    // added above, and a snapshot that must not see the new entries
+    ASSERT_OK(Put(Key(500), "mem"));
+    ASSERT_OK(Put(Key(2000), "other"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    {
+        SstFileWriter writer(options);
+        ASSERT_OK(writer.Open(sst));
+        for (int i = 400; i < 600; i++)
+        {
+            if (i == 450)
+            {
+                ASSERT_OK(writer.Delete(Key(i)));
+            }
+            else
+            {
+                ASSERT_OK(writer.Put(Key(i), "b"));
+            }
+        }
+        ASSERT_OK(writer.Finish());
+    }
+    ASSERT_OK(db_->IngestExternalFile(sst));
+    ASSERT_TRUE(!env_->FileExists(sst));
+    for (int r = 0; r < 2; r++)
+    {
+        ASSERT_EQ("a", Get(Key(399)));
+        ASSERT_EQ("b", Get(Key(400)));
+        ASSERT_EQ("NOT_FOUND", Get(Key(450)));
+        ASSERT_EQ("b", Get(Key(500)));
+        ASSERT_EQ("a", Get(Key(600)));
+        ASSERT_EQ("other", Get(Key(2000)));
+        if (r == 0)
+        {
+            ASSERT_EQ("mem", Get(Key(500), snapshot));
+            ASSERT_EQ("a", Get(Key(450), snapshot));
+            db_->ReleaseSnapshot(snapshot);
+
+            Iterator* iter = db_->NewIterator(ReadOptions());
+            int count = 0;
+            for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+            {
+                const int i = count < 450 ? count : count + 1;
+                ASSERT_EQ(i < 1000 ? Key(i) : Key(2000), iter->key().ToString());
+                ASSERT_EQ(i < 400 || i >= 600 ? (i < 1000 ? "a" : "other") : "b",
+                          iter->value().ToString());
+                count++;
+            }
+            ASSERT_EQ(1000, count);
+            delete iter;
+            Reopen(&options);
+        }
+    }
+
+    // The recovered sequence number covers the ingested entries
+    ASSERT_OK(Put(Key(500), "c"));
+    ASSERT_EQ("c", Get(Key(500)));
+
+    // Files that were not written by an SstFileWriter are refused
+    ASSERT_TRUE(!db_->IngestExternalFile(sst).ok());
+    ASSERT_TRUE(!db_->IngestExternalFile(dbname_ + "/CURRENT").ok());
+
+    delete db_;
+    db_ = NULL;
+    delete options.filter_policy;
+}
+
+namespace
+{
+// Compresses like the built-in LZ4 compressor under a custom type and
+// counts the blocks it compresses
+class CountingCompressor : public Compressor
+{
+private:
+    const Compressor* lz4_;
+    mutable port::Mutex mu_;
+    mutable int blocks_;
+
+public:
+    CountingCompressor() : lz4_(GetCompressor(kLZ4Compression)), blocks_(0) { }
+
+    int blocks() const
+    {
+        MutexLock l(&mu_);
+        return blocks_;
+    }
+
+    virtual CompressionType type() const
+    {
+        return static_cast<CompressionType>(0x81);
+    }
+
+    virtual const char* Name() const
+    {
+        return "test.Counting";
+    }
+
+    virtual bool Compress(const char* input, size_t length,
+                          std::string* output) const
+    {
+        MutexLock l(&mu_);
+        blocks_++;
+        return lz4_->Compress(input, length, output);
+    }
+
+    virtual bool GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) const
+    {
+        return lz4_->GetUncompressedLength(input, length, result);
+    }
+
+    virtual bool Uncompress(const char* input, size_t length,
+                            char* output) const
+    {
+        return lz4_->Uncompress(input, length, output);
+    }
+};
+}
+
+TEST(DBTest, CompressionPerLevel)
+{
+    static CountingCompressor counting;
+    ASSERT_OK(RegisterCompressor(&counting));
+    const CompressionType per_level[] =
+    {
+        kNoCompression, kLZ4HCCompression, counting.type()
+    };
+    Options options;
+    options.env = env_;
+    options.compression_per_level = per_level;
+    options.compression_per_level_size = 3;
+    Reopen(&options);
+
+    for (int i = 0; i < 200; i++)
+    {
+        ASSERT_OK(Put(Key(i), std::string(1000, 'a' + (i % 26))));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ(0, counting.blocks());
+    const uint64_t uncompressed = Size("", Key(1000));
+    ASSERT_GT(uncompressed, 200 * 1000);
+
+    // The last levels use the last entry
+    for (int level = 0; level < config::kNumLevels - 1; level++)
+    {
+        dbfull()->TEST_CompactRange(level, "", Key(1000));
+    }
+    ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 1));
+    ASSERT_GT(counting.blocks(), 0);
+    ASSERT_LT(Size("", Key(1000)), uncompressed / 10);
+
+    for (int r = 0; r < 2; r++)
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            ASSERT_EQ(std::string(1000, 'a' + (i % 26)), Get(Key(i)));
+        }
+        Reopen(&options);
+    }
+}
+
+TEST(DBTest, CachedIndexAndFilterBlocks)
+{
+    env_->count_random_reads_ = true;
+    Options options;
+    options.env = env_;
+    options.block_cache = NewLRUCache(1 << 20, 0.5);
+    options.cache_index_and_filter_blocks = true;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    Reopen(&options);
+
+    // More data than the cache holds
+    const int N = 10000;
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_OK(Put(Key(i), Key(i) + std::string(100, 'v')));
+    }
+    Compact("a", "z");
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_EQ(Key(i) + std::string(100, 'v'), Get(Key(i)));
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+    {
+        count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(N, count);
+    delete iter;
+
+    // Prevent auto compactions triggered by seeks
+    env_->delay_sstable_sync_.Release_Store(env_);
+
+    // The scan above left the index and filter blocks in the cache, so
+    // missing keys rarely cost a read.
+    env_->random_read_counter_.Reset();
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+    }
+    int reads = env_->random_read_counter_.Read();
+    fprintf(stderr, "%d missing => %d reads\n", N, reads);
+    ASSERT_LE(reads, 3*N/100);
+
+    env_->delay_sstable_sync_.Release_Store(NULL);
+    delete db_;
+    db_ = NULL;
+    delete options.block_cache;
+    delete options.filter_policy;
+}
+
+TEST(DBTest, MmapReads)
+{
+    Options options;
+    options.env = env_;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.max_mmap_read_bytes = 300000;  // Maps only some of the tables
+    Reopen(&options);
+
+    Random rnd(301);
+    std::vector<std::string> values;
+    for (int i = 0; i < 2000; i++)
+    {
+        values.push_back(RandomString(&rnd, 500));
+        ASSERT_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_GT(TotalTableFiles(), 3);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < 2000; i++)
+        {
+            ASSERT_EQ(values[i], Get(Key(i)));
+        }
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        iter->SeekToFirst();
+        for (int i = 0; i < 2000; i++)
+        {
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ(values[i], iter->value().ToString());
+            iter->Next();
+        }
+        ASSERT_TRUE(!iter->Valid());
+        delete iter;
+
+        // Compactions replace the mapped tables
+        Compact(Key(0), Key(2000));
+    }
+}
+
+TEST(DBTest, CompactRange)
+{
+    Options options;
+    options.env = env_;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.max_background_compactions = 4;
+    Reopen(&options);
+
+    // Spread the data over several files in more than one level
+    Random rnd(301);
+    const int N = 12000;
+    std::vector<std::string> values;
+    for (int i = 0; i < N; i++)
+    {
+        values.push_back(RandomString(&rnd, 1000));
+        ASSERT_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_GT(TotalTableFiles(), 1);
+
+    // Compacting a range that holds only deletions drops its data
+    for (int i = 0; i < N / 2; i++)
+    {
+        ASSERT_OK(Delete(Key(i)));
+    }
+    const std::string mid = Key(N / 2);
+    const Slice limit(mid);
+    db_->CompactRange(NULL, &limit);
+    ASSERT_LE(Size("", Key(N / 2 - 1)), 100000);
+    ASSERT_GE(Size(Key(N / 2), Key(N)), 5000000);
+
+    // Compacting everything leaves a single level that holds all files
+    db_->CompactRange(NULL, NULL);
+    int levels_with_files = 0;
+    for (int level = 0; level < config::kNumLevels; level++)
+    {
+        if (NumTableFilesAtLevel(level) > 0)
+        {
+            levels_with_files++;
+        }
+    }
+    ASSERT_EQ(levels_with_files, 1);
+    ASSERT_GT(TotalTableFiles(), 1);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        iter->SeekToFirst();
+        for (int i = N / 2; i < N; i++)
+        {
+            ASSERT_TRUE(iter->Valid());
+            ASSERT_EQ(Key(i), iter->key().ToString());
+            ASSERT_EQ(values[i], iter->value().ToString());
+            iter->Next();
+        }
+        ASSERT_TRUE(!iter->Valid());
+        delete iter;
+        ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+
+        // Check the recovered state as well
+        Reopen(&options);
+    }
+}
+
+TEST(DBTest, DynamicLevelTargets)
+{
+    Options options;
+    options.env = env_;
+    options.compression = kNoCompression;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.level_compaction_dynamic_level_bytes = true;
+    Reopen(&options);
+
+    // While the database is small, level-0 is compacted straight into the
+    // last level, and new tables are not pushed past level-0
+    Random rnd(301);
+    for (int i = 0; i < 50; i++)
+    {
+        ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ(1, NumTableFilesAtLevel(0));
+    dbfull()->TEST_CompactRange(0, "", "z");
+    for (int level = 0; level < config::kNumLevels - 1; level++)
+    {
+        ASSERT_EQ(0, NumTableFilesAtLevel(level));
+    }
+    ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+
+    // Once the last level outgrows the fixed level-1 target, level-0 is
+    // compacted into the level above it
+    for (int i = 0; i < 12000; i++)
+    {
+        ASSERT_OK(Put(Key(i), RandomString(&rnd, 1000)));
+    }
+    db_->CompactRange(NULL, NULL);
+    for (int level = 0; level < config::kNumLevels - 1; level++)
+    {
+        ASSERT_EQ(0, NumTableFilesAtLevel(level));
+    }
+    std::vector<std::string> values;
+    for (int i = 0; i < 10; i++)
+    {
+        values.push_back(RandomString(&rnd, 1000));
+        ASSERT_OK(Put(Key(i), values[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, "", "z");
+    for (int level = 0; level < config::kNumLevels - 2; level++)
+    {
+        ASSERT_EQ(0, NumTableFilesAtLevel(level));
+    }
+    ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 2));
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(values[i], Get(Key(i)));
+    }
+
+    // The levels survive reopening
+    Reopen(&options);
+    ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 2));
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(values[i], Get(Key(i)));
+    }
+}
+
+TEST(DBTest, SparseMerge)
+{
+    Options options;
+    options.compression = kNoCompression;
+    Reopen(&options);
+
+    FillLevels("A", "Z");
+
+    // Suppose there is:
+    //    small amount of data with prefix A
+    //    large amount of data with prefix B
+    //    small amount of data with prefix C
+    // and that recent updates have made small changes to all three prefixes.
+    // Check that we do not do a compaction that merges all of B in one shot.
+    const std::string value(1000, 'x');
+    Put("A", "va");
+    // Write approximately 100MB of "B" values
+    for (int i = 0; i < 100000; i++)
+    {
+        char key[100];
+        snprintf(key, sizeof(key), "B%010d", i);
+        Put(key, value);
+    }
+    Put("C", "vc");
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, "A", "Z");
+
+    // Make sparse update
+    Put("A",    "va2");
+    Put("B100", "bvalue2");
+    Put("C",    "vc2");
+    dbfull()->TEST_CompactMemTable();
+
+    // Compactions should not cause us to create a situation where
+    // a file overlaps too much data at the next level.
+    ASSERT_LE(dbfull()->TEST_MaxNextLevelOverlappingBytes(), 20*1048576);
+    dbfull()->TEST_CompactRange(0, "", "z");
+    ASSERT_LE(dbfull()->TEST_MaxNextLevelOverlappingBytes(), 20*1048576);
+    dbfull()->TEST_CompactRange(1, "", "z");
+    ASSERT_LE(dbfull()->TEST_MaxNextLevelOverlappingBytes(), 20*1048576);
+}
+
+static bool Between(uint64_t val, uint64_t low, uint64_t high)
+{
+    bool result = (val >= low) && (val <= high);
+    if (!result)
+    {
+        fprintf(stderr, "Value %llu is not in range [%llu, %llu]\n",
+                (unsigned long long)(val),
+                (unsigned long long)(low),
+                (unsigned long long)(high));
+    }
+    return result;
+}
+
+TEST(DBTest, ApproximateSizes)
+{
+    Options options;
+    options.write_buffer_size = 100000000;        // Large write buffer
+    options.compression = kNoCompression;
+    DestroyAndReopen();
+
+    ASSERT_TRUE(Between(Size("", "xyz"), 0, 0));
+    Reopen(&options);
+    ASSERT_TRUE(Between(Size("", "xyz"), 0, 0));
+
+    // Write 8MB (80 values, each 100K)
+    ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+    const int N = 80;
+    Random rnd(301);
+    for (int i = 0; i < N; i++)
+    {
+        ASSERT_OK(Put(Key(i), RandomString(&rnd, 100000)));
+    }
+
+    // 0 because GetApproximateSizes() does not account for memtable space
+    ASSERT_TRUE(Between(Size("", Key(50)), 0, 0));
+
+    // Check sizes across recovery by reopening a few times
+    for (int run = 0; run < 3; run++)
+    {
+        Reopen(&options);
+
+        for (int compact_start = 0; compact_start < N; compact_start += 10)
+        {
+            for (int i = 0; i < N; i += 10)
+            {
+                ASSERT_TRUE(Between(Size("", Key(i)), 100000*i, 100000*i + 10000));
+                ASSERT_TRUE(Between(Size("", Key(i)+".suffix"),
+                                    100000 * (i+1), 100000 * (i+1) + 10000));
+                ASSERT_TRUE(Between(Size(Key(i), Key(i+10)),
+                                    100000 * 10, 100000 * 10 + 10000));
+            }
+            ASSERT_TRUE(Between(Size("", Key(50)), 5000000, 5010000));
+            ASSERT_TRUE(Between(Size("", Key(50)+".suffix"), 5100000, 5110000));
+
+            dbfull()->TEST_CompactRange(0,
+                                        Key(compact_start),
+                                        Key(compact_start + 9));
+        }
+
+        ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+        ASSERT_GT(NumTableFilesAtLevel(1), 0);
+    }
+}
+
+TEST(DBTest, ApproximateSizes_MixOfSmallAndLarge)
+{
+    Options options;
+    options.compression = kNoCompression;
+    Reopen();
+
+    Random rnd(301);
+    std::string big1 = RandomString(&rnd, 100000);
+    ASSERT_OK(Put(Key(0), RandomString(&rnd, 10000)));
+    ASSERT_OK(Put(Key(1), RandomString(&rnd, 10000)));
+    ASSERT_OK(Put(Key(2), big1));
+    ASSERT_OK(Put(Key(3), RandomString(&rnd, 10000)));
+    ASSERT_OK(Put(Key(4), big1));
+    ASSERT_OK(Put(Key(5), RandomString(&rnd, 10000)));
+    ASSERT_OK(Put(Key(6), RandomString(&rnd, 300000)));
+    ASSERT_OK(Put(Key(7), RandomString(&rnd, 10000)));
+
+    // Check sizes across recovery by reopening a few times
+    for (int run = 0; run < 3; run++)
+    {
+        Reopen(&options);
 
         ASSERT_TRUE(Between(Size("", Key(0)), 0, 0));
         ASSERT_TRUE(Between(Size("", Key(1)), 10000, 11000));
@@ -1284,6 +2345,307 @@ TEST(DBTest, MultiThreaded)
     }
 }
 
+namespace
+{
+static const int kCommitWriters = 6;
+static const int kCommitsPerWriter = 200;
+
+struct CommitWriter
+{
+    DBTest* test;
+    int id;
+    Status status[kCommitsPerWriter];
+    port::AtomicPointer done;
+};
+
+static std::string CommitKey(int id, int i)
+{
+    char buf[30];
+    snprintf(buf, sizeof(buf), "commit%d.%06d", id, i);
+    return std::string(buf);
+}
+
+// The value of batch "i" of writer "id".  Writer 2 now and then writes
+// more than the 128KB that the group of a small batch may grow by, and
+// writer 3 batches big enough that two of them exceed the 1MB limit.
+static std::string CommitValue(int id, int i)
+{
+    size_t size = 100;
+    if (id == 2 && i % 20 == 0) size = 300 << 10;
+    if (id == 3 && i % 40 == 0) size = 700 << 10;
+    char buf[30];
+    snprintf(buf, sizeof(buf), "%d.%d.", id, i);
+    std::string value = buf;
+    value.resize(size, 'a' + id);
+    return value;
+}
+
+static void CommitWriterBody(void* arg)
+{
+    CommitWriter* t = reinterpret_cast<CommitWriter*>(arg);
+    DB* db = t->test->db_;
+    for (int i = 0; i < kCommitsPerWriter; i++)
+    {
+        // Writer 0 always syncs and writer 1 every third batch, so sync
+        // and non-sync writes wait in the queue together
+        WriteOptions options;
+        options.sync = (t->id == 0) || (t->id == 1 && i % 3 == 0);
+        WriteBatch batch;
+        batch.Put(CommitKey(t->id, i), CommitValue(t->id, i));
+        if (i > 0)
+        {
+            // Rewrite the previous key, which an earlier group committed
+            batch.Delete(CommitKey(t->id, i - 1));
+            batch.Put(CommitKey(t->id, i - 1), CommitValue(t->id, i - 1));
+        }
+        t->status[i] = db->Write(options, &batch);
+    }
+    t->done.Release_Store(t);
+}
+}
+
+TEST(DBTest, GroupCommit)
+{
+    Options options;
+    options.env = env_;
+    options.write_buffer_size = 2 << 20;
+    Reopen(&options);
+
+    CommitWriter writers[kCommitWriters];
+    for (int id = 0; id < kCommitWriters; id++)
+    {
+        writers[id].test = this;
+        writers[id].id = id;
+        writers[id].done.Release_Store(NULL);
+        env_->StartThread(CommitWriterBody, &writers[id]);
+    }
+
+    // Forced memtable switches put NULL batches in the queue, each of
+    // which has to lead a group of its own
+    for (int id = 0; id < kCommitWriters; id++)
+    {
+        while (writers[id].done.Acquire_Load() == NULL)
+        {
+            ASSERT_OK(dbfull()->TEST_CompactMemTable());
+            env_->SleepForMicroseconds(1000);
+        }
+    }
+
+    for (int id = 0; id < kCommitWriters; id++)
+    {
+        for (int i = 0; i < kCommitsPerWriter; i++)
+        {
+            ASSERT_OK(writers[id].status[i]);
+        }
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int id = 0; id < kCommitWriters; id++)
+        {
+            for (int i = 0; i < kCommitsPerWriter; i++)
+            {
+                ASSERT_TRUE(CommitValue(id, i) == Get(CommitKey(id, i)));
+            }
+        }
+
+        // Recovery replays the same groups from the log
+        Reopen(&options);
+    }
+}
+
+namespace
+{
+static const int kViewKeys = 100;
+
+struct ViewState
+{
+    DBTest* test;
+    port::AtomicPointer written;    // Number of Puts that have returned
+    port::AtomicPointer stop;
+    port::AtomicPointer readers_done;
+};
+
+static std::string ViewKey(uintptr_t i)
+{
+    char buf[20];
+    snprintf(buf, sizeof(buf), "%08d", static_cast<int>(i % kViewKeys));
+    return std::string(buf);
+}
+
+static void ViewReaderBody(void* arg)
+{
+    ViewState* state = reinterpret_cast<ViewState*>(arg);
+    DB* db = state->test->db_;
+    std::string value;
+    int reads = 0;
+    while (state->stop.Acquire_Load() == NULL)
+    {
+        // The last completed Put must be visible, whatever flushes and
+        // compactions have swapped the read view since.
+        uintptr_t n = reinterpret_cast<uintptr_t>(state->written.Acquire_Load());
+        if (n == 0) continue;
+        const uintptr_t last = n - 1;
+        ASSERT_OK(db->Get(ReadOptions(), ViewKey(last), &value));
+        ASSERT_GE(static_cast<uintptr_t>(atoi(value.c_str())), last);
+
+        if (++reads % 64 == 0 && n >= kViewKeys)
+        {
+            Iterator* iter = db->NewIterator(ReadOptions());
+            int count = 0;
+            for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+            {
+                count++;
+            }
+            ASSERT_OK(iter->status());
+            ASSERT_EQ(kViewKeys, count);
+            delete iter;
+        }
+    }
+    intptr_t done = reinterpret_cast<intptr_t>(state->readers_done.Acquire_Load());
+    while (!state->readers_done.CompareAndSwap(reinterpret_cast<void*>(done),
+                                               reinterpret_cast<void*>(done + 1)))
+    {
+        done = reinterpret_cast<intptr_t>(state->readers_done.Acquire_Load());
+    }
+}
+}
+
+TEST(DBTest, ReadViewsFollowFlushes)
+{
+    Options options;
+    options.env = env_;
+    options.write_buffer_size = 64 << 10;  // Switch memtables often
+    Reopen(&options);
+
+    ViewState state;
+    state.test = this;
+    state.written.Release_Store(NULL);
+    state.stop.Release_Store(NULL);
+    state.readers_done.Release_Store(NULL);
+    const int kReaders = 3;
+    for (int i = 0; i < kReaders; i++)
+    {
+        env_->StartThread(ViewReaderBody, &state);
+    }
+
+    const std::string padding(1000, 'x');
+    for (uintptr_t i = 0; i < 5000; i++)
+    {
+        char buf[20];
+        snprintf(buf, sizeof(buf), "%d.", static_cast<int>(i));
+        ASSERT_OK(Put(ViewKey(i), buf + padding));
+        state.written.Release_Store(reinterpret_cast<void*>(i + 1));
+    }
+
+    state.stop.Release_Store(&state);
+    while (reinterpret_cast<intptr_t>(state.readers_done.Acquire_Load()) < kReaders)
+    {
+        env_->SleepForMicroseconds(10000);
+    }
+    ASSERT_GT(TotalTableFiles(), 0);
+}
+
+namespace
+{
+static const int kGroupWriters = 4;
+static const int kBatchesPerWriter = 500;
+
+struct GroupWriteState
+{
+    DBTest* test;
+    port::AtomicPointer writers_done;
+};
+
+struct GroupWriter
+{
+    GroupWriteState* state;
+    int id;
+};
+
+static std::string GroupKey(int id, int i)
+{
+    char buf[30];
+    snprintf(buf, sizeof(buf), "key%06d.%d", i, id);
+    return std::string(buf);
+}
+
+static void GroupWriterBody(void* arg)
+{
+    GroupWriter* t = reinterpret_cast<GroupWriter*>(arg);
+    DB* db = t->state->test->db_;
+    for (int i = 0; i < kBatchesPerWriter; i++)
+    {
+        // Overwrite the previous key in the same batch so that entries
+        // for one user key must keep their sequence order.
+        WriteBatch batch;
+        batch.Put(GroupKey(t->id, i), "first");
+        batch.Put(GroupKey(t->id, i), std::string(200, 'a' + t->id));
+        if (i > 0)
+        {
+            batch.Delete(GroupKey(t->id, i - 1));
+            batch.Put(GroupKey(t->id, i - 1), "v");
+        }
+        ASSERT_OK(db->Write(WriteOptions(), &batch));
+    }
+    GroupWriteState* state = t->state;
+    intptr_t done = reinterpret_cast<intptr_t>(state->writers_done.Acquire_Load());
+    while (!state->writers_done.CompareAndSwap(reinterpret_cast<void*>(done),
+                                               reinterpret_cast<void*>(done + 1)))
+    {
+        done = reinterpret_cast<intptr_t>(state->writers_done.Acquire_Load());
+    }
+}
+}
+
+TEST(DBTest, ConcurrentMemtableWrites)
+{
+    Options options;
+    options.env = env_;
+    options.write_buffer_size = 100 << 10;  // Switch memtables a few times
+    options.allow_concurrent_memtable_write = true;
+    Reopen(&options);
+
+    GroupWriteState state;
+    state.test = this;
+    state.writers_done.Release_Store(NULL);
+    GroupWriter writers[kGroupWriters];
+    for (int id = 0; id < kGroupWriters; id++)
+    {
+        writers[id].state = &state;
+        writers[id].id = id;
+        env_->StartThread(GroupWriterBody, &writers[id]);
+    }
+    while (reinterpret_cast<intptr_t>(state.writers_done.Acquire_Load()) <
+           kGroupWriters)
+    {
+        env_->SleepForMicroseconds(10000);
+    }
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int id = 0; id < kGroupWriters; id++)
+        {
+            for (int i = 0; i < kBatchesPerWriter; i++)
+            {
+                const std::string expected = (i + 1 < kBatchesPerWriter) ?
+                                             "v" : std::string(200, 'a' + id);
+                ASSERT_EQ(expected, Get(GroupKey(id, i)));
+            }
+        }
+        Iterator* iter = db_->NewIterator(ReadOptions());
+        int count = 0;
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+        {
+            count++;
+        }
+        delete iter;
+        ASSERT_EQ(kGroupWriters * kBatchesPerWriter, count);
+
+        // Recovery replays the same groups from the log
+        Reopen(&options);
+    }
+}
+
 namespace
 {
 typedef std::map<std::string, std::string> KVMap;
@@ -1372,6 +2734,9 @@ public:
             sizes[i] = 0;
         }
     }
+    virtual void CompactRange(const Slice* start, const Slice* end)
+    {
+    }
 private:
     class ModelIter: public Iterator
     {
@@ -99,6 +99,45 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const
     }
 }
 
+const char* InternalFilterPolicy::Name() const
+{
+    return user_policy_->Name();
+}
+
+void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
+                                        std::string* dst) const
+{
+    // We rely on the fact that the code in table.cc does not mind us
+    // adjusting keys[].
+    Slice* mkey = const_cast<Slice*>(keys);
+    for (int i = 0; i < n; i++)
+    {
+        mkey[i] = ExtractUserKey(keys[i]);
+        // TODO(sanjay): Suppress dups?
+    }
+    user_policy_->CreateFilter(keys, n, dst);
+}
+
+bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const
+{
+    return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
+}
+
+const char* InternalKeySliceTransform::Name() const
+{
+    return user_transform_->Name();
+}
+
+Slice InternalKeySliceTransform::Transform(const Slice& key) const
+{
+    return user_transform_->Transform(ExtractUserKey(key));
+}
+
+bool InternalKeySliceTransform::InDomain(const Slice& key) const
+{
+    return key.size() >= 8 && user_transform_->InDomain(ExtractUserKey(key));
+}
+
 LookupKey::LookupKey(const Slice& user_key, SequenceNumber s)
 {
     size_t usize = user_key.size();
@@ -8,7 +8,9 @@
 #include <stdio.h>
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/slice.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "util/coding.h"
 #include "util/logging.h"
@@ -134,6 +136,35 @@ public:
     int Compare(const InternalKey& a, const InternalKey& b) const;
 };
 
+// Filter policy wrapper that converts from internal keys to user keys
+class InternalFilterPolicy : public FilterPolicy
+{
+private:
+    const FilterPolicy* const user_policy_;
+public:
+    explicit InternalFilterPolicy(const FilterPolicy* p) : user_policy_(p) { }
+    virtual const char* Name() const;
+    virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const;
+    virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const;
+};
+
+// Prefix extractor wrapper that converts from internal keys to user keys
+class InternalKeySliceTransform : public SliceTransform
+{
+private:
+    const SliceTransform* const user_transform_;
+public:
+    explicit InternalKeySliceTransform(const SliceTransform* t)
+        : user_transform_(t) { }
+    const SliceTransform* user_transform() const
+    {
+        return user_transform_;
+    }
+    virtual const char* Name() const;
+    virtual Slice Transform(const Slice& key) const;
+    virtual bool InDomain(const Slice& key) const;
+};
+
 // Modules in this directory should keep internal keys wrapped inside
 // the following class instead of plain strings so that we do not
 // incorrectly use string comparisons instead of an InternalKeyComparator.
@@ -7,6 +7,7 @@
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "port/port.h"
 #include "util/coding.h"
 
 namespace leveldb
@@ -20,22 +21,40 @@ static Slice GetLengthPrefixedSlice(const char* data)
     return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& cmp)
+// Used when Options::memtable_factory is NULL.  Created on first use
+// rather than by a static initializer, whose order relative to other
+// static initializers is unspecified.
+static port::OnceType default_factory_once = LEVELDB_ONCE_INIT;
+static MemTableRepFactory* default_factory = NULL;
+
+static void InitDefaultFactory()
+{
+    default_factory = NewSkipListMemTableRepFactory();
+}
+
+MemTable::MemTable(const InternalKeyComparator& cmp,
+                   MemTableRepFactory* factory)
     : comparator_(cmp),
-      refs_(0),
-      table_(comparator_, &arena_)
+      refs_(0)
 {
+    if (factory == NULL)
+    {
+        port::InitOnce(&default_factory_once, InitDefaultFactory);
+        factory = default_factory;
+    }
+    table_ = factory->CreateMemTableRep(comparator_, &arena_);
 }
 
 MemTable::~MemTable()
 {
     assert(refs_ == 0);
+    delete table_;
 }
 
 //z 实际调用了 arena 的 MemoryUsage 函数
 size_t MemTable::ApproximateMemoryUsage()
 {
-    return arena_.MemoryUsage();
+    return arena_.MemoryUsage() + table_->ApproximateMemoryUsage();
 }
 
 int MemTable::KeyComparator::operator()(const char* aptr, const char* bptr) const
@@ -57,42 +76,50 @@ static const char* EncodeKey(std::string* scratch, const Slice& target)
     return scratch->data();
 }
 
+// The representation's iterator is created on first use.  Some
+// representations sort their entries when the iterator is created, and
+// the flush path positions its iterator only after releasing the DB mutex.
 class MemTableIterator: public Iterator
 {
 public:
-    explicit MemTableIterator(MemTable::Table* table) : iter_(table) { }
+    explicit MemTableIterator(MemTableRep* table) : table_(table), iter_(NULL) { }
+
+    virtual ~MemTableIterator()
+    {
+        delete iter_;
+    }
 
     virtual bool Valid() const
     {
-        return iter_.Valid();
+        return iter_ != NULL && iter_->Valid();
     }
     virtual void Seek(const Slice& k)
     {
-        iter_.Seek(EncodeKey(&tmp_, k));
+        Rep()->Seek(EncodeKey(&tmp_, k));
     }
     virtual void SeekToFirst()
     {
-        iter_.SeekToFirst();
+        Rep()->SeekToFirst();
     }
     virtual void SeekToLast()
     {
-        iter_.SeekToLast();
+        Rep()->SeekToLast();
     }
     virtual void Next()
     {
-        iter_.Next();
+        iter_->Next();
     }
     virtual void Prev()
     {
-        iter_.Prev();
+        iter_->Prev();
     }
     virtual Slice key() const
     {
-        return GetLengthPrefixedSlice(iter_.key());
+        return GetLengthPrefixedSlice(iter_->key());
     }
     virtual Slice value() const
     {
-        Slice key_slice = GetLengthPrefixedSlice(iter_.key());
+        Slice key_slice = GetLengthPrefixedSlice(iter_->key());
         return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
     }
 
@@ -102,9 +129,19 @@ public:
     }
 
 private:
-    MemTable::Table::Iterator iter_;
+    MemTableRep* const table_;
+    MemTableRep::Iterator* iter_;
     std::string tmp_;       // For passing to EncodeKey
 
+    MemTableRep::Iterator* Rep()
+    {
+        if (iter_ == NULL)
+        {
+            iter_ = table_->NewIterator();
+        }
+        return iter_;
+    }
+
     // No copying allowed
     MemTableIterator(const MemTableIterator&);
     void operator=(const MemTableIterator&);
@@ -112,42 +149,59 @@ private:
 
 Iterator* MemTable::NewIterator()
 {
-    return new MemTableIterator(&table_);
+    return new MemTableIterator(table_);
 }
 
-void MemTable::Add(SequenceNumber s, ValueType type,
-                   const Slice& key,
-                   const Slice& value)
+// Format of an entry is concatenation of:
+//  key_size     : varint32 of internal_key.size()
+//  key bytes    : char[internal_key.size()]
+//  value_size   : varint32 of value.size()
+//  value bytes  : char[value.size()]
+static size_t EntryLength(const Slice& key, const Slice& value)
+{
+    size_t internal_key_size = key.size() + 8;
+    return VarintLength(internal_key_size) + internal_key_size +
+           VarintLength(value.size()) + value.size();
+}
+
+static void EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                        const Slice& key, const Slice& value)
 {
-    // Format of an entry is concatenation of:
-    //  key_size     : varint32 of internal_key.size()
-    //  key bytes    : char[internal_key.size()]
-    //  value_size   : varint32 of value.size()
-    //  value bytes  : char[value.size()]
     size_t key_size = key.size();
     size_t val_size = value.size();
-    size_t internal_key_size = key_size + 8;
-    const size_t encoded_len =
-        VarintLength(internal_key_size) + internal_key_size +
-        VarintLength(val_size) + val_size;
-    char* buf = arena_.Allocate(encoded_len);
-    char* p = EncodeVarint32(buf, internal_key_size);
+    char* p = EncodeVarint32(buf, key_size + 8);
     memcpy(p, key.data(), key_size);
     p += key_size;
     EncodeFixed64(p, (s << 8) | type);
     p += 8;
     p = EncodeVarint32(p, val_size);
     memcpy(p, value.data(), val_size);
-    assert((p + val_size) - buf == encoded_len);
-    table_.Insert(buf);
+    assert((p + val_size) - buf == EntryLength(key, value));
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type,
+                   const Slice& key,
+                   const Slice& value)
+{
+    char* buf = arena_.Allocate(EntryLength(key, value));
+    EncodeEntry(buf, s, type, key, value);
+    table_->Insert(buf);
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key,
+                               const Slice& value)
+{
+    char* buf = arena_.AllocateConcurrently(EntryLength(key, value));
+    EncodeEntry(buf, s, type, key, value);
+    table_->InsertConcurrently(buf);
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s)
 {
     Slice memkey = key.memtable_key();
-    Table::Iterator iter(&table_);
-    iter.Seek(memkey.data());
-    if (iter.Valid())
+    const char* entry = table_->FindGreaterOrEqual(memkey.data());
+    if (entry != NULL)
     {
         // entry format is:
         //    klength  varint32
@@ -158,7 +212,6 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s)
         // Check that it belongs to same user key.  We do not check the
         // sequence number since the Seek() call above should have skipped
         // all entries with overly large sequence numbers.
-        const char* entry = iter.key();
         uint32_t key_length;
         const char* key_ptr = GetVarint32Ptr(entry, entry+5, &key_length);
         if (comparator_.comparator.user_comparator()->Compare(
@@ -7,8 +7,8 @@
 
 #include <string>
 #include "leveldb/db.h"
+#include "leveldb/memtablerep.h"
 #include "db/dbformat.h"
-#include "db/skiplist.h"
 #include "util/arena.h"
 
 namespace leveldb
@@ -24,7 +24,10 @@ public:
     // is zero and the caller must call Ref() at least once.
     //z 采用了引用计数的形式。
     //z 其值初始为0，调用者必须至少调用一次 Ref() 。
-    explicit MemTable(const InternalKeyComparator& comparator);
+    // Entries are kept in a representation made by "*factory", or in a
+    // skip list if factory is NULL.
+    explicit MemTable(const InternalKeyComparator& comparator,
+                      MemTableRepFactory* factory = NULL);
 
     // Increase reference count.
     //z 增加引用计数
@@ -62,6 +65,13 @@ public:
     // db/format.{h,cc} module.
     Iterator* NewIterator();
 
+    // Tell the representation that no more entries will be added, e.g.
+    // because the memtable is about to be flushed.
+    void MarkReadOnly()
+    {
+        table_->MarkReadOnly();
+    }
+
     // Add an entry into memtable that maps key to value at the
     // specified sequence number and with the specified type.
     // Typically value will be empty if type==kTypeDeletion.
@@ -69,6 +79,12 @@ public:
              const Slice& key,
              const Slice& value);
 
+    // Same as Add(), but may be called from several threads at once.
+    // REQUIRES: no concurrent call to Add().
+    void AddConcurrently(SequenceNumber seq, ValueType type,
+                         const Slice& key,
+                         const Slice& value);
+
     // If memtable contains a value for key, store it in *value and return true.
     // If memtable contains a deletion for key, store a NotFound() error
     // in *status and return true.
@@ -78,22 +94,18 @@ public:
 private:
     ~MemTable();  // Private since only Unref() should be used to delete it
 
-    struct KeyComparator
+    struct KeyComparator : public MemTableRep::KeyComparator
     {
         const InternalKeyComparator comparator;
         explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) { }
-        int operator()(const char* a, const char* b) const;
+        virtual int operator()(const char* a, const char* b) const;
     };
     friend class MemTableIterator;
-    friend class MemTableBackwardIterator;
-
-    //z 看起来使用了一个 SkipList
-    typedef SkipList<const char*, KeyComparator> Table;
 
     KeyComparator comparator_;
     int refs_;
     Arena arena_;
-    Table table_;
+    MemTableRep* table_;
 
     // No copying allowed
     MemTable(const MemTable&);
@@ -0,0 +1,492 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/memtablerep.h"
+
+#include <algorithm>
+#include <vector>
+#include "db/skiplist.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+MemTableRep::KeyComparator::~KeyComparator() { }
+
+MemTableRep::Iterator::~Iterator() { }
+
+MemTableRep::~MemTableRep() { }
+
+void MemTableRep::InsertConcurrently(const char* entry)
+{
+    // Only reached if a factory claims support it does not provide
+    assert(false);
+    Insert(entry);
+}
+
+void MemTableRep::MarkReadOnly()
+{
+}
+
+size_t MemTableRep::ApproximateMemoryUsage()
+{
+    return 0;
+}
+
+Slice MemTableRep::UserKey(const char* entry)
+{
+    uint32_t len;
+    const char* p = GetVarint32Ptr(entry, entry + 5, &len);
+    assert(len >= 8);
+    return Slice(p, len - 8);
+}
+
+MemTableRepFactory::~MemTableRepFactory() { }
+
+bool MemTableRepFactory::IsInsertConcurrentlySupported() const
+{
+    return false;
+}
+
+namespace
+{
+
+typedef SkipList<const char*, const MemTableRep::KeyComparator&> EntryList;
+
+class SkipListIterator : public MemTableRep::Iterator
+{
+public:
+    explicit SkipListIterator(const EntryList* list) : iter_(list) { }
+
+    virtual bool Valid() const
+    {
+        return iter_.Valid();
+    }
+    virtual const char* key() const
+    {
+        return iter_.key();
+    }
+    virtual void Next()
+    {
+        iter_.Next();
+    }
+    virtual void Prev()
+    {
+        iter_.Prev();
+    }
+    virtual void Seek(const char* target)
+    {
+        iter_.Seek(target);
+    }
+    virtual void SeekToFirst()
+    {
+        iter_.SeekToFirst();
+    }
+    virtual void SeekToLast()
+    {
+        iter_.SeekToLast();
+    }
+
+private:
+    EntryList::Iterator iter_;
+};
+
+// Iterates over a sorted array of entries, which it deletes at the end if
+// it was given ownership.
+class VectorIterator : public MemTableRep::Iterator
+{
+public:
+    VectorIterator(const std::vector<const char*>* entries, bool owned,
+                   const MemTableRep::KeyComparator& cmp)
+        : entries_(entries),
+          owned_(owned),
+          compare_(cmp),
+          pos_(entries->size())
+    {
+    }
+
+    virtual ~VectorIterator()
+    {
+        if (owned_) delete entries_;
+    }
+
+    virtual bool Valid() const
+    {
+        return pos_ < entries_->size();
+    }
+    virtual const char* key() const
+    {
+        assert(Valid());
+        return (*entries_)[pos_];
+    }
+    virtual void Next()
+    {
+        assert(Valid());
+        pos_++;
+    }
+    virtual void Prev()
+    {
+        assert(Valid());
+        pos_ = (pos_ == 0) ? entries_->size() : pos_ - 1;
+    }
+    virtual void Seek(const char* target)
+    {
+        // Binary search for the first entry >= target
+        size_t left = 0;
+        size_t right = entries_->size();
+        while (left < right)
+        {
+            size_t mid = left + (right - left) / 2;
+            if (compare_((*entries_)[mid], target) < 0)
+            {
+                left = mid + 1;
+            }
+            else
+            {
+                right = mid;
+            }
+        }
+        pos_ = left;
+    }
+    virtual void SeekToFirst()
+    {
+        pos_ = 0;
+    }
+    virtual void SeekToLast()
+    {
+        pos_ = entries_->empty() ? 0 : entries_->size() - 1;
+    }
+
+private:
+    const std::vector<const char*>* entries_;
+    const bool owned_;
+    const MemTableRep::KeyComparator& compare_;
+    size_t pos_;
+
+    // No copying allowed
+    VectorIterator(const VectorIterator&);
+    void operator=(const VectorIterator&);
+};
+
+struct EntryLess
+{
+    const MemTableRep::KeyComparator* compare;
+    bool operator()(const char* a, const char* b) const
+    {
+        return (*compare)(a, b) < 0;
+    }
+};
+
+static void SortEntries(const MemTableRep::KeyComparator& cmp,
+                        std::vector<const char*>* entries)
+{
+    EntryLess less;
+    less.compare = &cmp;
+    std::sort(entries->begin(), entries->end(), less);
+}
+
+class SkipListRep : public MemTableRep
+{
+public:
+    SkipListRep(const KeyComparator& cmp, Arena* arena) : list_(cmp, arena) { }
+
+    virtual void Insert(const char* entry)
+    {
+        list_.Insert(entry);
+    }
+
+    virtual void InsertConcurrently(const char* entry)
+    {
+        list_.InsertConcurrently(entry);
+    }
+
+    virtual const char* FindGreaterOrEqual(const char* target)
+    {
+        EntryList::Iterator iter(&list_);
+        iter.Seek(target);
+        return iter.Valid() ? iter.key() : NULL;
+    }
+
+    virtual Iterator* NewIterator()
+    {
+        return new SkipListIterator(&list_);
+    }
+
+private:
+    EntryList list_;
+};
+
+class SkipListRepFactory : public MemTableRepFactory
+{
+public:
+    virtual const char* Name() const
+    {
+        return "leveldb.SkipListRepFactory";
+    }
+
+    virtual MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator& cmp,
+                                           Arena* arena)
+    {
+        return new SkipListRep(cmp, arena);
+    }
+
+    virtual bool IsInsertConcurrentlySupported() const
+    {
+        return true;
+    }
+};
+
+// Entries are spread over buckets by the hash of their user key's prefix.
+// Buckets are skip lists created in the arena on first use, so a reader
+// that races with the writer sees either no bucket or a usable one.
+class HashSkipListRep : public MemTableRep
+{
+public:
+    HashSkipListRep(const KeyComparator& cmp, Arena* arena,
+                    const SliceTransform* transform, size_t bucket_count)
+        : compare_(cmp),
+          arena_(arena),
+          transform_(transform),
+          bucket_count_(bucket_count),
+          buckets_(new port::AtomicPointer[bucket_count])
+    {
+        for (size_t i = 0; i < bucket_count_; i++)
+        {
+            buckets_[i].NoBarrier_Store(NULL);
+        }
+    }
+
+    virtual ~HashSkipListRep()
+    {
+        // The buckets live in the arena
+        delete[] buckets_;
+    }
+
+    virtual void Insert(const char* entry)
+    {
+        port::AtomicPointer* slot = &buckets_[BucketIndex(entry)];
+        EntryList* bucket = reinterpret_cast<EntryList*>(slot->NoBarrier_Load());
+        if (bucket == NULL)
+        {
+            char* mem = arena_->AllocateAligned(sizeof(EntryList));
+            bucket = new (mem) EntryList(compare_, arena_);
+            slot->Release_Store(bucket);
+        }
+        bucket->Insert(entry);
+    }
+
+    virtual const char* FindGreaterOrEqual(const char* target)
+    {
+        EntryList* bucket = GetBucket(BucketIndex(target));
+        if (bucket == NULL)
+        {
+            return NULL;
+        }
+        EntryList::Iterator iter(bucket);
+        iter.Seek(target);
+        return iter.Valid() ? iter.key() : NULL;
+    }
+
+    virtual Iterator* NewIterator()
+    {
+        // Buckets are not ordered relative to each other, so gather and
+        // sort everything.
+        std::vector<const char*>* entries = new std::vector<const char*>;
+        for (size_t i = 0; i < bucket_count_; i++)
+        {
+            EntryList* bucket = GetBucket(i);
+            if (bucket != NULL)
+            {
+                EntryList::Iterator iter(bucket);
+                for (iter.SeekToFirst(); iter.Valid(); iter.Next())
+                {
+                    entries->push_back(iter.key());
+                }
+            }
+        }
+        SortEntries(compare_, entries);
+        return new VectorIterator(entries, true, compare_);
+    }
+
+    virtual size_t ApproximateMemoryUsage()
+    {
+        return bucket_count_ * sizeof(port::AtomicPointer);
+    }
+
+private:
+    const KeyComparator& compare_;
+    Arena* const arena_;
+    const SliceTransform* const transform_;
+    const size_t bucket_count_;
+    port::AtomicPointer* buckets_;
+
+    size_t BucketIndex(const char* entry) const
+    {
+        Slice key = UserKey(entry);
+        if (transform_->InDomain(key))
+        {
+            key = transform_->Transform(key);
+        }
+        return Hash(key.data(), key.size(), 0) % bucket_count_;
+    }
+
+    EntryList* GetBucket(size_t i) const
+    {
+        return reinterpret_cast<EntryList*>(buckets_[i].Acquire_Load());
+    }
+
+    // No copying allowed
+    HashSkipListRep(const HashSkipListRep&);
+    void operator=(const HashSkipListRep&);
+};
+
+class HashSkipListRepFactory : public MemTableRepFactory
+{
+public:
+    HashSkipListRepFactory(const SliceTransform* transform, size_t bucket_count)
+        : transform_(transform),
+          bucket_count_(bucket_count > 0 ? bucket_count : 1)
+    {
+    }
+
+    virtual const char* Name() const
+    {
+        return "leveldb.HashSkipListRepFactory";
+    }
+
+    virtual MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator& cmp,
+                                           Arena* arena)
+    {
+        return new HashSkipListRep(cmp, arena, transform_, bucket_count_);
+    }
+
+private:
+    const SliceTransform* transform_;
+    size_t bucket_count_;
+};
+
+// Entries are appended to an array that is sorted in place once the rep
+// has been marked read-only.  Until then, every read works on a copy.
+class VectorRep : public MemTableRep
+{
+public:
+    explicit VectorRep(const KeyComparator& cmp)
+        : compare_(cmp),
+          read_only_(false),
+          sorted_(false)
+    {
+    }
+
+    virtual void Insert(const char* entry)
+    {
+        MutexLock l(&mu_);
+        assert(!read_only_);
+        entries_.push_back(entry);
+    }
+
+    virtual const char* FindGreaterOrEqual(const char* target)
+    {
+        MutexLock l(&mu_);
+        if (sorted_)
+        {
+            VectorIterator iter(&entries_, false, compare_);
+            iter.Seek(target);
+            return iter.Valid() ? iter.key() : NULL;
+        }
+
+        // A linear scan is cheaper than sorting a copy for one lookup
+        const char* result = NULL;
+        for (size_t i = 0; i < entries_.size(); i++)
+        {
+            const char* entry = entries_[i];
+            if (compare_(entry, target) >= 0 &&
+                    (result == NULL || compare_(entry, result) < 0))
+            {
+                result = entry;
+            }
+        }
+        return result;
+    }
+
+    virtual Iterator* NewIterator()
+    {
+        MutexLock l(&mu_);
+        if (read_only_)
+        {
+            if (!sorted_)
+            {
+                SortEntries(compare_, &entries_);
+                sorted_ = true;
+            }
+            // entries_ never changes again
+            return new VectorIterator(&entries_, false, compare_);
+        }
+        std::vector<const char*>* copy = new std::vector<const char*>(entries_);
+        SortEntries(compare_, copy);
+        return new VectorIterator(copy, true, compare_);
+    }
+
+    virtual void MarkReadOnly()
+    {
+        MutexLock l(&mu_);
+        read_only_ = true;
+    }
+
+    virtual size_t ApproximateMemoryUsage()
+    {
+        MutexLock l(&mu_);
+        return entries_.capacity() * sizeof(const char*);
+    }
+
+private:
+    const KeyComparator& compare_;
+    port::Mutex mu_;
+    std::vector<const char*> entries_;
+    bool read_only_;
+    bool sorted_;
+
+    // No copying allowed
+    VectorRep(const VectorRep&);
+    void operator=(const VectorRep&);
+};
+
+class VectorRepFactory : public MemTableRepFactory
+{
+public:
+    virtual const char* Name() const
+    {
+        return "leveldb.VectorRepFactory";
+    }
+
+    virtual MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator& cmp,
+                                           Arena* arena)
+    {
+        return new VectorRep(cmp);
+    }
+};
+
+}
+
+MemTableRepFactory* NewSkipListMemTableRepFactory()
+{
+    return new SkipListRepFactory;
+}
+
+MemTableRepFactory* NewHashSkipListMemTableRepFactory(
+    const SliceTransform* prefix_extractor, size_t bucket_count)
+{
+    return new HashSkipListRepFactory(prefix_extractor, bucket_count);
+}
+
+MemTableRepFactory* NewVectorMemTableRepFactory()
+{
+    return new VectorRepFactory;
+}
+
+}
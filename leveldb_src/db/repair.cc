@@ -51,7 +51,10 @@ public:
         : dbname_(dbname),
           env_(options.env),
           icmp_(options.comparator),
-          options_(SanitizeOptions(dbname, &icmp_, options)),
+          ipolicy_(options.filter_policy),
+          iprefix_(options.prefix_extractor),
+          options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, &iprefix_,
+                                   options)),
           owns_info_log_(options_.info_log != options.info_log),
           owns_cache_(options_.block_cache != options.block_cache),
           next_file_number_(1)
@@ -111,6 +114,8 @@ private:
     std::string const dbname_;
     Env* const env_;
     InternalKeyComparator const icmp_;
+    InternalFilterPolicy const ipolicy_;
+    InternalKeySliceTransform const iprefix_;
     Options const options_;
     bool owns_info_log_;
     bool owns_cache_;
@@ -228,7 +233,7 @@ private:
         std::string scratch;
         Slice record;
         WriteBatch batch;
-        MemTable* mem = new MemTable(icmp_);
+        MemTable* mem = new MemTable(icmp_, options_.memtable_factory);
         mem->Ref();
         int counter = 0;
         while (reader.ReadRecord(&record, &scratch))
@@ -8,7 +8,9 @@
 // 写需要外同步
 // 读需要在读过程中 skiplist 不会被销毁
 // 除此之外，读进程没有任何的内部锁定和同步
-// Writes require external synchronization, most likely a mutex.
+// Writes require external synchronization, most likely a mutex.  The
+// exception is InsertConcurrently(), which may be called by several
+// threads at once as long as no thread calls Insert() meanwhile.
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -63,6 +65,14 @@ public:
     //z 前提：在当前 list 中没有同样的key
     void Insert(const Key& key);
 
+    // Like Insert(), but safe to call from several threads at once.  Each
+    // link is spliced in with a compare-and-swap, and the node is allocated
+    // through the arena's thread-safe path.
+    // REQUIRES: no concurrent call to Insert().
+    // REQUIRES: nothing that compares equal to key is in, or being
+    // inserted into, the list.
+    void InsertConcurrently(const Key& key);
+
     // Returns true iff an entry that compares equal to key is in the list.
     //z 是否已经包含了该 key 。
     bool Contains(const Key& key) const;
@@ -130,8 +140,13 @@ private:
     // Read/written only by Insert().
     Random rnd_;
 
+    // Random state shared by InsertConcurrently() callers, advanced with
+    // a compare-and-swap.
+    port::AtomicPointer concurrent_rnd_;
+
     Node* NewNode(const Key& key, int height);
     int RandomHeight();
+    int RandomHeightConcurrently();
     bool Equal(const Key& a, const Key& b) const
     {
         return (compare_(a, b) == 0);
@@ -147,6 +162,11 @@ private:
     // node at "level" for every level in [0..max_height_-1].
     Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
 
+    // Starting at "before", which sorts before key, walk along "level" and
+    // store in *prev and *next the adjacent nodes that key falls between.
+    void FindSpliceForLevel(const Key& key, Node* before, int level,
+                            Node** prev, Node** next) const;
+
     // Return the latest node with a key < key.
     // Return head_ if there is no such node.
     Node* FindLessThan(const Key& key) const;
@@ -197,6 +217,14 @@ struct SkipList<Key,Comparator>::Node
         next_[n].NoBarrier_Store(x);
     }
 
+    // Link x in at level n if the link still points at "expected".  The
+    // swap is a full barrier, so it also publishes x like SetNext().
+    bool CASNext(int n, Node* expected, Node* x)
+    {
+        assert(n >= 0);
+        return next_[n].CompareAndSwap(expected, x);
+    }
+
 private:
     // Array of length equal to the node height.  next_[0] is lowest level link.
     port::AtomicPointer next_[1];
@@ -288,6 +316,34 @@ int SkipList<Key,Comparator>::RandomHeight()
     return height;
 }
 
+template<typename Key, class Comparator>
+int SkipList<Key,Comparator>::RandomHeightConcurrently()
+{
+    // Advance the shared generator by one step, then spend two bits of
+    // the drawn value per level, which matches kBranching == 4 above.
+    uint32_t r;
+    while (true)
+    {
+        void* seed = concurrent_rnd_.Acquire_Load();
+        Random rnd(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(seed)));
+        r = rnd.Next();
+        if (concurrent_rnd_.CompareAndSwap(
+                seed, reinterpret_cast<void*>(static_cast<uintptr_t>(r))))
+        {
+            break;
+        }
+    }
+    int height = 1;
+    while (height < kMaxHeight && (r & 3) == 0)
+    {
+        height++;
+        r >>= 2;
+    }
+    assert(height > 0);
+    assert(height <= kMaxHeight);
+    return height;
+}
+
 template<typename Key, class Comparator>
 bool SkipList<Key,Comparator>::KeyIsAfterNode(const Key& key, Node* n) const
 {
@@ -325,6 +381,24 @@ const
     }
 }
 
+template<typename Key, class Comparator>
+void SkipList<Key,Comparator>::FindSpliceForLevel(const Key& key, Node* before,
+                                                  int level, Node** prev,
+                                                  Node** next) const
+{
+    while (true)
+    {
+        Node* after = before->Next(level);
+        if (!KeyIsAfterNode(key, after))
+        {
+            *prev = before;
+            *next = after;
+            return;
+        }
+        before = after;
+    }
+}
+
 template<typename Key, class Comparator>
 typename SkipList<Key,Comparator>::Node*
 SkipList<Key,Comparator>::FindLessThan(const Key& key) const
@@ -388,7 +462,8 @@ SkipList<Key,Comparator>::SkipList(Comparator cmp, Arena* arena)
       arena_(arena),
       head_(NewNode(0 /* any key will do */, kMaxHeight)),
       max_height_(reinterpret_cast<void*>(1)),
-      rnd_(0xdeadbeef)
+      rnd_(0xdeadbeef),
+      concurrent_rnd_(reinterpret_cast<void*>(0xdeadbeef & 0x7fffffff))
 {
     for (int i = 0; i < kMaxHeight; i++)
     {
@@ -436,6 +511,63 @@ void SkipList<Key,Comparator>::Insert(const Key& key)
     }
 }
 
+template<typename Key, class Comparator>
+void SkipList<Key,Comparator>::InsertConcurrently(const Key& key)
+{
+    int height = RandomHeightConcurrently();
+
+    // Raise max_height_ first.  Readers that see the new height before x
+    // is linked find NULL at the new levels of head_ and drop down, just
+    // as in Insert().
+    int max_height = GetMaxHeight();
+    while (height > max_height)
+    {
+        if (max_height_.CompareAndSwap(reinterpret_cast<void*>(max_height),
+                                       reinterpret_cast<void*>(height)))
+        {
+            break;
+        }
+        max_height = GetMaxHeight();
+    }
+    if (max_height < height)
+    {
+        max_height = height;
+    }
+
+    Node* prev[kMaxHeight];
+    Node* next[kMaxHeight];
+    Node* before = head_;
+    for (int i = max_height - 1; i >= 0; i--)
+    {
+        FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+        before = prev[i];
+    }
+
+    // Our data structure does not allow duplicate insertion
+    assert(next[0] == NULL || !Equal(key, next[0]->key));
+
+    char* mem = arena_->AllocateAlignedConcurrently(
+                    sizeof(Node) + sizeof(port::AtomicPointer) * (height - 1));
+    Node* x = new (mem) Node(key);
+
+    // Link bottom-up so that x is reachable at level i only once it is
+    // reachable at every level below i.  When another writer wins the race
+    // for a link, the splice is recomputed from prev[i], which still sorts
+    // before key because nodes are never removed.
+    for (int i = 0; i < height; i++)
+    {
+        while (true)
+        {
+            x->NoBarrier_SetNext(i, next[i]);
+            if (prev[i]->CASNext(i, next[i], x))
+            {
+                break;
+            }
+            FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+        }
+    }
+}
+
 template<typename Key, class Comparator>
 bool SkipList<Key,Comparator>::Contains(const Key& key) const
 {
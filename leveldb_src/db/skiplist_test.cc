@@ -457,6 +457,106 @@ TEST(SkipTest, Concurrent5)
     RunConcurrent(5);
 }
 
+// Several threads calling InsertConcurrently() on one list
+namespace
+{
+static const int kInserters = 4;
+static const int kKeysPerInserter = 20000;
+
+struct InserterState
+{
+    SkipList<Key, Comparator>* list;
+    port::AtomicPointer go;
+    port::AtomicPointer done[kInserters];
+};
+
+struct Inserter
+{
+    InserterState* state;
+    int id;
+};
+
+static void InserterBody(void* arg)
+{
+    Inserter* t = reinterpret_cast<Inserter*>(arg);
+    while (t->state->go.Acquire_Load() == NULL)
+    {
+        // Spin so that all inserters start at about the same time
+    }
+    // Interleave the keys of all inserters so that they race for the
+    // same links.
+    Random rnd(1000 + t->id);
+    for (int i = 0; i < kKeysPerInserter; i++)
+    {
+        Key k = (static_cast<Key>(rnd.Next()) << 8) * kInserters + t->id;
+        if (!t->state->list->Contains(k))
+        {
+            t->state->list->InsertConcurrently(k);
+        }
+    }
+    t->state->done[t->id].Release_Store(t);
+}
+}
+
+TEST(SkipTest, InsertConcurrently)
+{
+    Arena arena;
+    Comparator cmp;
+    SkipList<Key, Comparator> list(cmp, &arena);
+    InserterState state;
+    state.list = &list;
+    state.go.Release_Store(NULL);
+    Inserter inserters[kInserters];
+    for (int id = 0; id < kInserters; id++)
+    {
+        state.done[id].Release_Store(NULL);
+        inserters[id].state = &state;
+        inserters[id].id = id;
+        Env::Default()->StartThread(InserterBody, &inserters[id]);
+    }
+    state.go.Release_Store(&state);
+    for (int id = 0; id < kInserters; id++)
+    {
+        while (state.done[id].Acquire_Load() == NULL)
+        {
+            Env::Default()->SleepForMicroseconds(1000);
+        }
+    }
+
+    // Replay each inserter's keys and check that the list holds exactly
+    // their union, in order.
+    std::set<Key> keys;
+    for (int id = 0; id < kInserters; id++)
+    {
+        Random rnd(1000 + id);
+        for (int i = 0; i < kKeysPerInserter; i++)
+        {
+            keys.insert((static_cast<Key>(rnd.Next()) << 8) * kInserters + id);
+        }
+    }
+    SkipList<Key, Comparator>::Iterator iter(&list);
+    iter.SeekToFirst();
+    for (std::set<Key>::iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*it, iter.key());
+        ASSERT_TRUE(list.Contains(*it));
+        iter.Next();
+    }
+    ASSERT_TRUE(!iter.Valid());
+
+    // Walking backwards uses the upper levels as well
+    iter.SeekToLast();
+    for (std::set<Key>::reverse_iterator it = keys.rbegin(); it != keys.rend();
+         ++it)
+    {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*it, iter.key());
+        iter.Prev();
+    }
+    ASSERT_TRUE(!iter.Valid());
+}
+
 }
 
 int main(int argc, char** argv)
@@ -0,0 +1,138 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include "db/dbformat.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb
+{
+
+// The file holds internal keys, like the tables of a database, all with
+// sequence number zero.  DB::IngestExternalFile() either adds the file as
+// it is or rewrites it with the sequence number it assigns.
+struct SstFileWriter::Rep
+{
+    const InternalKeyComparator icmp;
+    const InternalFilterPolicy ipolicy;
+    const InternalKeySliceTransform iprefix;
+    Options options;
+    WritableFile* file;
+    TableBuilder* builder;
+    uint64_t file_size;     // Once the builder is gone
+    std::string last_key;   // Last user key added
+    InternalKey ikey;
+
+    explicit Rep(const Options& opt)
+        : icmp(opt.comparator),
+          ipolicy(opt.filter_policy),
+          iprefix(opt.prefix_extractor),
+          options(opt),
+          file(NULL),
+          builder(NULL),
+          file_size(0)
+    {
+        options.comparator = &icmp;
+        options.filter_policy = (opt.filter_policy != NULL) ? &ipolicy : NULL;
+        options.prefix_extractor =
+            (opt.prefix_extractor != NULL) ? &iprefix : NULL;
+    }
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options))
+{
+}
+
+SstFileWriter::~SstFileWriter()
+{
+    if (rep_->builder != NULL)
+    {
+        rep_->builder->Abandon();
+        delete rep_->builder;
+    }
+    delete rep_->file;
+    delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname)
+{
+    Rep* r = rep_;
+    if (r->file != NULL)
+    {
+        return Status::InvalidArgument("file already opened", fname);
+    }
+    Status s = r->options.env->NewWritableFile(fname, &r->file);
+    if (s.ok())
+    {
+        r->builder = new TableBuilder(r->options, r->file);
+    }
+    return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value)
+{
+    return Add(key, value, false);
+}
+
+Status SstFileWriter::Delete(const Slice& key)
+{
+    return Add(key, Slice(), true);
+}
+
+Status SstFileWriter::Add(const Slice& key, const Slice& value,
+                          bool deletion)
+{
+    Rep* r = rep_;
+    if (r->builder == NULL)
+    {
+        return Status::InvalidArgument("file is not open");
+    }
+    if (r->builder->NumEntries() > 0 &&
+            r->icmp.user_comparator()->Compare(key, Slice(r->last_key)) <= 0)
+    {
+        return Status::InvalidArgument("keys must be added in strictly "
+                                       "increasing order");
+    }
+    r->last_key.assign(key.data(), key.size());
+    r->ikey = InternalKey(key, 0, deletion ? kTypeDeletion : kTypeValue);
+    r->builder->Add(r->ikey.Encode(), value);
+    return r->builder->status();
+}
+
+Status SstFileWriter::Finish()
+{
+    Rep* r = rep_;
+    if (r->builder == NULL)
+    {
+        return Status::InvalidArgument("file is not open");
+    }
+    if (r->builder->NumEntries() == 0)
+    {
+        return Status::InvalidArgument("cannot write a file without entries");
+    }
+    Status s = r->builder->Finish();
+    r->file_size = r->builder->FileSize();
+    delete r->builder;
+    r->builder = NULL;
+    if (s.ok())
+    {
+        s = r->file->Sync();
+    }
+    if (s.ok())
+    {
+        s = r->file->Close();
+    }
+    return s;
+}
+
+uint64_t SstFileWriter::FileSize() const
+{
+    return (rep_->builder != NULL) ? rep_->builder->FileSize()
+           : rep_->file_size;
+}
+
+}
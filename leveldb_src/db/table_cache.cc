@@ -8,6 +8,7 @@
 #include "leveldb/env.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb
 {
@@ -18,13 +19,20 @@ struct TableAndFile
     RandomAccessFile* file;
     //z .sst 文件在内存中的映像，有.sst文件和index block数据。
     Table* table;
+    TableCache* owner;
+    uint64_t mmap_bytes;    // Charged to owner's mapping budget
 };
 
-static void DeleteEntry(const Slice& key, void* value)
+void TableCache::DeleteEntry(const Slice& key, void* value)
 {
     TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
     delete tf->table;
     delete tf->file;
+    if (tf->mmap_bytes > 0)
+    {
+        MutexLock l(&tf->owner->mmap_mutex_);
+        tf->owner->mmap_bytes_ -= tf->mmap_bytes;
+    }
     delete tf;
 }
 
@@ -41,7 +49,8 @@ TableCache::TableCache(const std::string& dbname,
     : env_(options->env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries))//z 使用的也是LRU cache。
+      cache_(NewLRUCache(entries)),//z 使用的也是LRU cache。
+      mmap_bytes_(0)
 {
 }
 
@@ -50,31 +59,45 @@ TableCache::~TableCache()
     delete cache_;
 }
 
-Iterator* TableCache::NewIterator(const ReadOptions& options,
-                                  uint64_t file_number,
-                                  uint64_t file_size,
-                                  Table** tableptr)
+Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
+                             Cache::Handle** handle)
 {
-    if (tableptr != NULL)
-    {
-        *tableptr = NULL;
-    }
-
+    Status s;
     char buf[sizeof(file_number)];
     //z 统一编码为 le 
     EncodeFixed64(buf, file_number);
     Slice key(buf, sizeof(buf));
     //z 在cache中查找
-    Cache::Handle* handle = cache_->Lookup(key);
+    *handle = cache_->Lookup(key);
     //z 如果没有找到
-    if (handle == NULL)
+    if (*handle == NULL)
     {
         //z 根据dbname 以及 file_number 构造出一个 table file name
         std::string fname = TableFileName(dbname_, file_number);
         RandomAccessFile* file = NULL;
         Table* table = NULL;
+
+        // Map the file if it fits in what is left of the mapping budget
+        uint64_t mmap_bytes = 0;
+        if (options_->max_mmap_read_bytes > 0 && file_size > 0)
+        {
+            MutexLock l(&mmap_mutex_);
+            if (mmap_bytes_ + file_size <= options_->max_mmap_read_bytes)
+            {
+                mmap_bytes_ += file_size;
+                mmap_bytes = file_size;
+            }
+        }
+
         //z 根据 table file name 创建文件
-        Status s = env_->NewRandomAccessFile(fname, &file);
+        if (mmap_bytes > 0)
+        {
+            s = env_->NewMmapReadableFile(fname, &file);
+        }
+        else
+        {
+            s = env_->NewRandomAccessFile(fname, &file);
+        }
         if (s.ok())
         {
             //z 打开文件
@@ -85,16 +108,43 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
         {
             assert(table == NULL);
             delete file;
+            if (mmap_bytes > 0)
+            {
+                MutexLock l(&mmap_mutex_);
+                mmap_bytes_ -= mmap_bytes;
+            }
             // We do not cache error results so that if the error is transient,
             // or somebody repairs the file, we recover automatically.
-            return NewErrorIterator(s);
         }
+        else
+        {
+            //z 创建结构，用于存储对应的 file name 以及 table 等。
+            TableAndFile* tf = new TableAndFile;
+            tf->file = file;
+            tf->table = table;
+            tf->owner = this;
+            tf->mmap_bytes = mmap_bytes;
+            *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
+        }
+    }
+    return s;
+}
+
+Iterator* TableCache::NewIterator(const ReadOptions& options,
+                                  uint64_t file_number,
+                                  uint64_t file_size,
+                                  Table** tableptr)
+{
+    if (tableptr != NULL)
+    {
+        *tableptr = NULL;
+    }
 
-        //z 创建结构，用于存储对应的 file name 以及 table 等。
-        TableAndFile* tf = new TableAndFile;
-        tf->file = file;
-        tf->table = table;
-        handle = cache_->Insert(key, tf, 1, &DeleteEntry);
+    Cache::Handle* handle = NULL;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (!s.ok())
+    {
+        return NewErrorIterator(s);
     }
 
     Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
@@ -107,6 +157,50 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
     return result;
 }
 
+Status TableCache::Get(const ReadOptions& options,
+                       uint64_t file_number,
+                       uint64_t file_size,
+                       const Slice& k,
+                       void* arg,
+                       void (*saver)(void*, const Slice&, const Slice&))
+{
+    Cache::Handle* handle = NULL;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (s.ok())
+    {
+        Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+        s = t->InternalGet(options, k, arg, saver);
+        cache_->Release(handle);
+    }
+    return s;
+}
+
+void TableCache::MultiGet(const ReadOptions& options,
+                          uint64_t file_number,
+                          uint64_t file_size,
+                          int n,
+                          const Slice* keys,
+                          void* const* args,
+                          void (*saver)(void*, const Slice&, const Slice&),
+                          Status* statuses)
+{
+    Cache::Handle* handle = NULL;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (s.ok())
+    {
+        Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+        t->InternalMultiGet(options, n, keys, args, saver, statuses);
+        cache_->Release(handle);
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            statuses[i] = s;
+        }
+    }
+}
+
 void TableCache::Evict(uint64_t file_number)
 {
     char buf[sizeof(file_number)];
@@ -37,6 +37,26 @@ public:
                           uint64_t file_size,
                           Table** tableptr = NULL);
 
+    // If a seek to internal key "k" in specified file finds an entry,
+    // call (*handle_result)(arg, found_key, found_value).
+    Status Get(const ReadOptions& options,
+               uint64_t file_number,
+               uint64_t file_size,
+               const Slice& k,
+               void* arg,
+               void (*handle_result)(void*, const Slice&, const Slice&));
+
+    // Like Get() for each of keys[0,n-1], which must be sorted, calling
+    // (*handle_result)(args[i], ...) and setting statuses[i].
+    void MultiGet(const ReadOptions& options,
+                  uint64_t file_number,
+                  uint64_t file_size,
+                  int n,
+                  const Slice* keys,
+                  void* const* args,
+                  void (*handle_result)(void*, const Slice&, const Slice&),
+                  Status* statuses);
+
     // Evict any entry for the specified file number
     void Evict(uint64_t file_number);
 
@@ -45,6 +65,14 @@ private:
     const std::string dbname_;
     const Options* options_;
     Cache* cache_;
+
+    // Total size of the open files that were opened through mappings.
+    // Kept within options_->max_mmap_read_bytes.
+    port::Mutex mmap_mutex_;
+    uint64_t mmap_bytes_;
+
+    Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+    static void DeleteEntry(const Slice& key, void* value);
 };
 
 }
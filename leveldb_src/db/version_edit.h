@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 #include "db/dbformat.h"
+#include "port/port.h"
 
 namespace leveldb
 {
@@ -18,13 +19,16 @@ class VersionSet;
 struct FileMetaData
 {
     int refs;
-    int allowed_seeks;          // Seeks allowed until compaction
+    port::AtomicInt32 allowed_seeks;  // Seeks allowed until compaction
     uint64_t number;
     uint64_t file_size;         // File size in bytes
     InternalKey smallest;       // Smallest internal key served by table
     InternalKey largest;        // Largest internal key served by table
+    bool being_compacted;       // Input of a running compaction?
 
-    FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) { }
+    FileMetaData()
+        : refs(0), allowed_seeks(1 << 30), file_size(0),
+          being_compacted(false) { }
 };
 
 class VersionEdit
@@ -27,6 +27,9 @@ static const int kTargetFileSize = 2 * 1048576;
 // stop building a single file in a level->level+1 compaction.
 static const int64_t kMaxGrandParentOverlapBytes = 10 * kTargetFileSize;
 
+// Each level is this many times the size of the one above it
+static const int kLevelSizeMultiplier = 10;
+
 static double MaxBytesForLevel(int level)
 {
     // Note: the result for level zero is not really used since we set
@@ -34,7 +37,7 @@ static double MaxBytesForLevel(int level)
     double result = 10 * 1048576.0;  // Result for both level-0 and level-1
     while (level > 1)
     {
-        result *= 10;
+        result *= kLevelSizeMultiplier;
         level--;
     }
     return result;
@@ -115,15 +118,24 @@ int FindFile(const InternalKeyComparator& icmp,
 bool SomeFileOverlapsRange(
     const InternalKeyComparator& icmp,
     const std::vector<FileMetaData*>& files,
-    const Slice& smallest_user_key,
-    const Slice& largest_user_key)
+    const Slice* smallest_user_key,
+    const Slice* largest_user_key)
 {
-    // Find the earliest possible internal key for smallest_user_key
-    InternalKey small(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
-    const uint32_t index = FindFile(icmp, files, small.Encode());
-    return ((index < files.size()) &&
+    uint32_t index = 0;
+    if (smallest_user_key != NULL)
+    {
+        // Find the earliest possible internal key for smallest_user_key
+        InternalKey small(*smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
+        index = FindFile(icmp, files, small.Encode());
+    }
+    if (index >= files.size())
+    {
+        // Beginning of range is after all files, so no overlap
+        return false;
+    }
+    return (largest_user_key == NULL ||
             icmp.user_comparator()->Compare(
-                largest_user_key, files[index]->smallest.user_key()) >= 0);
+                *largest_user_key, files[index]->smallest.user_key()) >= 0);
 }
 
 // An internal iterator.  For a given version/level pair, yields
@@ -131,14 +143,21 @@ bool SomeFileOverlapsRange(
 // is the largest key that occurs in the file, and value() is an
 // 16-byte value containing the file number and file size, both
 // encoded using EncodeFixed64.
+//
+// If "prefix_extractor" is non-NULL, Next() after a Seek() stops before
+// the first file whose smallest key has another prefix than the target,
+// since the keys with that prefix end before such a file.
 class Version::LevelFileNumIterator : public Iterator
 {
 public:
     LevelFileNumIterator(const InternalKeyComparator& icmp,
-                         const std::vector<FileMetaData*>* flist)
+                         const std::vector<FileMetaData*>* flist,
+                         const SliceTransform* prefix_extractor = NULL)
         : icmp_(icmp),
           flist_(flist),
-          index_(flist->size())          // Marks as invalid
+          prefix_extractor_(prefix_extractor),
+          index_(flist->size()),         // Marks as invalid
+          prefix_bounded_(false)
     {
     }
     virtual bool Valid() const
@@ -148,23 +167,42 @@ public:
     virtual void Seek(const Slice& target)
     {
         index_ = FindFile(icmp_, *flist_, target);
+        prefix_bounded_ = (prefix_extractor_ != NULL &&
+                           prefix_extractor_->InDomain(target));
+        if (prefix_bounded_)
+        {
+            Slice prefix = prefix_extractor_->Transform(target);
+            prefix_.assign(prefix.data(), prefix.size());
+        }
     }
     virtual void SeekToFirst()
     {
         index_ = 0;
+        prefix_bounded_ = false;
     }
     virtual void SeekToLast()
     {
         index_ = flist_->empty() ? 0 : flist_->size() - 1;
+        prefix_bounded_ = false;
     }
     virtual void Next()
     {
         assert(Valid());
         index_++;
+        if (prefix_bounded_ && index_ < flist_->size())
+        {
+            Slice smallest = (*flist_)[index_]->smallest.Encode();
+            if (!prefix_extractor_->InDomain(smallest) ||
+                    prefix_extractor_->Transform(smallest) != Slice(prefix_))
+            {
+                index_ = flist_->size();  // Marks as invalid
+            }
+        }
     }
     virtual void Prev()
     {
         assert(Valid());
+        prefix_bounded_ = false;
         if (index_ == 0)
         {
             index_ = flist_->size();  // Marks as invalid
@@ -193,7 +231,10 @@ public:
 private:
     const InternalKeyComparator icmp_;
     const std::vector<FileMetaData*>* const flist_;
+    const SliceTransform* const prefix_extractor_;
     uint32_t index_;
+    bool prefix_bounded_;
+    std::string prefix_;
 
     // Backing store for value().  Holds the file number and size.
     mutable char value_buf_[16];
@@ -220,8 +261,12 @@ static Iterator* GetFileIterator(void* arg,
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
         int level) const
 {
+    const SliceTransform* prefix_extractor =
+        (options.prefix_same_as_start ? vset_->options_->prefix_extractor
+         : NULL);
     return NewTwoLevelIterator(
-               new LevelFileNumIterator(vset_->icmp_, &files_[level]),
+               new LevelFileNumIterator(vset_->icmp_, &files_[level],
+                                        prefix_extractor),
                &GetFileIterator, vset_->table_cache_, options);
 }
 
@@ -248,40 +293,43 @@ void Version::AddIterators(const ReadOptions& options,
     }
 }
 
-// If "*iter" points at a value or deletion for user_key, store
-// either the value, or a NotFound error and return true.
-// Else return false.
-static bool GetValue(Iterator* iter, const Slice& user_key,
-                     std::string* value,
-                     Status* s)
+// Callback from TableCache::Get()
+namespace
 {
-    if (!iter->Valid())
-    {
-        return false;
-    }
+enum SaverState
+{
+    kNotFound,
+    kFound,
+    kDeleted,
+    kCorrupt,
+};
+struct Saver
+{
+    SaverState state;
+    const Comparator* ucmp;
+    Slice user_key;
+    std::string* value;
+};
+}
+static void SaveValue(void* arg, const Slice& ikey, const Slice& v)
+{
+    Saver* s = reinterpret_cast<Saver*>(arg);
     ParsedInternalKey parsed_key;
-    if (!ParseInternalKey(iter->key(), &parsed_key))
+    if (!ParseInternalKey(ikey, &parsed_key))
     {
-        *s = Status::Corruption("corrupted key for ", user_key);
-        return true;
+        s->state = kCorrupt;
     }
-    if (parsed_key.user_key != user_key)
-    {
-        return false;
-    }
-    switch (parsed_key.type)
-    {
-    case kTypeDeletion:
-        *s = Status::NotFound(Slice());  // Use an empty error message for speed
-        break;
-    case kTypeValue:
+    else
     {
-        Slice v = iter->value();
-        value->assign(v.data(), v.size());
-        break;
-    }
+        if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0)
+        {
+            s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
+            if (s->state == kFound)
+            {
+                s->value->assign(v.data(), v.size());
+            }
+        }
     }
-    return true;
 }
 
 static bool NewestFirst(FileMetaData* a, FileMetaData* b)
@@ -375,30 +423,228 @@ Status Version::Get(const ReadOptions& options,
             last_file_read = f;
             last_file_read_level = level;
 
-            Iterator* iter = vset_->table_cache_->NewIterator(
-                                 options,
-                                 f->number,
-                                 f->file_size);
-            iter->Seek(ikey);
-            const bool done = GetValue(iter, user_key, value, &s);
-            if (!iter->status().ok())
+            Saver saver;
+            saver.state = kNotFound;
+            saver.ucmp = ucmp;
+            saver.user_key = user_key;
+            saver.value = value;
+            s = vset_->table_cache_->Get(options, f->number, f->file_size,
+                                         ikey, &saver, SaveValue);
+            if (!s.ok())
             {
-                s = iter->status();
-                delete iter;
                 return s;
             }
-            else
+            switch (saver.state)
+            {
+            case kNotFound:
+                break;      // Keep searching in other files
+            case kFound:
+                return s;
+            case kDeleted:
+                s = Status::NotFound(Slice());  // Use empty error message for speed
+                return s;
+            case kCorrupt:
+                s = Status::Corruption("corrupted key for ", user_key);
+                return s;
+            }
+        }
+    }
+
+    return Status::NotFound(Slice());  // Use an empty error message for speed
+}
+
+// Per-key state of Version::MultiGet()
+struct Version::MultiGetKey
+{
+    Saver saver;
+    Slice ikey;
+    bool done;
+    FileMetaData* last_file_read;
+    int last_file_read_level;
+};
+
+void Version::MultiGet(const ReadOptions& options,
+                       int n,
+                       const LookupKey* const* keys,
+                       std::string* const* vals,
+                       Status* statuses,
+                       GetStats* stats)
+{
+    if (n == 0) return;
+    const Comparator* ucmp = vset_->icmp_.user_comparator();
+    std::vector<MultiGetKey> state(n);
+    for (int i = 0; i < n; i++)
+    {
+        MultiGetKey* m = &state[i];
+        m->saver.state = kNotFound;
+        m->saver.ucmp = ucmp;
+        m->saver.user_key = keys[i]->user_key();
+        m->saver.value = vals[i];
+        m->ikey = keys[i]->internal_key();
+        m->done = false;
+        m->last_file_read = NULL;
+        m->last_file_read_level = -1;
+        stats[i].seek_file = NULL;
+        stats[i].seek_file_level = -1;
+        statuses[i] = Status::NotFound(Slice());
+    }
+
+    // As in Get(), search level-by-level; a key found in a smaller level
+    // is not looked up in later levels.
+    std::vector<int> batch;
+    std::vector<FileMetaData*> tmp;
+    for (int level = 0; level < config::kNumLevels; level++)
+    {
+        const std::vector<FileMetaData*>& files = files_[level];
+        if (files.empty()) continue;
+
+        if (level == 0)
+        {
+            // Level-0 files may overlap each other.  Visit them from newest
+            // to oldest, handing each the unresolved keys in its range.
+            tmp = files;
+            std::sort(tmp.begin(), tmp.end(), NewestFirst);
+            for (size_t j = 0; j < tmp.size(); j++)
+            {
+                FileMetaData* f = tmp[j];
+                batch.clear();
+                for (int i = 0; i < n; i++)
+                {
+                    const Slice& user_key = state[i].saver.user_key;
+                    if (!state[i].done &&
+                            ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+                            ucmp->Compare(user_key, f->largest.user_key()) <= 0)
+                    {
+                        batch.push_back(i);
+                    }
+                }
+                if (!batch.empty())
+                {
+                    MultiGetFromFile(options, f, level, batch, &state[0],
+                                     statuses, stats);
+                }
+            }
+        }
+        else
+        {
+            // Files are disjoint and sorted, so the sorted keys visit them
+            // in order and the keys for one file are contiguous.
+            FileMetaData* batch_file = NULL;
+            batch.clear();
+            for (int i = 0; i < n; i++)
             {
-                delete iter;
-                if (done)
+                if (state[i].done) continue;
+                uint32_t index = FindFile(vset_->icmp_, files, state[i].ikey);
+                if (index >= files.size())
+                {
+                    // This key and all later ones are past the last file
+                    break;
+                }
+                FileMetaData* f = files[index];
+                if (ucmp->Compare(state[i].saver.user_key,
+                                  f->smallest.user_key()) < 0)
+                {
+                    // All of "f" is past any data for this key
+                    continue;
+                }
+                if (f != batch_file)
                 {
-                    return s;
+                    if (!batch.empty())
+                    {
+                        MultiGetFromFile(options, batch_file, level, batch,
+                                         &state[0], statuses, stats);
+                    }
+                    batch.clear();
+                    batch_file = f;
                 }
+                batch.push_back(i);
+            }
+            if (!batch.empty())
+            {
+                MultiGetFromFile(options, batch_file, level, batch, &state[0],
+                                 statuses, stats);
             }
         }
     }
+}
 
-    return Status::NotFound(Slice());  // Use an empty error message for speed
+void Version::MultiGetFromFile(const ReadOptions& options,
+                               FileMetaData* f,
+                               int level,
+                               const std::vector<int>& batch,
+                               MultiGetKey* keys,
+                               Status* statuses,
+                               GetStats* stats)
+{
+    const size_t count = batch.size();
+    std::vector<Slice> ikeys(count);
+    std::vector<void*> args(count);
+    std::vector<Status> file_statuses(count);
+    for (size_t j = 0; j < count; j++)
+    {
+        const int i = batch[j];
+        MultiGetKey* m = &keys[i];
+        if (m->last_file_read != NULL && stats[i].seek_file == NULL)
+        {
+            // More than one seek for this key.  Charge the 1st file.
+            stats[i].seek_file = m->last_file_read;
+            stats[i].seek_file_level = m->last_file_read_level;
+        }
+        m->last_file_read = f;
+        m->last_file_read_level = level;
+        ikeys[j] = m->ikey;
+        args[j] = &m->saver;
+    }
+
+    vset_->table_cache_->MultiGet(options, f->number, f->file_size,
+                                  count, &ikeys[0], &args[0], SaveValue,
+                                  &file_statuses[0]);
+
+    for (size_t j = 0; j < count; j++)
+    {
+        const int i = batch[j];
+        MultiGetKey* m = &keys[i];
+        if (!file_statuses[j].ok())
+        {
+            statuses[i] = file_statuses[j];
+            m->done = true;
+            continue;
+        }
+        switch (m->saver.state)
+        {
+        case kNotFound:
+            break;      // Keep searching in other files
+        case kFound:
+            statuses[i] = Status::OK();
+            m->done = true;
+            break;
+        case kDeleted:
+            statuses[i] = Status::NotFound(Slice());
+            m->done = true;
+            break;
+        case kCorrupt:
+            statuses[i] = Status::Corruption("corrupted key for ",
+                                             m->saver.user_key);
+            m->done = true;
+            break;
+        }
+    }
+}
+
+// Once a file has run out of seeks, ChargeSeek() only asks for it to be
+// picked for compaction once every this many seeks, in case another file
+// was picked the first time.
+static const int32_t kSeeksBetweenPicks = 64;
+
+bool Version::ChargeSeek(const GetStats& stats)
+{
+    FileMetaData* f = stats.seek_file;
+    if (f == NULL)
+    {
+        return false;
+    }
+    const int32_t left = f->allowed_seeks.Decrement();
+    return left <= 0 && (-left) % kSeeksBetweenPicks == 0;
 }
 
 bool Version::UpdateStats(const GetStats& stats)
@@ -406,8 +652,7 @@ bool Version::UpdateStats(const GetStats& stats)
     FileMetaData* f = stats.seek_file;
     if (f != NULL)
     {
-        f->allowed_seeks--;
-        if (f->allowed_seeks <= 0 && file_to_compact_ == NULL)
+        if (f->allowed_seeks.NoBarrier_Load() <= 0 && file_to_compact_ == NULL)
         {
             file_to_compact_ = f;
             file_to_compact_level_ = stats.seek_file_level;
@@ -434,8 +679,8 @@ void Version::Unref()
 }
 
 bool Version::OverlapInLevel(int level,
-                             const Slice& smallest_user_key,
-                             const Slice& largest_user_key)
+                             const Slice* smallest_user_key,
+                             const Slice* largest_user_key)
 {
     return SomeFileOverlapsRange(vset_->icmp_, files_[level],
                                  smallest_user_key,
@@ -591,8 +836,9 @@ public:
             // same as the compaction of 40KB of data.  We are a little
             // conservative and allow approximately one seek for every 16KB
             // of data before triggering a compaction.
-            f->allowed_seeks = (f->file_size / 16384);
-            if (f->allowed_seeks < 100) f->allowed_seeks = 100;
+            int32_t allowed_seeks = static_cast<int32_t>(f->file_size / 16384);
+            if (allowed_seeks < 100) allowed_seeks = 100;
+            f->allowed_seeks.NoBarrier_Store(allowed_seeks);
 
             levels_[level].deleted_files.erase(f->number);
             levels_[level].added_files->insert(f);
@@ -744,7 +990,10 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu)
     }
 
     edit->SetNextFile(next_file_number_);
-    edit->SetLastSequence(last_sequence_);
+    if (!edit->has_last_sequence_ || edit->last_sequence_ < LastSequence())
+    {
+        edit->SetLastSequence(LastSequence());
+    }
 
     Version* v = new Version(this);
     {
@@ -951,7 +1200,7 @@ Status VersionSet::Recover()
         AppendVersion(v);
         manifest_file_number_ = next_file;
         next_file_number_ = next_file + 1;
-        last_sequence_ = last_sequence;
+        last_sequence_.Release_Store(last_sequence);
         log_number_ = log_number;
         prev_log_number_ = prev_log_number;
     }
@@ -977,8 +1226,98 @@ static int64_t TotalFileSize(const std::vector<FileMetaData*>& files)
     return sum;
 }
 
+void VersionSet::ComputeLevelTargets(Version* v)
+{
+    if (!options_->level_compaction_dynamic_level_bytes)
+    {
+        v->base_level_ = 1;
+        for (int level = 0; level < config::kNumLevels; level++)
+        {
+            v->max_bytes_for_level_[level] = MaxBytesForLevel(level);
+        }
+        return;
+    }
+
+    // Work the targets out upwards from the size of the largest level,
+    // which is normally the last one: each level above it is a tenth of
+    // its size, so that it holds about 90% of the data.  The first level
+    // whose target is no larger than that of level-1 in the fixed scheme
+    // becomes the base level.  The levels above it would be so small that
+    // compacting data through them is wasted work, so level-0 is
+    // compacted straight into the base level.
+    const int last = config::kNumLevels - 1;
+    const double base_bytes_max = MaxBytesForLevel(1);
+    const double base_bytes_min = base_bytes_max / kLevelSizeMultiplier;
+    int first_non_empty = -1;
+    int64_t max_level_bytes = 0;
+    for (int level = 1; level <= last; level++)
+    {
+        const int64_t bytes = TotalFileSize(v->files_[level]);
+        if (first_non_empty < 0 && !v->files_[level].empty())
+        {
+            first_non_empty = level;
+        }
+        if (bytes > max_level_bytes)
+        {
+            max_level_bytes = bytes;
+        }
+    }
+
+    double base_bytes;
+    if (first_non_empty < 0)
+    {
+        // Everything is in level-0 so far
+        v->base_level_ = last;
+        base_bytes = base_bytes_max;
+    }
+    else
+    {
+        double bytes = static_cast<double>(max_level_bytes);
+        for (int level = last; level > first_non_empty; level--)
+        {
+            bytes /= kLevelSizeMultiplier;
+        }
+        // The base level cannot be below a level that holds data: that
+        // data would end up above newer data compacted out of level-0.
+        v->base_level_ = first_non_empty;
+        if (bytes <= base_bytes_min)
+        {
+            // Make the levels that hold data shrink towards the last one
+            base_bytes = base_bytes_min;
+        }
+        else
+        {
+            while (v->base_level_ > 1 && bytes > base_bytes_max)
+            {
+                v->base_level_--;
+                bytes /= kLevelSizeMultiplier;
+            }
+            base_bytes = std::min(bytes, base_bytes_max);
+        }
+    }
+
+    for (int level = 0; level < config::kNumLevels; level++)
+    {
+        if (level == 0)
+        {
+            v->max_bytes_for_level_[level] = MaxBytesForLevel(0);  // Unused
+        }
+        else if (level < v->base_level_)
+        {
+            v->max_bytes_for_level_[level] = 0;   // Always empty
+        }
+        else
+        {
+            v->max_bytes_for_level_[level] = base_bytes;
+            base_bytes *= kLevelSizeMultiplier;
+        }
+    }
+}
+
 void VersionSet::Finalize(Version* v)
 {
+    ComputeLevelTargets(v);
+
     // Precomputed best level for next compaction
     int best_level = -1;
     double best_score = -1;
@@ -1002,13 +1341,19 @@ void VersionSet::Finalize(Version* v)
             score = v->files_[level].size() /
                     static_cast<double>(config::kL0_CompactionTrigger);
         }
+        else if (level < v->base_level_)
+        {
+            score = 0;   // Empty
+        }
         else
         {
             // Compute the ratio of current size to size limit.
             const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-            score = static_cast<double>(level_bytes) / MaxBytesForLevel(level);
+            score = static_cast<double>(level_bytes) /
+                    v->max_bytes_for_level_[level];
         }
 
+        v->level_score_[level] = score;
         if (score > best_score)
         {
             best_level = level;
@@ -1018,6 +1363,34 @@ void VersionSet::Finalize(Version* v)
 
     v->compaction_level_ = best_level;
     v->compaction_score_ = best_score;
+
+    // Level-0 files are all merged into the base level once there are
+    // enough of them.  The bytes by which a level then exceeds its target
+    // move down a level, and are merged with about as many times their
+    // size there as the ratio of the two levels' sizes.
+    int64_t pending = 0;
+    int64_t incoming = 0;
+    if (v->files_[0].size() >=
+            static_cast<size_t>(config::kL0_CompactionTrigger))
+    {
+        incoming = TotalFileSize(v->files_[0]);
+        pending = incoming + TotalFileSize(v->files_[v->base_level_]);
+    }
+    for (int level = v->base_level_; level < config::kNumLevels-1; level++)
+    {
+        const int64_t level_bytes = TotalFileSize(v->files_[level]) + incoming;
+        const double target = v->max_bytes_for_level_[level];
+        incoming = 0;
+        if (level_bytes > target)
+        {
+            incoming = level_bytes - static_cast<int64_t>(target);
+            const int64_t next_bytes = TotalFileSize(v->files_[level + 1]);
+            const double fanout =
+                static_cast<double>(level_bytes + next_bytes) / level_bytes;
+            pending += static_cast<int64_t>(incoming * (fanout + 1));
+        }
+    }
+    v->pending_compaction_bytes_ = pending;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log)
@@ -1106,20 +1479,28 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey)
             {
                 // "ikey" falls in the range for this table.  Add the
                 // approximate offset of "ikey" within the table.
-                Table* tableptr;
-                Iterator* iter = table_cache_->NewIterator(
-                                     ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
-                if (tableptr != NULL)
-                {
-                    result += tableptr->ApproximateOffsetOf(ikey.Encode());
-                }
-                delete iter;
+                result += ApproximateOffsetInFile(files[i], ikey);
             }
         }
     }
     return result;
 }
 
+uint64_t VersionSet::ApproximateOffsetInFile(FileMetaData* f,
+        const InternalKey& ikey)
+{
+    uint64_t result = 0;
+    Table* tableptr;
+    Iterator* iter = table_cache_->NewIterator(
+                         ReadOptions(), f->number, f->file_size, &tableptr);
+    if (tableptr != NULL)
+    {
+        result = tableptr->ApproximateOffsetOf(ikey.Encode());
+    }
+    delete iter;
+    return result;
+}
+
 void VersionSet::AddLiveFiles(std::set<uint64_t>* live)
 {
     for (Version* v = dummy_versions_.next_;
@@ -1153,7 +1534,7 @@ int64_t VersionSet::MaxNextLevelOverlappingBytes()
         for (size_t i = 0; i < current_->files_[level].size(); i++)
         {
             const FileMetaData* f = current_->files_[level][i];
-            GetOverlappingInputs(level+1, f->smallest, f->largest, &overlaps);
+            GetOverlappingInputs(level+1, &f->smallest, &f->largest, &overlaps);
             const int64_t sum = TotalFileSize(overlaps);
             if (sum > result)
             {
@@ -1167,19 +1548,28 @@ int64_t VersionSet::MaxNextLevelOverlappingBytes()
 // Store in "*inputs" all files in "level" that overlap [begin,end]
 void VersionSet::GetOverlappingInputs(
     int level,
-    const InternalKey& begin,
-    const InternalKey& end,
+    const InternalKey* begin,
+    const InternalKey* end,
     std::vector<FileMetaData*>* inputs)
 {
     inputs->clear();
-    Slice user_begin = begin.user_key();
-    Slice user_end = end.user_key();
+    Slice user_begin, user_end;
+    if (begin != NULL)
+    {
+        user_begin = begin->user_key();
+    }
+    if (end != NULL)
+    {
+        user_end = end->user_key();
+    }
     const Comparator* user_cmp = icmp_.user_comparator();
     for (size_t i = 0; i < current_->files_[level].size(); i++)
     {
         FileMetaData* f = current_->files_[level][i];
-        if (user_cmp->Compare(f->largest.user_key(), user_begin) < 0 ||
-                user_cmp->Compare(f->smallest.user_key(), user_end) > 0)
+        if ((begin != NULL &&
+                user_cmp->Compare(f->largest.user_key(), user_begin) < 0) ||
+                (end != NULL &&
+                 user_cmp->Compare(f->smallest.user_key(), user_end) > 0))
         {
             // Either completely before or after range; skip it
         }
@@ -1275,52 +1665,100 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c)
     return result;
 }
 
-Compaction* VersionSet::PickCompaction()
+static bool AnyBeingCompacted(const std::vector<FileMetaData*>& files)
 {
-    Compaction* c;
-    int level;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (files[i]->being_compacted)
+        {
+            return true;
+        }
+    }
+    return false;
+}
 
+Compaction* VersionSet::PickCompaction()
+{
     // We prefer compactions triggered by too much data in a level over
-    // the compactions triggered by seeks.
-    const bool size_compaction = (current_->compaction_score_ >= 1);
-    const bool seek_compaction = (current_->file_to_compact_ != NULL);
-    if (size_compaction)
+    // the compactions triggered by seeks.  Levels that need a compaction
+    // are tried in order of decreasing score, so that a level whose
+    // candidate files are all busy does not hold up the other levels.
+    int levels[config::kNumLevels];
+    int num_levels = 0;
+    for (int level = 0; level < config::kNumLevels-1; level++)
     {
-        level = current_->compaction_level_;
-        assert(level >= 0);
-        assert(level+1 < config::kNumLevels);
-        c = new Compaction(level);
+        const double score = current_->level_score_[level];
+        if (score >= 1)
+        {
+            int i = num_levels++;
+            while (i > 0 && current_->level_score_[levels[i-1]] < score)
+            {
+                levels[i] = levels[i-1];
+                i--;
+            }
+            levels[i] = level;
+        }
+    }
 
-        // Pick the first file that comes after compact_pointer_[level]
-        for (size_t i = 0; i < current_->files_[level].size(); i++)
+    for (int i = 0; i < num_levels; i++)
+    {
+        const int level = levels[i];
+        const std::vector<FileMetaData*>& files = current_->files_[level];
+        if (level == 0 && AnyBeingCompacted(files))
         {
-            FileMetaData* f = current_->files_[level][i];
-            if (compact_pointer_[level].empty() ||
-                    icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0)
+            // Only one level-0 compaction may run at a time
+            continue;
+        }
+
+        // Try the files in order, starting with the first file that comes
+        // after compact_pointer_[level] and wrapping around to the
+        // beginning of the key space.
+        size_t start = 0;
+        if (!compact_pointer_[level].empty())
+        {
+            while (start < files.size() &&
+                    icmp_.Compare(files[start]->largest.Encode(),
+                                  compact_pointer_[level]) <= 0)
             {
-                c->inputs_[0].push_back(f);
-                break;
+                start++;
+            }
+            if (start == files.size())
+            {
+                start = 0;
             }
         }
-        if (c->inputs_[0].empty())
+        for (size_t j = 0; j < files.size(); j++)
         {
-            // Wrap-around to the beginning of the key space
-            c->inputs_[0].push_back(current_->files_[level][0]);
+            Compaction* c = CompactionForFile(
+                                level, files[(start + j) % files.size()]);
+            if (c != NULL)
+            {
+                return c;
+            }
         }
     }
-    else if (seek_compaction)
+
+    FileMetaData* f = current_->file_to_compact_;
+    if (f != NULL)
     {
-        level = current_->file_to_compact_level_;
-        c = new Compaction(level);
-        c->inputs_[0].push_back(current_->file_to_compact_);
+        const int level = current_->file_to_compact_level_;
+        if (level != 0 || !AnyBeingCompacted(current_->files_[0]))
+        {
+            return CompactionForFile(level, f);
+        }
     }
-    else
+    return NULL;
+}
+
+Compaction* VersionSet::CompactionForFile(int level, FileMetaData* f)
+{
+    if (f->being_compacted)
     {
         return NULL;
     }
 
-    c->input_version_ = current_;
-    c->input_version_->Ref();
+    Compaction* c = new Compaction(level, CompactionOutputLevel(level));
+    c->inputs_[0].push_back(f);
 
     // Files in level 0 may overlap each other, so pick up all overlapping ones
     if (level == 0)
@@ -1330,40 +1768,54 @@ Compaction* VersionSet::PickCompaction()
         // Note that the next call will discard the file we placed in
         // c->inputs_[0] earlier and replace it with an overlapping set
         // which will include the picked file.
-        GetOverlappingInputs(0, smallest, largest, &c->inputs_[0]);
+        GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
         assert(!c->inputs_[0].empty());
     }
 
-    SetupOtherInputs(c);
+    if (AnyBeingCompacted(c->inputs_[0]) || !SetupOtherInputs(c))
+    {
+        delete c;
+        return NULL;
+    }
 
+    c->input_version_ = current_;
+    c->input_version_->Ref();
+    c->MarkFilesBeingCompacted(true);
     return c;
 }
 
-void VersionSet::SetupOtherInputs(Compaction* c)
+bool VersionSet::SetupOtherInputs(Compaction* c)
 {
     const int level = c->level();
+    const int output_level = c->output_level();
     InternalKey smallest, largest;
     GetRange(c->inputs_[0], &smallest, &largest);
 
-    GetOverlappingInputs(level+1, smallest, largest, &c->inputs_[1]);
+    GetOverlappingInputs(output_level, &smallest, &largest, &c->inputs_[1]);
+    if (AnyBeingCompacted(c->inputs_[1]))
+    {
+        return false;
+    }
 
     // Get entire range covered by compaction
     InternalKey all_start, all_limit;
     GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
 
     // See if we can grow the number of inputs in "level" without
-    // changing the number of "level+1" files we pick up.
+    // changing the number of "output_level" files we pick up.
     if (!c->inputs_[1].empty())
     {
         std::vector<FileMetaData*> expanded0;
-        GetOverlappingInputs(level, all_start, all_limit, &expanded0);
+        GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
         if (expanded0.size() > c->inputs_[0].size())
         {
             InternalKey new_start, new_limit;
             GetRange(expanded0, &new_start, &new_limit);
             std::vector<FileMetaData*> expanded1;
-            GetOverlappingInputs(level+1, new_start, new_limit, &expanded1);
-            if (expanded1.size() == c->inputs_[1].size())
+            GetOverlappingInputs(output_level, &new_start, &new_limit,
+                                 &expanded1);
+            if (expanded1.size() == c->inputs_[1].size() &&
+                    !AnyBeingCompacted(expanded0))
             {
                 Log(options_->info_log,
                     "Expanding@%d %d+%d to %d+%d\n",
@@ -1382,10 +1834,11 @@ void VersionSet::SetupOtherInputs(Compaction* c)
     }
 
     // Compute the set of grandparent files that overlap this compaction
-    // (parent == level+1; grandparent == level+2)
-    if (level + 2 < config::kNumLevels)
+    // (parent == output_level; grandparent == output_level+1)
+    if (output_level + 1 < config::kNumLevels)
     {
-        GetOverlappingInputs(level + 2, all_start, all_limit, &c->grandparents_);
+        GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
+                             &c->grandparents_);
     }
 
     if (false)
@@ -1402,48 +1855,201 @@ void VersionSet::SetupOtherInputs(Compaction* c)
     // key range next time.
     compact_pointer_[level] = largest.Encode().ToString();
     c->edit_.SetCompactPointer(level, largest);
+    return true;
+}
+
+namespace
+{
+struct UserKeyLess
+{
+    const Comparator* ucmp;
+    explicit UserKeyLess(const Comparator* c) : ucmp(c) { }
+    bool operator()(const Slice& a, const Slice& b) const
+    {
+        return ucmp->Compare(a, b) < 0;
+    }
+};
+}
+
+void VersionSet::GetCompactionBoundaries(
+    Compaction* c,
+    int max_ranges,
+    std::vector<std::string>* boundaries)
+{
+    boundaries->clear();
+
+    // Candidate boundaries are the user keys at which input files start
+    // or end.
+    uint64_t total = 0;
+    std::vector<Slice> keys;
+    for (int which = 0; which < 2; which++)
+    {
+        for (size_t i = 0; i < c->inputs_[which].size(); i++)
+        {
+            FileMetaData* f = c->inputs_[which][i];
+            total += f->file_size;
+            keys.push_back(f->smallest.user_key());
+            keys.push_back(f->largest.user_key());
+        }
+    }
+    uint64_t ranges = total / c->MaxOutputFileSize();
+    if (ranges > static_cast<uint64_t>(max_ranges))
+    {
+        ranges = max_ranges;
+    }
+    if (ranges <= 1)
+    {
+        return;
+    }
+
+    const Comparator* ucmp = icmp_.user_comparator();
+    std::sort(keys.begin(), keys.end(), UserKeyLess(ucmp));
+
+    // Estimate how much input data sorts before each candidate and start
+    // a new range whenever the next multiple of total/ranges is reached.
+    // keys[0] is skipped since it would leave the first range empty.
+    uint64_t next = 1;
+    for (size_t k = 1; k < keys.size() && next < ranges; k++)
+    {
+        if (ucmp->Compare(keys[k], keys[k-1]) == 0)
+        {
+            continue;
+        }
+        const InternalKey ikey(keys[k], kMaxSequenceNumber, kValueTypeForSeek);
+        uint64_t offset = 0;
+        for (int which = 0; which < 2; which++)
+        {
+            for (size_t i = 0; i < c->inputs_[which].size(); i++)
+            {
+                FileMetaData* f = c->inputs_[which][i];
+                if (icmp_.Compare(f->largest, ikey) <= 0)
+                {
+                    offset += f->file_size;
+                }
+                else if (icmp_.Compare(f->smallest, ikey) < 0)
+                {
+                    offset += ApproximateOffsetInFile(f, ikey);
+                }
+            }
+        }
+        if (offset >= total * next / ranges)
+        {
+            boundaries->push_back(keys[k].ToString());
+            while (next < ranges && offset >= total * next / ranges)
+            {
+                next++;
+            }
+        }
+    }
 }
 
 Compaction* VersionSet::CompactRange(
     int level,
-    const InternalKey& begin,
-    const InternalKey& end)
+    const InternalKey* begin,
+    const InternalKey* end,
+    bool* done)
 {
     std::vector<FileMetaData*> inputs;
     GetOverlappingInputs(level, begin, end, &inputs);
+    if (level > 0 && begin != NULL)
+    {
+        // Files that end at or before *begin belong to earlier pieces
+        size_t skip = 0;
+        while (skip < inputs.size() &&
+                icmp_.Compare(inputs[skip]->largest, *begin) <= 0)
+        {
+            skip++;
+        }
+        inputs.erase(inputs.begin(), inputs.begin() + skip);
+    }
     if (inputs.empty())
     {
+        *done = true;
+        return NULL;
+    }
+    bool last_piece = true;
+
+    if (level > 0)
+    {
+        // Avoid compacting too much in one shot in case the range is large,
+        // and stop in front of files that another compaction holds.
+        // Level-0 files may overlap each other, so they are taken whole.
+        const Comparator* user_cmp = icmp_.user_comparator();
+        const uint64_t limit = MaxFileSizeForLevel(level);
+        uint64_t total = 0;
+        size_t n = 0;
+        while (n < inputs.size() && !inputs[n]->being_compacted && total < limit)
+        {
+            total += inputs[n]->file_size;
+            n++;
+        }
+
+        // Files that share a boundary user key must be compacted together
+        // or the older entries would end up above the newer ones.
+        while (n > 0 && n < inputs.size() && !inputs[n]->being_compacted &&
+                user_cmp->Compare(inputs[n-1]->largest.user_key(),
+                                  inputs[n]->smallest.user_key()) == 0)
+        {
+            n++;
+        }
+        while (n > 0 && n < inputs.size() &&
+                user_cmp->Compare(inputs[n-1]->largest.user_key(),
+                                  inputs[n]->smallest.user_key()) == 0)
+        {
+            n--;
+        }
+        if (n == 0)
+        {
+            *done = false;
+            return NULL;
+        }
+        last_piece = (n == inputs.size());
+        inputs.resize(n);
+    }
+    else if (AnyBeingCompacted(inputs))
+    {
+        *done = false;
+        return NULL;
+    }
+
+    Compaction* c = new Compaction(level, CompactionOutputLevel(level));
+    c->inputs_[0] = inputs;
+    if (!SetupOtherInputs(c))
+    {
+        delete c;
+        *done = false;
         return NULL;
     }
 
-    Compaction* c = new Compaction(level);
     c->input_version_ = current_;
     c->input_version_->Ref();
-    c->inputs_[0] = inputs;
-    SetupOtherInputs(c);
+    c->MarkFilesBeingCompacted(true);
+    *done = last_piece;
     return c;
 }
 
-Compaction::Compaction(int level)
+Compaction::Compaction(int level, int output_level)
     : level_(level),
+      output_level_(output_level),
       max_output_file_size_(MaxFileSizeForLevel(level)),
-      input_version_(NULL),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0)
+      input_version_(NULL)
+{
+}
+
+Compaction::Cursor::Cursor()
+    : grandparent_index(0),
+      seen_key(false),
+      overlapped_bytes(0)
 {
     for (int i = 0; i < config::kNumLevels; i++)
     {
-        level_ptrs_[i] = 0;
+        level_ptrs[i] = 0;
     }
 }
 
 Compaction::~Compaction()
 {
-    if (input_version_ != NULL)
-    {
-        input_version_->Unref();
-    }
+    ReleaseInputs();
 }
 
 bool Compaction::IsTrivialMove() const
@@ -1462,21 +2068,22 @@ void Compaction::AddInputDeletions(VersionEdit* edit)
     {
         for (size_t i = 0; i < inputs_[which].size(); i++)
         {
-            edit->DeleteFile(level_ + which, inputs_[which][i]->number);
+            edit->DeleteFile(which == 0 ? level_ : output_level_,
+                             inputs_[which][i]->number);
         }
     }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key)
+bool Compaction::IsBaseLevelForKey(Cursor* cursor, const Slice& user_key)
 {
     // Maybe use binary search to find right entry instead of linear search?
     const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-    for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++)
+    for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++)
     {
         const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-        for (; level_ptrs_[lvl] < files.size(); )
+        for (; cursor->level_ptrs[lvl] < files.size(); )
         {
-            FileMetaData* f = files[level_ptrs_[lvl]];
+            FileMetaData* f = files[cursor->level_ptrs[lvl]];
             if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0)
             {
                 // We've advanced far enough
@@ -1487,32 +2094,36 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key)
                 }
                 break;
             }
-            level_ptrs_[lvl]++;
+            cursor->level_ptrs[lvl]++;
         }
     }
     return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key)
+bool Compaction::ShouldStopBefore(Cursor* cursor,
+                                  const Slice& internal_key)
 {
     // Scan to find earliest grandparent file that contains key.
     const InternalKeyComparator* icmp = &input_version_->vset_->icmp_;
-    while (grandparent_index_ < grandparents_.size() &&
-            icmp->Compare(internal_key,
-                          grandparents_[grandparent_index_]->largest.Encode()) > 0)
+    while (cursor->grandparent_index < grandparents_.size())
     {
-        if (seen_key_)
+        const FileMetaData* g = grandparents_[cursor->grandparent_index];
+        if (icmp->Compare(internal_key, g->largest.Encode()) <= 0)
+        {
+            break;
+        }
+        if (cursor->seen_key)
         {
-            overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+            cursor->overlapped_bytes += g->file_size;
         }
-        grandparent_index_++;
+        cursor->grandparent_index++;
     }
-    seen_key_ = true;
+    cursor->seen_key = true;
 
-    if (overlapped_bytes_ > kMaxGrandParentOverlapBytes)
+    if (cursor->overlapped_bytes > kMaxGrandParentOverlapBytes)
     {
         // Too much overlap for current output; start new output
-        overlapped_bytes_ = 0;
+        cursor->overlapped_bytes = 0;
         return true;
     }
     else
@@ -1521,10 +2132,24 @@ bool Compaction::ShouldStopBefore(const Slice& internal_key)
     }
 }
 
+void Compaction::MarkFilesBeingCompacted(bool value)
+{
+    for (int which = 0; which < 2; which++)
+    {
+        for (size_t i = 0; i < inputs_[which].size(); i++)
+        {
+            assert(inputs_[which][i]->being_compacted != value);
+            inputs_[which][i]->being_compacted = value;
+        }
+    }
+}
+
 void Compaction::ReleaseInputs()
 {
     if (input_version_ != NULL)
     {
+        // Clear the marks while input_version_ keeps the files alive
+        MarkFilesBeingCompacted(false);
         input_version_->Unref();
         input_version_ = NULL;
     }
@@ -47,12 +47,14 @@ extern int FindFile(const InternalKeyComparator& icmp,
                     const Slice& key);
 
 // Returns true iff some file in "files" overlaps the user key range
-// [smallest,largest].
+// [*smallest,*largest].
+// smallest==NULL represents a key smaller than all keys in the DB.
+// largest==NULL represents a key larger than all keys in the DB.
 extern bool SomeFileOverlapsRange(
     const InternalKeyComparator& icmp,
     const std::vector<FileMetaData*>& files,
-    const Slice& smallest_user_key,
-    const Slice& largest_user_key);
+    const Slice* smallest_user_key,
+    const Slice* largest_user_key);
 
 class Version
 {
@@ -73,8 +75,23 @@ public:
     Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
                GetStats* stats);
 
-    // Adds "stats" into the current state.  Returns true if a new
-    // compaction may need to be triggered, false otherwise.
+    // Like Get() for each of keys[0,n-1], which must be sorted: stores
+    // the result in *vals[i] and statuses[i], and fills stats[i].  Keys
+    // that land in the same table file are looked up together.
+    // REQUIRES: lock is not held
+    void MultiGet(const ReadOptions&, int n, const LookupKey* const* keys,
+                  std::string* const* vals, Status* statuses,
+                  GetStats* stats);
+
+    // Charge the seek in "stats" to its file.  Returns true if the file
+    // has run out of allowed seeks and UpdateStats() should be called;
+    // most lookups only decrement the file's counter.
+    // REQUIRES: lock is not held
+    static bool ChargeSeek(const GetStats& stats);
+
+    // Make the file in "stats" the next one to compact for seeks, if it
+    // has run out of them and no other file is picked yet.  Returns true
+    // if a new compaction may need to be triggered, false otherwise.
     // REQUIRES: lock is held
     bool UpdateStats(const GetStats& stats);
 
@@ -84,10 +101,12 @@ public:
     void Unref();
 
     // Returns true iff some file in the specified level overlaps
-    // some part of [smallest_user_key,largest_user_key].
+    // some part of [*smallest_user_key,*largest_user_key].
+    // smallest_user_key==NULL represents a key smaller than all keys in the DB.
+    // largest_user_key==NULL represents a key larger than all keys in the DB.
     bool OverlapInLevel(int level,
-                        const Slice& smallest_user_key,
-                        const Slice& largest_user_key);
+                        const Slice* smallest_user_key,
+                        const Slice* largest_user_key);
 
     int NumFiles(int level) const
     {
@@ -104,6 +123,12 @@ private:
     class LevelFileNumIterator;
     Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
 
+    // Looks up the keys listed in "batch" in file f for MultiGet()
+    struct MultiGetKey;
+    void MultiGetFromFile(const ReadOptions&, FileMetaData* f, int level,
+                          const std::vector<int>& batch, MultiGetKey* keys,
+                          Status* statuses, GetStats* stats);
+
     VersionSet* vset_;            // VersionSet to which this Version belongs
     Version* next_;               // Next version in linked list
     Version* prev_;               // Previous version in linked list
@@ -122,13 +147,34 @@ private:
     double compaction_score_;
     int compaction_level_;
 
+    // Compaction score of every level, so that another level can be
+    // picked when the best one is busy.  Initialized by Finalize().
+    double level_score_[config::kNumLevels];
+
+    // Estimate of the bytes that compactions have to write to bring every
+    // level within its target.  Initialized by Finalize().
+    int64_t pending_compaction_bytes_;
+
+    // Level that level-0 files are compacted into, and the size that
+    // every level is compacted down to.  Levels between 0 and base_level_
+    // are empty.  Initialized by Finalize().
+    int base_level_;
+    double max_bytes_for_level_[config::kNumLevels];
+
     explicit Version(VersionSet* vset)
         : vset_(vset), next_(this), prev_(this), refs_(0),
           file_to_compact_(NULL),
           file_to_compact_level_(-1),
           compaction_score_(-1),
-          compaction_level_(-1)
+          compaction_level_(-1),
+          pending_compaction_bytes_(0),
+          base_level_(1)
     {
+        for (int level = 0; level < config::kNumLevels; level++)
+        {
+            level_score_[level] = -1;
+            max_bytes_for_level_[level] = 0;
+        }
     }
 
     ~Version();
@@ -181,17 +227,26 @@ public:
     // Return the combined file size of all files at the specified level.
     int64_t NumLevelBytes(int level) const;
 
-    // Return the last sequence number.
+    // Return the estimated number of bytes that compactions have to write
+    // before no level of the current version needs compacting.
+    int64_t PendingCompactionBytes() const
+    {
+        return current_->pending_compaction_bytes_;
+    }
+
+    // Return the last sequence number.  Safe to call without holding the
+    // mutex; every write to the memtable up to the returned sequence is
+    // visible to the caller.
     uint64_t LastSequence() const
     {
-        return last_sequence_;
+        return last_sequence_.Acquire_Load();
     }
 
     // Set the last sequence number to s.
     void SetLastSequence(uint64_t s)
     {
-        assert(s >= last_sequence_);
-        last_sequence_ = s;
+        assert(s >= last_sequence_.Acquire_Load());
+        last_sequence_.Release_Store(s);
     }
 
     // Mark the specified file number as used.
@@ -210,25 +265,43 @@ public:
         return prev_log_number_;
     }
 
-    // Pick level and inputs for a new compaction.
-    // Returns NULL if there is no compaction to be done.
+    // Pick level and inputs for a new compaction.  Files that are inputs
+    // of a compaction that has not been deleted yet are never picked, and
+    // no level-0 compaction is picked while another one is running.
+    // Returns NULL if there is no compaction that can be done.
     // Otherwise returns a pointer to a heap-allocated object that
     // describes the compaction.  Caller should delete the result.
     Compaction* PickCompaction();
 
-    // Return a compaction object for compacting the range [begin,end] in
-    // the specified level.  Returns NULL if there is nothing in that
-    // level that overlaps the specified range.  Caller should delete
-    // the result.
+    // Return a compaction object for compacting a piece of the range
+    // [*begin,*end] in the specified level, starting at its beginning.
+    // begin==NULL and end==NULL leave that side of the range open.
+    // Large ranges in levels > 0 are handed out a piece at a time so that
+    // the pieces can be compacted concurrently; callers move *begin past
+    // the returned inputs before asking for the next piece.  Sets *done
+    // to true iff no part of the range remains after the returned piece.
+    // Returns NULL if there is nothing in that level that overlaps the
+    // range, or if the next piece involves files that are already being
+    // compacted.  Caller should delete the result.
     Compaction* CompactRange(
         int level,
-        const InternalKey& begin,
-        const InternalKey& end);
+        const InternalKey* begin,
+        const InternalKey* end,
+        bool* done);
 
     // Return the maximum overlapping data (in bytes) at next level for any
     // file at a level >= 1.
     int64_t MaxNextLevelOverlappingBytes();
 
+    // Split the key range of compaction "*c" into at most "max_ranges"
+    // ranges that hold roughly the same amount of input data, and store
+    // in *boundaries the user keys at which the second and later ranges
+    // begin.  No range is made smaller than the compaction's output file
+    // size limit, so small compactions are not split at all.
+    // Does not need the DB mutex; may read table indexes.
+    void GetCompactionBoundaries(Compaction* c, int max_ranges,
+                                 std::vector<std::string>* boundaries);
+
     // Create an iterator that reads over the compaction inputs for "*c".
     // The caller should delete the iterator when no longer needed.
     Iterator* MakeInputIterator(Compaction* c);
@@ -262,14 +335,24 @@ private:
     friend class Compaction;
     friend class Version;
 
+    // Store in v->max_bytes_for_level_ the size each level of "v" should
+    // be compacted down to, and in v->base_level_ the level that level-0
+    // is compacted into.
+    void ComputeLevelTargets(Version* v);
+
     void Finalize(Version* v);
 
+    // Store in *inputs the files in "level" that overlap [*begin,*end].
+    // begin==NULL and end==NULL leave that side of the range open.
     void GetOverlappingInputs(
         int level,
-        const InternalKey& begin,
-        const InternalKey& end,
+        const InternalKey* begin,
+        const InternalKey* end,
         std::vector<FileMetaData*>* inputs);
 
+    // Return the approximate offset of "ikey" within the table "f".
+    uint64_t ApproximateOffsetInFile(FileMetaData* f, const InternalKey& ikey);
+
     void GetRange(const std::vector<FileMetaData*>& inputs,
                   InternalKey* smallest,
                   InternalKey* largest);
@@ -279,7 +362,22 @@ private:
                    InternalKey* smallest,
                    InternalKey* largest);
 
-    void SetupOtherInputs(Compaction* c);
+    // Fill in the "output_level" inputs of *c and the grandparent files,
+    // growing the "level" inputs when that is free.  Returns false, without
+    // updating the compaction pointer, if any file the compaction needs
+    // is already being compacted.
+    bool SetupOtherInputs(Compaction* c);
+
+    // Level that a compaction of "level" in the current version writes to
+    int CompactionOutputLevel(int level) const
+    {
+        return (level == 0) ? current_->base_level_ : level + 1;
+    }
+
+    // Return a compaction of file "f" in "level" together with the files
+    // it has to be merged with, or NULL if any of them is already being
+    // compacted.
+    Compaction* CompactionForFile(int level, FileMetaData* f);
 
     // Save current contents to *log
     Status WriteSnapshot(log::Writer* log);
@@ -293,7 +391,7 @@ private:
     const InternalKeyComparator icmp_;
     uint64_t next_file_number_;
     uint64_t manifest_file_number_;
-    uint64_t last_sequence_;
+    port::AtomicUint64 last_sequence_;
     uint64_t log_number_;
     uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
 
@@ -319,12 +417,22 @@ public:
     ~Compaction();
 
     // Return the level that is being compacted.  Inputs from "level"
-    // and "level+1" will be merged to produce a set of "level+1" files.
+    // and "output_level" will be merged to produce a set of
+    // "output_level" files.
     int level() const
     {
         return level_;
     }
 
+    // Return the level the compaction writes to.  This is "level+1",
+    // except that level-0 files go to the base level of the Version, which
+    // is deeper while the database is small and level targets are derived
+    // from the size of the last level.
+    int output_level() const
+    {
+        return output_level_;
+    }
+
     // Return the object that holds the edits to the descriptor done
     // by this compaction.
     VersionEdit* edit()
@@ -338,7 +446,8 @@ public:
         return inputs_[which].size();
     }
 
-    // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+    // Return the ith input file at "level()" (which == 0) or
+    // "output_level()" (which == 1).
     FileMetaData* input(int which, int i) const
     {
         return inputs_[which][i];
@@ -357,48 +466,64 @@ public:
     // Add all inputs to this compaction as delete operations to *edit.
     void AddInputDeletions(VersionEdit* edit);
 
+    // Position of a scan over the compaction's keys, used by
+    // IsBaseLevelForKey() and ShouldStopBefore().  Both expect to see
+    // keys in increasing order, so every thread that processes a key
+    // range of the compaction needs a Cursor of its own.
+    struct Cursor
+    {
+        // State used to check for number of of overlapping grandparent files
+        // (parent == output_level_, grandparent == output_level_ + 1)
+        size_t grandparent_index;  // Index in grandparents_
+        bool seen_key;             // Some output key has been seen
+        int64_t overlapped_bytes;  // Bytes of overlap between current output
+        // and grandparent files
+
+        // State for implementing IsBaseLevelForKey
+
+        // level_ptrs holds indices into input_version_->levels_: our state
+        // is that we are positioned at one of the file ranges for each
+        // higher level than the ones involved in this compaction (i.e. for
+        // all L > output_level_).
+        size_t level_ptrs[config::kNumLevels];
+
+        Cursor();
+    };
+
     // Returns true if the information we have available guarantees that
-    // the compaction is producing data in "level+1" for which no data exists
-    // in levels greater than "level+1".
-    bool IsBaseLevelForKey(const Slice& user_key);
+    // the compaction is producing data in "output_level" for which no data
+    // exists in levels greater than "output_level".
+    bool IsBaseLevelForKey(Cursor* cursor, const Slice& user_key);
 
     // Returns true iff we should stop building the current output
     // before processing "internal_key".
-    bool ShouldStopBefore(const Slice& internal_key);
+    bool ShouldStopBefore(Cursor* cursor, const Slice& internal_key);
 
     // Release the input version for the compaction, once the compaction
-    // is successful.
+    // is successful.  Also makes the input files available to other
+    // compactions again.
     void ReleaseInputs();
 
 private:
     friend class Version;
     friend class VersionSet;
 
-    explicit Compaction(int level);
+    Compaction(int level, int output_level);
+
+    // Set the being_compacted flag of every input file to "value".
+    void MarkFilesBeingCompacted(bool value);
 
     int level_;
+    int output_level_;
     uint64_t max_output_file_size_;
-    Version* input_version_;
+    Version* input_version_;      // Non-NULL iff the inputs are held
     VersionEdit edit_;
 
-    // Each compaction reads inputs from "level_" and "level_+1"
+    // Each compaction reads inputs from "level_" and "output_level_"
     std::vector<FileMetaData*> inputs_[2];      // The two sets of inputs
 
-    // State used to check for number of of overlapping grandparent files
-    // (parent == level_ + 1, grandparent == level_ + 2)
+    // Grandparent files (output_level_ + 1) that overlap this compaction
     std::vector<FileMetaData*> grandparents_;
-    size_t grandparent_index_;  // Index in grandparent_starts_
-    bool seen_key_;             // Some output key has been seen
-    int64_t overlapped_bytes_;  // Bytes of overlap between current output
-    // and grandparent files
-
-    // State for implementing IsBaseLevelForKey
-
-    // level_ptrs_ holds indices into input_version_->levels_: our state
-    // is that we are positioned at one of the file ranges for each
-    // higher level than the ones involved in this compaction (i.e. for
-    // all L >= level_ + 2).
-    size_t level_ptrs_[config::kNumLevels];
 };
 
 }
@@ -44,7 +44,11 @@ public:
     bool Overlaps(const char* smallest, const char* largest)
     {
         InternalKeyComparator cmp(BytewiseComparator());
-        return SomeFileOverlapsRange(cmp, files_, smallest, largest);
+        Slice s(smallest != NULL ? smallest : "");
+        Slice l(largest != NULL ? largest : "");
+        return SomeFileOverlapsRange(cmp, files_,
+                                     (smallest != NULL ? &s : NULL),
+                                     (largest != NULL ? &l : NULL));
     }
 };
 
@@ -52,6 +56,9 @@ TEST(FindFileTest, Empty)
 {
     ASSERT_EQ(0, Find("foo"));
     ASSERT_TRUE(! Overlaps("a", "z"));
+    ASSERT_TRUE(! Overlaps(NULL, "z"));
+    ASSERT_TRUE(! Overlaps("a", NULL));
+    ASSERT_TRUE(! Overlaps(NULL, NULL));
 }
 
 TEST(FindFileTest, Single)
@@ -76,6 +83,13 @@ TEST(FindFileTest, Single)
     ASSERT_TRUE(Overlaps("p1", "z"));
     ASSERT_TRUE(Overlaps("q", "q"));
     ASSERT_TRUE(Overlaps("q", "q1"));
+
+    ASSERT_TRUE(! Overlaps(NULL, "j"));
+    ASSERT_TRUE(! Overlaps("r", NULL));
+    ASSERT_TRUE(Overlaps(NULL, "p"));
+    ASSERT_TRUE(Overlaps(NULL, "p1"));
+    ASSERT_TRUE(Overlaps("q", NULL));
+    ASSERT_TRUE(Overlaps(NULL, NULL));
 }
 
 
@@ -116,6 +130,20 @@ TEST(FindFileTest, Multiple)
     ASSERT_TRUE(Overlaps("375", "400"));
     ASSERT_TRUE(Overlaps("450", "450"));
     ASSERT_TRUE(Overlaps("450", "500"));
+
+    ASSERT_TRUE(! Overlaps(NULL, "149"));
+    ASSERT_TRUE(! Overlaps("451", NULL));
+    ASSERT_TRUE(Overlaps(NULL, NULL));
+    ASSERT_TRUE(Overlaps(NULL, "150"));
+    ASSERT_TRUE(Overlaps(NULL, "199"));
+    ASSERT_TRUE(Overlaps(NULL, "200"));
+    ASSERT_TRUE(Overlaps(NULL, "201"));
+    ASSERT_TRUE(Overlaps(NULL, "400"));
+    ASSERT_TRUE(Overlaps(NULL, "800"));
+    ASSERT_TRUE(Overlaps("100", NULL));
+    ASSERT_TRUE(Overlaps("200", NULL));
+    ASSERT_TRUE(Overlaps("449", NULL));
+    ASSERT_TRUE(Overlaps("450", NULL));
 }
 
 TEST(FindFileTest, OverlapSequenceChecks)
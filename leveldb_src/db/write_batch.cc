@@ -134,15 +134,28 @@ class MemTableInserter : public WriteBatch::Handler
 public:
     SequenceNumber sequence_;
     MemTable* mem_;
+    bool concurrent_;
 
     virtual void Put(const Slice& key, const Slice& value)
     {
-        mem_->Add(sequence_, kTypeValue, key, value);
-        sequence_++;
+        Add(kTypeValue, key, value);
     }
     virtual void Delete(const Slice& key)
     {
-        mem_->Add(sequence_, kTypeDeletion, key, Slice());
+        Add(kTypeDeletion, key, Slice());
+    }
+
+private:
+    void Add(ValueType type, const Slice& key, const Slice& value)
+    {
+        if (concurrent_)
+        {
+            mem_->AddConcurrently(sequence_, type, key, value);
+        }
+        else
+        {
+            mem_->Add(sequence_, type, key, value);
+        }
         sequence_++;
     }
 };
@@ -154,6 +167,17 @@ Status WriteBatchInternal::InsertInto(const WriteBatch* b,
     MemTableInserter inserter;
     inserter.sequence_ = WriteBatchInternal::Sequence(b);
     inserter.mem_ = memtable;
+    inserter.concurrent_ = false;
+    return b->Iterate(&inserter);
+}
+
+Status WriteBatchInternal::InsertIntoConcurrently(const WriteBatch* b,
+                                                  MemTable* memtable)
+{
+    MemTableInserter inserter;
+    inserter.sequence_ = WriteBatchInternal::Sequence(b);
+    inserter.mem_ = memtable;
+    inserter.concurrent_ = true;
     return b->Iterate(&inserter);
 }
 
@@ -163,4 +187,11 @@ void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents)
     b->rep_.assign(contents.data(), contents.size());
 }
 
+void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src)
+{
+    SetCount(dst, Count(dst) + Count(src));
+    assert(src->rep_.size() >= 12);
+    dst->rep_.append(src->rep_.data() + 12, src->rep_.size() - 12);
+}
+
 }
@@ -43,6 +43,15 @@ public:
     static void SetContents(WriteBatch* batch, const Slice& contents);
 
     static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
+
+    // Like InsertInto(), but uses MemTable::AddConcurrently() so that
+    // several batches can be inserted into "memtable" at once.
+    static Status InsertIntoConcurrently(const WriteBatch* batch,
+                                         MemTable* memtable);
+
+    // Append the entries of "src" to "dst".  The sequence number of "dst"
+    // is left unchanged.
+    static void Append(WriteBatch* dst, const WriteBatch* src);
 };
 
 }
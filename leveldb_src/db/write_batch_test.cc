@@ -90,6 +90,34 @@ TEST(WriteBatchTest, Corruption)
               PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, Append)
+{
+    WriteBatch b1, b2;
+    WriteBatchInternal::SetSequence(&b1, 200);
+    WriteBatchInternal::SetSequence(&b2, 300);
+    WriteBatchInternal::Append(&b1, &b2);
+    ASSERT_EQ("",
+              PrintContents(&b1));
+    b2.Put("a", "va");
+    WriteBatchInternal::Append(&b1, &b2);
+    ASSERT_EQ("Put(a, va)@200",
+              PrintContents(&b1));
+    b2.Clear();
+    b2.Put("b", "vb");
+    WriteBatchInternal::Append(&b1, &b2);
+    ASSERT_EQ("Put(a, va)@200"
+              "Put(b, vb)@201",
+              PrintContents(&b1));
+    b2.Delete("foo");
+    WriteBatchInternal::Append(&b1, &b2);
+    ASSERT_EQ("Put(a, va)@200"
+              "Put(b, vb)@202"
+              "Put(b, vb)@201"
+              "Delete(foo)@203",
+              PrintContents(&b1));
+    ASSERT_EQ(4, WriteBatchInternal::Count(&b1));
+}
+
 }
 
 int main(int argc, char** argv)
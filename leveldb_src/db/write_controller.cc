@@ -0,0 +1,65 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+namespace leveldb
+{
+
+// Delayed writes are never let through at less than this fraction of
+// the maximum rate, since writes stop altogether soon after.
+static const uint64_t kMinRateDivisor = 16;
+
+WriteController::WriteController(uint64_t max_rate)
+    : max_rate_(max_rate > 0 ? max_rate : 1),
+      delayed_(false),
+      rate_(max_rate_),
+      next_write_micros_(0)
+{
+}
+
+void WriteController::SetDelayed(double pressure)
+{
+    if (pressure < 0) pressure = 0;
+    if (pressure > 1) pressure = 1;
+    const uint64_t min_rate =
+        (max_rate_ + kMinRateDivisor - 1) / kMinRateDivisor;
+    rate_ = static_cast<uint64_t>(max_rate_ * (1 - pressure));
+    if (rate_ < min_rate)
+    {
+        rate_ = min_rate;
+    }
+    delayed_ = true;
+}
+
+void WriteController::SetNormal()
+{
+    delayed_ = false;
+    next_write_micros_ = 0;
+}
+
+uint64_t WriteController::GetDelay(uint64_t now) const
+{
+    if (!delayed_ || next_write_micros_ <= now)
+    {
+        return 0;
+    }
+    return next_write_micros_ - now;
+}
+
+void WriteController::Charge(uint64_t now, uint64_t bytes)
+{
+    if (!delayed_)
+    {
+        return;
+    }
+    // Time the database spent idle is not saved up for a burst of writes
+    if (next_write_micros_ < now)
+    {
+        next_write_micros_ = now;
+    }
+    next_write_micros_ += bytes * 1000000 / rate_;
+}
+
+}
@@ -0,0 +1,67 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// WriteController paces writes while compaction falls behind.  Instead of
+// stopping writers outright, it lets them through at a rate that drops as
+// the pressure on compaction rises and recovers as it eases.  The rate is
+// enforced with a virtual clock: every write moves the time at which the
+// next one may start forward by its size divided by the rate.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <stdint.h>
+
+namespace leveldb
+{
+
+// Not thread-safe; DBImpl only calls it with its mutex held.
+class WriteController
+{
+public:
+    // Writes are never let through at more than "max_rate" bytes per
+    // second while delayed.
+    explicit WriteController(uint64_t max_rate);
+
+    // Set how close the database is to stopping writes, from 0 (writes
+    // are about to be delayed) to 1 (writes are about to stop).  The rate
+    // falls linearly from the maximum to a sixteenth of it.
+    void SetDelayed(double pressure);
+
+    // Stop delaying writes.
+    void SetNormal();
+
+    bool IsDelayed() const
+    {
+        return delayed_;
+    }
+
+    // The current rate in bytes per second, or 0 when writes are not
+    // delayed.
+    uint64_t rate() const
+    {
+        return delayed_ ? rate_ : 0;
+    }
+
+    // Return the number of microseconds from "now" that the next write
+    // has to wait while writes are delayed.
+    uint64_t GetDelay(uint64_t now) const;
+
+    // Account for a write of "bytes" that starts at "now".
+    void Charge(uint64_t now, uint64_t bytes);
+
+private:
+    const uint64_t max_rate_;
+    bool delayed_;
+    uint64_t rate_;
+    uint64_t next_write_micros_;   // When the next write may start
+
+    // No copying allowed
+    WriteController(const WriteController&);
+    void operator=(const WriteController&);
+};
+
+}
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
@@ -0,0 +1,75 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "util/testharness.h"
+
+namespace leveldb
+{
+
+class WriteControllerTest { };
+
+TEST(WriteControllerTest, NotDelayed)
+{
+    WriteController c(1000000);
+    ASSERT_TRUE(!c.IsDelayed());
+    ASSERT_EQ(0, c.rate());
+    c.Charge(100, 1 << 20);
+    ASSERT_EQ(0, c.GetDelay(100));
+}
+
+TEST(WriteControllerTest, RateFallsWithPressure)
+{
+    WriteController c(1600000);
+    c.SetDelayed(0);
+    ASSERT_TRUE(c.IsDelayed());
+    ASSERT_EQ(1600000, c.rate());
+    c.SetDelayed(0.5);
+    ASSERT_EQ(800000, c.rate());
+    c.SetDelayed(1);
+    ASSERT_EQ(100000, c.rate());
+    c.SetDelayed(5);
+    ASSERT_EQ(100000, c.rate());
+    c.SetNormal();
+    ASSERT_EQ(0, c.rate());
+}
+
+TEST(WriteControllerTest, Pacing)
+{
+    WriteController c(1000000);   // One byte per microsecond
+    c.SetDelayed(0);
+
+    // Each write pushes the next one back by its size over the rate
+    uint64_t now = 5000;
+    c.Charge(now, 1000);
+    ASSERT_EQ(1000, c.GetDelay(now));
+    c.Charge(now, 500);
+    ASSERT_EQ(1500, c.GetDelay(now));
+    ASSERT_EQ(500, c.GetDelay(now + 1000));
+    ASSERT_EQ(0, c.GetDelay(now + 2000));
+
+    // Idle time is not saved up
+    now += 100000;
+    c.Charge(now, 200);
+    ASSERT_EQ(200, c.GetDelay(now));
+
+    // A lower rate spaces writes further apart
+    c.SetDelayed(0.5);
+    c.Charge(now, 200);
+    ASSERT_EQ(600, c.GetDelay(now));
+
+    // Writes are let through at once when no longer delayed
+    c.SetNormal();
+    ASSERT_EQ(0, c.GetDelay(now));
+    c.SetDelayed(0);
+    ASSERT_EQ(0, c.GetDelay(now));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    return leveldb::test::RunAllTests();
+}
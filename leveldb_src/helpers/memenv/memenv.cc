@@ -232,6 +232,12 @@ public:
         return file_->Read(offset, n, result, scratch);
     }
 
+    virtual bool StableReads() const
+    {
+        // Blocks are never moved or freed while we hold a reference
+        return true;
+    }
+
 private:
     FileState* file_;
 };
@@ -313,6 +319,13 @@ public:
         return Status::OK();
     }
 
+    virtual Status NewMmapReadableFile(const std::string& fname,
+                                       RandomAccessFile** result)
+    {
+        // The files already live in memory
+        return NewRandomAccessFile(fname, result);
+    }
+
     virtual Status NewWritableFile(const std::string& fname,
                                    WritableFile** result)
     {
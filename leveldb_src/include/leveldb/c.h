@@ -55,6 +55,7 @@ typedef struct leveldb_cache_t         leveldb_cache_t;
 typedef struct leveldb_comparator_t    leveldb_comparator_t;
 typedef struct leveldb_env_t           leveldb_env_t;
 typedef struct leveldb_filelock_t      leveldb_filelock_t;
+typedef struct leveldb_filterpolicy_t  leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t      leveldb_iterator_t;
 typedef struct leveldb_logger_t        leveldb_logger_t;
 typedef struct leveldb_options_t       leveldb_options_t;
@@ -103,6 +104,19 @@ extern char* leveldb_get(
     size_t* vallen,
     char** errptr);
 
+/* Looks up num_keys keys against one state of the db.  For each i,
+   values[i] is NULL if keys[i] is not found and a malloc()ed array
+   otherwise, with its length stored in vallens[i].  errs[i] is set as
+   errptr is by leveldb_get(), so each entry must be NULL or a previous
+   error on entry. */
+extern void leveldb_multi_get(
+    leveldb_t* db,
+    const leveldb_readoptions_t* options,
+    int num_keys,
+    const char* const* keys, const size_t* keylens,
+    char** values, size_t* vallens,
+    char** errs);
+
 extern leveldb_iterator_t* leveldb_create_iterator(
     leveldb_t* db,
     const leveldb_readoptions_t* options);
@@ -127,6 +141,11 @@ extern void leveldb_approximate_sizes(
     const char* const* range_limit_key, const size_t* range_limit_key_len,
     uint64_t* sizes);
 
+extern void leveldb_compact_range(
+    leveldb_t* db,
+    const char* start_key, size_t start_key_len,
+    const char* limit_key, size_t limit_key_len);
+
 /* Management operations */
 
 extern void leveldb_destroy_db(
@@ -177,6 +196,9 @@ extern void leveldb_options_destroy(leveldb_options_t*);
 extern void leveldb_options_set_comparator(
     leveldb_options_t*,
     leveldb_comparator_t*);
+extern void leveldb_options_set_filter_policy(
+    leveldb_options_t*,
+    leveldb_filterpolicy_t*);
 extern void leveldb_options_set_create_if_missing(
     leveldb_options_t*, unsigned char);
 extern void leveldb_options_set_error_if_exists(
@@ -194,7 +216,10 @@ extern void leveldb_options_set_block_restart_interval(leveldb_options_t*, int);
 enum
 {
     leveldb_no_compression = 0,
-    leveldb_snappy_compression = 1
+    leveldb_snappy_compression = 1,
+    leveldb_lz4_compression = 2,
+    leveldb_lz4hc_compression = 3,
+    leveldb_zstd_compression = 4
 };
 extern void leveldb_options_set_compression(leveldb_options_t*, int);
 
@@ -210,6 +235,26 @@ extern leveldb_comparator_t* leveldb_comparator_create(
     const char* (*name)(void*));
 extern void leveldb_comparator_destroy(leveldb_comparator_t*);
 
+/* Filter policy */
+
+extern leveldb_filterpolicy_t* leveldb_filterpolicy_create(
+    void* state,
+    void (*destructor)(void*),
+    char* (*create_filter)(
+        void*,
+        const char* const* key_array, const size_t* key_length_array,
+        int num_keys,
+        size_t* filter_length),
+    unsigned char (*key_may_match)(
+        void*,
+        const char* key, size_t length,
+        const char* filter, size_t filter_length),
+    const char* (*name)(void*));
+extern void leveldb_filterpolicy_destroy(leveldb_filterpolicy_t*);
+
+extern leveldb_filterpolicy_t* leveldb_filterpolicy_create_bloom(
+    int bits_per_key);
+
 /* Read options */
 
 extern leveldb_readoptions_t* leveldb_readoptions_create();
@@ -233,6 +278,7 @@ extern void leveldb_writeoptions_set_sync(
 /* Cache */
 
 extern leveldb_cache_t* leveldb_cache_create_lru(size_t capacity);
+extern leveldb_cache_t* leveldb_cache_create_clock(size_t capacity);
 extern void leveldb_cache_destroy(leveldb_cache_t* cache);
 
 /* Env */
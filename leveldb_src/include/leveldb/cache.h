@@ -33,6 +33,27 @@ class Cache;
 // of Cache uses a least-recently-used eviction policy.
 extern Cache* NewLRUCache(size_t capacity);
 
+// Like NewLRUCache(capacity), but up to high_pri_pool_ratio of the
+// capacity is set aside for entries inserted with Cache::kHighPriority
+// and for entries that are looked up again after being inserted.  Other
+// new entries are inserted at the midpoint of the LRU list, i.e. below
+// that pool, so a large scan that touches each block once only cycles
+// through the remaining capacity instead of evicting the hot entries.
+// A ratio of 0 gives a plain LRU cache.
+extern Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio);
+
+// Create a new cache with a fixed size capacity that evicts entries with
+// the CLOCK algorithm, an approximation of least-recently-used.  Lookups
+// and releases of cached entries use atomic operations only, so readers
+// do not serialize on a lock when the data they want is cached.
+//
+// Entries live in fixed tables sized for capacity/estimated_entry_charge
+// entries; the cache evicts early rather than hold more than that.  The
+// single-argument form assumes entries of about 4KB, i.e. a block cache
+// with the default block size.
+extern Cache* NewClockCache(size_t capacity);
+extern Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge);
+
 class LEVELDB_EXPORT Cache
 {
 public:
@@ -46,6 +67,14 @@ public:
     //z 一个不透明的handle。
     struct Handle { };
 
+    // Hint passed to Insert() about how valuable an entry is.  Caches
+    // that do not distinguish priorities treat all entries alike.
+    enum Priority
+    {
+        kLowPriority,
+        kHighPriority
+    };
+
     //z 存储key-value值对到cache中，并根据整个cache的容量将之赋值到指定的charge
     // Insert a mapping from key->value into the cache and assign it
     // the specified charge against the total cache capacity.
@@ -62,6 +91,12 @@ public:
     virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                            void (*deleter)(const Slice& key, void* value)) = 0;
 
+    // Like Insert() above, but with a hint about the priority of the entry.
+    // The default implementation ignores the hint.
+    virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value),
+                           Priority priority);
+
     // If the cache has no mapping for "key", returns NULL.
     //
     // Else return a handle that corresponds to the mapping.  The caller
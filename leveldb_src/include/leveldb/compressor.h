@@ -0,0 +1,90 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Compressor implements one way of compressing the blocks of a table
+// file.  Every block carries the CompressionType of the compressor that
+// wrote it in its trailer, and readers find the compressor to use through
+// a registry keyed by that type.  The built-in compressors are always
+// registered; applications can register their own under the types
+// reserved for them (kCustomCompressionMin..kCustomCompressionMax).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPRESSOR_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPRESSOR_H_
+
+#include "win32exports.h"
+#include <stddef.h>
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb
+{
+
+class LEVELDB_EXPORT Compressor
+{
+public:
+    virtual ~Compressor();
+
+    // The type recorded in the trailer of every block written by this
+    // compressor.  It is part of the persistent format and must never
+    // change once files were written with it.
+    virtual CompressionType type() const = 0;
+
+    // The name of the compressor, used in log messages.
+    virtual const char* Name() const = 0;
+
+    // Store the compressed form of input[0,length-1] in *output.
+    // Return false if this compressor is not available (e.g. it was
+    // left out of the build), in which case the block is stored as is.
+    virtual bool Compress(const char* input, size_t length,
+                          std::string* output) const = 0;
+
+    // If input[0,length-1] looks like the output of Compress(), store
+    // the size of the uncompressed data in *result and return true.
+    // Else return false.
+    virtual bool GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) const = 0;
+
+    // Uncompress input[0,length-1] into output, which has room for the
+    // number of bytes reported by GetUncompressedLength().  Return false
+    // if the input is corrupt.
+    virtual bool Uncompress(const char* input, size_t length,
+                            char* output) const = 0;
+
+    // Return true if this compressor makes use of a dictionary.  Tables
+    // built with options.compression_dictionary_size are only given one
+    // for compressors that do.  The default returns false.
+    virtual bool SupportsDictionary() const;
+
+    // Like Compress(), but the output may refer to "dictionary", data
+    // that resembles the input and is passed to UncompressWithDictionary()
+    // as well.  The default ignores the dictionary and calls Compress().
+    virtual bool CompressWithDictionary(const char* input, size_t length,
+                                        const Slice& dictionary,
+                                        std::string* output) const;
+
+    // Uncompress the output of CompressWithDictionary() for the same
+    // dictionary.  The default ignores the dictionary and calls
+    // Uncompress().
+    virtual bool UncompressWithDictionary(const char* input, size_t length,
+                                          const Slice& dictionary,
+                                          char* output) const;
+};
+
+// Make "compressor" available to every database in this process, for
+// writing as well as for reading.  Returns InvalidArgument if its type
+// is not a custom type or is already taken.  Should be called before any
+// database that uses it is opened.
+//
+// The compressor is never deleted; it must live until the process exits.
+extern Status RegisterCompressor(const Compressor* compressor);
+
+// Return the compressor registered for "type", or NULL if there is none.
+// There is never one for kNoCompression.
+extern const Compressor* GetCompressor(CompressionType type);
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPRESSOR_H_
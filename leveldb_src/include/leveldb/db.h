@@ -87,6 +87,16 @@ public:
     virtual Status Get(const ReadOptions& options,
                        const Slice& key, std::string* value) = 0;
 
+    // For each i in [0,n-1], look up "keys[i]" as Get() would, storing
+    // the value in "values[i]" and the result in "statuses[i]".  All of
+    // the lookups observe the same state of the DB.
+    //
+    // Cheaper than n calls to Get(): keys that fall in the same table
+    // file or block share the work of finding them.
+    virtual void MultiGet(const ReadOptions& options,
+                          const Slice* keys, int n,
+                          std::string* values, Status* statuses);
+
     // Return a heap-allocated iterator over the contents of the database.
     // The result of NewIterator() is initially invalid (caller must
     // call one of the Seek methods on the iterator before using it).
@@ -117,6 +127,16 @@ public:
     //     where <N> is an ASCII representation of a level number (e.g. "0").
     //  "leveldb.stats" - returns a multi-line string that describes statistics
     //     about the internal operation of the DB.
+    //  "leveldb.pending-compaction-bytes" - returns an estimate of the number
+    //     of bytes compaction has to rewrite to bring every level back under
+    //     its target size.
+    //  "leveldb.delayed-write-rate" - returns the rate in bytes per second
+    //     that writes are held to while compaction falls behind, or 0 if
+    //     writes are not being delayed.
+    //  "leveldb.write-stall-micros.<cause>" - returns the total time writes
+    //     have waited for <cause>, one of "level0-slowdown",
+    //     "pending-compaction-slowdown", "memtable-full", "level0-stop" or
+    //     "pending-compaction-stop".
     virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
     // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -130,8 +150,32 @@ public:
     virtual void GetApproximateSizes(const Range* range, int n,
                                      uint64_t* sizes) = 0;
 
-    // Possible extensions:
-    // (1) Add a method to compact a range of keys
+    // Compact the underlying storage for the key range [*begin,*end].
+    // In particular, deleted and overwritten versions are discarded,
+    // and the data is rearranged to reduce the cost of operations
+    // needed to access the data.  This operation should typically only
+    // be invoked by users who understand the underlying implementation.
+    //
+    // begin==NULL is treated as a key before all keys in the database.
+    // end==NULL is treated as a key after all keys in the database.
+    // Therefore the following call will compact the entire database:
+    //    db->CompactRange(NULL, NULL);
+    //
+    // Pieces of the range that do not share input files are compacted
+    // concurrently when max_background_compactions allows it, and
+    // automatic compactions keep running while the call is in progress.
+    virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+    // Add the table file named "fname", written by an SstFileWriter
+    // with the options of this database, to the database as if its
+    // entries had been written in one batch.  The file is placed in the
+    // deepest level that none of the existing data in its key range is
+    // above, and is moved into the database directory, so it must be on
+    // the same file system.  If older entries for keys in its range exist
+    // or snapshots are live, the file is instead rewritten with a new
+    // sequence number and then removed.  Writes wait while a file is
+    // being added.
+    virtual Status IngestExternalFile(const std::string& fname);
 
 private:
     // No copying allowed
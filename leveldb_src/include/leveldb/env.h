@@ -62,6 +62,17 @@ public:
     virtual Status NewRandomAccessFile(const std::string& fname,
                                        RandomAccessFile** result) = 0;
 
+    // Like NewRandomAccessFile(), but maps the whole file into memory
+    // where the platform supports it.  Read() on the returned file then
+    // stores in *result a slice that points into the mapping and leaves
+    // "scratch" untouched; the data stays valid while the file is open.
+    // Each open file holds its mapping, so callers should bound the
+    // total size of the files they open this way.
+    //
+    // The default implementation calls NewRandomAccessFile().
+    virtual Status NewMmapReadableFile(const std::string& fname,
+                                       RandomAccessFile** result);
+
     // Create an object that writes to a new file with the specified
     // name.  Deletes any existing file with the same name and creates a
     // new file.  On success, stores a pointer to the new file in
@@ -128,6 +139,12 @@ public:
         void (*function)(void* arg),
         void* arg) = 0;
 
+    // Ask the environment to run at least "num" functions passed to
+    // Schedule() concurrently.  This is only a hint: the default
+    // implementation does nothing, and an Env whose Schedule() already
+    // runs work items in parallel may ignore it.
+    virtual void SetBackgroundThreads(int num);
+
     // Start a new thread, invoking "function(arg)" within the new thread.
     // When "function(arg)" returns, the thread will be destroyed.
     virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -195,6 +212,14 @@ public:
     // Safe for concurrent use by multiple threads.
     virtual Status Read(uint64_t offset, size_t n, Slice* result,
                         char* scratch) const = 0;
+
+    // Returns true if the data that Read() returns outside of "scratch"
+    // stays valid and unchanged until this file is deleted.  Readers may
+    // then keep referring to that memory instead of copying it.
+    virtual bool StableReads() const
+    {
+        return false;
+    }
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -286,6 +311,10 @@ public:
     {
         return target_->NewRandomAccessFile(f, r);
     }
+    Status NewMmapReadableFile(const std::string& f, RandomAccessFile** r)
+    {
+        return target_->NewMmapReadableFile(f, r);
+    }
     Status NewWritableFile(const std::string& f, WritableFile** r)
     {
         return target_->NewWritableFile(f, r);
@@ -330,6 +359,10 @@ public:
     {
         return target_->Schedule(f, a);
     }
+    void SetBackgroundThreads(int num)
+    {
+        return target_->SetBackgroundThreads(num);
+    }
     void StartThread(void (*f)(void*), void* a)
     {
         return target_->StartThread(f, a);
@@ -0,0 +1,135 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MemTableRep holds the sorted entries of a memtable.  By default every
+// memtable keeps its entries in a skip list; Options::memtable_factory
+// selects another representation that better suits a workload:
+//
+//  - NewHashSkipListMemTableRepFactory() spreads entries over buckets
+//    chosen by a key prefix, each bucket a small skip list.  Point lookups
+//    search a single bucket, but iterating over the whole memtable (as
+//    flushes and DB iterators do) must first sort all entries.
+//
+//  - NewVectorMemTableRepFactory() appends entries to an array that is
+//    sorted once, when the memtable is flushed.  This is the cheapest way
+//    to absorb a bulk load, but every read of the memtable before then
+//    has to sort or scan a copy of the array.
+//
+// Entries handed to a MemTableRep are pointers to memtable records: the
+// varint32-prefixed internal key followed by the varint32-prefixed value.
+// They stay valid for the lifetime of the representation.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
+#define STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
+
+#include "win32exports.h"
+#include <stddef.h>
+#include "leveldb/slice.h"
+
+namespace leveldb
+{
+
+class Arena;
+class SliceTransform;
+
+class LEVELDB_EXPORT MemTableRep
+{
+public:
+    // Orders memtable entries (or lookup keys encoded the same way
+    // without a value) by internal key.
+    class KeyComparator
+    {
+    public:
+        virtual ~KeyComparator();
+        virtual int operator()(const char* a, const char* b) const = 0;
+    };
+
+    // Iteration over the entries of a representation, in comparator order
+    class Iterator
+    {
+    public:
+        virtual ~Iterator();
+        virtual bool Valid() const = 0;
+        // REQUIRES: Valid()
+        virtual const char* key() const = 0;
+        // REQUIRES: Valid()
+        virtual void Next() = 0;
+        // REQUIRES: Valid()
+        virtual void Prev() = 0;
+        // Position at the first entry >= target
+        virtual void Seek(const char* target) = 0;
+        virtual void SeekToFirst() = 0;
+        virtual void SeekToLast() = 0;
+    };
+
+    virtual ~MemTableRep();
+
+    // Add "entry".  Calls are externally synchronized, but may run
+    // concurrently with reads.
+    // REQUIRES: nothing that compares equal to entry is present.
+    virtual void Insert(const char* entry) = 0;
+
+    // Like Insert(), but may be called from several threads at once.
+    // Only used if MemTableRepFactory::IsInsertConcurrentlySupported().
+    virtual void InsertConcurrently(const char* entry);
+
+    // Return the first entry >= target, or NULL if there is none.  Only
+    // entries with the same user key as "target" need to be considered,
+    // so a representation may restrict the search to one partition.
+    virtual const char* FindGreaterOrEqual(const char* target) = 0;
+
+    // Return a new iterator over all entries.  The caller must delete it
+    // before the representation is destroyed.
+    virtual Iterator* NewIterator() = 0;
+
+    // Called once no more entries will be added.
+    virtual void MarkReadOnly();
+
+    // Return the memory used by the representation apart from what it
+    // allocated from the arena passed to its factory.
+    virtual size_t ApproximateMemoryUsage();
+
+    // Return the user key of an entry.
+    static Slice UserKey(const char* entry);
+};
+
+class LEVELDB_EXPORT MemTableRepFactory
+{
+public:
+    virtual ~MemTableRepFactory();
+
+    // Return the name of this factory, for logging.
+    virtual const char* Name() const = 0;
+
+    // Return a new representation that orders entries with "cmp".  Memory
+    // allocated from "arena" is released together with the memtable; both
+    // outlive the representation.
+    virtual MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator& cmp,
+                                           Arena* arena) = 0;
+
+    // Return true if the representations created by this factory support
+    // InsertConcurrently().  Options::allow_concurrent_memtable_write is
+    // ignored otherwise.
+    virtual bool IsInsertConcurrentlySupported() const;
+};
+
+// The callers of the following functions must delete the result after
+// any database that is using it has been closed.
+
+// Return a new factory for the default skip list representation.
+extern MemTableRepFactory* NewSkipListMemTableRepFactory();
+
+// Return a new factory for representations that hash the prefix of each
+// user key, as computed by *prefix_extractor, into one of "bucket_count"
+// buckets.  Keys outside the extractor's domain are hashed whole.
+// *prefix_extractor must outlive the factory.
+extern MemTableRepFactory* NewHashSkipListMemTableRepFactory(
+    const SliceTransform* prefix_extractor, size_t bucket_count);
+
+// Return a new factory for append-only vector representations.
+extern MemTableRepFactory* NewVectorMemTableRepFactory();
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
@@ -7,6 +7,7 @@
 
 #include "win32exports.h"
 #include <stddef.h>
+#include <stdint.h>
 
 namespace leveldb
 {
@@ -14,7 +15,10 @@ namespace leveldb
 class Cache;
 class Comparator;
 class Env;
+class FilterPolicy;
 class Logger;
+class MemTableRepFactory;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -26,7 +30,15 @@ enum CompressionType
     // NOTE: do not change the values of existing entries, as these are
     // part of the persistent format on disk.
     kNoCompression     = 0x0,
-    kSnappyCompression = 0x1
+    kSnappyCompression = 0x1,
+    kLZ4Compression    = 0x2,
+    kLZ4HCCompression  = 0x3,
+    kZstdCompression   = 0x4,
+
+    // Types reserved for compressors registered by the application
+    // (see leveldb/compressor.h)
+    kCustomCompressionMin = 0x80,
+    kCustomCompressionMax = 0xff
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -85,6 +97,22 @@ struct LEVELDB_EXPORT Options
     // Default: 4MB
     size_t write_buffer_size;
 
+    // If true, writers whose batches are logged together as one group
+    // then insert their own batches into the memtable in parallel instead
+    // of leaving the whole group to a single thread.  This helps when many
+    // threads write at once on a machine with several cores.
+    //
+    // Default: false
+    bool allow_concurrent_memtable_write;
+
+    // If non-NULL, use the specified factory to create the data structure
+    // that holds the entries of each memtable (see leveldb/memtablerep.h).
+    // Concurrent memtable writes are only used if the factory supports
+    // them.
+    //
+    // Default: NULL, which keeps entries in a skip list
+    MemTableRepFactory* memtable_factory;
+
     // Number of open files that can be used by the DB.  You may need to
     // increase this if your database has a large working set (budget
     // one open file per 2MB of working set).
@@ -92,6 +120,77 @@ struct LEVELDB_EXPORT Options
     // Default: 1000
     int max_open_files;
 
+    // Maximum number of background compactions that may run at the same
+    // time.  Compactions that run concurrently never share input files,
+    // and at most one of them compacts level-0 files at any time.
+    // Memtable flushes are also run by these background jobs.  Raising
+    // this value lets compactions at different levels proceed in
+    // parallel on machines with spare disk bandwidth and cores.
+    //
+    // Default: 1
+    int max_background_compactions;
+
+    // Maximum number of threads that work on a single compaction.  A
+    // large compaction is split into this many key ranges of roughly equal
+    // size, which are merged in parallel and installed together.  This
+    // mostly shortens the level-0 compactions that writers may be waiting
+    // for.  Compactions whose input is small are never split.  The extra
+    // threads are started as they are needed and kept until the database
+    // is closed.
+    //
+    // Default: 1
+    int max_subcompactions;
+
+    // If true, the size each level is compacted down to is derived from
+    // the size of the last level, so that the last level holds about 90%
+    // of the data whatever the size of the database, and level-0 files
+    // are compacted straight into the first level that is big enough to
+    // be worth having.  This writes data fewer times on its way down than
+    // the fixed targets of 10MB for level-1, 100MB for level-2 and so on,
+    // which suit only databases of a few particular sizes.
+    //
+    // Default: false
+    bool level_compaction_dynamic_level_bytes;
+
+    // Writes are delayed while compaction falls behind: once level-0
+    // holds 8 files, or compactions are estimated to have more than
+    // soft_pending_compaction_bytes_limit bytes to write.  Delayed writes
+    // are let through at this many bytes per second at first, and at a
+    // lower rate the closer the database gets to the point where writes
+    // stop (12 level-0 files or hard_pending_compaction_bytes_limit).
+    // The rate recovers as compaction catches up.  Spreading the delay
+    // over all writes keeps writers from stalling for seconds at a time.
+    //
+    // Default: 16MB/s
+    uint64_t delayed_write_rate;
+
+    // Estimated bytes left to compact at which writes are delayed, and
+    // at which they stop until compaction catches up.  Zero disables the
+    // limit.
+    //
+    // Default: 64GB and 256GB
+    uint64_t soft_pending_compaction_bytes_limit;
+    uint64_t hard_pending_compaction_bytes_limit;
+
+    // If non-zero, table files are read through memory mappings on
+    // platforms that support them, as long as the mapped files add up to
+    // no more than this many bytes; files opened beyond the budget are
+    // read normally.  Reads from a mapped file use the data in place, which
+    // saves a system call and a copy per block when the data sits in the
+    // operating system's page cache.  Only 64-bit builds map files.
+    //
+    // Default: 0 (no mappings)
+    uint64_t max_mmap_read_bytes;
+
+    // Number of bytes at the end of a table file that are read in one go
+    // when the table is opened.  The footer, index block and meta blocks
+    // that fall within them are then parsed without further reads, which
+    // matters when tables are opened on the lookup path because
+    // max_open_files is smaller than the number of table files.
+    //
+    // Default: 64K
+    size_t tail_prefetch_size;
+
     // Control over blocks (user data is stored in a set of blocks, and
     // a block is the unit of reading from disk).
 
@@ -100,6 +199,16 @@ struct LEVELDB_EXPORT Options
     // Default: NULL
     Cache* block_cache;
 
+    // If true, the index and filter blocks of table files are kept in
+    // block_cache, inserted with Cache::kHighPriority, instead of being
+    // held in memory for as long as the table is open.  Their memory is
+    // then bounded by the cache capacity; combine with a cache made by
+    // NewLRUCache(capacity, high_pri_pool_ratio) so that scans do not
+    // evict them.
+    //
+    // Default: false
+    bool cache_index_and_filter_blocks;
+
     // Approximate size of user data packed per block.  Note that the
     // block size specified here corresponds to uncompressed data.  The
     // actual size of the unit read from disk may be smaller if
@@ -108,6 +217,26 @@ struct LEVELDB_EXPORT Options
     // Default: 4K
     size_t block_size;
 
+    // If true, each data block ends in a small hash index from user keys
+    // to the restart interval that holds them, so that point lookups skip
+    // the binary search over the block's restart points.  It costs about
+    // one byte per key.  Blocks with more than 254 restart points are
+    // written without one.  Tables with such blocks cannot be read by
+    // versions that predate the hash index.
+    //
+    // Default: false
+    bool data_block_hash_index;
+
+    // If non-zero, the index of each table file is split into partitions
+    // of about this many bytes that are read through the block cache like
+    // data blocks, and only a small top-level index over the partitions is
+    // held while the table is open.  This bounds the memory used by the
+    // indexes of large tables with small blocks.  Tables written with a
+    // partitioned index cannot be read by versions that predate it.
+    //
+    // Default: 0 (a single index block per table)
+    size_t index_partition_size;
+
     // Number of keys between restart points for delta encoding of keys.
     // This parameter can be changed dynamically.  Most clients should
     // leave this parameter alone.
@@ -129,8 +258,81 @@ struct LEVELDB_EXPORT Options
     // worth switching to kNoCompression.  Even if the input data is
     // incompressible, the kSnappyCompression implementation will
     // efficiently detect that and will switch to uncompressed mode.
+    //
+    // kLZ4Compression is about as fast as kSnappyCompression and usually
+    // compresses a little better.  kLZ4HCCompression writes the same
+    // format, so it decompresses just as fast, but it spends several
+    // times the CPU to find better matches.  Being limited to the LZ4
+    // format, that only makes blocks some 5-10% smaller.
+    //
+    // kZstdCompression makes blocks a fifth to a quarter smaller than
+    // kLZ4HCCompression and compresses at half its speed or better, but
+    // it decompresses at a few hundred MB/s, many times slower than LZ4.
+    // It is meant for the large, cold levels (see compression_per_level).  It is only available if
+    // leveldb was built with zstd (see zstd_src); otherwise blocks are
+    // stored uncompressed.
     CompressionType compression;
 
+    // If non-NULL, the table files that compactions write to level L are
+    // compressed with compression_per_level[L] instead of "compression",
+    // where levels beyond the end of the array use its last entry.
+    // The other files a database writes, such as the tables its memtables
+    // are written to, use the entry for level 0.  This allows,
+    // for example, fast compression for the frequently rewritten upper
+    // levels and harder compression for the large, cold lower levels.
+    //
+    // The array must hold compression_per_level_size entries and outlive
+    // any database opened with these options.
+    //
+    // Default: NULL
+    const CompressionType* compression_per_level;
+    int compression_per_level_size;
+
+    // If greater than 1, the data blocks of each table being written are
+    // compressed by up to this many threads while the thread adding
+    // entries goes on filling the next ones.  The threads are shared by
+    // all the tables built through the same Env and kept until the
+    // process exits.  The blocks are still written in order, so the
+    // table is the same as without them.  This speeds up the
+    // compactions and memtable writes that are limited by compression,
+    // which is mostly the case with kLZ4HCCompression.
+    //
+    // Default: 1 (blocks are compressed by the thread adding entries)
+    int compression_threads;
+
+    // If non-zero, each table gets a dictionary of up to this many bytes,
+    // built from samples of its first data blocks and stored in the
+    // table, and its data blocks are compressed against it.  Small blocks
+    // of similar records compress much better that way, since what they
+    // have in common is not repeated in every block.  The blocks sampled
+    // are held in memory until the dictionary is built, about 16 times
+    // its size.  Readers load the dictionary once per open table.
+    //
+    // Only compressors that support dictionaries use one.  kZstdCompression
+    // does, and so do kLZ4Compression and kLZ4HCCompression, which refer
+    // to at most its last 64K bytes.
+    //
+    // Default: 0 (no dictionary)
+    size_t compression_dictionary_size;
+
+    // If non-NULL, use the specified filter policy to reduce disk reads.
+    // Many applications will benefit from passing the result of
+    // NewBloomFilterPolicy() here.
+    //
+    // Default: NULL
+    const FilterPolicy* filter_policy;
+
+    // If non-NULL, keys are grouped by the prefix this transformation
+    // extracts from them, and when filter_policy is also set, each table
+    // file holds one filter over the prefixes of its keys.  Iterators
+    // created with ReadOptions::prefix_same_as_start use it to skip the
+    // tables that hold no key with the prefix of the sought key.  Keys
+    // with the same prefix must be adjacent in the comparator order, as
+    // they are with NewFixedPrefixTransform() and the default comparator.
+    //
+    // Default: NULL
+    const SliceTransform* prefix_extractor;
+
     // Create an Options object with default values for all fields.
     Options();
 };
@@ -155,10 +357,21 @@ struct LEVELDB_EXPORT ReadOptions
     // Default: NULL
     const Snapshot* snapshot;
 
+    // If true, and the DB was opened with a prefix_extractor, an iterator
+    // positioned by Seek(target) only yields keys with the same prefix as
+    // target, and does not read from table files whose prefix filter
+    // shows that they hold no such key.  Such an iterator may only move
+    // forward from Seek(); Prev() makes it invalid with a NotSupported
+    // status.  SeekToFirst() and SeekToLast() iterate over all keys as
+    // usual.  Targets outside the extractor's domain are not bounded.
+    // Default: false
+    bool prefix_same_as_start;
+
     ReadOptions()
         : verify_checksums(false),
           fill_cache(true),
-          snapshot(NULL)
+          snapshot(NULL),
+          prefix_same_as_start(false)
     {
     }
 };
@@ -0,0 +1,49 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps a user key to a shorter key, typically a prefix
+// that groups related keys together.  Parts of leveldb that can take
+// advantage of such groups (e.g., the hash-bucketed memtable created by
+// NewHashSkipListMemTableRepFactory()) are configured with one.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include "win32exports.h"
+#include <stddef.h>
+
+namespace leveldb
+{
+
+class Slice;
+
+class LEVELDB_EXPORT SliceTransform
+{
+public:
+    virtual ~SliceTransform();
+
+    // Return the name of this transformation.  If the transformation
+    // changes in an incompatible way, the name must be changed too.
+    virtual const char* Name() const = 0;
+
+    // Return the transformed key.  The result must refer to data that
+    // lives as long as "key", which usually means a part of "key".
+    // REQUIRES: InDomain(key)
+    virtual Slice Transform(const Slice& key) const = 0;
+
+    // Return true iff Transform() may be applied to "key".  Keys outside
+    // the domain are handled as if each formed a group of its own.
+    virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transformation that maps a key to its first "prefix_len"
+// bytes.  Keys shorter than "prefix_len" are outside its domain.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+extern const SliceTransform* NewFixedPrefixTransform(size_t prefix_len);
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -0,0 +1,69 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter writes sorted key/value pairs into a table file that can
+// be added to a database with DB::IngestExternalFile(), bypassing the
+// log, the memtable and the compactions that DB::Write() would cost.
+//
+// An SstFileWriter is not safe for concurrent use.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include "win32exports.h"
+#include <stdint.h>
+#include <string>
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb
+{
+
+class Slice;
+
+class LEVELDB_EXPORT SstFileWriter
+{
+public:
+    // "options" should be the options of the database the file is meant
+    // for.  Its comparator must be the same, and the file gets filters
+    // only if it has the same filter_policy (and prefix_extractor).  The
+    // block size, compression and other table settings are taken from it.
+    explicit SstFileWriter(const Options& options);
+
+    // Abandons the file if Finish() has not been called
+    ~SstFileWriter();
+
+    // Create the file named "fname" and prepare to write into it.
+    Status Open(const std::string& fname);
+
+    // Add an entry that sets "key" to "value".
+    // REQUIRES: key is after any previously added key according to the
+    // comparator; otherwise InvalidArgument is returned.
+    Status Put(const Slice& key, const Slice& value);
+
+    // Add an entry that deletes any existing value of "key".
+    // REQUIRES: as for Put()
+    Status Delete(const Slice& key);
+
+    // Write out the rest of the file, sync and close it.  A file without
+    // any entries is not useful and yields InvalidArgument.
+    Status Finish();
+
+    // Size of the file written so far
+    uint64_t FileSize() const;
+
+private:
+    struct Rep;
+    Rep* rep_;
+
+    Status Add(const Slice& key, const Slice& value, bool deletion);
+
+    // No copying allowed
+    SstFileWriter(const SstFileWriter&);
+    void operator=(const SstFileWriter&);
+};
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
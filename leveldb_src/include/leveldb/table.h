@@ -7,6 +7,7 @@
 
 #include "win32exports.h"
 #include <stdint.h>
+#include "leveldb/cache.h"
 #include "leveldb/iterator.h"
 
 namespace leveldb
@@ -14,6 +15,8 @@ namespace leveldb
 
 class Block;
 class BlockHandle;
+class FilterBlockReader;
+class Footer;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
@@ -56,6 +59,11 @@ public:
     // be close to the file length.
     uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+    // Returns false if the prefix filter of the table shows that it holds
+    // no key with the same prefix as "key" under options.prefix_extractor.
+    // Returns true if it may hold one, or if the table has no prefix filter.
+    bool PrefixMayMatch(const Slice& key) const;
+
 private:
     struct Rep;
     Rep* rep_;
@@ -65,6 +73,45 @@ private:
         rep_ = rep;
     }
     static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+    static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                          const Slice&);
+    Iterator* BlockIterator(const ReadOptions&, const Slice& index_value,
+                            bool data_block, Cache::Priority priority) const;
+    Status FetchBlock(const ReadOptions&, const BlockHandle& handle,
+                      bool data_block, Cache::Priority priority,
+                      Block** block, Cache::Handle** cache_handle) const;
+    Status GetIndexBlock(const ReadOptions&,
+                         Block** block, Cache::Handle** cache_handle) const;
+    void UnpinBlock(Block* block, Cache::Handle* cache_handle) const;
+    Iterator* NewIndexIterator(const ReadOptions&) const;
+    FilterBlockReader* GetFilter(Cache::Handle** cache_handle) const;
+
+    // Calls (*handle_result)(arg, ...) with the entry found after a call
+    // to Seek(key).  May not make such a call if the filter policy or the
+    // hash index of the data block says that key is not present.  Does not
+    // heap-allocate any iterators.
+    friend class TableCache;
+    Status InternalGet(
+        const ReadOptions&, const Slice& key,
+        void* arg,
+        void (*handle_result)(void* arg, const Slice& k, const Slice& v));
+
+    // Like InternalGet() for each of keys[0,n-1], which must be sorted.
+    // Calls (*handle_result)(args[i], ...) and sets statuses[i].  Keys
+    // that fall in the same data block share one index seek and one block
+    // fetch.
+    Status InternalMultiGet(
+        const ReadOptions&, int n, const Slice* keys,
+        void* const* args,
+        void (*handle_result)(void* arg, const Slice& k, const Slice& v),
+        Status* statuses);
+
+    Status ReadMeta(RandomAccessFile* file, const Footer& footer);
+    void ReadFilter(RandomAccessFile* file, const Slice& filter_handle_value);
+    void ReadPrefixFilter(RandomAccessFile* file,
+                          const Slice& filter_handle_value);
+    Status ReadCompressionDictionary(RandomAccessFile* file,
+                                     const Slice& handle_value);
 
     // No copying allowed
     Table(const Table&);
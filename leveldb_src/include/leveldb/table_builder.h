@@ -73,8 +73,12 @@ public:
     // Number of calls to Add() so far.
     uint64_t NumEntries() const;
 
-    // Size of the file generated so far.  If invoked after a successful
-    // Finish() call, returns the size of the final generated file.
+    // Size of the file generated so far, which leaves out data blocks that
+    // are still being compressed (see Options::compression_threads) or are
+    // held back to build the compression dictionary (see
+    // Options::compression_dictionary_size).  If invoked after a
+    // successful Finish() call, returns the size of the final generated
+    // file.
     uint64_t FileSize() const;
 
 private:
@@ -82,7 +86,14 @@ private:
     {
         return status().ok();
     }
-    void WriteBlock(BlockBuilder* block, BlockHandle* handle);
+    void WriteBlock(BlockBuilder* block, const Slice& dictionary,
+                    BlockHandle* handle);
+    void WritePendingBlocks(size_t max_pending);
+    void BuildDictionary();
+    void AddIndexEntry(const Slice& key, const BlockHandle& handle);
+    void FlushIndexPartition();
+    void AddPrefix(const Slice& key);
+    void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
 
     struct Rep;
     Rep* rep_;
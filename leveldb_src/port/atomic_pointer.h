@@ -125,6 +125,33 @@ public:
         MemoryBarrier();
         rep_ = v;
     }
+
+    // Exchange() and CompareAndSwap() are full barriers.
+#if defined(COMPILER_MSVC)
+    inline void* Exchange(void* v)
+    {
+        return InterlockedExchangePointer(&rep_, v);
+    }
+    inline bool CompareAndSwap(void* old_value, void* new_value)
+    {
+        return InterlockedCompareExchangePointer(&rep_, new_value, old_value) == old_value;
+    }
+#else
+    inline void* Exchange(void* v)
+    {
+        void* old_value;
+        do
+        {
+            old_value = rep_;
+        }
+        while (!__sync_bool_compare_and_swap(&rep_, old_value, v));
+        return old_value;
+    }
+    inline bool CompareAndSwap(void* old_value, void* new_value)
+    {
+        return __sync_bool_compare_and_swap(&rep_, old_value, new_value);
+    }
+#endif
 };
 
 // AtomicPointer based on <cstdatomic>
@@ -152,6 +179,14 @@ public:
     {
         rep_.store(v, std::memory_order_relaxed);
     }
+    inline void* Exchange(void* v)
+    {
+        return rep_.exchange(v);
+    }
+    inline bool CompareAndSwap(void* old_value, void* new_value)
+    {
+        return rep_.compare_exchange_strong(old_value, new_value);
+    }
 };
 
 // We have neither MemoryBarrier(), nor <cstdatomic>
@@ -160,6 +195,110 @@ public:
 
 #endif
 
+// AtomicUint64 holds a 64-bit value that can be read and written without
+// word-tearing, even on 32-bit targets.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__LP64__)
+class AtomicUint64
+{
+private:
+    AtomicPointer rep_;
+public:
+    AtomicUint64() { }
+    explicit AtomicUint64(uint64_t v) : rep_(reinterpret_cast<void*>(v)) { }
+    inline uint64_t Acquire_Load() const
+    {
+        return reinterpret_cast<uint64_t>(rep_.Acquire_Load());
+    }
+    inline void Release_Store(uint64_t v)
+    {
+        rep_.Release_Store(reinterpret_cast<void*>(v));
+    }
+};
+
+#elif defined(LEVELDB_CSTDATOMIC_PRESENT) && !defined(LEVELDB_HAVE_MEMORY_BARRIER)
+class AtomicUint64
+{
+private:
+    std::atomic<uint64_t> rep_;
+public:
+    AtomicUint64() { }
+    explicit AtomicUint64(uint64_t v) : rep_(v) { }
+    inline uint64_t Acquire_Load() const
+    {
+        return rep_.load(std::memory_order_acquire);
+    }
+    inline void Release_Store(uint64_t v)
+    {
+        rep_.store(v, std::memory_order_release);
+    }
+};
+
+#else
+// 32-bit targets: a 64-bit compare-and-swap (cmpxchg8b on x86) is the
+// only way to move all eight bytes at once.
+class AtomicUint64
+{
+private:
+    volatile int64_t rep_;
+
+    inline int64_t CompareAndSwap(int64_t old_value, int64_t new_value)
+    {
+#if defined(COMPILER_MSVC)
+        return InterlockedCompareExchange64(&rep_, new_value, old_value);
+#else
+        return __sync_val_compare_and_swap(&rep_, old_value, new_value);
+#endif
+    }
+public:
+    AtomicUint64() { }
+    explicit AtomicUint64(uint64_t v) : rep_(v) { }
+    inline uint64_t Acquire_Load() const
+    {
+        return const_cast<AtomicUint64*>(this)->CompareAndSwap(0, 0);
+    }
+    inline void Release_Store(uint64_t v)
+    {
+        int64_t old_value = rep_;
+        int64_t prev;
+        while ((prev = CompareAndSwap(old_value, v)) != old_value)
+        {
+            old_value = prev;
+        }
+    }
+};
+#endif
+
+// AtomicInt32 is a counter that threads may decrement without a lock.
+class AtomicInt32
+{
+private:
+#if defined(COMPILER_MSVC)
+    volatile LONG rep_;
+#else
+    volatile int32_t rep_;
+#endif
+public:
+    AtomicInt32() : rep_(0) { }
+    explicit AtomicInt32(int32_t v) : rep_(v) { }
+    inline int32_t NoBarrier_Load() const
+    {
+        return rep_;
+    }
+    inline void NoBarrier_Store(int32_t v)
+    {
+        rep_ = v;
+    }
+    // Subtract one and return the new value.  Acts as a full barrier.
+    inline int32_t Decrement()
+    {
+#if defined(COMPILER_MSVC)
+        return InterlockedDecrement(&rep_);
+#else
+        return __sync_sub_and_fetch(&rep_, 1);
+#endif
+    }
+};
+
 #undef LEVELDB_HAVE_MEMORY_BARRIER
 #undef ARCH_CPU_X86_FAMILY
 #undef ARCH_CPU_ARM_FAMILY
@@ -79,6 +79,10 @@ private:
     pthread_cond_t cv_;
 };
 
+typedef pthread_once_t OnceType;
+#define LEVELDB_ONCE_INIT PTHREAD_ONCE_INIT
+extern void InitOnce(OnceType* once, void (*initializer)());
+
 #ifndef ARMV6_OR_7
 // On ARM chipsets <V6, 0xffff0fa0 is the hard coded address of a
 // memory barrier function provided by the kernel.
@@ -126,6 +130,37 @@ public:
     {
         rep_ = v;
     }
+    inline void* Exchange(void* v)
+    {
+        void* old_value;
+        do
+        {
+            old_value = rep_;
+        }
+        while (!__sync_bool_compare_and_swap(&rep_, old_value, v));
+        return old_value;
+    }
+    inline bool CompareAndSwap(void* old_value, void* new_value)
+    {
+        return __sync_bool_compare_and_swap(&rep_, old_value, new_value);
+    }
+};
+
+class AtomicUint64
+{
+private:
+    std::atomic<uint64_t> rep_;
+public:
+    AtomicUint64() { }
+    explicit AtomicUint64(uint64_t v) : rep_(v) { }
+    inline uint64_t Acquire_Load() const
+    {
+        return rep_.load(std::memory_order_acquire);
+    }
+    inline void Release_Store(uint64_t v)
+    {
+        rep_.store(v, std::memory_order_release);
+    }
 };
 
 // TODO(gabor): Implement compress
@@ -153,6 +188,33 @@ inline bool Snappy_Uncompress(
     return false;
 }
 
+inline bool Zstd_Compress(
+    const char* input,
+    size_t input_length,
+    const char* dict,
+    size_t dict_length,
+    int level,
+    std::string* output)
+{
+    return false;
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result)
+{
+    return false;
+}
+
+inline bool Zstd_Uncompress(
+    const char* input_data,
+    size_t input_length,
+    const char* dict,
+    size_t dict_length,
+    char* output)
+{
+    return false;
+}
+
 inline uint64_t ThreadIdentifier()
 {
     pthread_t tid = pthread_self();
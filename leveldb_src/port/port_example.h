@@ -64,6 +64,16 @@ public:
     void SignallAll();
 };
 
+// Thread-safe initialization.
+// Used as follows:
+//      static port::OnceType init_control = LEVELDB_ONCE_INIT;
+//      static void Initializer() { ... do something ...; }
+//      ...
+//      port::InitOnce(&init_control, &Initializer);
+typedef intptr_t OnceType;
+#define LEVELDB_ONCE_INIT 0
+extern void InitOnce(OnceType* once, void (*initializer)());
+
 // A type that holds a pointer that can be read or written atomically
 // (i.e., without word-tearing.)
 class AtomicPointer
@@ -92,6 +102,46 @@ public:
 
     // Set va as the stored pointer with no ordering guarantees.
     void NoBarrier_Store(void* v);
+
+    // Store v and return the previous pointer, as one atomic step.
+    // Acts as a full memory barrier.
+    void* Exchange(void* v);
+
+    // If the stored pointer equals old_value, replace it with new_value and
+    // return true.  Otherwise leave it alone and return false.  Acts as a
+    // full memory barrier.
+    bool CompareAndSwap(void* old_value, void* new_value);
+};
+
+// A 64-bit value that can be read or written atomically, even on
+// platforms where a plain 64-bit access takes two instructions.
+class AtomicUint64
+{
+public:
+    AtomicUint64();
+    explicit AtomicUint64(uint64_t v);
+
+    // Same ordering guarantees as AtomicPointer::Acquire_Load().
+    uint64_t Acquire_Load() const;
+
+    // Same ordering guarantees as AtomicPointer::Release_Store().
+    void Release_Store(uint64_t v);
+};
+
+// A 32-bit counter that threads may decrement without a lock.
+class AtomicInt32
+{
+public:
+    AtomicInt32();
+    explicit AtomicInt32(int32_t v);
+
+    // Read and write the value without any ordering guarantees.
+    int32_t NoBarrier_Load() const;
+    void NoBarrier_Store(int32_t v);
+
+    // Subtract one and return the new value, as one atomic step.  Acts
+    // as a full memory barrier.
+    int32_t Decrement();
 };
 
 // ------------------ Compression -------------------
@@ -117,6 +167,31 @@ extern bool Snappy_GetUncompressedLength(const char* input, size_t length,
 extern bool Snappy_Uncompress(const char* input_data, size_t input_length,
                               char* output);
 
+// Store the zstd compression of "input[0,input_length-1]" at compression
+// "level" in *output.  If "dict_length" is not zero, dict[0,dict_length-1]
+// is used as a dictionary that the output may refer to.  Returns false if
+// zstd is not supported by this port.
+extern bool Zstd_Compress(const char* input, size_t input_length,
+                          const char* dict, size_t dict_length, int level,
+                          std::string* output);
+
+// If input[0,input_length-1] looks like a zstd frame that records its
+// uncompressed size, store that size in *result and return true.  Else
+// return false.
+extern bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result);
+
+// Attempt to zstd uncompress input[0,input_length-1] into *output, with
+// the dictionary it was compressed against.  Returns true if successful,
+// false if the input is invalid zstd compressed data.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Zstd_GetUncompressedLength.
+extern bool Zstd_Uncompress(const char* input_data, size_t input_length,
+                            const char* dict, size_t dict_length,
+                            char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -124,6 +199,10 @@ extern bool Snappy_Uncompress(const char* input_data, size_t input_length,
 // The concatenation of all "data[0,n-1]" fragments is the heap profile.
 extern bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg);
 
+// Returns a value that identifies the calling thread.  Distinct live
+// threads get distinct values.
+extern uint64_t ThreadIdentifier();
+
 }
 }
 
@@ -23,7 +23,11 @@
 #ifdef SNAPPY
 #include <snappy.h>
 #endif
+#ifdef ZSTD
+#include <zstd.h>
+#endif
 #include <stdint.h>
+#include <string.h>
 #include <string>
 #include "port/atomic_pointer.h"
 
@@ -84,6 +88,10 @@ private:
     Mutex* mu_;
 };
 
+typedef pthread_once_t OnceType;
+#define LEVELDB_ONCE_INIT PTHREAD_ONCE_INIT
+extern void InitOnce(OnceType* once, void (*initializer)());
+
 inline bool Snappy_Compress(const char* input, size_t length,
                             ::std::string* output)
 {
@@ -118,6 +126,81 @@ inline bool Snappy_Uncompress(const char* input, size_t length,
 #endif
 }
 
+inline bool Zstd_Compress(const char* input, size_t length,
+                          const char* dict, size_t dict_length, int level,
+                          ::std::string* output)
+{
+#ifdef ZSTD
+    ZSTD_CCtx* ctx = ZSTD_createCCtx();
+    if (ctx == NULL)
+    {
+        return false;
+    }
+    output->resize(ZSTD_compressBound(length));
+    const size_t outlen = ZSTD_compress_usingDict(ctx, &(*output)[0],
+                          output->size(), input, length,
+                          dict, dict_length, level);
+    ZSTD_freeCCtx(ctx);
+    if (ZSTD_isError(outlen))
+    {
+        return false;
+    }
+    output->resize(outlen);
+    return true;
+#endif
+
+    return false;
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result)
+{
+#ifdef ZSTD
+    const unsigned long long n = ZSTD_getFrameContentSize(input, length);
+    if (n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR ||
+            static_cast<size_t>(n) != n)
+    {
+        return false;
+    }
+    *result = static_cast<size_t>(n);
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline bool Zstd_Uncompress(const char* input, size_t length,
+                            const char* dict, size_t dict_length,
+                            char* output)
+{
+#ifdef ZSTD
+    size_t n;
+    if (!Zstd_GetUncompressedLength(input, length, &n))
+    {
+        return false;
+    }
+    ZSTD_DCtx* ctx = ZSTD_createDCtx();
+    if (ctx == NULL)
+    {
+        return false;
+    }
+    const size_t outlen = ZSTD_decompress_usingDict(ctx, output, n,
+                          input, length, dict, dict_length);
+    ZSTD_freeDCtx(ctx);
+    return outlen == n;
+#else
+    return false;
+#endif
+}
+
+inline uint64_t ThreadIdentifier()
+{
+    pthread_t tid = pthread_self();
+    uint64_t r = 0;
+    memcpy(&r, &tid, sizeof(r) < sizeof(tid) ? sizeof(r) : sizeof(tid));
+    return r;
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg)
 {
     return false;
@@ -9,7 +9,9 @@
 #include <vector>
 #include <algorithm>
 #include "leveldb/comparator.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 #include "util/logging.h"
 
 namespace leveldb
@@ -18,32 +20,56 @@ namespace leveldb
 inline uint32_t Block::NumRestarts() const
 {
     assert(size_ >= 2*sizeof(uint32_t));
-    return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+    return DecodeFixed32(data_ + size_ - sizeof(uint32_t)) & ~kHashIndexFlag;
 }
 
-Block::Block(const char* data, size_t size)
-    : data_(data),
-      size_(size)
+Block::Block(const BlockContents& contents)
+    : data_(contents.data.data()),
+      size_(contents.data.size()),
+      owned_(contents.heap_allocated),
+      hash_buckets_(NULL),
+      num_hash_buckets_(0)
 {
     if (size_ < sizeof(uint32_t))
     {
         size_ = 0;  // Error marker
+        return;
     }
-    else
+
+    const uint32_t last_word = DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+    const uint64_t num_restarts = last_word & ~kHashIndexFlag;
+    uint64_t trailer_size = (1 + num_restarts) * sizeof(uint32_t);
+    if ((last_word & kHashIndexFlag) != 0)
     {
-        restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
-        if (restart_offset_ > size_ - sizeof(uint32_t))
+        // The buckets and their count sit between the restart array and
+        // num_restarts
+        if (size_ < 2*sizeof(uint32_t))
         {
-            // The size is too small for NumRestarts() and therefore
-            // restart_offset_ wrapped around.
             size_ = 0;
+            return;
         }
+        num_hash_buckets_ = DecodeFixed32(data_ + size_ - 2*sizeof(uint32_t));
+        trailer_size += sizeof(uint32_t) + num_hash_buckets_;
+    }
+    if (trailer_size > size_)
+    {
+        // The size is too small for the trailer it claims to have
+        size_ = 0;
+        return;
+    }
+    restart_offset_ = static_cast<uint32_t>(size_ - trailer_size);
+    if (num_hash_buckets_ > 0)
+    {
+        hash_buckets_ = data_ + size_ - 2*sizeof(uint32_t) - num_hash_buckets_;
     }
 }
 
 Block::~Block()
 {
-    delete[] data_;
+    if (owned_)
+    {
+        delete[] data_;
+    }
 }
 
 // Helper routine: decode the next block entry starting at "p",
@@ -239,6 +265,17 @@ public:
         }
     }
 
+    // Like Seek(), but starts the linear search at restart point "index"
+    // instead of binary searching for where to start.
+    void SeekFromRestartPoint(uint32_t index, const Slice& target)
+    {
+        SeekToRestartPoint(index);
+        while (ParseNextKey() && Compare(key_, target) < 0)
+        {
+            // Keep skipping
+        }
+    }
+
     virtual void SeekToFirst()
     {
         SeekToRestartPoint(0);
@@ -317,4 +354,63 @@ Iterator* Block::NewIterator(const Comparator* cmp)
     }
 }
 
+Status Block::Get(const Comparator* cmp, const Slice& target,
+                  void* arg,
+                  void (*saver)(void*, const Slice&, const Slice&))
+{
+    if (size_ < 2*sizeof(uint32_t))
+    {
+        return Status::Corruption("bad block contents");
+    }
+    const uint32_t num_restarts = NumRestarts();
+    if (num_restarts == 0)
+    {
+        return Status::OK();
+    }
+
+    Iter iter(cmp, data_, restart_offset_, num_restarts);
+    iter.Seek(target);
+    if (iter.Valid())
+    {
+        (*saver)(arg, iter.key(), iter.value());
+    }
+    return iter.status();
+}
+
+Status Block::PointLookup(const Comparator* cmp, const Slice& target,
+                          void* arg,
+                          void (*saver)(void*, const Slice&, const Slice&))
+{
+    if (hash_buckets_ == NULL || target.size() < kHashIndexKeySuffix)
+    {
+        return Get(cmp, target, arg, saver);
+    }
+
+    const uint32_t hash = Hash(target.data(),
+                               target.size() - kHashIndexKeySuffix,
+                               kHashIndexSeed);
+    const uint8_t bucket =
+        static_cast<uint8_t>(hash_buckets_[hash % num_hash_buckets_]);
+    if (bucket == kHashIndexNoEntry)
+    {
+        // No entry of this block has the key
+        return Status::OK();
+    }
+    const uint32_t num_restarts = NumRestarts();
+    if (bucket == kHashIndexCollision || bucket >= num_restarts)
+    {
+        return Get(cmp, target, arg, saver);
+    }
+
+    // The entries with the key are all in the interval, so the first key
+    // >= target is there or is the first key of the next interval.
+    Iter iter(cmp, data_, restart_offset_, num_restarts);
+    iter.SeekFromRestartPoint(bucket, target);
+    if (iter.Valid())
+    {
+        (*saver)(arg, iter.key(), iter.value());
+    }
+    return iter.status();
+}
+
 }
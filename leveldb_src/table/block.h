@@ -12,14 +12,16 @@
 namespace leveldb
 {
 
+struct BlockContents;
 class Comparator;
 
 class Block
 {
 public:
-    // Initialize the block with the specified contents.
-    // Takes ownership of data[] and will delete[] it when done.
-    Block(const char* data, size_t size);
+    // Initialize the block with the specified contents.  Takes ownership
+    // of contents.data and will delete[] it when done if it is heap
+    // allocated; otherwise the memory must outlive the block.
+    explicit Block(const BlockContents& contents);
 
     ~Block();
 
@@ -29,12 +31,31 @@ public:
     }
     Iterator* NewIterator(const Comparator* comparator);
 
+    // Find the first entry whose key is >= "target" and, if there is
+    // one, call (*saver)(arg, key, value) on it.  Unlike NewIterator(),
+    // this does not heap-allocate an iterator.  The slices passed to
+    // "saver" are only valid for the duration of the call.
+    Status Get(const Comparator* comparator, const Slice& target,
+               void* arg,
+               void (*saver)(void*, const Slice& k, const Slice& v));
+
+    // Like Get(), for a lookup of the entries whose keys match "target"
+    // up to the last kHashIndexKeySuffix bytes (see format.h).  Blocks
+    // with a hash index go straight to the restart interval that holds
+    // those entries, and do not call "saver" at all when there are none.
+    Status PointLookup(const Comparator* comparator, const Slice& target,
+                       void* arg,
+                       void (*saver)(void*, const Slice& k, const Slice& v));
+
 private:
     uint32_t NumRestarts() const;
 
     const char* data_;
     size_t size_;
     uint32_t restart_offset_;	  // Offset in data_ of restart array
+    bool owned_;                  // Block owns data_[]
+    const char* hash_buckets_;    // NULL if the block has no hash index
+    uint32_t num_hash_buckets_;
 
     // No copying allowed
     Block(const Block&);
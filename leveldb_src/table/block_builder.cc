@@ -25,6 +25,17 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// Blocks built with a hash index instead end in:
+//     restarts: uint32[num_restarts]
+//     buckets: uint8[num_buckets]
+//     num_buckets: uint32
+//     num_restarts | kHashIndexFlag: uint32
+// Keys hash (see format.h) to a bucket that holds the index of the restart
+// interval with the entries for that key, kHashIndexNoEntry if there are
+// none, or kHashIndexCollision if the entries of different keys, or of
+// one key spread over two intervals, hash to the bucket.  Blocks with more
+// than kHashIndexMaxRestarts restart points do not get a hash index.
 
 #include "table/block_builder.h"
 
@@ -32,16 +43,20 @@
 #include <assert.h>
 #include "leveldb/comparator.h"
 #include "leveldb/table_builder.h"
+#include "table/format.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace leveldb
 {
 
-BlockBuilder::BlockBuilder(const Options* options)
+BlockBuilder::BlockBuilder(const Options* options, bool hash_index)
     : options_(options),
       restarts_(),
       counter_(0),
-      finished_(false)
+      finished_(false),
+      hash_index_(hash_index),
+      hashable_(true)
 {
     assert(options->block_restart_interval >= 1);
     restarts_.push_back(0);       // First restart point is at offset 0
@@ -55,12 +70,27 @@ void BlockBuilder::Reset()
     counter_ = 0;
     finished_ = false;
     last_key_.clear();
+    hashable_ = true;
+    key_hashes_.clear();
+    key_restarts_.clear();
+}
+
+// Buckets per key of the hash index
+static uint32_t NumHashBuckets(size_t num_keys)
+{
+    return static_cast<uint32_t>(num_keys + num_keys / 3 + 1);
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const
 {
+    size_t hash_index_size = 0;
+    if (hash_index_)
+    {
+        hash_index_size = NumHashBuckets(key_hashes_.size()) + sizeof(uint32_t);
+    }
     return (buffer_.size() +                        // Raw data buffer
             restarts_.size() * sizeof(uint32_t) +   // Restart array
+            hash_index_size +                       // Hash index
             sizeof(uint32_t));                      // Restart array length
 }
 
@@ -71,11 +101,39 @@ Slice BlockBuilder::Finish()
     {
         PutFixed32(&buffer_, restarts_[i]);
     }
-    PutFixed32(&buffer_, restarts_.size());
+    uint32_t num_restarts = restarts_.size();
+    if (hash_index_ && hashable_ && !key_hashes_.empty() &&
+            num_restarts <= kHashIndexMaxRestarts)
+    {
+        AppendHashIndex();
+        num_restarts |= kHashIndexFlag;
+    }
+    PutFixed32(&buffer_, num_restarts);
     finished_ = true;
     return Slice(buffer_);
 }
 
+void BlockBuilder::AppendHashIndex()
+{
+    const uint32_t num_buckets = NumHashBuckets(key_hashes_.size());
+    std::string buckets(num_buckets, static_cast<char>(kHashIndexNoEntry));
+    for (size_t i = 0; i < key_hashes_.size(); i++)
+    {
+        char* bucket = &buckets[key_hashes_[i] % num_buckets];
+        const uint8_t restart = key_restarts_[i];
+        if (static_cast<uint8_t>(*bucket) == kHashIndexNoEntry)
+        {
+            *bucket = static_cast<char>(restart);
+        }
+        else if (static_cast<uint8_t>(*bucket) != restart)
+        {
+            *bucket = static_cast<char>(kHashIndexCollision);
+        }
+    }
+    buffer_.append(buckets);
+    PutFixed32(&buffer_, num_buckets);
+}
+
 void BlockBuilder::Add(const Slice& key, const Slice& value)
 {
     Slice last_key_piece(last_key_);
@@ -110,6 +168,22 @@ void BlockBuilder::Add(const Slice& key, const Slice& value)
     buffer_.append(key.data() + shared, non_shared);
     buffer_.append(value.data(), value.size());
 
+    if (hash_index_ && hashable_)
+    {
+        if (key.size() >= kHashIndexKeySuffix &&
+                restarts_.size() <= kHashIndexMaxRestarts)
+        {
+            key_hashes_.push_back(Hash(key.data(),
+                                       key.size() - kHashIndexKeySuffix,
+                                       kHashIndexSeed));
+            key_restarts_.push_back(static_cast<uint8_t>(restarts_.size() - 1));
+        }
+        else
+        {
+            hashable_ = false;
+        }
+    }
+
     // Update state
     last_key_.resize(shared);
     last_key_.append(key.data() + shared, non_shared);
@@ -18,7 +18,9 @@ struct Options;
 class BlockBuilder
 {
 public:
-    explicit BlockBuilder(const Options* options);
+    // If "hash_index" is true, Finish() appends a hash index over the
+    // keys (see block_builder.cc) whenever the block allows one.
+    explicit BlockBuilder(const Options* options, bool hash_index = false);
 
     // Reset the contents as if the BlockBuilder was just constructed.
     void Reset();
@@ -50,6 +52,14 @@ private:
     bool                  finished_;    // Has Finish() been called?
     std::string           last_key_;
 
+    // Hash index state: hash and restart interval of each key
+    bool                  hash_index_;
+    bool                  hashable_;    // All keys so far can be hashed
+    std::vector<uint32_t> key_hashes_;
+    std::vector<uint8_t>  key_restarts_;
+
+    void AppendHashIndex();
+
     // No copying allowed
     BlockBuilder(const BlockBuilder&);
     void operator=(const BlockBuilder&);
@@ -4,6 +4,7 @@
 
 #include "table/format.h"
 
+#include "leveldb/compressor.h"
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
@@ -77,9 +78,12 @@ Status Footer::DecodeFrom(Slice* input)
 Status ReadBlock(RandomAccessFile* file,
                  const ReadOptions& options,
                  const BlockHandle& handle,
-                 Block** block)
+                 BlockContents* result,
+                 const Slice& dictionary)
 {
-    *block = NULL;
+    result->data = Slice();
+    result->cachable = false;
+    result->heap_allocated = false;
 
     // Read the block contents as well as the type/crc footer.
     // See table_builder.cc for the code that built this structure.
@@ -118,38 +122,67 @@ Status ReadBlock(RandomAccessFile* file,
         if (data != buf)
         {
             // File implementation gave us pointer to some other data.
-            // Copy into buf[].
-            memcpy(buf, data, n + kBlockTrailerSize);
+            if (file->StableReads())
+            {
+                // Use it directly for as long as the file is open.  It
+                // is in memory already, so there is no point in caching it.
+                delete[] buf;
+                result->data = Slice(data, n);
+                result->heap_allocated = false;
+                result->cachable = false;
+            }
+            else
+            {
+                // Copy into buf[].
+                memcpy(buf, data, n + kBlockTrailerSize);
+                result->data = Slice(buf, n);
+                result->heap_allocated = true;
+                result->cachable = true;
+            }
+        }
+        else
+        {
+            result->data = Slice(buf, n);
+            result->heap_allocated = true;
+            result->cachable = true;
         }
 
         // Ok
         break;
-    case kSnappyCompression:
+    default:
     {
+        const Compressor* compressor =
+            GetCompressor(static_cast<CompressionType>(
+                              static_cast<unsigned char>(data[n])));
+        if (compressor == NULL)
+        {
+            delete[] buf;
+            return Status::Corruption("bad block type");
+        }
         size_t ulength = 0;
-        if (!port::Snappy_GetUncompressedLength(data, n, &ulength))
+        if (!compressor->GetUncompressedLength(data, n, &ulength))
         {
             delete[] buf;
             return Status::Corruption("corrupted compressed block contents");
         }
         char* ubuf = new char[ulength];
-        if (!port::Snappy_Uncompress(data, n, ubuf))
+        if (dictionary.empty()
+                ? !compressor->Uncompress(data, n, ubuf)
+                : !compressor->UncompressWithDictionary(data, n, dictionary,
+                                                        ubuf))
         {
             delete[] buf;
             delete[] ubuf;
             return Status::Corruption("corrupted compressed block contents");
         }
         delete[] buf;
-        buf = ubuf;
-        n = ulength;
+        result->data = Slice(ubuf, ulength);
+        result->heap_allocated = true;
+        result->cachable = true;
         break;
     }
-    default:
-        delete[] buf;
-        return Status::Corruption("bad block type");
     }
 
-    *block = new Block(buf, n);  // Block takes ownership of buf[]
     return Status::OK();
 }
 
@@ -14,7 +14,6 @@
 namespace leveldb
 {
 
-class Block;
 class RandomAccessFile;
 struct ReadOptions;
 
@@ -107,13 +106,55 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
-// Read the block identified by "handle" from "file".  On success,
-// store a pointer to the heap-allocated result in *block and return
-// OK.  On failure store NULL in *block and return non-OK.
+// Data blocks may end in a hash index that maps keys to the restart
+// interval holding them (see block_builder.cc).  Keys are hashed without
+// their last kHashIndexKeySuffix bytes, i.e. the sequence number and type
+// that leveldb appends to user keys, so all versions of a user key share
+// a bucket.
+static const size_t kHashIndexKeySuffix = 8;
+static const uint32_t kHashIndexSeed = 0x3c6ef372;
+static const uint32_t kHashIndexFlag = 1u << 31;    // In num_restarts
+static const uint8_t kHashIndexNoEntry = 255;       // Bucket values
+static const uint8_t kHashIndexCollision = 254;
+static const uint32_t kHashIndexMaxRestarts = 254;
+
+// Metaindex key of tables whose index block is a top-level index over
+// index partitions rather than an index over the data blocks
+static const char kPartitionedIndexKey[] = "index.partitioned";
+
+// Tables written with a prefix extractor and a filter policy hold one
+// filter over the prefixes of all their keys, under the metaindex key
+// kPrefixFilterKey + extractor name + "." + policy name.  Each prefix is
+// passed to the policy followed by kPrefixFilterPadding zero bytes, so
+// that a policy that drops the sequence number and type leveldb appends
+// to user keys sees the bare prefix.  The padding is part of the filter
+// format: it is the size of that tag, whatever the hash index uses.
+static const char kPrefixFilterKey[] = "prefixfilter.";
+static const size_t kPrefixFilterPadding = 8;
+
+// Metaindex key of the uncompressed block holding the compression
+// dictionary of tables built with one.  Their data blocks are compressed
+// against it; index and meta blocks are not.
+static const char kCompressionDictionaryKey[] = "compression.dictionary";
+
+struct BlockContents
+{
+    Slice data;           // Actual contents of data
+    bool cachable;        // True iff data can be cached
+    bool heap_allocated;  // True iff caller should delete[] data.data()
+};
+
+// Read the (uncompressed) contents of the block identified by "handle"
+// from "file" into *result and return OK, or return non-OK on failure.
+// Uncompressed blocks of files with StableReads() point into the file's
+// own memory; such blocks are neither heap allocated nor worth caching.
+// A compressed block is uncompressed against "dictionary" unless it is
+// empty.
 extern Status ReadBlock(RandomAccessFile* file,
                         const ReadOptions& options,
                         const BlockHandle& handle,
-                        Block** block);
+                        BlockContents* result,
+                        const Slice& dictionary = Slice());
 
 // Implementation details follow.  Clients should ignore,
 
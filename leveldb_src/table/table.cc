@@ -5,8 +5,12 @@
 #include "leveldb/table.h"
 
 #include "leveldb/cache.h"
+#include "leveldb/comparator.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "table/block.h"
+#include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
@@ -18,6 +22,11 @@ struct Table::Rep
 {
     ~Rep()
     {
+        delete filter;
+        delete[] filter_data;
+        delete prefix_filter;
+        delete[] prefix_filter_data;
+        delete[] compression_dictionary_data;
         delete index_block;
     }
 
@@ -25,10 +34,105 @@ struct Table::Rep
     Status status;
     RandomAccessFile* file;
     uint64_t cache_id;
+    FilterBlockReader* filter;
+    const char* filter_data;
 
     BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
     Block* index_block;
+
+    // With options.cache_index_and_filter_blocks, index_block and filter
+    // are NULL and the blocks are fetched through the block cache.
+    BlockHandle index_handle;
+    BlockHandle filter_handle;
+    bool cached_filter;
+
+    // If true, the index block only indexes the index partitions, which
+    // are read like data blocks.
+    bool partitioned_index;
+
+    // Filter over the key prefixes of the whole table, held for as long
+    // as the table is open.  It is small as there is one entry per prefix.
+    FilterBlockReader* prefix_filter;
+    const char* prefix_filter_data;
+
+    // Data blocks are uncompressed against this dictionary if it is not
+    // empty (see Options::compression_dictionary_size)
+    Slice compression_dictionary;
+    const char* compression_dictionary_data;
+};
+
+namespace
+{
+// A filter block kept in the block cache, together with its contents
+struct CachedFilter
+{
+    FilterBlockReader reader;
+    const char* data;  // Deleted with the entry if heap allocated
+
+    CachedFilter(const FilterPolicy* policy, const BlockContents& contents)
+        : reader(policy, contents.data),
+          data(contents.heap_allocated ? contents.data.data() : NULL)
+    {
+    }
+    ~CachedFilter()
+    {
+        delete[] data;
+    }
 };
+}
+
+static void DeleteCachedBlock(const Slice& key, void* value)
+{
+    Block* block = reinterpret_cast<Block*>(value);
+    delete block;
+}
+
+static void DeleteCachedFilter(const Slice& key, void* value)
+{
+    delete reinterpret_cast<CachedFilter*>(value);
+}
+
+// Blocks of a table are cached under its cache id and the block offset
+static Slice BlockCacheKey(uint64_t cache_id, uint64_t offset, char* buf)
+{
+    EncodeFixed64(buf, cache_id);
+    EncodeFixed64(buf+8, offset);
+    return Slice(buf, 16);
+}
+
+namespace
+{
+// Serves reads that fall within the prefetched tail of a table file from
+// memory and passes the others on to the file itself.
+class PrefetchedTailFile : public RandomAccessFile
+{
+public:
+    PrefetchedTailFile(RandomAccessFile* file, uint64_t tail_offset,
+                       const Slice& tail)
+        : file_(file),
+          tail_offset_(tail_offset),
+          tail_(tail)
+    {
+    }
+
+    virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                        char* scratch) const
+    {
+        if (offset >= tail_offset_ &&
+                offset - tail_offset_ + n <= tail_.size())
+        {
+            *result = Slice(tail_.data() + (offset - tail_offset_), n);
+            return Status::OK();
+        }
+        return file_->Read(offset, n, result, scratch);
+    }
+
+private:
+    RandomAccessFile* file_;
+    uint64_t tail_offset_;
+    Slice tail_;
+};
+}
 
 Status Table::Open(const Options& options,
                    RandomAccessFile* file,
@@ -41,21 +145,54 @@ Status Table::Open(const Options& options,
         return Status::InvalidArgument("file is too short to be an sstable");
     }
 
-    char footer_space[Footer::kEncodedLength];
-    Slice footer_input;
-    Status s = file->Read(size - Footer::kEncodedLength, Footer::kEncodedLength,
-                          &footer_input, footer_space);
-    if (!s.ok()) return s;
+    // Read the footer together with the blocks written just before it,
+    // which are usually the index and meta blocks, in a single read.
+    // There is nothing to save for files whose reads are served from
+    // memory in place.
+    size_t tail_size = Footer::kEncodedLength;
+    if (!file->StableReads() && options.tail_prefetch_size > tail_size)
+    {
+        tail_size = options.tail_prefetch_size;
+        if (tail_size > size)
+        {
+            tail_size = static_cast<size_t>(size);
+        }
+    }
+    char* tail_space = new char[tail_size];
+    Slice tail;
+    Status s = file->Read(size - tail_size, tail_size, &tail, tail_space);
+    if (s.ok() && tail.size() != tail_size)
+    {
+        s = Status::Corruption("truncated table file read");
+    }
+    if (!s.ok())
+    {
+        delete[] tail_space;
+        return s;
+    }
 
     Footer footer;
+    Slice footer_input(tail.data() + tail_size - Footer::kEncodedLength,
+                       Footer::kEncodedLength);
     s = footer.DecodeFrom(&footer_input);
-    if (!s.ok()) return s;
+    if (!s.ok())
+    {
+        delete[] tail_space;
+        return s;
+    }
+    PrefetchedTailFile prefetched(file, size - tail_size, tail);
 
     // Read the index block
+    BlockContents contents;
     Block* index_block = NULL;
     if (s.ok())
     {
-        s = ReadBlock(file, ReadOptions(), footer.index_handle(), &index_block);
+        s = ReadBlock(&prefetched, ReadOptions(), footer.index_handle(),
+                      &contents);
+        if (s.ok())
+        {
+            index_block = new Block(contents);
+        }
     }
 
     if (s.ok())
@@ -67,17 +204,192 @@ Status Table::Open(const Options& options,
         rep->file = file;
         rep->metaindex_handle = footer.metaindex_handle();
         rep->index_block = index_block;
+        rep->index_handle = footer.index_handle();
         rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+        rep->filter_data = NULL;
+        rep->filter = NULL;
+        rep->cached_filter = false;
+        if (options.cache_index_and_filter_blocks &&
+                options.block_cache != NULL && contents.cachable)
+        {
+            // Hand the index block over to the cache
+            char cache_key_buffer[16];
+            options.block_cache->Release(options.block_cache->Insert(
+                BlockCacheKey(rep->cache_id, rep->index_handle.offset(),
+                              cache_key_buffer),
+                index_block, index_block->size(), &DeleteCachedBlock,
+                Cache::kHighPriority));
+            rep->index_block = NULL;
+        }
+        rep->partitioned_index = false;
+        rep->prefix_filter = NULL;
+        rep->prefix_filter_data = NULL;
+        rep->compression_dictionary_data = NULL;
         *table = new Table(rep);
+        s = (*table)->ReadMeta(&prefetched, footer);
+        if (!s.ok())
+        {
+            delete *table;
+            *table = NULL;
+        }
     }
     else
     {
         if (index_block) delete index_block;
     }
 
+    delete[] tail_space;
     return s;
 }
 
+Status Table::ReadMeta(RandomAccessFile* file, const Footer& footer)
+{
+    // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
+    // it is an empty block.
+    ReadOptions opt;
+    BlockContents contents;
+    Status s = ReadBlock(file, opt, footer.metaindex_handle(), &contents);
+    if (!s.ok())
+    {
+        // The filter is optional, but without the metaindex we cannot tell
+        // how to read the index.
+        return s;
+    }
+    Block* meta = new Block(contents);
+
+    Iterator* iter = meta->NewIterator(BytewiseComparator());
+    iter->Seek(kCompressionDictionaryKey);
+    if (iter->Valid() && iter->key() == Slice(kCompressionDictionaryKey))
+    {
+        // The data blocks cannot be read without it
+        s = ReadCompressionDictionary(file, iter->value());
+        if (!s.ok())
+        {
+            delete iter;
+            delete meta;
+            return s;
+        }
+    }
+    if (rep_->options.filter_policy != NULL)
+    {
+        std::string key = "filter.";
+        key.append(rep_->options.filter_policy->Name());
+        iter->Seek(key);
+        if (iter->Valid() && iter->key() == Slice(key))
+        {
+            ReadFilter(file, iter->value());
+        }
+    }
+    iter->Seek(kPartitionedIndexKey);
+    if (iter->Valid() && iter->key() == Slice(kPartitionedIndexKey))
+    {
+        rep_->partitioned_index = true;
+    }
+    if (rep_->options.filter_policy != NULL &&
+            rep_->options.prefix_extractor != NULL)
+    {
+        std::string key = kPrefixFilterKey;
+        key.append(rep_->options.prefix_extractor->Name());
+        key.append(".");
+        key.append(rep_->options.filter_policy->Name());
+        iter->Seek(key);
+        if (iter->Valid() && iter->key() == Slice(key))
+        {
+            ReadPrefixFilter(file, iter->value());
+        }
+    }
+    delete iter;
+    delete meta;
+    return Status::OK();
+}
+
+void Table::ReadFilter(RandomAccessFile* file,
+                       const Slice& filter_handle_value)
+{
+    Slice v = filter_handle_value;
+    BlockHandle filter_handle;
+    if (!filter_handle.DecodeFrom(&v).ok())
+    {
+        return;
+    }
+
+    // We might want to unify with ReadBlock() if we start
+    // requiring checksum verification in Table::Open.
+    ReadOptions opt;
+    BlockContents block;
+    if (!ReadBlock(file, opt, filter_handle, &block).ok())
+    {
+        return;
+    }
+    Cache* block_cache = rep_->options.block_cache;
+    if (rep_->options.cache_index_and_filter_blocks &&
+            block_cache != NULL && block.cachable)
+    {
+        char cache_key_buffer[16];
+        block_cache->Release(block_cache->Insert(
+            BlockCacheKey(rep_->cache_id, filter_handle.offset(),
+                          cache_key_buffer),
+            new CachedFilter(rep_->options.filter_policy, block),
+            block.data.size(), &DeleteCachedFilter, Cache::kHighPriority));
+        rep_->filter_handle = filter_handle;
+        rep_->cached_filter = true;
+        return;
+    }
+    if (block.heap_allocated)
+    {
+        rep_->filter_data = block.data.data();     // Will need to delete later
+    }
+    rep_->filter = new FilterBlockReader(rep_->options.filter_policy,
+                                         block.data);
+}
+
+void Table::ReadPrefixFilter(RandomAccessFile* file,
+                             const Slice& filter_handle_value)
+{
+    Slice v = filter_handle_value;
+    BlockHandle filter_handle;
+    if (!filter_handle.DecodeFrom(&v).ok())
+    {
+        return;
+    }
+    BlockContents block;
+    if (!ReadBlock(file, ReadOptions(), filter_handle, &block).ok())
+    {
+        return;
+    }
+    if (block.heap_allocated)
+    {
+        rep_->prefix_filter_data = block.data.data();
+    }
+    rep_->prefix_filter = new FilterBlockReader(rep_->options.filter_policy,
+                                                block.data);
+}
+
+Status Table::ReadCompressionDictionary(RandomAccessFile* file,
+                                        const Slice& handle_value)
+{
+    Slice v = handle_value;
+    BlockHandle handle;
+    Status s = handle.DecodeFrom(&v);
+    BlockContents block;
+    if (s.ok())
+    {
+        ReadOptions opt;
+        opt.verify_checksums = true;
+        s = ReadBlock(file, opt, handle, &block);
+    }
+    if (!s.ok())
+    {
+        return s;
+    }
+    if (block.heap_allocated)
+    {
+        rep_->compression_dictionary_data = block.data.data();
+    }
+    rep_->compression_dictionary = block.data;
+    return Status::OK();
+}
+
 Table::~Table()
 {
     delete rep_;
@@ -88,12 +400,6 @@ static void DeleteBlock(void* arg, void* ignored)
     delete reinterpret_cast<Block*>(arg);
 }
 
-static void DeleteCachedBlock(const Slice& key, void* value)
-{
-    Block* block = reinterpret_cast<Block*>(value);
-    delete block;
-}
-
 static void ReleaseBlock(void* arg, void* h)
 {
     Cache* cache = reinterpret_cast<Cache*>(arg);
@@ -101,6 +407,133 @@ static void ReleaseBlock(void* arg, void* h)
     cache->Release(handle);
 }
 
+// Fetch the block at "handle", going through the block cache if there is
+// one.  On return "*cache_handle" is either the pinned cache entry holding
+// "*result", or NULL if the caller owns "*result" and must delete it.
+Status Table::FetchBlock(const ReadOptions& options,
+                         const BlockHandle& handle,
+                         bool data_block,
+                         Cache::Priority priority,
+                         Block** result,
+                         Cache::Handle** cache_handle) const
+{
+    Cache* block_cache = rep_->options.block_cache;
+    Block* block = NULL;
+    *cache_handle = NULL;
+
+    const Slice dictionary =
+        data_block ? rep_->compression_dictionary : Slice();
+    Status s;
+    if (block_cache != NULL)
+    {
+        char cache_key_buffer[16];
+        Slice key = BlockCacheKey(rep_->cache_id, handle.offset(),
+                                  cache_key_buffer);
+        *cache_handle = block_cache->Lookup(key);
+        if (*cache_handle != NULL)
+        {
+            block = reinterpret_cast<Block*>(block_cache->Value(*cache_handle));
+        }
+        else
+        {
+            BlockContents contents;
+            s = ReadBlock(rep_->file, options, handle, &contents, dictionary);
+            if (s.ok())
+            {
+                block = new Block(contents);
+                if (contents.cachable && options.fill_cache)
+                {
+                    *cache_handle = block_cache->Insert(
+                                        key, block, block->size(), &DeleteCachedBlock,
+                                        priority);
+                }
+            }
+        }
+    }
+    else
+    {
+        BlockContents contents;
+        s = ReadBlock(rep_->file, options, handle, &contents, dictionary);
+        if (s.ok())
+        {
+            block = new Block(contents);
+        }
+    }
+
+    *result = block;
+    return s;
+}
+
+// Pin the index block of the table.  It is either held by the table or
+// fetched through the block cache; pass the results to UnpinBlock().
+Status Table::GetIndexBlock(const ReadOptions& options,
+                            Block** block,
+                            Cache::Handle** cache_handle) const
+{
+    if (rep_->index_block != NULL)
+    {
+        *block = rep_->index_block;
+        *cache_handle = NULL;
+        return Status::OK();
+    }
+    ReadOptions opt = options;
+    opt.fill_cache = true;
+    return FetchBlock(opt, rep_->index_handle, false, Cache::kHighPriority,
+                      block, cache_handle);
+}
+
+void Table::UnpinBlock(Block* block, Cache::Handle* cache_handle) const
+{
+    if (cache_handle != NULL)
+    {
+        rep_->options.block_cache->Release(cache_handle);
+    }
+    else if (block != rep_->index_block)
+    {
+        delete block;
+    }
+}
+
+// Return the filter of the table, or NULL if it has none or it cannot be
+// read.  If the filter is pinned in the block cache, "*cache_handle" must
+// be released by the caller.
+FilterBlockReader* Table::GetFilter(Cache::Handle** cache_handle) const
+{
+    *cache_handle = NULL;
+    if (!rep_->cached_filter)
+    {
+        return rep_->filter;
+    }
+
+    Cache* block_cache = rep_->options.block_cache;
+    char cache_key_buffer[16];
+    Slice key = BlockCacheKey(rep_->cache_id, rep_->filter_handle.offset(),
+                              cache_key_buffer);
+    *cache_handle = block_cache->Lookup(key);
+    if (*cache_handle == NULL)
+    {
+        BlockContents block;
+        if (!ReadBlock(rep_->file, ReadOptions(), rep_->filter_handle,
+                       &block).ok())
+        {
+            return NULL;
+        }
+        CachedFilter* filter =
+            new CachedFilter(rep_->options.filter_policy, block);
+        if (!block.cachable)
+        {
+            // Not worth reading on every lookup; do without the filter
+            delete filter;
+            return NULL;
+        }
+        *cache_handle = block_cache->Insert(key, filter, block.data.size(),
+                                            &DeleteCachedFilter,
+                                            Cache::kHighPriority);
+    }
+    return &reinterpret_cast<CachedFilter*>(
+               block_cache->Value(*cache_handle))->reader;
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg,
@@ -108,7 +541,26 @@ Iterator* Table::BlockReader(void* arg,
                              const Slice& index_value)
 {
     Table* table = reinterpret_cast<Table*>(arg);
-    Cache* block_cache = table->rep_->options.block_cache;
+    return table->BlockIterator(options, index_value, true,
+                                Cache::kLowPriority);
+}
+
+// Like BlockReader(), but for the partitions of a partitioned index
+Iterator* Table::IndexPartitionReader(void* arg,
+                                      const ReadOptions& options,
+                                      const Slice& index_value)
+{
+    Table* table = reinterpret_cast<Table*>(arg);
+    return table->BlockIterator(options, index_value, false,
+                                Cache::kHighPriority);
+}
+
+Iterator* Table::BlockIterator(const ReadOptions& options,
+                               const Slice& index_value,
+                               bool data_block,
+                               Cache::Priority priority) const
+{
+    Cache* block_cache = rep_->options.block_cache;
     Block* block = NULL;
     Cache::Handle* cache_handle = NULL;
 
@@ -120,37 +572,14 @@ Iterator* Table::BlockReader(void* arg,
 
     if (s.ok())
     {
-        if (block_cache != NULL)
-        {
-            char cache_key_buffer[16];
-            EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-            EncodeFixed64(cache_key_buffer+8, handle.offset());
-            Slice key(cache_key_buffer, sizeof(cache_key_buffer));
-            cache_handle = block_cache->Lookup(key);
-            if (cache_handle != NULL)
-            {
-                block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
-            }
-            else
-            {
-                s = ReadBlock(table->rep_->file, options, handle, &block);
-                if (s.ok() && options.fill_cache)
-                {
-                    cache_handle = block_cache->Insert(
-                                       key, block, block->size(), &DeleteCachedBlock);
-                }
-            }
-        }
-        else
-        {
-            s = ReadBlock(table->rep_->file, options, handle, &block);
-        }
+        s = FetchBlock(options, handle, data_block, priority,
+                       &block, &cache_handle);
     }
 
     Iterator* iter;
     if (block != NULL)
     {
-        iter = block->NewIterator(table->rep_->options.comparator);
+        iter = block->NewIterator(rep_->options.comparator);
         if (cache_handle == NULL)
         {
             iter->RegisterCleanup(&DeleteBlock, block, NULL);
@@ -167,17 +596,308 @@ Iterator* Table::BlockReader(void* arg,
     return iter;
 }
 
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const
+{
+    Block* index_block;
+    Cache::Handle* cache_handle;
+    Status s = GetIndexBlock(options, &index_block, &cache_handle);
+    if (!s.ok())
+    {
+        return NewErrorIterator(s);
+    }
+    Iterator* iter = index_block->NewIterator(rep_->options.comparator);
+    if (index_block != rep_->index_block)
+    {
+        if (cache_handle == NULL)
+        {
+            iter->RegisterCleanup(&DeleteBlock, index_block, NULL);
+        }
+        else
+        {
+            iter->RegisterCleanup(&ReleaseBlock, rep_->options.block_cache,
+                                  cache_handle);
+        }
+    }
+    if (rep_->partitioned_index)
+    {
+        iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                                   const_cast<Table*>(this), options);
+    }
+    return iter;
+}
+
+namespace
+{
+// Table iterator for ReadOptions::prefix_same_as_start.  A Seek() to a key
+// whose prefix the table does not hold leaves it invalid without reading
+// any data block.
+class PrefixFilterIterator : public Iterator
+{
+public:
+    PrefixFilterIterator(Iterator* iter, const Table* table)
+        : iter_(iter),
+          table_(table),
+          filtered_(false)
+    {
+    }
+    virtual ~PrefixFilterIterator()
+    {
+        delete iter_;
+    }
+    virtual bool Valid() const
+    {
+        return !filtered_ && iter_->Valid();
+    }
+    virtual void Seek(const Slice& target)
+    {
+        filtered_ = !table_->PrefixMayMatch(target);
+        if (!filtered_)
+        {
+            iter_->Seek(target);
+        }
+    }
+    virtual void SeekToFirst()
+    {
+        filtered_ = false;
+        iter_->SeekToFirst();
+    }
+    virtual void SeekToLast()
+    {
+        filtered_ = false;
+        iter_->SeekToLast();
+    }
+    virtual void Next()
+    {
+        assert(Valid());
+        iter_->Next();
+    }
+    virtual void Prev()
+    {
+        assert(Valid());
+        iter_->Prev();
+    }
+    virtual Slice key() const
+    {
+        assert(Valid());
+        return iter_->key();
+    }
+    virtual Slice value() const
+    {
+        assert(Valid());
+        return iter_->value();
+    }
+    virtual Status status() const
+    {
+        return filtered_ ? Status::OK() : iter_->status();
+    }
+
+private:
+    Iterator* iter_;
+    const Table* table_;
+    bool filtered_;
+};
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const
 {
-    return NewTwoLevelIterator(
-               rep_->index_block->NewIterator(rep_->options.comparator),
-               &Table::BlockReader, const_cast<Table*>(this), options);
+    Iterator* iter = NewTwoLevelIterator(
+                         NewIndexIterator(options),
+                         &Table::BlockReader, const_cast<Table*>(this), options);
+    if (options.prefix_same_as_start && rep_->prefix_filter != NULL)
+    {
+        iter = new PrefixFilterIterator(iter, this);
+    }
+    return iter;
+}
+
+bool Table::PrefixMayMatch(const Slice& key) const
+{
+    const SliceTransform* extractor = rep_->options.prefix_extractor;
+    if (rep_->prefix_filter == NULL || !extractor->InDomain(key))
+    {
+        return true;
+    }
+    std::string padded;
+    Slice prefix = extractor->Transform(key);
+    padded.reserve(prefix.size() + kPrefixFilterPadding);
+    padded.assign(prefix.data(), prefix.size());
+    padded.append(kPrefixFilterPadding, '\0');
+    return rep_->prefix_filter->KeyMayMatch(0, padded);
+}
+
+namespace
+{
+// Index block entry located by Table::InternalGet()
+struct IndexEntry
+{
+    bool found;
+    Status status;
+    BlockHandle handle;
+};
+}
+static void SaveIndexEntry(void* arg, const Slice& k, const Slice& v)
+{
+    IndexEntry* e = reinterpret_cast<IndexEntry*>(arg);
+    Slice input = v;
+    e->found = true;
+    e->status = e->handle.DecodeFrom(&input);
+}
+
+Status Table::InternalGet(const ReadOptions& options, const Slice& k,
+                          void* arg,
+                          void (*saver)(void*, const Slice&, const Slice&))
+{
+    Block* index_block;
+    Cache::Handle* index_handle;
+    Status s = GetIndexBlock(options, &index_block, &index_handle);
+    if (!s.ok())
+    {
+        return s;
+    }
+    IndexEntry entry;
+    entry.found = false;
+    s = index_block->Get(rep_->options.comparator, k,
+                         &entry, &SaveIndexEntry);
+    UnpinBlock(index_block, index_handle);
+    if (s.ok() && entry.found && entry.status.ok() && rep_->partitioned_index)
+    {
+        // entry.handle is the index partition that covers k
+        Block* partition = NULL;
+        Cache::Handle* partition_handle = NULL;
+        s = FetchBlock(options, entry.handle, false, Cache::kHighPriority,
+                       &partition, &partition_handle);
+        if (partition != NULL)
+        {
+            entry.found = false;
+            s = partition->Get(rep_->options.comparator, k,
+                               &entry, &SaveIndexEntry);
+            UnpinBlock(partition, partition_handle);
+        }
+    }
+    if (!s.ok() || !entry.found)
+    {
+        // "k" is past the last key in the table
+        return s;
+    }
+    if (!entry.status.ok())
+    {
+        return entry.status;
+    }
+
+    Cache::Handle* filter_handle;
+    FilterBlockReader* filter = GetFilter(&filter_handle);
+    const bool may_match =
+        (filter == NULL || filter->KeyMayMatch(entry.handle.offset(), k));
+    if (filter_handle != NULL)
+    {
+        rep_->options.block_cache->Release(filter_handle);
+    }
+    if (!may_match)
+    {
+        // Not found
+        return s;
+    }
+
+    Block* block = NULL;
+    Cache::Handle* cache_handle = NULL;
+    s = FetchBlock(options, entry.handle, true, Cache::kLowPriority,
+                   &block, &cache_handle);
+    if (block != NULL)
+    {
+        s = block->PointLookup(rep_->options.comparator, k, arg, saver);
+        UnpinBlock(block, cache_handle);
+    }
+    return s;
+}
+
+Status Table::InternalMultiGet(
+    const ReadOptions& options, int n, const Slice* keys,
+    void* const* args,
+    void (*saver)(void*, const Slice&, const Slice&),
+    Status* statuses)
+{
+    const Comparator* cmp = rep_->options.comparator;
+    Cache::Handle* filter_handle;
+    FilterBlockReader* filter = GetFilter(&filter_handle);
+    Iterator* index_iter = NewIndexIterator(options);
+    bool seeked = false;
+    BlockHandle handle;
+    Status handle_status;
+    Block* block = NULL;
+    Cache::Handle* cache_handle = NULL;
+    uint64_t block_offset = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        const Slice& k = keys[i];
+        // The index entry found for the previous key also covers k as long
+        // as k is not past that entry's key.
+        if (!seeked ||
+                (index_iter->Valid() && cmp->Compare(k, index_iter->key()) > 0))
+        {
+            index_iter->Seek(k);
+            seeked = true;
+            if (index_iter->Valid())
+            {
+                Slice input = index_iter->value();
+                handle_status = handle.DecodeFrom(&input);
+            }
+        }
+        if (!index_iter->Valid())
+        {
+            // k, and every key after it, is past the last key in the table
+            statuses[i] = index_iter->status();
+            continue;
+        }
+        if (!handle_status.ok())
+        {
+            statuses[i] = handle_status;
+            continue;
+        }
+
+        statuses[i] = Status::OK();
+        if (filter != NULL && !filter->KeyMayMatch(handle.offset(), k))
+        {
+            // Not found
+            continue;
+        }
+
+        if (block == NULL || block_offset != handle.offset())
+        {
+            if (block != NULL)
+            {
+                UnpinBlock(block, cache_handle);
+                block = NULL;
+                cache_handle = NULL;
+            }
+            statuses[i] = FetchBlock(options, handle, true,
+                                     Cache::kLowPriority,
+                                     &block, &cache_handle);
+            if (block == NULL)
+            {
+                continue;
+            }
+            block_offset = handle.offset();
+        }
+        statuses[i] = block->PointLookup(cmp, k, args[i], saver);
+    }
+
+    if (block != NULL)
+    {
+        UnpinBlock(block, cache_handle);
+    }
+    if (filter_handle != NULL)
+    {
+        rep_->options.block_cache->Release(filter_handle);
+    }
+    Status s = index_iter->status();
+    delete index_iter;
+    return s;
 }
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const
 {
-    Iterator* index_iter =
-        rep_->index_block->NewIterator(rep_->options.comparator);
+    Iterator* index_iter = NewIndexIterator(ReadOptions());
     index_iter->Seek(key);
     uint64_t result;
     if (index_iter->Valid())
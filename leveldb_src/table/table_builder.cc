@@ -6,17 +6,199 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <deque>
+#include <map>
+#include <vector>
 #include "leveldb/comparator.h"
+#include "leveldb/compressor.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "table/block_builder.h"
+#include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
+#include "util/compression_dict.h"
 #include "util/crc32c.h"
 #include "util/logging.h"
+#include "util/mutexlock.h"
+#include "util/worker_pool.h"
 
 namespace leveldb
 {
 
+// Compress "raw" with the compressor for "type" into *compressed, against
+// "dictionary" unless it is empty.  Returns the type of the contents to
+// store, which is kNoCompression if "raw" should be stored as it is.
+static CompressionType CompressBlock(CompressionType type, const Slice& raw,
+                                     const Slice& dictionary,
+                                     std::string* compressed)
+{
+    const Compressor* compressor = GetCompressor(type);
+    if (compressor != NULL &&
+            (dictionary.empty()
+             ? compressor->Compress(raw.data(), raw.size(), compressed)
+             : compressor->CompressWithDictionary(raw.data(), raw.size(),
+                                                  dictionary, compressed)) &&
+            compressed->size() < raw.size() - (raw.size() / 8u))
+    {
+        return type;
+    }
+
+    // No compression, compressor not available, or compressed less
+    // than 12.5%, so just store uncompressed form
+    return kNoCompression;
+}
+
+namespace
+{
+// A data block handed to the compression threads or held back to build
+// the compression dictionary.  Everything that depends on where the block
+// lands in the file waits until it is written: its index entry and the
+// keys for the filter block.
+struct PendingBlock
+{
+    std::string raw;
+    std::string compressed;
+    Slice dictionary;           // To compress against, if not empty
+    CompressionType type;       // Set to the type to store once done
+    bool done;                  // Protected by CompressionWorkers::mu_
+    std::string index_key;
+    bool has_index_key;
+    std::string filter_keys;    // Filter keys of the block, concatenated
+    std::vector<size_t> filter_key_starts;
+
+    PendingBlock() : done(false), has_index_key(false) { }
+};
+
+// Compression threads are shared by all the tables built through the same
+// Env and live until the process exits, so that building many tables does
+// not start threads for each of them.
+static port::OnceType pools_once = LEVELDB_ONCE_INIT;
+static port::Mutex* pools_mu;
+static std::map<Env*, WorkerPool*>* pools;
+
+static void InitPools()
+{
+    pools_mu = new port::Mutex;
+    pools = new std::map<Env*, WorkerPool*>;
+}
+
+// Return the compression threads of "env", with room for at least
+// "threads" of them.
+static WorkerPool* CompressionPool(Env* env, int threads)
+{
+    port::InitOnce(&pools_once, InitPools);
+    MutexLock l(pools_mu);
+    WorkerPool*& pool = (*pools)[env];
+    if (pool == NULL)
+    {
+        pool = new WorkerPool(env, threads);
+    }
+    else
+    {
+        pool->SetMaxThreads(threads);
+    }
+    return pool;
+}
+
+// Hands the data blocks of one table to the compression threads
+class CompressionWorkers
+{
+public:
+    CompressionWorkers(Env* env, int threads)
+        : pool_(CompressionPool(env, threads)),
+          done_cv_(&mu_),
+          shutting_down_(false),
+          scheduled_(0)
+    {
+    }
+
+    // Waits for the work handed to the threads to return.  Blocks that
+    // were not compressed yet are left alone.
+    ~CompressionWorkers()
+    {
+        MutexLock l(&mu_);
+        shutting_down_ = true;
+        while (scheduled_ > 0)
+        {
+            done_cv_.Wait();
+        }
+    }
+
+    void Schedule(PendingBlock* block)
+    {
+        {
+            MutexLock l(&mu_);
+            queue_.push_back(block);
+            scheduled_++;
+        }
+        pool_->Schedule(&CompressionWorkers::Run, this);
+    }
+
+    // Return true if "block" has been compressed.  If "wait" is true,
+    // wait for that first.
+    bool Done(PendingBlock* block, bool wait)
+    {
+        MutexLock l(&mu_);
+        while (wait && !block->done)
+        {
+            done_cv_.Wait();
+        }
+        return block->done;
+    }
+
+private:
+    WorkerPool* const pool_;
+    port::Mutex mu_;
+    port::CondVar done_cv_;   // Signalled when a block or work item is done
+    std::deque<PendingBlock*> queue_;   // Blocks not taken by a thread yet
+    bool shutting_down_;
+    int scheduled_;           // Work items handed to pool_ and not done
+
+    static void Run(void* arg)
+    {
+        reinterpret_cast<CompressionWorkers*>(arg)->Work();
+    }
+
+    // Compress the oldest block not taken yet.  Each call of Schedule()
+    // hands one call of this to the threads.
+    void Work()
+    {
+        MutexLock l(&mu_);
+        if (!shutting_down_)
+        {
+            assert(!queue_.empty());
+            PendingBlock* block = queue_.front();
+            queue_.pop_front();
+            mu_.Unlock();
+            block->type = CompressBlock(block->type, block->raw,
+                                        block->dictionary, &block->compressed);
+            mu_.Lock();
+            block->done = true;
+        }
+        scheduled_--;
+        done_cv_.SignalAll();
+    }
+};
+
+// Number of data blocks per compression thread that may wait to be
+// written before the thread adding entries waits for them
+static const size_t kPendingBlocksPerThread = 4;
+
+// The data blocks sampled for a compression dictionary add up to this
+// many times its size
+static const size_t kDictionarySampleRatio = 16;
+
+// Return true if tables built with "options" get a compression dictionary
+static bool UseDictionary(const Options& options)
+{
+    const Compressor* compressor = GetCompressor(options.compression);
+    return options.compression_dictionary_size > 0 &&
+           compressor != NULL && compressor->SupportsDictionary();
+}
+}
+
 struct TableBuilder::Rep
 {
     Options options;
@@ -25,10 +207,16 @@ struct TableBuilder::Rep
     uint64_t offset;
     Status status;
     BlockBuilder data_block;
-    BlockBuilder index_block;
+    BlockBuilder index_block;     // Current partition if partitioned
+    BlockBuilder top_index_block; // Index over the partitions
+    std::string last_index_key;   // Last key added to index_block
     std::string last_key;
     int64_t num_entries;
     bool closed;          // Either Finish() or Abandon() has been called.
+    FilterBlockBuilder* filter_block;
+    FilterBlockBuilder* prefix_filter_block;  // A single filter
+    std::string last_prefix;
+    bool has_prefix;      // last_prefix holds the prefix of an added key
 
     // We do not emit the index entry for a block until we have seen the
     // first key for the next data block.  This allows us to use shorter
@@ -44,16 +232,42 @@ struct TableBuilder::Rep
 
     std::string compressed_output;
 
+    // If options.compression_threads > 1, data blocks are compressed by
+    // "workers" and written in order from "pending_blocks", and the
+    // filter keys of data_block are collected in "filter_keys" until then.
+    CompressionWorkers* workers;
+    std::deque<PendingBlock*> pending_blocks;
+    std::string filter_keys;
+    std::vector<size_t> filter_key_starts;
+
+    // While "sampling", data blocks are held back in pending_blocks until
+    // "sampled_bytes" of them are enough to build "dictionary".
+    bool sampling;
+    size_t sampled_bytes;
+    std::string dictionary;
+
     Rep(const Options& opt, WritableFile* f)
         : options(opt),
           index_block_options(opt),
           file(f),
           offset(0),
-          data_block(&options),
+          data_block(&options, opt.data_block_hash_index),
           index_block(&index_block_options),
+          top_index_block(&index_block_options),
           num_entries(0),
           closed(false),
-          pending_index_entry(false)
+          filter_block(opt.filter_policy == NULL ? NULL
+                       : new FilterBlockBuilder(opt.filter_policy)),
+          prefix_filter_block(
+              (opt.filter_policy == NULL || opt.prefix_extractor == NULL)
+              ? NULL : new FilterBlockBuilder(opt.filter_policy)),
+          has_prefix(false),
+          pending_index_entry(false),
+          workers(opt.compression_threads > 1
+                  ? new CompressionWorkers(opt.env, opt.compression_threads)
+                  : NULL),
+          sampling(UseDictionary(opt)),
+          sampled_bytes(0)
     {
         index_block_options.block_restart_interval = 1;
     }
@@ -62,11 +276,22 @@ struct TableBuilder::Rep
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
     : rep_(new Rep(options, file))
 {
+    if (rep_->filter_block != NULL)
+    {
+        rep_->filter_block->StartBlock(0);
+    }
+    if (rep_->prefix_filter_block != NULL)
+    {
+        rep_->prefix_filter_block->StartBlock(0);
+    }
 }
 
 TableBuilder::~TableBuilder()
 {
     assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+    assert(rep_->workers == NULL);
+    delete rep_->filter_block;
+    delete rep_->prefix_filter_block;
     delete rep_;
 }
 
@@ -79,6 +304,19 @@ Status TableBuilder::ChangeOptions(const Options& options)
     {
         return Status::InvalidArgument("changing comparator while building table");
     }
+    if (options.filter_policy != rep_->options.filter_policy)
+    {
+        return Status::InvalidArgument("changing filter policy while building table");
+    }
+    if (options.prefix_extractor != rep_->options.prefix_extractor)
+    {
+        return Status::InvalidArgument("changing prefix extractor while building table");
+    }
+    if ((options.index_partition_size == 0) !=
+            (rep_->options.index_partition_size == 0))
+    {
+        return Status::InvalidArgument("changing index partitioning while building table");
+    }
 
     // Note that any live BlockBuilders point to rep_->options and therefore
     // will automatically pick up the updated options.
@@ -102,12 +340,43 @@ void TableBuilder::Add(const Slice& key, const Slice& value)
     {
         assert(r->data_block.empty());
         r->options.comparator->FindShortestSeparator(&r->last_key, key);
-        std::string handle_encoding;
-        r->pending_handle.EncodeTo(&handle_encoding);
-        r->index_block.Add(r->last_key, Slice(handle_encoding));
+        if (!r->pending_blocks.empty())
+        {
+            // The entry is added once the block has been written
+            PendingBlock* block = r->pending_blocks.back();
+            block->index_key = r->last_key;
+            block->has_index_key = true;
+        }
+        else
+        {
+            AddIndexEntry(r->last_key, r->pending_handle);
+            if (r->filter_block != NULL && r->options.index_partition_size > 0)
+            {
+                // The next data block starts after any index partition that
+                // was just written.
+                r->filter_block->StartBlock(r->offset);
+            }
+        }
         r->pending_index_entry = false;
     }
 
+    if (r->filter_block != NULL)
+    {
+        if (r->workers != NULL || r->sampling)
+        {
+            r->filter_key_starts.push_back(r->filter_keys.size());
+            r->filter_keys.append(key.data(), key.size());
+        }
+        else
+        {
+            r->filter_block->AddKey(key);
+        }
+    }
+    if (r->prefix_filter_block != NULL)
+    {
+        AddPrefix(key);
+    }
+
     r->last_key.assign(key.data(), key.size());
     r->num_entries++;
     r->data_block.Add(key, value);
@@ -119,6 +388,28 @@ void TableBuilder::Add(const Slice& key, const Slice& value)
     }
 }
 
+// Add the prefix of "key" to the prefix filter unless it is the prefix
+// of the previous key as well.
+void TableBuilder::AddPrefix(const Slice& key)
+{
+    Rep* r = rep_;
+    const SliceTransform* extractor = r->options.prefix_extractor;
+    if (!extractor->InDomain(key))
+    {
+        return;
+    }
+    Slice prefix = extractor->Transform(key);
+    if (r->has_prefix && prefix == Slice(r->last_prefix))
+    {
+        return;
+    }
+    r->last_prefix.assign(prefix.data(), prefix.size());
+    r->has_prefix = true;
+    std::string padded = r->last_prefix;
+    padded.append(kPrefixFilterPadding, '\0');
+    r->prefix_filter_block->AddKey(padded);
+}
+
 void TableBuilder::Flush()
 {
     Rep* r = rep_;
@@ -126,15 +417,52 @@ void TableBuilder::Flush()
     if (!ok()) return;
     if (r->data_block.empty()) return;
     assert(!r->pending_index_entry);
-    WriteBlock(&r->data_block, &r->pending_handle);
+    if (r->workers != NULL || r->sampling)
+    {
+        PendingBlock* block = new PendingBlock;
+        Slice raw = r->data_block.Finish();
+        block->raw.assign(raw.data(), raw.size());
+        block->dictionary = r->dictionary;
+        block->type = r->options.compression;
+        block->filter_keys.swap(r->filter_keys);
+        block->filter_key_starts.swap(r->filter_key_starts);
+        r->data_block.Reset();
+        r->pending_blocks.push_back(block);
+        r->pending_index_entry = true;
+        if (r->sampling)
+        {
+            r->sampled_bytes += block->raw.size();
+            if (r->sampled_bytes >= kDictionarySampleRatio *
+                    r->options.compression_dictionary_size)
+            {
+                BuildDictionary();
+                if (r->workers == NULL && r->filter_block != NULL)
+                {
+                    // Keys are added directly again from here on
+                    r->filter_block->StartBlock(r->offset);
+                }
+            }
+            return;
+        }
+        r->workers->Schedule(block);
+        WritePendingBlocks(kPendingBlocksPerThread *
+                           r->options.compression_threads);
+        return;
+    }
+    WriteBlock(&r->data_block, r->dictionary, &r->pending_handle);
     if (ok())
     {
         r->pending_index_entry = true;
         r->status = r->file->Flush();
     }
+    if (r->filter_block != NULL)
+    {
+        r->filter_block->StartBlock(r->offset);
+    }
 }
 
-void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle)
+void TableBuilder::WriteBlock(BlockBuilder* block, const Slice& dictionary,
+                              BlockHandle* handle)
 {
     // File format contains a sequence of blocks where each block has:
     //    block_data: uint8[n]
@@ -143,34 +471,115 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle)
     assert(ok());
     Rep* r = rep_;
     Slice raw = block->Finish();
+    const CompressionType type = CompressBlock(r->options.compression, raw,
+                                 dictionary, &r->compressed_output);
+    WriteRawBlock(type == kNoCompression ? raw : Slice(r->compressed_output),
+                  type, handle);
+    r->compressed_output.clear();
+    block->Reset();
+}
 
-    Slice block_contents;
-    CompressionType type = r->options.compression;
-    // TODO(postrelease): Support more compression options: zlib?
-    switch (type)
-    {
-    case kNoCompression:
-        block_contents = raw;
-        break;
-
-    case kSnappyCompression:
+// Write the compressed blocks at the head of pending_blocks, first
+// waiting for them as long as more than "max_pending" are left.  Without
+// compression threads the blocks are compressed here.
+void TableBuilder::WritePendingBlocks(size_t max_pending)
+{
+    Rep* r = rep_;
+    while (!r->pending_blocks.empty())
     {
-        std::string* compressed = &r->compressed_output;
-        if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-                compressed->size() < raw.size() - (raw.size() / 8u))
+        PendingBlock* block = r->pending_blocks.front();
+        if (r->workers != NULL &&
+                !r->workers->Done(block, r->pending_blocks.size() > max_pending))
         {
-            block_contents = *compressed;
+            break;
         }
-        else
+        r->pending_blocks.pop_front();
+        if (ok())
         {
-            // Snappy not supported, or compressed less than 12.5%, so just
-            // store uncompressed form
-            block_contents = raw;
-            type = kNoCompression;
+            if (r->workers == NULL)
+            {
+                block->type = CompressBlock(block->type, block->raw,
+                                            block->dictionary,
+                                            &block->compressed);
+            }
+            if (r->filter_block != NULL)
+            {
+                r->filter_block->StartBlock(r->offset);
+                const std::vector<size_t>& starts = block->filter_key_starts;
+                for (size_t i = 0; i < starts.size(); i++)
+                {
+                    const size_t limit = (i + 1 < starts.size())
+                                         ? starts[i + 1] : block->filter_keys.size();
+                    r->filter_block->AddKey(Slice(block->filter_keys.data() + starts[i],
+                                                  limit - starts[i]));
+                }
+            }
+            BlockHandle handle;
+            WriteRawBlock(block->type == kNoCompression
+                          ? Slice(block->raw) : Slice(block->compressed),
+                          block->type, &handle);
+            if (ok())
+            {
+                r->status = r->file->Flush();
+            }
+            if (!block->has_index_key)
+            {
+                r->pending_handle = handle;
+            }
+            else if (ok())
+            {
+                AddIndexEntry(block->index_key, handle);
+            }
         }
-        break;
+        delete block;
     }
+}
+
+// Build the compression dictionary from the data blocks held back so
+// far, then compress and write them like the blocks that follow.
+void TableBuilder::BuildDictionary()
+{
+    Rep* r = rep_;
+    assert(r->sampling);
+    r->sampling = false;
+    std::vector<Slice> samples;
+    for (size_t i = 0; i < r->pending_blocks.size(); i++)
+    {
+        samples.push_back(r->pending_blocks[i]->raw);
     }
+    // A table too small to fill the samples gets a smaller dictionary
+    size_t max_size = r->sampled_bytes / kDictionarySampleRatio;
+    if (max_size > r->options.compression_dictionary_size)
+    {
+        max_size = r->options.compression_dictionary_size;
+    }
+    BuildCompressionDictionary(samples, max_size, &r->dictionary);
+
+    for (size_t i = 0; i < r->pending_blocks.size(); i++)
+    {
+        PendingBlock* block = r->pending_blocks[i];
+        block->dictionary = r->dictionary;
+        if (r->workers != NULL)
+        {
+            r->workers->Schedule(block);
+        }
+    }
+    if (r->workers != NULL)
+    {
+        WritePendingBlocks(kPendingBlocksPerThread *
+                           r->options.compression_threads);
+    }
+    else
+    {
+        WritePendingBlocks(0);
+    }
+}
+
+void TableBuilder::WriteRawBlock(const Slice& block_contents,
+                                 CompressionType type,
+                                 BlockHandle* handle)
+{
+    Rep* r = rep_;
     handle->set_offset(r->offset);
     handle->set_size(block_contents.size());
     r->status = r->file->Append(block_contents);
@@ -187,8 +596,39 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle)
             r->offset += block_contents.size() + kBlockTrailerSize;
         }
     }
-    r->compressed_output.clear();
-    block->Reset();
+}
+
+void TableBuilder::AddIndexEntry(const Slice& key, const BlockHandle& handle)
+{
+    Rep* r = rep_;
+    std::string handle_encoding;
+    handle.EncodeTo(&handle_encoding);
+    r->index_block.Add(key, Slice(handle_encoding));
+    if (r->options.index_partition_size > 0)
+    {
+        r->last_index_key.assign(key.data(), key.size());
+        if (r->index_block.CurrentSizeEstimate() >=
+                r->options.index_partition_size)
+        {
+            FlushIndexPartition();
+        }
+    }
+}
+
+// Write out the current index partition and point the top-level index
+// at it.  Its last key is >= every key of the data blocks it covers.
+void TableBuilder::FlushIndexPartition()
+{
+    Rep* r = rep_;
+    if (!ok() || r->index_block.empty()) return;
+    BlockHandle handle;
+    WriteBlock(&r->index_block, Slice(), &handle);
+    if (ok())
+    {
+        std::string handle_encoding;
+        handle.EncodeTo(&handle_encoding);
+        r->top_index_block.Add(r->last_index_key, Slice(handle_encoding));
+    }
 }
 
 Status TableBuilder::status() const
@@ -202,25 +642,95 @@ Status TableBuilder::Finish()
     Flush();
     assert(!r->closed);
     r->closed = true;
-    BlockHandle metaindex_block_handle;
-    BlockHandle index_block_handle;
+    if (r->sampling && ok())
+    {
+        BuildDictionary();
+    }
+    if (r->workers != NULL)
+    {
+        WritePendingBlocks(0);
+        delete r->workers;
+        r->workers = NULL;
+    }
+    BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+    BlockHandle prefix_filter_handle, dictionary_handle;
+
+    // Write the compression dictionary
+    if (ok() && !r->dictionary.empty())
+    {
+        WriteRawBlock(r->dictionary, kNoCompression, &dictionary_handle);
+    }
+
+    // Write filter block
+    if (ok() && r->filter_block != NULL)
+    {
+        WriteRawBlock(r->filter_block->Finish(), kNoCompression,
+                      &filter_block_handle);
+    }
+    if (ok() && r->prefix_filter_block != NULL)
+    {
+        WriteRawBlock(r->prefix_filter_block->Finish(), kNoCompression,
+                      &prefix_filter_handle);
+    }
+
+    // Write metaindex block
     if (ok())
     {
         BlockBuilder meta_index_block(&r->options);
+        if (!r->dictionary.empty())
+        {
+            std::string handle_encoding;
+            dictionary_handle.EncodeTo(&handle_encoding);
+            meta_index_block.Add(kCompressionDictionaryKey, handle_encoding);
+        }
+        if (r->filter_block != NULL)
+        {
+            // Add mapping from "filter.Name" to location of filter data
+            std::string key = "filter.";
+            key.append(r->options.filter_policy->Name());
+            std::string handle_encoding;
+            filter_block_handle.EncodeTo(&handle_encoding);
+            meta_index_block.Add(key, handle_encoding);
+        }
+        if (r->options.index_partition_size > 0)
+        {
+            meta_index_block.Add(kPartitionedIndexKey, Slice());
+        }
+        if (r->prefix_filter_block != NULL)
+        {
+            // Sorts after the entries above
+            std::string key = kPrefixFilterKey;
+            key.append(r->options.prefix_extractor->Name());
+            key.append(".");
+            key.append(r->options.filter_policy->Name());
+            std::string handle_encoding;
+            prefix_filter_handle.EncodeTo(&handle_encoding);
+            meta_index_block.Add(key, handle_encoding);
+        }
+
         // TODO(postrelease): Add stats and other meta blocks
-        WriteBlock(&meta_index_block, &metaindex_block_handle);
+        WriteBlock(&meta_index_block, Slice(), &metaindex_block_handle);
     }
     if (ok())
     {
         if (r->pending_index_entry)
         {
             r->options.comparator->FindShortSuccessor(&r->last_key);
-            std::string handle_encoding;
-            r->pending_handle.EncodeTo(&handle_encoding);
-            r->index_block.Add(r->last_key, Slice(handle_encoding));
+            AddIndexEntry(r->last_key, r->pending_handle);
             r->pending_index_entry = false;
         }
-        WriteBlock(&r->index_block, &index_block_handle);
+        if (r->options.index_partition_size > 0)
+        {
+            FlushIndexPartition();
+            if (ok())
+            {
+                WriteBlock(&r->top_index_block, Slice(), &index_block_handle);
+            }
+        }
+        else
+        {
+            WriteBlock(&r->index_block, Slice(), &index_block_handle);
+        }
     }
     if (ok())
     {
@@ -243,6 +753,13 @@ void TableBuilder::Abandon()
     Rep* r = rep_;
     assert(!r->closed);
     r->closed = true;
+    delete r->workers;
+    r->workers = NULL;
+    for (size_t i = 0; i < r->pending_blocks.size(); i++)
+    {
+        delete r->pending_blocks[i];
+    }
+    r->pending_blocks.clear();
 }
 
 uint64_t TableBuilder::NumEntries() const
@@ -11,11 +11,15 @@
 #include "db/write_batch_internal.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -140,8 +144,12 @@ private:
 class StringSource: public RandomAccessFile
 {
 public:
-    StringSource(const Slice& contents)
-        : contents_(contents.data(), contents.size())
+    // If "stable" is true, reads return pointers into the contents
+    // instead of copying into "scratch", like a memory-mapped file.
+    StringSource(const Slice& contents, bool stable = false)
+        : contents_(contents.data(), contents.size()),
+          stable_(stable),
+          reads_(0)
     {
     }
 
@@ -152,9 +160,16 @@ public:
         return contents_.size();
     }
 
+    // Number of calls to Read() so far
+    int reads() const
+    {
+        return reads_;
+    }
+
     virtual Status Read(uint64_t offset, size_t n, Slice* result,
                         char* scratch) const
     {
+        reads_++;
         if (offset > contents_.size())
         {
             return Status::InvalidArgument("invalid Read offset");
@@ -163,13 +178,27 @@ public:
         {
             n = contents_.size() - offset;
         }
-        memcpy(scratch, &contents_[offset], n);
-        *result = Slice(scratch, n);
+        if (stable_)
+        {
+            *result = Slice(contents_.data() + offset, n);
+        }
+        else
+        {
+            memcpy(scratch, &contents_[offset], n);
+            *result = Slice(scratch, n);
+        }
         return Status::OK();
     }
 
+    virtual bool StableReads() const
+    {
+        return stable_;
+    }
+
 private:
     std::string contents_;
+    bool stable_;
+    mutable int reads_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -244,7 +273,7 @@ public:
     {
         delete block_;
         block_ = NULL;
-        BlockBuilder builder(&options);
+        BlockBuilder builder(&options, options.data_block_hash_index);
 
         for (KVMap::const_iterator it = data.begin();
                 it != data.end();
@@ -257,7 +286,11 @@ public:
         block_size_ = block_data.size();
         char* block_data_copy = new char[block_size_];
         memcpy(block_data_copy, block_data.data(), block_size_);
-        block_ = new Block(block_data_copy, block_size_);
+        BlockContents contents;
+        contents.data = Slice(block_data_copy, block_size_);
+        contents.heap_allocated = true;
+        contents.cachable = false;
+        block_ = new Block(contents);
         return Status::OK();
     }
     virtual size_t NumBytes() const
@@ -281,8 +314,14 @@ private:
 class TableConstructor: public Constructor
 {
 public:
-    TableConstructor(const Comparator* cmp)
+    // "stable_reads" builds uncompressed tables and serves them from a
+    // source whose blocks are used in place.  If "index_cache" is non-NULL
+    // the table keeps its index block in that cache.
+    TableConstructor(const Comparator* cmp, bool stable_reads = false,
+                     Cache* index_cache = NULL)
         : Constructor(cmp),
+          stable_reads_(stable_reads),
+          index_cache_(index_cache),
           source_(NULL), table_(NULL)
     {
     }
@@ -294,7 +333,12 @@ public:
     {
         Reset();
         StringSink sink;
-        TableBuilder builder(options, &sink);
+        Options builder_options = options;
+        if (stable_reads_)
+        {
+            builder_options.compression = kNoCompression;
+        }
+        TableBuilder builder(builder_options, &sink);
 
         for (KVMap::const_iterator it = data.begin();
                 it != data.end();
@@ -309,9 +353,14 @@ public:
         ASSERT_EQ(sink.contents().size(), builder.FileSize());
 
         // Open the table
-        source_ = new StringSource(sink.contents());
+        source_ = new StringSource(sink.contents(), stable_reads_);
         Options table_options;
         table_options.comparator = options.comparator;
+        if (index_cache_ != NULL)
+        {
+            table_options.block_cache = index_cache_;
+            table_options.cache_index_and_filter_blocks = true;
+        }
         return Table::Open(table_options, source_, sink.contents().size(), &table_);
     }
     virtual size_t NumBytes() const
@@ -338,6 +387,8 @@ private:
         source_ = NULL;
     }
 
+    bool stable_reads_;
+    Cache* index_cache_;
     StringSource* source_;
     Table* table_;
 
@@ -414,11 +465,13 @@ private:
 class MemTableConstructor: public Constructor
 {
 public:
-    explicit MemTableConstructor(const Comparator* cmp)
+    explicit MemTableConstructor(const Comparator* cmp,
+                                 MemTableRepFactory* factory = NULL)
         : Constructor(cmp),
-          internal_comparator_(cmp)
+          internal_comparator_(cmp),
+          factory_(factory)
     {
-        memtable_ = new MemTable(internal_comparator_);
+        memtable_ = new MemTable(internal_comparator_, factory_);
         memtable_->Ref();
     }
     ~MemTableConstructor()
@@ -428,7 +481,7 @@ public:
     virtual Status FinishImpl(const Options& options, const KVMap& data)
     {
         memtable_->Unref();
-        memtable_ = new MemTable(internal_comparator_);
+        memtable_ = new MemTable(internal_comparator_, factory_);
         memtable_->Ref();
         int seq = 1;
         for (KVMap::const_iterator it = data.begin();
@@ -452,6 +505,7 @@ public:
 
 private:
     InternalKeyComparator internal_comparator_;
+    MemTableRepFactory* factory_;
     MemTable* memtable_;
 };
 
@@ -526,8 +580,17 @@ private:
 enum TestType
 {
     TABLE_TEST,
+    STABLE_TABLE_TEST,
+    CACHED_INDEX_TABLE_TEST,
+    PARTITIONED_INDEX_TABLE_TEST,
+    PARALLEL_COMPRESSION_TABLE_TEST,
+    DICTIONARY_TABLE_TEST,
+    ZSTD_TABLE_TEST,
     BLOCK_TEST,
+    HASH_INDEX_BLOCK_TEST,
     MEMTABLE_TEST,
+    HASH_MEMTABLE_TEST,
+    VECTOR_MEMTABLE_TEST,
     DB_TEST
 };
 
@@ -547,6 +610,30 @@ static const TestArgs kTestArgList[] =
     { TABLE_TEST, true, 1 },
     { TABLE_TEST, true, 1024 },
 
+    // Tables whose blocks are used in place
+    { STABLE_TABLE_TEST, false, 16 },
+    { STABLE_TABLE_TEST, true, 16 },
+
+    // Tables whose index block lives in the block cache
+    { CACHED_INDEX_TABLE_TEST, false, 16 },
+    { CACHED_INDEX_TABLE_TEST, true, 16 },
+
+    // Tables whose index is split into partitions
+    { PARTITIONED_INDEX_TABLE_TEST, false, 16 },
+    { PARTITIONED_INDEX_TABLE_TEST, true, 16 },
+
+    // Tables whose blocks are compressed by several threads
+    { PARALLEL_COMPRESSION_TABLE_TEST, false, 16 },
+    { PARALLEL_COMPRESSION_TABLE_TEST, true, 16 },
+
+    // Tables compressed against a dictionary
+    { DICTIONARY_TABLE_TEST, false, 16 },
+    { DICTIONARY_TABLE_TEST, true, 16 },
+
+    // Tables compressed with zstd, against a dictionary
+    { ZSTD_TABLE_TEST, false, 16 },
+    { ZSTD_TABLE_TEST, true, 16 },
+
     { BLOCK_TEST, false, 16 },
     { BLOCK_TEST, false, 1 },
     { BLOCK_TEST, false, 1024 },
@@ -554,9 +641,18 @@ static const TestArgs kTestArgList[] =
     { BLOCK_TEST, true, 1 },
     { BLOCK_TEST, true, 1024 },
 
+    // Blocks that end in a hash index
+    { HASH_INDEX_BLOCK_TEST, false, 16 },
+    { HASH_INDEX_BLOCK_TEST, false, 1 },
+    { HASH_INDEX_BLOCK_TEST, true, 16 },
+
     // Restart interval does not matter for memtables
     { MEMTABLE_TEST, false, 16 },
     { MEMTABLE_TEST, true, 16 },
+    { HASH_MEMTABLE_TEST, false, 16 },
+    { HASH_MEMTABLE_TEST, true, 16 },
+    { VECTOR_MEMTABLE_TEST, false, 16 },
+    { VECTOR_MEMTABLE_TEST, true, 16 },
 
     // Do not bother with restart interval variations for DB
     { DB_TEST, false, 16 },
@@ -564,6 +660,14 @@ static const TestArgs kTestArgList[] =
 };
 static const int kNumTestArgs = sizeof(kTestArgList) / sizeof(kTestArgList[0]);
 
+// Shared by every harness run; a few buckets so that they fill up
+static const SliceTransform* prefix_transform = NewFixedPrefixTransform(1);
+static MemTableRepFactory* hash_factory =
+    NewHashSkipListMemTableRepFactory(prefix_transform, 7);
+static MemTableRepFactory* vector_factory = NewVectorMemTableRepFactory();
+// Small enough that index blocks are evicted and read again
+static Cache* index_cache = NewLRUCache(4096, 0.5);
+
 class Harness
 {
 public:
@@ -588,12 +692,52 @@ public:
         case TABLE_TEST:
             constructor_ = new TableConstructor(options_.comparator);
             break;
+        case STABLE_TABLE_TEST:
+            constructor_ = new TableConstructor(options_.comparator, true);
+            break;
+        case CACHED_INDEX_TABLE_TEST:
+            constructor_ = new TableConstructor(options_.comparator, false,
+                                                index_cache);
+            break;
+        case PARTITIONED_INDEX_TABLE_TEST:
+            options_.index_partition_size = 64;
+            constructor_ = new TableConstructor(options_.comparator, false,
+                                                index_cache);
+            break;
+        case PARALLEL_COMPRESSION_TABLE_TEST:
+            options_.compression_threads = 3;
+            options_.index_partition_size = 64;
+            constructor_ = new TableConstructor(options_.comparator);
+            break;
+        case DICTIONARY_TABLE_TEST:
+            options_.compression = kLZ4Compression;
+            options_.compression_dictionary_size = 256;
+            constructor_ = new TableConstructor(options_.comparator, false,
+                                                index_cache);
+            break;
+        case ZSTD_TABLE_TEST:
+            options_.compression = kZstdCompression;
+            options_.compression_dictionary_size = 256;
+            constructor_ = new TableConstructor(options_.comparator);
+            break;
         case BLOCK_TEST:
             constructor_ = new BlockConstructor(options_.comparator);
             break;
+        case HASH_INDEX_BLOCK_TEST:
+            options_.data_block_hash_index = true;
+            constructor_ = new BlockConstructor(options_.comparator);
+            break;
         case MEMTABLE_TEST:
             constructor_ = new MemTableConstructor(options_.comparator);
             break;
+        case HASH_MEMTABLE_TEST:
+            constructor_ = new MemTableConstructor(options_.comparator,
+                                                   hash_factory);
+            break;
+        case VECTOR_MEMTABLE_TEST:
+            constructor_ = new MemTableConstructor(options_.comparator,
+                                                   vector_factory);
+            break;
         case DB_TEST:
             constructor_ = new DBConstructor(options_.comparator);
             break;
@@ -923,6 +1067,91 @@ TEST(Harness, RandomizedLongDB)
     ASSERT_GT(files, 0);
 }
 
+class BlockTest { };
+
+namespace
+{
+struct FoundEntry
+{
+    bool found;
+    std::string key;
+};
+}
+static void SaveFoundEntry(void* arg, const Slice& k, const Slice& v)
+{
+    FoundEntry* e = reinterpret_cast<FoundEntry*>(arg);
+    e->found = true;
+    e->key = k.ToString();
+}
+
+static Block* BuildInternalKeyBlock(const Options& options, int num_keys)
+{
+    BlockBuilder builder(&options, options.data_block_hash_index);
+    for (int i = 0; i < num_keys; i++)
+    {
+        char user_key[20];
+        snprintf(user_key, sizeof(user_key), "key%04d", i);
+        // Up to three versions of each key, newest first
+        for (int v = i % 3; v >= 0; v--)
+        {
+            builder.Add(InternalKey(user_key, 100 + v, kTypeValue).Encode(),
+                        "value");
+        }
+    }
+    Slice raw = builder.Finish();
+    char* copy = new char[raw.size()];
+    memcpy(copy, raw.data(), raw.size());
+    BlockContents contents;
+    contents.data = Slice(copy, raw.size());
+    contents.heap_allocated = true;
+    contents.cachable = false;
+    return new Block(contents);
+}
+
+TEST(BlockTest, HashIndexPointLookup)
+{
+    InternalKeyComparator cmp(BytewiseComparator());
+    Options options;
+    options.comparator = &cmp;
+    options.block_restart_interval = 4;
+    Block* plain = BuildInternalKeyBlock(options, 200);
+    options.data_block_hash_index = true;
+    Block* hashed = BuildInternalKeyBlock(options, 200);
+    ASSERT_GT(hashed->size(), plain->size());
+
+    for (int i = 0; i < 200; i++)
+    {
+        char user_key[20];
+        snprintf(user_key, sizeof(user_key), "key%04d", i);
+        for (SequenceNumber seq = 99; seq <= 103; seq++)
+        {
+            std::string target =
+                InternalKey(user_key, seq, kValueTypeForSeek).Encode().ToString();
+            FoundEntry expected, actual;
+            expected.found = actual.found = false;
+            ASSERT_OK(plain->Get(&cmp, target, &expected, &SaveFoundEntry));
+            ASSERT_OK(hashed->PointLookup(&cmp, target, &actual,
+                                          &SaveFoundEntry));
+            ASSERT_EQ(expected.found, actual.found);
+            ASSERT_EQ(expected.key, actual.key);
+        }
+
+        // Missing keys may be skipped, or land on another user key
+        std::string missing = std::string(user_key) + "x";
+        std::string target =
+            InternalKey(missing, 200, kValueTypeForSeek).Encode().ToString();
+        FoundEntry actual;
+        actual.found = false;
+        ASSERT_OK(hashed->PointLookup(&cmp, target, &actual, &SaveFoundEntry));
+        if (actual.found)
+        {
+            ASSERT_NE(missing, ExtractUserKey(actual.key).ToString());
+        }
+    }
+    delete plain;
+    delete hashed;
+}
+
 class MemTableTest { };
 
 TEST(MemTableTest, Simple)
@@ -998,6 +1227,138 @@ TEST(TableTest, ApproximateOffsetOfPlain)
 
 }
 
+TEST(TableTest, OpenReadsTailOnce)
+{
+    Options options;
+    options.block_size = 1024;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    for (int i = 0; i < 1000; i++)
+    {
+        char key[20];
+        snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, "value");
+    }
+    ASSERT_OK(builder.Finish());
+
+    // The footer, index, metaindex and filter blocks all come from one read
+    StringSource source(sink.contents());
+    Table* table = NULL;
+    ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+    ASSERT_EQ(1, source.reads());
+    Iterator* iter = table->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next())
+    {
+        count++;
+    }
+    ASSERT_EQ(1000, count);
+    delete iter;
+    delete table;
+
+    // Without the prefetch each of them is read separately
+    options.tail_prefetch_size = 0;
+    StringSource unprefetched(sink.contents());
+    ASSERT_OK(Table::Open(options, &unprefetched, sink.contents().size(),
+                          &table));
+    ASSERT_EQ(4, unprefetched.reads());
+    delete table;
+    delete options.filter_policy;
+}
+
+TEST(TableTest, PrefixFilter)
+{
+    Options options;
+    options.block_size = 256;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    options.prefix_extractor = NewFixedPrefixTransform(4);
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    for (int i = 0; i < 100; i++)
+    {
+        char key[20];
+        snprintf(key, sizeof(key), "p%03d/%04d", i * 2, i);
+        builder.Add(key, "value");
+        snprintf(key, sizeof(key), "p%03d/%04d", i * 2, i + 1);
+        builder.Add(key, "value");
+    }
+    ASSERT_OK(builder.Finish());
+
+    StringSource source(sink.contents());
+    Table* table = NULL;
+    ASSERT_OK(Table::Open(options, &source, sink.contents().size(), &table));
+    ASSERT_TRUE(table->PrefixMayMatch("p000/0000"));
+    ASSERT_TRUE(table->PrefixMayMatch("p198"));
+    ASSERT_TRUE(table->PrefixMayMatch("p0"));  // Outside the domain
+    int absent = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        char key[20];
+        snprintf(key, sizeof(key), "p%03d/", i * 2 + 1);
+        if (!table->PrefixMayMatch(key)) absent++;
+    }
+    ASSERT_GE(absent, 95);
+
+    // A prefix seek to a missing prefix reads no data block, while a plain
+    // seek reads the block that would hold it.
+    ReadOptions ro;
+    ro.prefix_same_as_start = true;
+    Iterator* iter = table->NewIterator(ro);
+    const int reads = source.reads();
+    iter->Seek("p101/0000");
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(reads, source.reads());
+    iter->Seek("p100/0051");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("p100/0051", iter->key().ToString());
+    delete iter;
+    iter = table->NewIterator(ReadOptions());
+    iter->Seek("p101/0000");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("p102/0051", iter->key().ToString());
+    delete iter;
+    delete table;
+
+    // Tables are still readable without the extractor
+    Options plain = options;
+    plain.prefix_extractor = NULL;
+    ASSERT_OK(Table::Open(plain, &source, sink.contents().size(), &table));
+    ASSERT_TRUE(table->PrefixMayMatch("p101/0000"));
+    delete table;
+    delete options.prefix_extractor;
+    delete options.filter_policy;
+}
+
+TEST(TableTest, ApproximateOffsetOfPartitionedIndex)
+{
+    TableConstructor c(BytewiseComparator());
+    c.Add("k01", "hello");
+    c.Add("k02", "hello2");
+    c.Add("k03", std::string(10000, 'x'));
+    c.Add("k04", std::string(200000, 'x'));
+    c.Add("k05", std::string(300000, 'x'));
+    c.Add("k06", "hello3");
+    c.Add("k07", std::string(100000, 'x'));
+    std::vector<std::string> keys;
+    KVMap kvmap;
+    Options options;
+    options.block_size = 1024;
+    options.compression = kNoCompression;
+    options.index_partition_size = 1;  // One index entry per partition
+    c.Finish(options, &keys, &kvmap);
+
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"),       0,      0));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k01"),       0,      0));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k03"),       0,      0));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"),   10000,  11000));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k05"),  210000, 211000));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k06"),  510000, 511000));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("k07"),  510000, 511000));
+    ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"),  610000, 612000));
+}
+
 static bool SnappyCompressionSupported()
 {
     std::string out;
@@ -1035,6 +1396,158 @@ TEST(TableTest, ApproximateOffsetOfCompressed)
     ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"),    4000,   6000));
 }
 
+// Build a table of "n" compressible entries with "options"
+static std::string BuildCompressibleTable(const Options& options, int n)
+{
+    Random rnd(301);
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    std::string value;
+    for (int i = 0; i < n; i++)
+    {
+        char key[20];
+        snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, test::CompressibleString(&rnd, 0.5, 300, &value));
+    }
+    ASSERT_OK(builder.Finish());
+    ASSERT_EQ(sink.contents().size(), builder.FileSize());
+    return sink.contents();
+}
+
+TEST(TableTest, ParallelCompression)
+{
+    Options options;
+    options.compression = kLZ4HCCompression;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    for (int variant = 0; variant < 4; variant++)
+    {
+        options.index_partition_size = (variant & 1) ? 256 : 0;
+        options.compression_dictionary_size = (variant & 2) ? 2048 : 0;
+        options.compression_threads = 1;
+        const std::string expected = BuildCompressibleTable(options, 5000);
+
+        // The threads do not change what is written
+        for (int threads = 2; threads <= 4; threads++)
+        {
+            options.compression_threads = threads;
+            ASSERT_TRUE(BuildCompressibleTable(options, 5000) == expected);
+        }
+    }
+
+    // Abandoning a table stops the threads
+    options.compression_threads = 4;
+    StringSink sink;
+    TableBuilder builder(options, &sink);
+    std::string value;
+    Random rnd(301);
+    for (int i = 0; i < 1000; i++)
+    {
+        char key[20];
+        snprintf(key, sizeof(key), "k%06d", i);
+        builder.Add(key, test::CompressibleString(&rnd, 0.5, 300, &value));
+    }
+    builder.Abandon();
+    delete options.filter_policy;
+}
+
+// Counts the threads started through it
+class ThreadCountingEnv : public EnvWrapper
+{
+public:
+    ThreadCountingEnv() : EnvWrapper(Env::Default()), started_(0) { }
+
+    virtual void StartThread(void (*function)(void* arg), void* arg)
+    {
+        mu_.Lock();
+        started_++;
+        mu_.Unlock();
+        target()->StartThread(function, arg);
+    }
+
+    int Started()
+    {
+        MutexLock l(&mu_);
+        return started_;
+    }
+
+private:
+    port::Mutex mu_;
+    int started_;
+};
+
+TEST(TableTest, CompressionThreadsAreShared)
+{
+    // The compression threads of an Env outlive the tables, so the Env
+    // has to as well
+    static ThreadCountingEnv* env = new ThreadCountingEnv;
+    Options options;
+    options.env = env;
+    options.compression = kLZ4Compression;
+    options.compression_threads = 4;
+    for (int i = 0; i < 200; i++)
+    {
+        BuildCompressibleTable(options, 200);
+    }
+    ASSERT_GT(env->Started(), 0);
+    ASSERT_LE(env->Started(), 4);
+
+    // A table asking for more threads than the others adds to them
+    options.compression_threads = 6;
+    for (int i = 0; i < 20; i++)
+    {
+        BuildCompressibleTable(options, 200);
+    }
+    ASSERT_LE(env->Started(), 6);
+}
+
+TEST(TableTest, DictionaryCompression)
+{
+    Options options;
+    options.compression = kLZ4Compression;
+    options.block_size = 1024;
+    options.filter_policy = NewBloomFilterPolicy(10);
+    size_t sizes[2];
+    for (int dictionary = 0; dictionary < 2; dictionary++)
+    {
+        // JSON-like records that have most of their text in common
+        Random rnd(301);
+        TableConstructor c(BytewiseComparator());
+        for (int i = 0; i < 2000; i++)
+        {
+            char key[20], value[200];
+            snprintf(key, sizeof(key), "k%06d", i);
+            snprintf(value, sizeof(value),
+                     "{\"id\":%d,\"user\":\"user%05d\",\"status\":\"%s\","
+                     "\"score\":%d,\"tags\":[\"alpha\",\"beta\"]}",
+                     i, static_cast<int>(rnd.Uniform(100000)),
+                     rnd.OneIn(2) ? "active" : "inactive",
+                     static_cast<int>(rnd.Uniform(1000)));
+            c.Add(key, value);
+        }
+        options.compression_dictionary_size = dictionary ? 4096 : 0;
+        std::vector<std::string> keys;
+        KVMap kvmap;
+        c.Finish(options, &keys, &kvmap);
+        sizes[dictionary] = c.NumBytes();
+
+        Iterator* iter = c.NewIterator();
+        KVMap::const_iterator model = kvmap.begin();
+        for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++model)
+        {
+            ASSERT_TRUE(model != kvmap.end());
+            ASSERT_EQ(model->first, iter->key().ToString());
+            ASSERT_EQ(model->second, iter->value().ToString());
+        }
+        ASSERT_TRUE(model == kvmap.end());
+        ASSERT_OK(iter->status());
+        delete iter;
+    }
+    fprintf(stderr, "table of 2000 records: %d bytes, %d with a dictionary\n",
+            static_cast<int>(sizes[0]), static_cast<int>(sizes[1]));
+    ASSERT_LT(sizes[1], sizes[0] * 19 / 20);
+    delete options.filter_policy;
+}
+
 }
 
 int main(int argc, char** argv)
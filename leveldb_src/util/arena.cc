@@ -4,6 +4,7 @@
 
 #include "util/arena.h"
 #include <assert.h>
+#include "util/mutexlock.h"
 
 namespace leveldb
 {
@@ -82,6 +83,18 @@ char* Arena::AllocateAligned(size_t bytes)
     return result;
 }
 
+char* Arena::AllocateConcurrently(size_t bytes)
+{
+    MutexLock l(&mu_);
+    return Allocate(bytes);
+}
+
+char* Arena::AllocateAlignedConcurrently(size_t bytes)
+{
+    MutexLock l(&mu_);
+    return AllocateAligned(bytes);
+}
+
 //z 在不小于一个page的时候，直接采用这种方式
 char* Arena::AllocateNewBlock(size_t block_bytes)
 {
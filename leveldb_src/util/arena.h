@@ -9,6 +9,7 @@
 #include <vector>
 #include <assert.h>
 #include <stdint.h>
+#include "port/port.h"
 
 namespace leveldb
 {
@@ -30,6 +31,12 @@ public:
     // Allocate memory with the normal alignment guarantees provided by malloc
     char* AllocateAligned(size_t bytes);
 
+    // Thread-safe variants of Allocate() and AllocateAligned().  They may
+    // be called from several threads at once, but not at the same time as
+    // the variants above.
+    char* AllocateConcurrently(size_t bytes);
+    char* AllocateAlignedConcurrently(size_t bytes);
+
     // Returns an estimate of the total memory usage of data allocated
     // by the arena (including space allocated but not yet used for user
     // allocations).
@@ -54,6 +61,9 @@ private:
     // Bytes of memory in blocks allocated so far
     size_t blocks_memory_;
 
+    // Serializes the *Concurrently() allocation paths
+    port::Mutex mu_;
+
     // No copying allowed
     Arena(const Arena&);
     void operator=(const Arena&);
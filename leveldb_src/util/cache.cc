@@ -18,6 +18,13 @@ Cache::~Cache()
 {
 }
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority)
+{
+    return Insert(key, value, charge, deleter);
+}
+
 namespace
 {
 
@@ -39,6 +46,7 @@ struct LRUHandle
     size_t charge;      // TODO(opt): Only allow uint32_t?
     size_t key_length;
     uint32_t refs;
+    bool in_high_pri_pool;  // Above the midpoint of the LRU list
     //z hash值，用于快速 sharding 和比较
     uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
     //z 存放key起始的地方
@@ -207,47 +215,61 @@ public:
 
     // Separate from constructor so caller can easily make an array of LRUCache
     //z 设置 capacity
-    void SetCapacity(size_t capacity)
+    void SetCapacity(size_t capacity, double high_pri_pool_ratio)
     {
         capacity_ = capacity;
+        high_pri_pool_capacity_ =
+            static_cast<size_t>(capacity * high_pri_pool_ratio);
     }
 
     // Like Cache methods, but with an extra "hash" parameter.
     Cache::Handle* Insert(const Slice& key, uint32_t hash,
                           void* value, size_t charge,
-                          void (*deleter)(const Slice& key, void* value));
+                          void (*deleter)(const Slice& key, void* value),
+                          Cache::Priority priority);
     Cache::Handle* Lookup(const Slice& key, uint32_t hash);
     void Release(Cache::Handle* handle);
     void Erase(const Slice& key, uint32_t hash);
 
 private:
     void LRU_Remove(LRUHandle* e);
-    void LRU_Append(LRUHandle* e);
+    void LRU_Insert(LRUHandle* e, bool high_pri);
+    void MaintainPoolSize();
     void Unref(LRUHandle* e);
 
     // Initialized before use.
     size_t capacity_;
+    size_t high_pri_pool_capacity_;
 
     // mutex_ protects the following state.
     port::Mutex mutex_;
     size_t usage_;
+    size_t high_pri_pool_usage_;
     uint64_t last_id_;
 
     // Dummy head of LRU list.
     // lru.prev is newest entry, lru.next is oldest entry.
     //z lru_.prev 总是最新的，lru.next是最老的 entry。
+    // Entries after lru_low_pri_ make up the high priority pool; new low
+    // priority entries are inserted right after lru_low_pri_ (or at the
+    // oldest end when lru_low_pri_ == &lru_).
     LRUHandle lru_;
+    LRUHandle* lru_low_pri_;
 
     HandleTable table_;
 };
 
 LRUCache::LRUCache()
-    : usage_(0),
+    : capacity_(0),
+      high_pri_pool_capacity_(0),
+      usage_(0),
+      high_pri_pool_usage_(0),
       last_id_(0)
 {
     // Make empty circular linked list
     lru_.next = &lru_;
     lru_.prev = &lru_;
+    lru_low_pri_ = &lru_;
 }
 
 LRUCache::~LRUCache()
@@ -276,21 +298,56 @@ void LRUCache::Unref(LRUHandle* e)
 
 void LRUCache::LRU_Remove(LRUHandle* e)
 {
+    if (lru_low_pri_ == e)
+    {
+        lru_low_pri_ = e->prev;
+    }
     e->next->prev = e->prev;
     e->prev->next = e->next;
+    if (e->in_high_pri_pool)
+    {
+        high_pri_pool_usage_ -= e->charge;
+    }
 }
 
-void LRUCache::LRU_Append(LRUHandle* e)
+void LRUCache::LRU_Insert(LRUHandle* e, bool high_pri)
 {
-    // Make "e" newest entry by inserting just before lru_
-    //z 最新的节点总是插入在 lru_ 之前
-    e->next = &lru_;
-    e->prev = lru_.prev;
+    if (high_pri && high_pri_pool_capacity_ > 0)
+    {
+        // Make "e" newest entry by inserting just before lru_
+        //z 最新的节点总是插入在 lru_ 之前
+        e->next = &lru_;
+        e->prev = lru_.prev;
+        e->in_high_pri_pool = true;
+        high_pri_pool_usage_ += e->charge;
+    }
+    else
+    {
+        // Make "e" the newest entry below the high priority pool
+        e->next = lru_low_pri_->next;
+        e->prev = lru_low_pri_;
+        e->in_high_pri_pool = false;
+        lru_low_pri_ = e;
+    }
     e->prev->next = e;
     e->next->prev = e;
+    MaintainPoolSize();
 }
 
-Cache::Handle* LRUCache::Loovkup(const Slice& key, uint32_t hash)
+// Move the oldest entries of the high priority pool below the midpoint
+// until the pool fits its share of the capacity.
+void LRUCache::MaintainPoolSize()
+{
+    while (high_pri_pool_usage_ > high_pri_pool_capacity_)
+    {
+        lru_low_pri_ = lru_low_pri_->next;
+        assert(lru_low_pri_ != &lru_);
+        lru_low_pri_->in_high_pri_pool = false;
+        high_pri_pool_usage_ -= lru_low_pri_->charge;
+    }
+}
+
+Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash)
 {
     //z 这样的话，在查找的时候只用锁定16中的一个，而不影响其他shard_的操作
     MutexLock l(&mutex_);
@@ -298,9 +355,10 @@ Cache::Handle* LRUCache::Loovkup(const Slice& key, uint32_t hash)
     LRUHandle* e = table_.Lookup(key, hash);
     if (e != NULL)
     {
+        // A hit promotes the entry into the high priority pool
         e->refs++;
         LRU_Remove(e);
-        LRU_Append(e);
+        LRU_Insert(e, true);
     }
     return reinterpret_cast<Cache::Handle*>(e);
 }
@@ -313,7 +371,8 @@ void LRUCache::Release(Cache::Handle* handle)
 
 Cache::Handle* LRUCache::Insert(
     const Slice& key, uint32_t hash, void* value, size_t charge,
-    void (*deleter)(const Slice& key, void* value))
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority)
 {
     MutexLock l(&mutex_);
 
@@ -333,7 +392,7 @@ Cache::Handle* LRUCache::Insert(
     e->refs = 2;  // One from LRUCache, one for the returned handle
     //z 拷贝 key 的值
     memcpy(e->key_data, key.data(), key.size());
-    LRU_Append(e);
+    LRU_Insert(e, priority == Cache::kHighPriority);
     usage_ += charge;
 
     LRUHandle* old = table_.Insert(e);
@@ -389,25 +448,32 @@ private:
     }
 
 public:
-    explicit ShardedLRUCache(size_t capacity)
+    ShardedLRUCache(size_t capacity, double high_pri_pool_ratio)
         : last_id_(0)
     {
         const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
         //z 对 16 个 shard_ 均设置容量
         for (int s = 0; s < kNumShards; s++)
         {
-            shard_[s].SetCapacity(per_shard);
+            shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
         }
     }
     virtual ~ShardedLRUCache() { }
     virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                            void (*deleter)(const Slice& key, void* value))
+    {
+        return Insert(key, value, charge, deleter, kLowPriority);
+    }
+    virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value),
+                           Priority priority)
     {
         //z 由 key 计算得到一个 hash 值
         const uint32_t hash = HashSlice(key);
         //z 根据 hash 值插入到不同的 shard_ 中去。
         //z charge 用于什么目的了？
-        return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+        return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                          priority);
     }
     virtual Handle* Lookup(const Slice& key)
     {
@@ -441,7 +507,13 @@ public:
 
 Cache* NewLRUCache(size_t capacity)
 {
-    return new ShardedLRUCache(capacity);
+    return new ShardedLRUCache(capacity, 0.0);
+}
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio)
+{
+    assert(high_pri_pool_ratio >= 0.0 && high_pri_pool_ratio <= 1.0);
+    return new ShardedLRUCache(capacity, high_pri_pool_ratio);
 }
 
 }
@@ -5,7 +5,10 @@
 #include "leveldb/cache.h"
 
 #include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb
@@ -206,6 +209,300 @@ TEST(CacheTest, NewId)
     ASSERT_NE(a, b);
 }
 
+// An LRU cache with half of its capacity set aside for high priority
+// and frequently used entries
+class PriorityCacheTest : public CacheTest
+{
+public:
+    PriorityCacheTest()
+    {
+        delete cache_;
+        cache_ = NewLRUCache(kCacheSize, 0.5);
+    }
+
+    void InsertHighPriority(int key, int value)
+    {
+        cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), 1,
+                                       &CacheTest::Deleter,
+                                       Cache::kHighPriority));
+    }
+
+    // Insert "n" entries starting at "first" and never look at them again
+    void Scan(int first, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            Insert(first + i, first + i);
+        }
+    }
+};
+
+TEST(PriorityCacheTest, HitEntriesSurviveScans)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        Insert(i, 100 + i);
+        ASSERT_EQ(100 + i, Lookup(i));
+    }
+    Insert(10, 110);
+    Scan(1000, 10 * kCacheSize);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(100 + i, Lookup(i));
+    }
+    // Entries that were never hit again are not protected
+    ASSERT_EQ(-1, Lookup(10));
+}
+
+TEST(PriorityCacheTest, HighPriorityEntriesSurviveScans)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        InsertHighPriority(i, 100 + i);
+    }
+    Scan(1000, 10 * kCacheSize);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(100 + i, Lookup(i));
+    }
+}
+
+TEST(PriorityCacheTest, HighPriorityPoolIsBounded)
+{
+    for (int i = 0; i < kCacheSize; i++)
+    {
+        InsertHighPriority(i, 100 + i);
+    }
+    Scan(100000, 10 * kCacheSize);
+
+    // Only about half of the capacity was protected from the scan
+    int cached = 0;
+    for (int i = 0; i < kCacheSize; i++)
+    {
+        if (Lookup(i) >= 0)
+        {
+            cached++;
+        }
+    }
+    ASSERT_GE(cached, kCacheSize / 4);
+    ASSERT_LE(cached, kCacheSize * 3 / 4);
+}
+
+TEST(PriorityCacheTest, PlainLRUWithoutPool)
+{
+    delete cache_;
+    cache_ = NewLRUCache(kCacheSize, 0.0);
+    Insert(100, 101);
+    ASSERT_EQ(101, Lookup(100));
+    InsertHighPriority(200, 201);
+    Scan(1000, 10 * kCacheSize);
+    ASSERT_EQ(-1, Lookup(100));
+    ASSERT_EQ(-1, Lookup(200));
+}
+
+// The same checks against the cache made by NewClockCache()
+class ClockCacheTest : public CacheTest
+{
+public:
+    ClockCacheTest()
+    {
+        delete cache_;
+        cache_ = NewClockCache(kCacheSize, 1);
+    }
+};
+
+TEST(ClockCacheTest, ClockHitAndMiss)
+{
+    ASSERT_EQ(-1, Lookup(100));
+    Insert(100, 101);
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(-1,  Lookup(200));
+    Insert(200, 201);
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+
+    Insert(100, 102);
+    ASSERT_EQ(102, Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+    ASSERT_EQ(1, deleted_keys_.size());
+    ASSERT_EQ(100, deleted_keys_[0]);
+    ASSERT_EQ(101, deleted_values_[0]);
+}
+
+TEST(ClockCacheTest, ClockErase)
+{
+    Erase(200);
+    ASSERT_EQ(0, deleted_keys_.size());
+
+    Insert(100, 101);
+    Insert(200, 201);
+    Erase(100);
+    ASSERT_EQ(-1,  Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+    ASSERT_EQ(1, deleted_keys_.size());
+    ASSERT_EQ(100, deleted_keys_[0]);
+
+    Erase(100);
+    ASSERT_EQ(1, deleted_keys_.size());
+}
+
+TEST(ClockCacheTest, ClockEntriesArePinned)
+{
+    Insert(100, 101);
+    Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+    ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+
+    Insert(100, 102);
+    Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+    ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+    ASSERT_EQ(0, deleted_keys_.size());
+
+    cache_->Release(h1);
+    ASSERT_EQ(1, deleted_keys_.size());
+    ASSERT_EQ(101, deleted_values_[0]);
+
+    Erase(100);
+    ASSERT_EQ(-1, Lookup(100));
+    ASSERT_EQ(1, deleted_keys_.size());
+
+    cache_->Release(h2);
+    ASSERT_EQ(2, deleted_keys_.size());
+    ASSERT_EQ(102, deleted_values_[1]);
+}
+
+TEST(ClockCacheTest, ClockEvictionPolicy)
+{
+    Insert(100, 101);
+    Insert(200, 201);
+
+    // An entry that is used between sweeps of the clock hand survives,
+    // one that is never used again does not.
+    for (int i = 0; i < 2 * kCacheSize; i++)
+    {
+        Insert(1000+i, 2000+i);
+        ASSERT_EQ(101, Lookup(100));
+    }
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(-1, Lookup(200));
+}
+
+TEST(ClockCacheTest, ClockHeavyEntries)
+{
+    const int kLight = 1;
+    const int kHeavy = 10;
+    int added = 0;
+    int index = 0;
+    while (added < 2*kCacheSize)
+    {
+        const int weight = (index & 1) ? kLight : kHeavy;
+        Insert(index, 1000+index, weight);
+        added += weight;
+        index++;
+    }
+
+    int cached_weight = 0;
+    for (int i = 0; i < index; i++)
+    {
+        const int weight = (i & 1 ? kLight : kHeavy);
+        int r = Lookup(i);
+        if (r >= 0)
+        {
+            cached_weight += weight;
+            ASSERT_EQ(1000+i, r);
+        }
+    }
+    ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
+    ASSERT_GE(cached_weight, kCacheSize / 2);
+}
+
+TEST(ClockCacheTest, TableFullOfPinnedEntries)
+{
+    // Pin far more entries than the tables have slots for.  The ones that
+    // do not fit are handed out anyway and freed when released.
+    std::vector<Cache::Handle*> handles;
+    for (int i = 0; i < 4 * kCacheSize; i++)
+    {
+        handles.push_back(cache_->Insert(EncodeKey(i), EncodeValue(i), 0,
+                                         &CacheTest::Deleter));
+        ASSERT_EQ(i, DecodeValue(cache_->Value(handles.back())));
+    }
+    ASSERT_EQ(0, deleted_keys_.size());
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        cache_->Release(handles[i]);
+    }
+    ASSERT_GT(deleted_keys_.size(), 0);
+    ASSERT_LT(deleted_keys_.size(), 4 * kCacheSize);
+
+    // The cache keeps working once the pins are gone
+    Insert(100000, 7);
+    ASSERT_EQ(7, Lookup(100000));
+}
+
+namespace
+{
+struct ClockThreadState
+{
+    Cache* cache;
+    port::AtomicPointer done;
+};
+
+static void IgnoreDeleter(const Slice& key, void* value)
+{
+}
+
+static void ClockLookupThread(void* arg)
+{
+    ClockThreadState* state = reinterpret_cast<ClockThreadState*>(arg);
+    Random rnd(301);
+    for (int i = 0; i < 100000; i++)
+    {
+        const int k = rnd.Uniform(200);
+        Cache::Handle* h = state->cache->Lookup(EncodeKey(k));
+        if (h != NULL)
+        {
+            ASSERT_EQ(k, DecodeValue(state->cache->Value(h)) % 1000);
+            state->cache->Release(h);
+        }
+        else
+        {
+            state->cache->Release(state->cache->Insert(
+                EncodeKey(k), EncodeValue(1000 * (i % 50) + k), 1,
+                &IgnoreDeleter));
+        }
+        if (rnd.OneIn(100))
+        {
+            state->cache->Erase(EncodeKey(k));
+        }
+    }
+    intptr_t done = reinterpret_cast<intptr_t>(state->done.Acquire_Load());
+    while (!state->done.CompareAndSwap(reinterpret_cast<void*>(done),
+                                       reinterpret_cast<void*>(done + 1)))
+    {
+        done = reinterpret_cast<intptr_t>(state->done.Acquire_Load());
+    }
+}
+}
+
+TEST(ClockCacheTest, ConcurrentUse)
+{
+    // Fewer slots than keys so that entries are evicted while looked up
+    Cache* cache = NewClockCache(100, 1);
+    ClockThreadState state;
+    state.cache = cache;
+    state.done.Release_Store(NULL);
+    const int kThreads = 4;
+    for (int i = 0; i < kThreads; i++)
+    {
+        Env::Default()->StartThread(ClockLookupThread, &state);
+    }
+    while (reinterpret_cast<intptr_t>(state.done.Acquire_Load()) < kThreads)
+    {
+        Env::Default()->SleepForMicroseconds(10000);
+    }
+    delete cache;
+}
+
 }
 
 int main(int argc, char** argv)
@@ -0,0 +1,533 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A Cache that replaces entries with the CLOCK algorithm.  Each shard
+// keeps its entries in a fixed array of slots addressed by open hashing.
+// Slots are never freed, only recycled, so Lookup() and Release() can
+// work on them with compare-and-swap alone.  The shard mutex is taken to
+// insert, erase or evict entries, and to free an erased entry whose last
+// handle is released.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+namespace
+{
+
+// A word that is read and updated atomically
+class AtomicWord
+{
+private:
+    port::AtomicPointer rep_;
+
+public:
+    AtomicWord() : rep_(NULL) { }
+    uintptr_t Load() const
+    {
+        return reinterpret_cast<uintptr_t>(rep_.Acquire_Load());
+    }
+    void Store(uintptr_t v)
+    {
+        rep_.Release_Store(reinterpret_cast<void*>(v));
+    }
+    bool CompareAndSwap(uintptr_t old_value, uintptr_t new_value)
+    {
+        return rep_.CompareAndSwap(reinterpret_cast<void*>(old_value),
+                                   reinterpret_cast<void*>(new_value));
+    }
+};
+
+// The state of a slot, its clock bit and the number of outstanding
+// handles share one word so that they change together.
+//
+//   kEmpty:        unused
+//   kConstruction: being filled or emptied by the holder of the mutex
+//   kVisible:      in the cache; lookups may take references
+//   kInvisible:    erased or replaced, but still referenced by handles
+static const int kStateShift = 30;
+static const uintptr_t kEmpty = 0;
+static const uintptr_t kConstruction = 1;
+static const uintptr_t kVisible = 2;
+static const uintptr_t kInvisible = 3;
+static const uintptr_t kClockBit = static_cast<uintptr_t>(1) << 29;
+static const uintptr_t kRefsMask = kClockBit - 1;
+
+static inline uintptr_t State(uintptr_t meta)
+{
+    return (meta >> kStateShift) & 3;
+}
+
+static inline uintptr_t Refs(uintptr_t meta)
+{
+    return meta & kRefsMask;
+}
+
+// Keys up to this size are stored in the slot itself
+static const size_t kInlineKeySize = 24;
+
+struct ClockHandle
+{
+    AtomicWord meta;
+    // Number of entries whose probe sequence passes over this slot to a
+    // later one.  Only changed with the mutex held.
+    AtomicWord displacements;
+    void* value;
+    void (*deleter)(const Slice&, void* value);
+    size_t charge;
+    char* key_data;
+    size_t key_length;
+    uint32_t hash;
+    bool detached;      // Allocated outside the table (see Insert())
+    char inline_key[kInlineKeySize];
+
+    Slice key() const
+    {
+        return Slice(key_data, key_length);
+    }
+};
+
+// A single shard of a sharded clock cache
+class ClockCacheShard
+{
+public:
+    ClockCacheShard();
+    ~ClockCacheShard();
+
+    // Separate from constructor so caller can easily make an array
+    void Init(size_t capacity, size_t estimated_entry_charge);
+
+    // Like Cache methods, but with an extra "hash" parameter.
+    Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                          void* value, size_t charge,
+                          void (*deleter)(const Slice& key, void* value));
+    Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+    void Release(Cache::Handle* handle);
+    void Erase(const Slice& key, uint32_t hash);
+
+private:
+    // Index of the i-th slot probed for "hash".  The step is odd and the
+    // table size a power of two, so every slot is eventually probed.
+    size_t Probe(uint32_t hash, size_t i) const
+    {
+        const size_t step = ((hash >> 16) | (hash << 16)) | 1;
+        return (hash + i * step) & (num_slots_ - 1);
+    }
+
+    // Take a reference on a visible slot.  Returns false if the slot
+    // stopped being visible.
+    static bool Ref(ClockHandle* h);
+
+    ClockHandle* FindVisible(const Slice& key, uint32_t hash);
+    void MakeInvisible(ClockHandle* h);
+    void Reclaim(ClockHandle* h);
+    bool EvictOne();
+    void FillEntry(ClockHandle* h, const Slice& key, uint32_t hash,
+                   void* value, size_t charge,
+                   void (*deleter)(const Slice& key, void* value));
+    static void FreeEntry(ClockHandle* h);
+    void RemoveSlot(ClockHandle* h);
+
+    // Initialized before use.
+    size_t capacity_;
+    size_t num_slots_;
+    size_t max_occupancy_;
+    ClockHandle* slots_;
+
+    // mutex_ protects the following state, and is required to move a
+    // slot out of or into kEmpty.
+    port::Mutex mutex_;
+    size_t usage_;
+    size_t occupancy_;
+    size_t clock_hand_;
+};
+
+ClockCacheShard::ClockCacheShard()
+    : capacity_(0),
+      num_slots_(0),
+      max_occupancy_(0),
+      slots_(NULL),
+      usage_(0),
+      occupancy_(0),
+      clock_hand_(0)
+{
+}
+
+ClockCacheShard::~ClockCacheShard()
+{
+    for (size_t i = 0; i < num_slots_; i++)
+    {
+        ClockHandle* h = &slots_[i];
+        uintptr_t meta = h->meta.Load();
+        // Error if caller has an unreleased handle
+        assert(Refs(meta) == 0);
+        if (State(meta) != kEmpty)
+        {
+            FreeEntry(h);
+        }
+    }
+    delete[] slots_;
+}
+
+void ClockCacheShard::Init(size_t capacity, size_t estimated_entry_charge)
+{
+    capacity_ = capacity;
+    // Keep the table at most 3/4 full so that probe sequences stay short
+    const size_t entries = capacity / estimated_entry_charge + 1;
+    num_slots_ = 16;
+    while (num_slots_ * 3 / 4 < entries)
+    {
+        num_slots_ *= 2;
+    }
+    max_occupancy_ = num_slots_ * 3 / 4;
+    slots_ = new ClockHandle[num_slots_];
+}
+
+bool ClockCacheShard::Ref(ClockHandle* h)
+{
+    uintptr_t meta = h->meta.Load();
+    while (State(meta) == kVisible)
+    {
+        if (h->meta.CompareAndSwap(meta, meta + 1))
+        {
+            return true;
+        }
+        meta = h->meta.Load();
+    }
+    return false;
+}
+
+Cache::Handle* ClockCacheShard::Lookup(const Slice& key, uint32_t hash)
+{
+    for (size_t i = 0; i < num_slots_; i++)
+    {
+        ClockHandle* h = &slots_[Probe(hash, i)];
+        // The key of a slot is only stable while we hold a reference
+        if (Ref(h))
+        {
+            if (h->hash == hash && h->key() == key)
+            {
+                // Mark the entry as recently used, unless it already is
+                uintptr_t meta = h->meta.Load();
+                while ((meta & kClockBit) == 0 && State(meta) == kVisible &&
+                        !h->meta.CompareAndSwap(meta, meta | kClockBit))
+                {
+                    meta = h->meta.Load();
+                }
+                return reinterpret_cast<Cache::Handle*>(h);
+            }
+            Release(reinterpret_cast<Cache::Handle*>(h));
+        }
+        if (h->displacements.Load() == 0)
+        {
+            // No entry for this hash was placed beyond this slot
+            break;
+        }
+    }
+    return NULL;
+}
+
+void ClockCacheShard::Release(Cache::Handle* handle)
+{
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    uintptr_t meta = h->meta.Load();
+    while (true)
+    {
+        assert(Refs(meta) > 0);
+        if (h->meta.CompareAndSwap(meta, meta - 1))
+        {
+            break;
+        }
+        meta = h->meta.Load();
+    }
+    if (Refs(meta) == 1 && State(meta) == kInvisible)
+    {
+        // We dropped the last reference to an erased entry
+        if (h->detached)
+        {
+            FreeEntry(h);
+            delete h;
+        }
+        else
+        {
+            MutexLock l(&mutex_);
+            Reclaim(h);
+        }
+    }
+}
+
+Cache::Handle* ClockCacheShard::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value))
+{
+    MutexLock l(&mutex_);
+
+    ClockHandle* old = FindVisible(key, hash);
+    if (old != NULL)
+    {
+        MakeInvisible(old);
+    }
+
+    while (usage_ + charge > capacity_ || occupancy_ >= max_occupancy_)
+    {
+        if (!EvictOne())
+        {
+            // Everything left is in use
+            break;
+        }
+    }
+
+    if (occupancy_ < num_slots_)
+    {
+        for (size_t i = 0; i < num_slots_; i++)
+        {
+            ClockHandle* h = &slots_[Probe(hash, i)];
+            if (State(h->meta.Load()) == kEmpty)
+            {
+                // No lookup can reference an empty slot, and we hold the
+                // mutex, so the slot is ours to fill.
+                h->meta.Store(kConstruction << kStateShift);
+                FillEntry(h, key, hash, value, charge, deleter);
+                h->detached = false;
+                usage_ += charge;
+                occupancy_++;
+                // One reference for the returned handle
+                h->meta.Store((kVisible << kStateShift) | 1);
+                return reinterpret_cast<Cache::Handle*>(h);
+            }
+            h->displacements.Store(h->displacements.Load() + 1);
+        }
+        assert(false);
+    }
+
+    // Every slot holds an entry that is still referenced.  Hand out an
+    // entry that is not in the table and is freed when released.
+    ClockHandle* h = new ClockHandle;
+    FillEntry(h, key, hash, value, charge, deleter);
+    h->detached = true;
+    h->meta.Store((kInvisible << kStateShift) | 1);
+    return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCacheShard::Erase(const Slice& key, uint32_t hash)
+{
+    MutexLock l(&mutex_);
+    ClockHandle* h = FindVisible(key, hash);
+    if (h != NULL)
+    {
+        MakeInvisible(h);
+    }
+}
+
+// REQUIRES: mutex_ is held
+ClockHandle* ClockCacheShard::FindVisible(const Slice& key, uint32_t hash)
+{
+    for (size_t i = 0; i < num_slots_; i++)
+    {
+        ClockHandle* h = &slots_[Probe(hash, i)];
+        // Keys only change with the mutex held, so they can be read
+        // without taking a reference.
+        if (State(h->meta.Load()) == kVisible &&
+                h->hash == hash && h->key() == key)
+        {
+            return h;
+        }
+        if (h->displacements.Load() == 0)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// REQUIRES: mutex_ is held
+void ClockCacheShard::MakeInvisible(ClockHandle* h)
+{
+    uintptr_t meta = h->meta.Load();
+    while (true)
+    {
+        assert(State(meta) == kVisible);
+        uintptr_t invisible = (kInvisible << kStateShift) | Refs(meta);
+        if (h->meta.CompareAndSwap(meta, invisible))
+        {
+            break;
+        }
+        meta = h->meta.Load();
+    }
+    Reclaim(h);
+}
+
+// Free "h" if it is erased and no longer referenced.
+// REQUIRES: mutex_ is held
+void ClockCacheShard::Reclaim(ClockHandle* h)
+{
+    uintptr_t meta = h->meta.Load();
+    if (State(meta) == kInvisible && Refs(meta) == 0 &&
+            h->meta.CompareAndSwap(meta, kConstruction << kStateShift))
+    {
+        RemoveSlot(h);
+    }
+}
+
+// Advance the clock hand to the next unreferenced entry whose clock bit
+// is clear, clearing the bits it passes, and evict that entry.
+// REQUIRES: mutex_ is held
+bool ClockCacheShard::EvictOne()
+{
+    for (size_t step = 0; step < 2 * num_slots_; step++)
+    {
+        ClockHandle* h = &slots_[clock_hand_];
+        clock_hand_ = (clock_hand_ + 1) & (num_slots_ - 1);
+        uintptr_t meta = h->meta.Load();
+        if (State(meta) != kVisible || Refs(meta) != 0)
+        {
+            continue;
+        }
+        if ((meta & kClockBit) != 0)
+        {
+            // Second chance.  A failed swap means a lookup just took a
+            // reference, so the entry is left alone either way.
+            h->meta.CompareAndSwap(meta, meta & ~kClockBit);
+            continue;
+        }
+        if (h->meta.CompareAndSwap(meta, kConstruction << kStateShift))
+        {
+            RemoveSlot(h);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ClockCacheShard::FillEntry(ClockHandle* h, const Slice& key, uint32_t hash,
+                                void* value, size_t charge,
+                                void (*deleter)(const Slice& key, void* value))
+{
+    h->value = value;
+    h->deleter = deleter;
+    h->charge = charge;
+    h->hash = hash;
+    h->key_length = key.size();
+    h->key_data = (key.size() <= kInlineKeySize)
+                  ? h->inline_key
+                  : reinterpret_cast<char*>(malloc(key.size()));
+    memcpy(h->key_data, key.data(), key.size());
+}
+
+void ClockCacheShard::FreeEntry(ClockHandle* h)
+{
+    (*h->deleter)(h->key(), h->value);
+    if (h->key_data != h->inline_key)
+    {
+        free(h->key_data);
+    }
+}
+
+// Free the entry in "h", which is in kConstruction, and empty the slot.
+// REQUIRES: mutex_ is held
+void ClockCacheShard::RemoveSlot(ClockHandle* h)
+{
+    for (size_t i = 0; i < num_slots_; i++)
+    {
+        ClockHandle* p = &slots_[Probe(h->hash, i)];
+        if (p == h)
+        {
+            break;
+        }
+        p->displacements.Store(p->displacements.Load() - 1);
+    }
+    usage_ -= h->charge;
+    occupancy_--;
+    FreeEntry(h);
+    h->meta.Store(kEmpty << kStateShift);
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedClockCache : public Cache
+{
+private:
+    ClockCacheShard shard_[kNumShards];
+    port::Mutex id_mutex_;
+    uint64_t last_id_;
+
+    static inline uint32_t HashSlice(const Slice& s)
+    {
+        return Hash(s.data(), s.size(), 0);
+    }
+
+    static uint32_t Shard(uint32_t hash)
+    {
+        return hash >> (32 - kNumShardBits);
+    }
+
+public:
+    ShardedClockCache(size_t capacity, size_t estimated_entry_charge)
+        : last_id_(0)
+    {
+        const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+        if (estimated_entry_charge == 0)
+        {
+            estimated_entry_charge = 1;
+        }
+        for (int s = 0; s < kNumShards; s++)
+        {
+            shard_[s].Init(per_shard, estimated_entry_charge);
+        }
+    }
+    virtual ~ShardedClockCache() { }
+    virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                           void (*deleter)(const Slice& key, void* value))
+    {
+        const uint32_t hash = HashSlice(key);
+        return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    }
+    virtual Handle* Lookup(const Slice& key)
+    {
+        const uint32_t hash = HashSlice(key);
+        return shard_[Shard(hash)].Lookup(key, hash);
+    }
+    virtual void Release(Handle* handle)
+    {
+        ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+        shard_[Shard(h->hash)].Release(handle);
+    }
+    virtual void Erase(const Slice& key)
+    {
+        const uint32_t hash = HashSlice(key);
+        shard_[Shard(hash)].Erase(key, hash);
+    }
+    virtual void* Value(Handle* handle)
+    {
+        return reinterpret_cast<ClockHandle*>(handle)->value;
+    }
+    virtual uint64_t NewId()
+    {
+        MutexLock l(&id_mutex_);
+        return ++(last_id_);
+    }
+};
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge)
+{
+    return new ShardedClockCache(capacity, estimated_entry_charge);
+}
+
+Cache* NewClockCache(size_t capacity)
+{
+    return NewClockCache(capacity, 4096);
+}
+
+}
@@ -0,0 +1,134 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Segments are scored by the d-mers (substrings of kDmerLength bytes) they
+// hold, each worth the number of samples it occurs in.  Segments are
+// picked greedily, best first; the d-mers of a picked segment are worth
+// nothing from then on, so that later picks add what is still missing.
+
+#include "util/compression_dict.h"
+
+#include <stdint.h>
+#include <queue>
+#include "util/hash.h"
+
+namespace leveldb
+{
+
+namespace
+{
+static const size_t kDmerLength = 8;
+static const size_t kSegmentLength = 64;
+static const size_t kSegmentStep = 32;     // Between candidate segments
+static const int kHashBits = 18;
+
+// Segments that score less share too little with other samples to be
+// worth having; a few d-mers in common may well be hash collisions.
+static const uint64_t kMinScore = kSegmentLength;
+
+struct Candidate
+{
+    uint64_t score;
+    size_t sample;
+    size_t start;
+
+    // Orders a priority_queue best first, then by position
+    bool operator<(const Candidate& c) const
+    {
+        if (score != c.score) return score < c.score;
+        if (sample != c.sample) return sample > c.sample;
+        return start > c.start;
+    }
+};
+
+// Sum of the worth of the d-mers in the segment at "start", whose hashes
+// are hashes[start..]
+static uint64_t Score(const std::vector<uint32_t>& hashes, size_t start,
+                      const std::vector<uint32_t>& worth)
+{
+    uint64_t score = 0;
+    for (size_t i = 0; i + kDmerLength <= kSegmentLength; i++)
+    {
+        score += worth[hashes[start + i]];
+    }
+    return score;
+}
+}
+
+void BuildCompressionDictionary(const std::vector<Slice>& samples,
+                                size_t max_size,
+                                std::string* dictionary)
+{
+    dictionary->clear();
+
+    // Hash every d-mer and count the samples it occurs in
+    std::vector<std::vector<uint32_t> > hashes(samples.size());
+    std::vector<uint32_t> worth(1 << kHashBits, 0);
+    std::vector<uint32_t> last_sample(1 << kHashBits, 0);
+    for (size_t s = 0; s < samples.size(); s++)
+    {
+        const Slice& sample = samples[s];
+        for (size_t i = 0; i + kDmerLength <= sample.size(); i++)
+        {
+            const uint32_t h = Hash(sample.data() + i, kDmerLength, 0) >>
+                               (32 - kHashBits);
+            hashes[s].push_back(h);
+            if (last_sample[h] != s + 1)
+            {
+                last_sample[h] = static_cast<uint32_t>(s + 1);
+                worth[h]++;
+            }
+        }
+    }
+    // What only one sample holds does not help the others
+    for (size_t h = 0; h < worth.size(); h++)
+    {
+        if (worth[h] < 2) worth[h] = 0;
+    }
+
+    std::priority_queue<Candidate> queue;
+    for (size_t s = 0; s < samples.size(); s++)
+    {
+        for (size_t start = 0;
+                start + kSegmentLength <= samples[s].size();
+                start += kSegmentStep)
+        {
+            Candidate c;
+            c.score = Score(hashes[s], start, worth);
+            c.sample = s;
+            c.start = start;
+            if (c.score >= kMinScore) queue.push(c);
+        }
+    }
+
+    std::vector<Candidate> picked;
+    while (!queue.empty() &&
+            (picked.size() + 1) * kSegmentLength <= max_size)
+    {
+        Candidate c = queue.top();
+        queue.pop();
+        // Scores only drop as segments are picked, so the best candidate
+        // is only known to be best once its score is current.
+        const uint64_t score = Score(hashes[c.sample], c.start, worth);
+        if (score < c.score)
+        {
+            c.score = score;
+            if (score >= kMinScore) queue.push(c);
+            continue;
+        }
+        picked.push_back(c);
+        for (size_t i = 0; i + kDmerLength <= kSegmentLength; i++)
+        {
+            worth[hashes[c.sample][c.start + i]] = 0;
+        }
+    }
+
+    for (size_t i = picked.size(); i > 0; i--)
+    {
+        const Candidate& c = picked[i - 1];
+        dictionary->append(samples[c.sample].data() + c.start, kSegmentLength);
+    }
+}
+
+}
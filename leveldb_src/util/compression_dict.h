@@ -0,0 +1,31 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Builds compression dictionaries out of sample data.  The dictionary is
+// made of short segments of the samples that hold the most substrings
+// common to many samples, so that compressing a sample against it finds
+// matches for what the samples share.
+
+#ifndef STORAGE_LEVELDB_UTIL_COMPRESSION_DICT_H_
+#define STORAGE_LEVELDB_UTIL_COMPRESSION_DICT_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "leveldb/slice.h"
+
+namespace leveldb
+{
+
+// Store a dictionary of at most "max_size" bytes for data like "samples"
+// in *dictionary.  Its most useful segments come last, where they are
+// closest to the data compressed against it.  The dictionary is empty if
+// the samples have nothing in common.
+extern void BuildCompressionDictionary(const std::vector<Slice>& samples,
+                                       size_t max_size,
+                                       std::string* dictionary);
+
+}
+
+#endif  // STORAGE_LEVELDB_UTIL_COMPRESSION_DICT_H_
@@ -0,0 +1,296 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/compressor.h"
+
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/lz4.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+Compressor::~Compressor() { }
+
+bool Compressor::SupportsDictionary() const
+{
+    return false;
+}
+
+bool Compressor::CompressWithDictionary(const char* input, size_t length,
+                                        const Slice& dictionary,
+                                        std::string* output) const
+{
+    return Compress(input, length, output);
+}
+
+bool Compressor::UncompressWithDictionary(const char* input, size_t length,
+                                          const Slice& dictionary,
+                                          char* output) const
+{
+    return Uncompress(input, length, output);
+}
+
+namespace
+{
+class SnappyCompressor : public Compressor
+{
+public:
+    virtual CompressionType type() const
+    {
+        return kSnappyCompression;
+    }
+
+    virtual const char* Name() const
+    {
+        return "leveldb.Snappy";
+    }
+
+    virtual bool Compress(const char* input, size_t length,
+                          std::string* output) const
+    {
+        return port::Snappy_Compress(input, length, output);
+    }
+
+    virtual bool GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) const
+    {
+        return port::Snappy_GetUncompressedLength(input, length, result);
+    }
+
+    virtual bool Uncompress(const char* input, size_t length,
+                            char* output) const
+    {
+        return port::Snappy_Uncompress(input, length, output);
+    }
+};
+
+// The LZ4 block format does not record the uncompressed length, so it is
+// stored in front of the compressed data as a varint32; what follows is a
+// plain LZ4 block (see util/lz4.h).  A dictionary is
+// used as a prefix of the input that matches may refer back into.
+class LZ4Compressor : public Compressor
+{
+private:
+    const bool high_;
+
+    // The last part of "dictionary" that matches can refer to
+    static Slice UsableDictionary(const Slice& dictionary)
+    {
+        const size_t kMaxDictionary = 65535;
+        if (dictionary.size() <= kMaxDictionary)
+        {
+            return dictionary;
+        }
+        return Slice(dictionary.data() + dictionary.size() - kMaxDictionary,
+                     kMaxDictionary);
+    }
+
+    // Compress input[0,length-1], which "prefix" bytes of dictionary
+    // precede in memory, into *output.
+    bool CompressPrefixed(const char* input, size_t length, size_t prefix,
+                          std::string* output) const
+    {
+        if (length > 0xffffffffu)
+        {
+            return false;
+        }
+        output->clear();
+        PutVarint32(output, static_cast<uint32_t>(length));
+        const size_t header = output->size();
+        output->resize(header + lz4::MaxCompressedLength(length));
+        char* dst = &(*output)[header];
+        const size_t n = high_
+                         ? lz4::CompressHCWithPrefix(input, length, prefix, dst)
+                         : lz4::CompressWithPrefix(input, length, prefix, dst);
+        output->resize(header + n);
+        return true;
+    }
+
+public:
+    explicit LZ4Compressor(bool high)
+        : high_(high)
+    {
+    }
+
+    virtual CompressionType type() const
+    {
+        return high_ ? kLZ4HCCompression : kLZ4Compression;
+    }
+
+    virtual const char* Name() const
+    {
+        return high_ ? "leveldb.LZ4HC" : "leveldb.LZ4";
+    }
+
+    virtual bool Compress(const char* input, size_t length,
+                          std::string* output) const
+    {
+        return CompressPrefixed(input, length, 0, output);
+    }
+
+    virtual bool GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) const
+    {
+        uint32_t v;
+        if (GetVarint32Ptr(input, input + length, &v) == NULL)
+        {
+            return false;
+        }
+        *result = v;
+        return true;
+    }
+
+    virtual bool Uncompress(const char* input, size_t length,
+                            char* output) const
+    {
+        uint32_t v;
+        const char* p = GetVarint32Ptr(input, input + length, &v);
+        if (p == NULL)
+        {
+            return false;
+        }
+        return lz4::Uncompress(p, input + length - p, output, v);
+    }
+
+    virtual bool SupportsDictionary() const
+    {
+        return true;
+    }
+
+    virtual bool CompressWithDictionary(const char* input, size_t length,
+                                        const Slice& dictionary,
+                                        std::string* output) const
+    {
+        // The matcher needs the dictionary right before the input
+        const Slice dict = UsableDictionary(dictionary);
+        std::string buffer;
+        buffer.reserve(dict.size() + length);
+        buffer.append(dict.data(), dict.size());
+        buffer.append(input, length);
+        return CompressPrefixed(buffer.data() + dict.size(), length,
+                                dict.size(), output);
+    }
+
+    virtual bool UncompressWithDictionary(const char* input, size_t length,
+                                          const Slice& dictionary,
+                                          char* output) const
+    {
+        uint32_t v;
+        const char* p = GetVarint32Ptr(input, input + length, &v);
+        if (p == NULL)
+        {
+            return false;
+        }
+        const Slice dict = UsableDictionary(dictionary);
+        return lz4::UncompressWithDictionary(p, input + length - p,
+                                             dict.data(), dict.size(),
+                                             output, v);
+    }
+};
+
+// The zstd frame format records the uncompressed length itself, so the
+// output is a plain zstd frame.  A dictionary is loaded as raw content
+// that matches may refer back into.
+class ZstdCompressor : public Compressor
+{
+private:
+    // Compression level.  On blocks of a few KB, higher levels take two to
+    // five times the CPU to save another 1-2%.
+    static const int kLevel = 6;
+
+public:
+    virtual CompressionType type() const
+    {
+        return kZstdCompression;
+    }
+
+    virtual const char* Name() const
+    {
+        return "leveldb.Zstd";
+    }
+
+    virtual bool Compress(const char* input, size_t length,
+                          std::string* output) const
+    {
+        return port::Zstd_Compress(input, length, NULL, 0, kLevel, output);
+    }
+
+    virtual bool GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) const
+    {
+        return port::Zstd_GetUncompressedLength(input, length, result);
+    }
+
+    virtual bool Uncompress(const char* input, size_t length,
+                            char* output) const
+    {
+        return port::Zstd_Uncompress(input, length, NULL, 0, output);
+    }
+
+    virtual bool SupportsDictionary() const
+    {
+        return true;
+    }
+
+    virtual bool CompressWithDictionary(const char* input, size_t length,
+                                        const Slice& dictionary,
+                                        std::string* output) const
+    {
+        return port::Zstd_Compress(input, length, dictionary.data(),
+                                   dictionary.size(), kLevel, output);
+    }
+
+    virtual bool UncompressWithDictionary(const char* input, size_t length,
+                                          const Slice& dictionary,
+                                          char* output) const
+    {
+        return port::Zstd_Uncompress(input, length, dictionary.data(),
+                                     dictionary.size(), output);
+    }
+};
+
+static const SnappyCompressor snappy_compressor;
+static const LZ4Compressor lz4_compressor(false);
+static const LZ4Compressor lz4hc_compressor(true);
+static const ZstdCompressor zstd_compressor;
+
+// Indexed by type.  Readers look up compressors without locking; a slot
+// is only ever written once, by RegisterCompressor() under the mutex.
+static const Compressor* registry[256] =
+{
+    NULL,
+    &snappy_compressor,
+    &lz4_compressor,
+    &lz4hc_compressor,
+    &zstd_compressor
+};
+static port::Mutex registry_mutex;
+}
+
+Status RegisterCompressor(const Compressor* compressor)
+{
+    const int type = compressor->type();
+    if (type < kCustomCompressionMin || type > kCustomCompressionMax)
+    {
+        return Status::InvalidArgument(compressor->Name(),
+                                       "compression type is not a custom type");
+    }
+    MutexLock l(&registry_mutex);
+    if (registry[type] != NULL)
+    {
+        return Status::InvalidArgument(compressor->Name(),
+                                       "compression type is already registered");
+    }
+    registry[type] = compressor;
+    return Status::OK();
+}
+
+const Compressor* GetCompressor(CompressionType type)
+{
+    return registry[type & 0xff];
+}
+
+}
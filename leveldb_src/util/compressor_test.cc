@@ -0,0 +1,425 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/compressor.h"
+
+#include <algorithm>
+#include "port/port.h"
+#include "util/compression_dict.h"
+#include "util/lz4.h"
+#include "util/random.h"
+#include "util/testharness.h"
+#include "util/testutil.h"
+
+namespace leveldb
+{
+
+class CompressorTest { };
+
+// Compress "input" with the compressor for "type", check that it comes
+// back unchanged and return the compressed size.
+static size_t RoundTrip(CompressionType type, const std::string& input)
+{
+    const Compressor* c = GetCompressor(type);
+    ASSERT_TRUE(c != NULL);
+    ASSERT_EQ(type, c->type());
+    std::string compressed;
+    ASSERT_TRUE(c->Compress(input.data(), input.size(), &compressed));
+    size_t ulength = 0;
+    ASSERT_TRUE(c->GetUncompressedLength(compressed.data(), compressed.size(),
+                                         &ulength));
+    ASSERT_EQ(input.size(), ulength);
+    std::string output(ulength, 'x');
+    ASSERT_TRUE(c->Uncompress(compressed.data(), compressed.size(),
+                              &output[0]));
+    ASSERT_TRUE(output == input);
+    return compressed.size();
+}
+
+TEST(CompressorTest, Builtins)
+{
+    ASSERT_TRUE(GetCompressor(kNoCompression) == NULL);
+    ASSERT_TRUE(GetCompressor(kSnappyCompression) != NULL);
+    ASSERT_TRUE(GetCompressor(kLZ4Compression) != NULL);
+    ASSERT_TRUE(GetCompressor(kLZ4HCCompression) != NULL);
+    ASSERT_TRUE(GetCompressor(kZstdCompression) != NULL);
+    ASSERT_TRUE(GetCompressor(kCustomCompressionMax) == NULL);
+}
+
+// JSON-like records of the same few fields with different values
+static std::string Record(Random* rnd, int i)
+{
+    char buf[200];
+    snprintf(buf, sizeof(buf),
+             "{\"id\":%d,\"user\":\"user%05d\",\"status\":\"%s\","
+             "\"score\":%d,\"tags\":[\"alpha\",\"beta\"]}",
+             i, static_cast<int>(rnd->Uniform(100000)),
+             rnd->OneIn(2) ? "active" : "inactive",
+             static_cast<int>(rnd->Uniform(1000)));
+    return buf;
+}
+
+static bool ZstdCompressionSupported()
+{
+    std::string out;
+    Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    return port::Zstd_Compress(in.data(), in.size(), NULL, 0, 1, &out);
+}
+
+TEST(CompressorTest, LZ4RoundTrip)
+{
+    Random rnd(301);
+    std::string input;
+    for (int len = 0; len < 40; len++)
+    {
+        input.assign(len, 'a');
+        RoundTrip(kLZ4Compression, input);
+        RoundTrip(kLZ4HCCompression, input);
+        test::RandomString(&rnd, len, &input);
+        RoundTrip(kLZ4Compression, input);
+        RoundTrip(kLZ4HCCompression, input);
+    }
+    for (int i = 0; i < 50; i++)
+    {
+        const int len = rnd.Skewed(17);
+        test::CompressibleString(&rnd, 0.1 * (1 + rnd.Uniform(9)), len, &input);
+        RoundTrip(kLZ4Compression, input);
+        RoundTrip(kLZ4HCCompression, input);
+    }
+
+    // Long runs and literals need the extended length bytes
+    input.assign(100000, 'z');
+    ASSERT_LT(RoundTrip(kLZ4Compression, input), 1000);
+    test::RandomString(&rnd, 100000, &input);
+    ASSERT_LT(RoundTrip(kLZ4Compression, input), 100500);
+}
+
+TEST(CompressorTest, LZ4HCCompressesHarder)
+{
+    Random rnd(301);
+    std::string input, piece;
+    while (input.size() < 64 * 1024)
+    {
+        test::CompressibleString(&rnd, 0.5, 1000, &piece);
+        input += piece;
+        input += test::RandomKey(&rnd, 20);
+    }
+    const size_t fast = RoundTrip(kLZ4Compression, input);
+    const size_t high = RoundTrip(kLZ4HCCompression, input);
+    fprintf(stderr, "%d bytes: lz4 %d, lz4hc %d\n",
+            static_cast<int>(input.size()),
+            static_cast<int>(fast), static_cast<int>(high));
+    ASSERT_LT(fast, input.size());
+    ASSERT_LE(high, fast);
+}
+
+TEST(CompressorTest, ZstdRoundTrip)
+{
+    if (!ZstdCompressionSupported())
+    {
+        fprintf(stderr, "skipping zstd tests\n");
+        return;
+    }
+
+    Random rnd(301);
+    std::string input;
+    for (int len = 0; len < 40; len++)
+    {
+        input.assign(len, 'a');
+        RoundTrip(kZstdCompression, input);
+        test::RandomString(&rnd, len, &input);
+        RoundTrip(kZstdCompression, input);
+    }
+    for (int i = 0; i < 50; i++)
+    {
+        const int len = rnd.Skewed(17);
+        test::CompressibleString(&rnd, 0.1 * (1 + rnd.Uniform(9)), len, &input);
+        RoundTrip(kZstdCompression, input);
+    }
+    input.assign(100000, 'z');
+    ASSERT_LT(RoundTrip(kZstdCompression, input), 100);
+
+    // Truncated or corrupted input is rejected, not overrun
+    test::CompressibleString(&rnd, 0.25, 10000, &input);
+    const Compressor* c = GetCompressor(kZstdCompression);
+    std::string compressed;
+    ASSERT_TRUE(c->Compress(input.data(), input.size(), &compressed));
+    std::string output(input.size(), 'x');
+    for (size_t n = 1; n < compressed.size(); n += 7)
+    {
+        size_t ulength;
+        if (c->GetUncompressedLength(compressed.data(), n, &ulength))
+        {
+            ASSERT_TRUE(!c->Uncompress(compressed.data(), n, &output[0]));
+        }
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string bad = compressed;
+        bad[rnd.Uniform(bad.size())] ^= 1 << rnd.Uniform(8);
+        size_t ulength;
+        if (c->GetUncompressedLength(bad.data(), bad.size(), &ulength) &&
+                ulength <= output.size())
+        {
+            c->Uncompress(bad.data(), bad.size(), &output[0]);
+        }
+    }
+}
+
+TEST(CompressorTest, ZstdCompressesHarderThanLZ4HC)
+{
+    if (!ZstdCompressionSupported())
+    {
+        fprintf(stderr, "skipping zstd tests\n");
+        return;
+    }
+
+    // Table-sized blocks of text and of records
+    Random rnd(301);
+    std::string text, records, piece;
+    while (text.size() < 4096)
+    {
+        test::CompressibleString(&rnd, 0.5, 1000, &piece);
+        text += piece;
+    }
+    text.resize(4096);
+    for (int i = 0; records.size() < 4096; i++)
+    {
+        records += Record(&rnd, i);
+    }
+    records.resize(4096);
+
+    const std::string* inputs[] = { &text, &records };
+    for (int i = 0; i < 2; i++)
+    {
+        const size_t high = RoundTrip(kLZ4HCCompression, *inputs[i]);
+        const size_t zstd = RoundTrip(kZstdCompression, *inputs[i]);
+        fprintf(stderr, "%d bytes: lz4hc %d, zstd %d\n",
+                static_cast<int>(inputs[i]->size()),
+                static_cast<int>(high), static_cast<int>(zstd));
+        ASSERT_LT(zstd, high * 9 / 10);
+    }
+}
+
+TEST(CompressorTest, LZ4Corruption)
+{
+    Random rnd(301);
+    std::string input;
+    test::CompressibleString(&rnd, 0.25, 10000, &input);
+    const Compressor* c = GetCompressor(kLZ4Compression);
+    std::string compressed;
+    ASSERT_TRUE(c->Compress(input.data(), input.size(), &compressed));
+    std::string output(input.size(), 'x');
+
+    // Any truncation loses part of the output
+    for (size_t n = 1; n < compressed.size(); n += 7)
+    {
+        size_t ulength;
+        if (c->GetUncompressedLength(compressed.data(), n, &ulength))
+        {
+            ASSERT_TRUE(!c->Uncompress(compressed.data(), n, &output[0]));
+        }
+    }
+
+    // Corrupted bytes must not make the decoder overrun its buffers
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string bad = compressed;
+        bad[1 + rnd.Uniform(bad.size() - 1)] ^= 1 << rnd.Uniform(8);
+        c->Uncompress(bad.data(), bad.size(), &output[0]);
+    }
+}
+
+// Blocks written by the reference LZ4 library (version 1.9.4), which the
+// blocks of kLZ4Compression and kLZ4HCCompression tables have to match
+TEST(CompressorTest, LZ4ReferenceFormat)
+{
+    const std::string input =
+        "leveldb stores keys in sorted order; leveldb stores values next to "
+        "their keys; leveldb stores keys and values in sorted tables. "
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa end";
+    // LZ4_compress_default(); LZ4_compress_HC() at level 12 writes the same
+    static const char kBlock[] =
+        "\xfb\x16leveldb stores keys in sorted order; %\x00\xf1\x05values next"
+        " to their:\x00\x0d*\x00\x01O\x00" "4and3\x00\x06Z\x00\x9ftables. a"
+        "\x01\x00\x13Pa end";
+    std::string output(input.size(), 'x');
+    ASSERT_TRUE(lz4::Uncompress(kBlock, sizeof(kBlock) - 1,
+                                &output[0], output.size()));
+    ASSERT_TRUE(output == input);
+    ASSERT_TRUE(!lz4::Uncompress(kBlock, sizeof(kBlock) - 1,
+                                 &output[0], output.size() - 1));
+
+    // LZ4_compress_fast_continue() after LZ4_loadDict()
+    const std::string dictionary =
+        "sorted tables hold keys and values in sorted order. ";
+    const std::string dict_input =
+        "keys and values in sorted tables, in sorted order.";
+    static const char kDictBlock[] =
+        "\x0f!\x00\x07xtables,3\x00Prder.";
+    output.assign(dict_input.size(), 'x');
+    ASSERT_TRUE(lz4::UncompressWithDictionary(kDictBlock,
+                                              sizeof(kDictBlock) - 1,
+                                              dictionary.data(),
+                                              dictionary.size(),
+                                              &output[0], output.size()));
+    ASSERT_TRUE(output == dict_input);
+}
+
+TEST(CompressorTest, Dictionary)
+{
+    Random rnd(301);
+    std::vector<std::string> blocks(20);
+    std::vector<Slice> samples;
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        while (blocks[b].size() < 500)
+        {
+            blocks[b] += Record(&rnd, b * 10 + blocks[b].size() % 7);
+        }
+        samples.push_back(blocks[b]);
+    }
+    std::string dictionary;
+    BuildCompressionDictionary(samples, 1024, &dictionary);
+    ASSERT_GT(dictionary.size(), 0);
+    ASSERT_LE(dictionary.size(), 1024);
+
+    // Samples with nothing in common give nothing to build one from
+    std::string unique;
+    std::vector<Slice> random_samples;
+    test::RandomString(&rnd, 4000, &unique);
+    for (int i = 0; i < 4; i++)
+    {
+        random_samples.push_back(Slice(unique.data() + i * 1000, 1000));
+    }
+    std::string empty;
+    BuildCompressionDictionary(random_samples, 1024, &empty);
+    ASSERT_EQ(0, empty.size());
+
+    const CompressionType types[] =
+    {
+        kLZ4Compression, kLZ4HCCompression, kZstdCompression
+    };
+    const int num_types = ZstdCompressionSupported() ? 3 : 2;
+    for (int t = 0; t < num_types; t++)
+    {
+        const Compressor* c = GetCompressor(types[t]);
+        ASSERT_TRUE(c->SupportsDictionary());
+        for (size_t b = 0; b < blocks.size(); b++)
+        {
+            const std::string& input = Record(&rnd, b) + blocks[b];
+            std::string plain, compressed;
+            ASSERT_TRUE(c->Compress(input.data(), input.size(), &plain));
+            ASSERT_TRUE(c->CompressWithDictionary(input.data(), input.size(),
+                                                  dictionary, &compressed));
+            ASSERT_LT(compressed.size(), plain.size());
+            std::string output(input.size(), 'x');
+            ASSERT_TRUE(c->UncompressWithDictionary(
+                            compressed.data(), compressed.size(),
+                            dictionary, &output[0]));
+            ASSERT_TRUE(output == input);
+
+            // The data refers to the dictionary, which cannot be left out
+            if (c->Uncompress(compressed.data(), compressed.size(),
+                              &output[0]))
+            {
+                ASSERT_TRUE(output != input);
+            }
+        }
+
+        // Matches may run from the dictionary on into the output
+        const std::string input = dictionary.substr(dictionary.size() - 20) +
+                                  dictionary.substr(dictionary.size() - 20);
+        std::string compressed;
+        ASSERT_TRUE(c->CompressWithDictionary(input.data(), input.size(),
+                                              dictionary, &compressed));
+        std::string output(input.size(), 'x');
+        ASSERT_TRUE(c->UncompressWithDictionary(compressed.data(),
+                                                compressed.size(),
+                                                dictionary, &output[0]));
+        ASSERT_TRUE(output == input);
+    }
+
+    // Compressors without dictionary support ignore it
+    const Compressor* snappy = GetCompressor(kSnappyCompression);
+    ASSERT_TRUE(!snappy->SupportsDictionary());
+    std::string compressed;
+    if (snappy->CompressWithDictionary(blocks[0].data(), blocks[0].size(),
+                                       dictionary, &compressed))
+    {
+        std::string output(blocks[0].size(), 'x');
+        ASSERT_TRUE(snappy->Uncompress(compressed.data(), compressed.size(),
+                                       &output[0]));
+        ASSERT_TRUE(output == blocks[0]);
+    }
+}
+
+namespace
+{
+class ReversingCompressor : public Compressor
+{
+public:
+    virtual CompressionType type() const
+    {
+        return static_cast<CompressionType>(0x90);
+    }
+
+    virtual const char* Name() const
+    {
+        return "test.Reversing";
+    }
+
+    virtual bool Compress(const char* input, size_t length,
+                          std::string* output) const
+    {
+        output->assign(input, length);
+        std::reverse(output->begin(), output->end());
+        return true;
+    }
+
+    virtual bool GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) const
+    {
+        *result = length;
+        return true;
+    }
+
+    virtual bool Uncompress(const char* input, size_t length,
+                            char* output) const
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            output[i] = input[length - 1 - i];
+        }
+        return true;
+    }
+};
+
+class BuiltinTypeCompressor : public ReversingCompressor
+{
+public:
+    virtual CompressionType type() const
+    {
+        return kLZ4Compression;
+    }
+};
+}
+
+TEST(CompressorTest, Register)
+{
+    static ReversingCompressor reversing;
+    static BuiltinTypeCompressor builtin;
+    ASSERT_TRUE(!RegisterCompressor(&builtin).ok());
+    ASSERT_TRUE(RegisterCompressor(&reversing).ok());
+    ASSERT_TRUE(!RegisterCompressor(&reversing).ok());
+    ASSERT_TRUE(GetCompressor(reversing.type()) == &reversing);
+    RoundTrip(reversing.type(), "hello world");
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    return leveldb::test::RunAllTests();
+}
@@ -3,13 +3,27 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 //
 // A portable implementation of crc32c, optimized to handle
-// four bytes at a time.
+// four bytes at a time, and one for x86-64 CPUs with SSE4.2 that is
+// used when CPUID reports the crc32 instruction.
 
 #include "util/crc32c.h"
 
 #include <stdint.h>
+#include <string.h>
 #include "util/coding.h"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define LEVELDB_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define LEVELDB_TARGET_SSE42
+#else
+#include <cpuid.h>
+#define LEVELDB_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
 namespace leveldb
 {
 namespace crc32c
@@ -290,7 +304,7 @@ static inline uint32_t LE_LOAD32(const uint8_t *p)
     return DecodeFixed32(reinterpret_cast<const char*>(p));
 }
 
-uint32_t Extend(uint32_t crc, const char* buf, size_t size)
+uint32_t ExtendPortable(uint32_t crc, const char* buf, size_t size)
 {
     const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
     const uint8_t *e = p + size;
@@ -344,5 +358,171 @@ uint32_t Extend(uint32_t crc, const char* buf, size_t size)
     return l ^ 0xffffffffu;
 }
 
+#ifdef LEVELDB_CRC32C_SSE42
+
+// Buffers are split into three streams of equal length whose crcs the
+// CPU computes in parallel, since the crc32 instruction has a latency of
+// three cycles but can start every cycle.  The crcs of the streams are
+// then combined by shifting each over the length of the data after it.
+// Long buffers use long streams; the rest of them, and medium-sized
+// buffers, short ones.
+static const size_t kLongStream = 1024;
+static const size_t kShortStream = 128;
+
+// The crc state after "n" zero bytes are fed to a state "x" (without
+// the inversions done by Extend()) is linear in x.  Such a shift is
+// done with four lookups in a table built for "n".
+struct ShiftTable
+{
+    uint32_t t[4][256];
+
+    void Init(size_t n)
+    {
+        // Shift the 32 unit vectors and combine them for each byte value
+        uint32_t unit[32];
+        for (int i = 0; i < 32; i++)
+        {
+            uint32_t l = 1u << i;
+            for (size_t j = 0; j < n; j++)
+            {
+                l = table0_[l & 0xff] ^ (l >> 8);
+            }
+            unit[i] = l;
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            for (int v = 0; v < 256; v++)
+            {
+                uint32_t r = 0;
+                for (int b = 0; b < 8; b++)
+                {
+                    if (v & (1 << b)) r ^= unit[8 * k + b];
+                }
+                t[k][v] = r;
+            }
+        }
+    }
+
+    uint32_t Shift(uint32_t x) const
+    {
+        return t[0][x & 0xff] ^ t[1][(x >> 8) & 0xff] ^
+               t[2][(x >> 16) & 0xff] ^ t[3][x >> 24];
+    }
+};
+
+static ShiftTable long_shift;
+static ShiftTable short_shift;
+
+static inline uint64_t Load64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Feed the buffer at *p to the state l in groups of three streams of
+// "n" bytes each, for as long as it holds at least one group.
+LEVELDB_TARGET_SSE42
+static uint64_t Extend3Way(uint64_t l, const uint8_t** p, const uint8_t* e,
+                           size_t n, const ShiftTable& shift)
+{
+    const uint8_t* q = *p;
+    while (static_cast<size_t>(e - q) >= 3 * n)
+    {
+        uint64_t c0 = l;
+        uint64_t c1 = 0;
+        uint64_t c2 = 0;
+        for (size_t i = 0; i < n; i += 8)
+        {
+            c0 = _mm_crc32_u64(c0, Load64(q + i));
+            c1 = _mm_crc32_u64(c1, Load64(q + n + i));
+            c2 = _mm_crc32_u64(c2, Load64(q + 2 * n + i));
+        }
+        l = shift.Shift(shift.Shift(static_cast<uint32_t>(c0)) ^
+                        static_cast<uint32_t>(c1)) ^ static_cast<uint32_t>(c2);
+        q += 3 * n;
+    }
+    *p = q;
+    return l;
+}
+
+LEVELDB_TARGET_SSE42
+static uint32_t ExtendSSE42(uint32_t crc, const char* buf, size_t size)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(buf);
+    const uint8_t *e = p + size;
+    uint64_t l = crc ^ 0xffffffffu;
+
+    // Process bytes until finished or p is 8-byte aligned
+    while (p != e && (reinterpret_cast<uintptr_t>(p) & 7) != 0)
+    {
+        l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+    }
+    l = Extend3Way(l, &p, e, kLongStream, long_shift);
+    l = Extend3Way(l, &p, e, kShortStream, short_shift);
+    // Process bytes 8 at a time
+    while ((e - p) >= 8)
+    {
+        l = _mm_crc32_u64(l, Load64(p));
+        p += 8;
+    }
+    // Process the last few bytes
+    while (p != e)
+    {
+        l = _mm_crc32_u8(static_cast<uint32_t>(l), *p++);
+    }
+    return static_cast<uint32_t>(l) ^ 0xffffffffu;
+}
+
+static bool CPUHasSSE42()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2) != 0;
+#endif
+}
+
+#endif  // LEVELDB_CRC32C_SSE42
+
+typedef uint32_t (*ExtendFunction)(uint32_t crc, const char* buf, size_t size);
+
+// Statically initialized, so that crcs computed before the check below
+// has run are correct as well
+static ExtendFunction extend_function = ExtendPortable;
+
+namespace
+{
+// Switches to the crc32 instruction before main() if the CPU has it
+struct ChooseExtendFunction
+{
+    ChooseExtendFunction()
+    {
+#ifdef LEVELDB_CRC32C_SSE42
+        if (CPUHasSSE42())
+        {
+            long_shift.Init(kLongStream);
+            short_shift.Init(kShortStream);
+            extend_function = ExtendSSE42;
+        }
+#endif
+    }
+};
+static ChooseExtendFunction choose_extend_function;
+}
+
+uint32_t Extend(uint32_t crc, const char* buf, size_t size)
+{
+    return extend_function(crc, buf, size);
+}
+
+bool IsHardwareAccelerated()
+{
+    return extend_function != ExtendPortable;
+}
+
 }
 }
@@ -16,8 +16,17 @@ namespace crc32c
 // Return the crc32c of concat(A, data[0,n-1]) where init_crc is the
 // crc32c of some string A.  Extend() is often used to maintain the
 // crc32c of a stream of data.
+//
+// On x86-64 CPUs with SSE4.2 this uses the crc32 instruction, and
+// ExtendPortable() otherwise.
 extern uint32_t Extend(uint32_t init_crc, const char* data, size_t n);
 
+// The table-driven implementation that works everywhere
+extern uint32_t ExtendPortable(uint32_t init_crc, const char* data, size_t n);
+
+// Return true if Extend() uses the crc32 instruction of this CPU.
+extern bool IsHardwareAccelerated();
+
 // Return the crc32c of data[0,n-1]
 inline uint32_t Value(const char* data, size_t n)
 {
@@ -3,7 +3,11 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "util/crc32c.h"
+
+#include <vector>
+#include "util/random.h"
 #include "util/testharness.h"
+#include "util/testutil.h"
 
 namespace leveldb
 {
@@ -64,6 +68,41 @@ TEST(CRC, Extend)
               Extend(Value("hello ", 6), "world", 5));
 }
 
+TEST(CRC, PortableMatches)
+{
+    fprintf(stderr, "crc32c is %s\n",
+            IsHardwareAccelerated() ? "hardware accelerated" : "portable");
+
+    // Every alignment of short buffers, and lengths around the sizes at
+    // which the accelerated version changes strategy
+    Random rnd(301);
+    std::string data;
+    test::RandomString(&rnd, 200000, &data);
+    std::vector<size_t> lengths;
+    for (size_t n = 0; n < 1000; n++)
+    {
+        lengths.push_back(n);
+    }
+    const size_t kSizes[] = { 3 * 128, 3 * 1024, 4096, 32768, 100000 };
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++)
+    {
+        for (size_t n = kSizes[i] - 9; n <= kSizes[i] + 9; n++)
+        {
+            lengths.push_back(n);
+        }
+    }
+    for (size_t i = 0; i < lengths.size(); i++)
+    {
+        for (size_t offset = 0; offset < 8; offset++)
+        {
+            const char* p = data.data() + offset;
+            const uint32_t init = rnd.Next();
+            ASSERT_EQ(ExtendPortable(init, p, lengths[i]),
+                      Extend(init, p, lengths[i]));
+        }
+    }
+}
+
 TEST(CRC, Mask)
 {
     uint32_t crc = Value("foo", 3);
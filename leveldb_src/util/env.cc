@@ -11,6 +11,16 @@ Env::~Env()
 {
 }
 
+void Env::SetBackgroundThreads(int num)
+{
+}
+
+Status Env::NewMmapReadableFile(const std::string& fname,
+                                RandomAccessFile** result)
+{
+    return NewRandomAccessFile(fname, result);
+}
+
 SequentialFile::~SequentialFile()
 {
 }
@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#include <vector>
 #if defined(LEVELDB_PLATFORM_ANDROID)
 #include <sys/stat.h>
 #endif
@@ -109,6 +110,50 @@ public:
     }
 };
 
+// mmap() based random-access
+class PosixMmapReadableFile: public RandomAccessFile
+{
+private:
+    std::string filename_;
+    void* mmapped_region_;
+    size_t length_;
+
+public:
+    // base[0,length-1] contains the mmapped contents of the file.
+    PosixMmapReadableFile(const std::string& fname, void* base, size_t length)
+        : filename_(fname), mmapped_region_(base), length_(length) { }
+    virtual ~PosixMmapReadableFile()
+    {
+        munmap(mmapped_region_, length_);
+    }
+
+    virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                        char* scratch) const
+    {
+        Status s;
+        if (offset > length_)
+        {
+            *result = Slice();
+            s = IOError(filename_, EINVAL);
+        }
+        else
+        {
+            // Like pread(), return what is left if the read runs past the end
+            if (n > length_ - offset)
+            {
+                n = length_ - offset;
+            }
+            *result = Slice(reinterpret_cast<char*>(mmapped_region_) + offset, n);
+        }
+        return s;
+    }
+
+    virtual bool StableReads() const
+    {
+        return true;
+    }
+};
+
 // We preallocate up to an extra megabyte and use memcpy to append new
 // data to the file.  This is safe since we either properly close the
 // file before reading from it, or for log files, the reading code
@@ -367,6 +412,45 @@ public:
         return Status::OK();
     }
 
+    virtual Status NewMmapReadableFile(const std::string& fname,
+                                       RandomAccessFile** result)
+    {
+        if (sizeof(void*) < 8)
+        {
+            // Mappings would soon exhaust a 32-bit address space
+            return NewRandomAccessFile(fname, result);
+        }
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            *result = NULL;
+            return IOError(fname, errno);
+        }
+        struct stat sbuf;
+        if (fstat(fd, &sbuf) != 0)
+        {
+            *result = NULL;
+            Status s = IOError(fname, errno);
+            close(fd);
+            return s;
+        }
+        void* base = NULL;
+        if (sbuf.st_size > 0)
+        {
+            base = mmap(NULL, sbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        if (base == NULL || base == MAP_FAILED)
+        {
+            // Empty files cannot be mapped; serve those (and files we
+            // fail to map) with ordinary reads.
+            *result = new PosixRandomAccessFile(fname, fd);
+            return Status::OK();
+        }
+        close(fd);  // The mapping stays valid without the descriptor
+        *result = new PosixMmapReadableFile(fname, base, sbuf.st_size);
+        return Status::OK();
+    }
+
     virtual Status NewWritableFile(const std::string& fname,
                                    WritableFile** result)
     {
@@ -501,6 +585,8 @@ public:
 
     virtual void Schedule(void (*function)(void*), void* arg);
 
+    virtual void SetBackgroundThreads(int num);
+
     virtual void StartThread(void (*function)(void* arg), void* arg);
 
     virtual Status GetTestDirectory(std::string* result)
@@ -577,8 +663,8 @@ private:
     size_t page_size_;
     pthread_mutex_t mu_;
     pthread_cond_t bgsignal_;
-    pthread_t bgthread_;
-    bool started_bgthread_;
+    std::vector<pthread_t> bgthreads_;
+    size_t max_bgthreads_;  // Number of threads Schedule() may start
 
     // Entry per Schedule() call
     struct BGItem
@@ -591,7 +677,7 @@ private:
 };
 
 PosixEnv::PosixEnv() : page_size_(getpagesize()),
-    started_bgthread_(false)
+    max_bgthreads_(1)
 {
     PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
     PthreadCall("cvar_init", pthread_cond_init(&bgsignal_, NULL));
@@ -601,21 +687,20 @@ void PosixEnv::Schedule(void (*function)(void*), void* arg)
 {
     PthreadCall("lock", pthread_mutex_lock(&mu_));
 
-    // Start background thread if necessary
-    if (!started_bgthread_)
+    // Start background threads if necessary
+    while (bgthreads_.size() < max_bgthreads_)
     {
-        started_bgthread_ = true;
+        pthread_t t;
         PthreadCall(
             "create thread",
-            pthread_create(&bgthread_, NULL,  &PosixEnv::BGThreadWrapper, this));
+            pthread_create(&t, NULL,  &PosixEnv::BGThreadWrapper, this));
+        bgthreads_.push_back(t);
     }
 
-    // If the queue is currently empty, the background thread may currently be
-    // waiting.
-    if (queue_.empty())
-    {
-        PthreadCall("signal", pthread_cond_signal(&bgsignal_));
-    }
+    // Wake up one idle background thread.  With more than one thread the
+    // queue may be non-empty while another thread is waiting, so always
+    // signal.
+    PthreadCall("signal", pthread_cond_signal(&bgsignal_));
 
     // Add to priority queue
     queue_.push_back(BGItem());
@@ -625,6 +710,17 @@ void PosixEnv::Schedule(void (*function)(void*), void* arg)
     PthreadCall("unlock", pthread_mutex_unlock(&mu_));
 }
 
+void PosixEnv::SetBackgroundThreads(int num)
+{
+    PthreadCall("lock", pthread_mutex_lock(&mu_));
+    if (num > 0 && static_cast<size_t>(num) > max_bgthreads_)
+    {
+        // Threads are started lazily by the next Schedule() call
+        max_bgthreads_ = num;
+    }
+    PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+}
+
 void PosixEnv::BGThread()
 {
     while (true)
@@ -669,6 +765,7 @@ void PosixEnv::StartThread(void (*function)(void* arg), void* arg)
     state->arg = arg;
     PthreadCall("start thread",
                 pthread_create(&t, NULL,  &StartThreadWrapper, state));
+    PthreadCall("detach thread", pthread_detach(t));
 }
 
 }
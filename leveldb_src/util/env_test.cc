@@ -108,6 +108,36 @@ TEST(EnvPosixTest, StartThread)
     ASSERT_EQ(state.val, 3);
 }
 
+TEST(EnvPosixTest, MmapReadableFile)
+{
+    std::string dir;
+    ASSERT_OK(env_->GetTestDirectory(&dir));
+    const std::string fname = dir + "/mmap_readable_file";
+    ASSERT_OK(WriteStringToFile(env_, "0123456789", fname));
+
+    RandomAccessFile* file;
+    ASSERT_OK(env_->NewMmapReadableFile(fname, &file));
+    char scratch[10];
+    Slice result;
+    ASSERT_OK(file->Read(2, 3, &result, scratch));
+    ASSERT_EQ("234", result.ToString());
+    ASSERT_OK(file->Read(8, 5, &result, scratch));
+    ASSERT_EQ("89", result.ToString());
+    ASSERT_OK(file->Read(10, 1, &result, scratch));
+    ASSERT_EQ("", result.ToString());
+    delete file;
+
+    // Empty files are served as well
+    ASSERT_OK(WriteStringToFile(env_, "", fname));
+    ASSERT_OK(env_->NewMmapReadableFile(fname, &file));
+    ASSERT_OK(file->Read(0, 1, &result, scratch));
+    ASSERT_EQ("", result.ToString());
+    delete file;
+
+    ASSERT_TRUE(!env_->NewMmapReadableFile(dir + "/no_such_file", &file).ok());
+    ASSERT_OK(env_->DeleteFile(fname));
+}
+
 }
 
 int main(int argc, char** argv)
@@ -0,0 +1,415 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Each sequence starts with a token byte whose high four bits hold the
+// number of literals and whose low four bits hold the match length minus
+// four.  A field of 15 continues in the following bytes, each of which
+// adds its value to it until one is less than 255.  The literals follow,
+// then the distance of the match as two little-endian bytes.  The last
+// sequence holds only literals.  As in the reference implementation, the
+// last five bytes are always literals and no match starts in the last
+// twelve bytes.
+
+#include "util/lz4.h"
+
+#include <string.h>
+#include <vector>
+
+namespace leveldb
+{
+namespace lz4
+{
+
+namespace
+{
+
+static const size_t kMinMatch = 4;
+static const size_t kLastLiterals = 5;
+static const size_t kMatchFindLimit = 12;
+static const size_t kMaxDistance = 65535;
+static const size_t kRunMask = 15;
+
+static const int kMaxHashLog = 14;
+static const int kMaxHCHashLog = 15;
+static const int kMaxHCAttempts = 256;
+static const uint32_t kNoPosition = 0xffffffffu;
+
+inline uint32_t Load32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Number of hash bits for "length" bytes of input: about one slot per
+// byte, within [8, max_log].  Small blocks then clear small tables.
+static int HashLog(size_t length, int max_log)
+{
+    int log = 8;
+    while (log < max_log && (static_cast<size_t>(1) << log) < length)
+    {
+        log++;
+    }
+    return log;
+}
+
+inline uint32_t HashOf(uint32_t v, int log)
+{
+    return (v * 2654435761u) >> (32 - log);
+}
+
+// Number of bytes at "b" that equal those at the earlier position "a",
+// without looking at "limit" or beyond.
+inline size_t MatchLength(const char* a, const char* b, const char* limit)
+{
+    const char* start = b;
+    while (b + 4 <= limit && Load32(a) == Load32(b))
+    {
+        a += 4;
+        b += 4;
+    }
+    while (b < limit && *a == *b)
+    {
+        a++;
+        b++;
+    }
+    return b - start;
+}
+
+static char* EncodeLength(char* op, size_t n)
+{
+    while (n >= 255)
+    {
+        *op++ = static_cast<char>(255);
+        n -= 255;
+    }
+    *op++ = static_cast<char>(n);
+    return op;
+}
+
+static bool DecodeLength(const unsigned char** ip, const unsigned char* limit,
+                         size_t* length)
+{
+    unsigned int b;
+    do
+    {
+        if (*ip >= limit) return false;
+        b = *(*ip)++;
+        *length += b;
+    }
+    while (b == 255);
+    return true;
+}
+
+// Append the literals [literals, literals + literal_length) followed by a
+// match of "match_length" bytes "distance" bytes back.
+static char* EmitSequence(char* op, const char* literals,
+                          size_t literal_length, size_t distance,
+                          size_t match_length)
+{
+    char* token = op++;
+    const size_t extra = match_length - kMinMatch;
+    *token = static_cast<char>(
+                 ((literal_length < kRunMask ? literal_length : kRunMask) << 4) |
+                 (extra < kRunMask ? extra : kRunMask));
+    if (literal_length >= kRunMask)
+    {
+        op = EncodeLength(op, literal_length - kRunMask);
+    }
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+    op[0] = static_cast<char>(distance & 0xff);
+    op[1] = static_cast<char>(distance >> 8);
+    op += 2;
+    if (extra >= kRunMask)
+    {
+        op = EncodeLength(op, extra - kRunMask);
+    }
+    return op;
+}
+
+static char* EmitLastLiterals(char* op, const char* literals,
+                              size_t literal_length)
+{
+    *op++ = static_cast<char>(
+                (literal_length < kRunMask ? literal_length : kRunMask) << 4);
+    if (literal_length >= kRunMask)
+    {
+        op = EncodeLength(op, literal_length - kRunMask);
+    }
+    memcpy(op, literals, literal_length);
+    return op + literal_length;
+}
+
+// Hash chains over every position of the input seen so far, newest first
+class MatchFinder
+{
+public:
+    MatchFinder(const char* input, size_t length)
+        : input_(input),
+          log_(HashLog(length, kMaxHCHashLog)),
+          head_(static_cast<size_t>(1) << log_, kNoPosition),
+          chain_(length),
+          next_(0)
+    {
+    }
+
+    // Return the length of the longest match for "ip" that ends before
+    // "limit", and store its start in *match.  Returns 0 if there is none.
+    size_t Find(const char* ip, const char* limit, const char** match)
+    {
+        const size_t pos = ip - input_;
+        InsertUpTo(pos);
+        size_t best = 0;
+        uint32_t candidate = head_[HashOf(Load32(ip), log_)];
+        for (int attempts = kMaxHCAttempts;
+                candidate != kNoPosition && attempts > 0;
+                attempts--)
+        {
+            if (pos - candidate > kMaxDistance) break;
+            const char* c = input_ + candidate;
+            // Only a match that also covers ip[best] can be longer
+            if (c[best] == ip[best] && Load32(c) == Load32(ip))
+            {
+                const size_t len =
+                    kMinMatch + MatchLength(c + kMinMatch, ip + kMinMatch, limit);
+                if (len > best)
+                {
+                    best = len;
+                    *match = c;
+                }
+            }
+            candidate = chain_[candidate];
+        }
+        return best;
+    }
+
+private:
+    const char* input_;
+    int log_;
+    std::vector<uint32_t> head_;
+    std::vector<uint32_t> chain_;
+    size_t next_;   // First position not yet inserted
+
+    void InsertUpTo(size_t pos)
+    {
+        while (next_ < pos)
+        {
+            const uint32_t h = HashOf(Load32(input_ + next_), log_);
+            chain_[next_] = head_[h];
+            head_[h] = static_cast<uint32_t>(next_);
+            next_++;
+        }
+    }
+};
+
+}
+
+size_t MaxCompressedLength(size_t length)
+{
+    return length + length / 255 + 16;
+}
+
+// The part of a prefix of "prefix_length" bytes that matches can reach
+static size_t UsablePrefix(size_t prefix_length)
+{
+    return prefix_length < kMaxDistance ? prefix_length : kMaxDistance;
+}
+
+size_t Compress(const char* input, size_t length, char* output)
+{
+    return CompressWithPrefix(input, length, 0, output);
+}
+
+size_t CompressWithPrefix(const char* input, size_t length,
+                          size_t prefix_length, char* output)
+{
+    const char* const base = input - UsablePrefix(prefix_length);
+    const char* const end = input + length;
+    const char* anchor = input;
+    char* op = output;
+    if (length > kMatchFindLimit)
+    {
+        const char* const match_limit = end - kLastLiterals;
+        const char* const find_limit = end - kMatchFindLimit;
+        const int log = HashLog(end - base, kMaxHashLog);
+        uint32_t table[1 << kMaxHashLog];
+        memset(table, 0, sizeof(table[0]) << log);
+        // Like the reference implementation, only every third position
+        // of the prefix is worth the time to hash.
+        for (const char* p = base; p < input; p += 3)
+        {
+            table[HashOf(Load32(p), log)] = static_cast<uint32_t>(p - base);
+        }
+
+        // Skip ahead faster the longer no match has been found, so that
+        // incompressible input is passed over quickly.
+        int misses = 0;
+        const char* ip = (base < input) ? input : input + 1;
+        while (ip < find_limit)
+        {
+            const uint32_t h = HashOf(Load32(ip), log);
+            const char* candidate = base + table[h];
+            table[h] = static_cast<uint32_t>(ip - base);
+            if (static_cast<size_t>(ip - candidate) > kMaxDistance ||
+                    Load32(candidate) != Load32(ip))
+            {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            while (ip > anchor && candidate > base && ip[-1] == candidate[-1])
+            {
+                ip--;
+                candidate--;
+            }
+            const size_t len = kMinMatch +
+                               MatchLength(candidate + kMinMatch, ip + kMinMatch, match_limit);
+            op = EmitSequence(op, anchor, ip - anchor, ip - candidate, len);
+            ip += len;
+            anchor = ip;
+            if (ip < find_limit)
+            {
+                table[HashOf(Load32(ip - 2), log)] =
+                    static_cast<uint32_t>(ip - 2 - base);
+            }
+        }
+    }
+    op = EmitLastLiterals(op, anchor, end - anchor);
+    return op - output;
+}
+
+size_t CompressHC(const char* input, size_t length, char* output)
+{
+    return CompressHCWithPrefix(input, length, 0, output);
+}
+
+size_t CompressHCWithPrefix(const char* input, size_t length,
+                            size_t prefix_length, char* output)
+{
+    const char* const base = input - UsablePrefix(prefix_length);
+    const char* const end = input + length;
+    const char* anchor = input;
+    char* op = output;
+    if (length > kMatchFindLimit)
+    {
+        const char* const match_limit = end - kLastLiterals;
+        const char* const find_limit = end - kMatchFindLimit;
+        MatchFinder finder(base, end - base);
+        const char* ip = input;
+        while (ip < find_limit)
+        {
+            const char* match;
+            size_t len = finder.Find(ip, match_limit, &match);
+            if (len == 0)
+            {
+                ip++;
+                continue;
+            }
+            // Give up bytes to the literals while that buys a longer match
+            while (ip + 1 < find_limit)
+            {
+                const char* next_match;
+                const size_t next_len = finder.Find(ip + 1, match_limit,
+                                                    &next_match);
+                if (next_len <= len) break;
+                ip++;
+                len = next_len;
+                match = next_match;
+            }
+            op = EmitSequence(op, anchor, ip - anchor, ip - match, len);
+            ip += len;
+            anchor = ip;
+        }
+    }
+    op = EmitLastLiterals(op, anchor, end - anchor);
+    return op - output;
+}
+
+bool Uncompress(const char* input, size_t length,
+                char* output, size_t output_length)
+{
+    return UncompressWithDictionary(input, length, NULL, 0,
+                                    output, output_length);
+}
+
+bool UncompressWithDictionary(const char* input, size_t length,
+                              const char* dictionary,
+                              size_t dictionary_length,
+                              char* output, size_t output_length)
+{
+    const unsigned char* ip = reinterpret_cast<const unsigned char*>(input);
+    const unsigned char* const iend = ip + length;
+    char* op = output;
+    char* const oend = output + output_length;
+    while (ip < iend)
+    {
+        const unsigned int token = *ip++;
+        size_t literal_length = token >> 4;
+        if (literal_length == kRunMask &&
+                !DecodeLength(&ip, iend, &literal_length))
+        {
+            return false;
+        }
+        if (literal_length > static_cast<size_t>(iend - ip) ||
+                literal_length > static_cast<size_t>(oend - op))
+        {
+            return false;
+        }
+        memcpy(op, ip, literal_length);
+        op += literal_length;
+        ip += literal_length;
+        if (ip == iend)
+        {
+            break;  // The last sequence has no match
+        }
+
+        if (iend - ip < 2) return false;
+        const size_t distance = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        if (distance == 0 ||
+                distance > static_cast<size_t>(op - output) + dictionary_length)
+        {
+            return false;
+        }
+        size_t match_length = token & kRunMask;
+        if (match_length == kRunMask &&
+                !DecodeLength(&ip, iend, &match_length))
+        {
+            return false;
+        }
+        match_length += kMinMatch;
+        if (match_length > static_cast<size_t>(oend - op)) return false;
+
+        if (distance > static_cast<size_t>(op - output))
+        {
+            // The match starts in the dictionary and may run on into the
+            // output, whose start then continues it.
+            const size_t back = distance - (op - output);
+            const size_t n = (back < match_length) ? back : match_length;
+            memcpy(op, dictionary + dictionary_length - back, n);
+            op += n;
+            match_length -= n;
+            if (match_length == 0) continue;
+        }
+        const char* match = op - distance;
+        if (distance >= match_length)
+        {
+            memcpy(op, match, match_length);
+            op += match_length;
+        }
+        else
+        {
+            // The match overlaps the bytes it produces
+            for (size_t i = 0; i < match_length; i++)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+    return op == oend;
+}
+
+}
+}
@@ -0,0 +1,68 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A self-contained implementation of the LZ4 block format: a sequence of
+// literal runs and back references of at least four bytes at distances of
+// up to 64K.  Compress() finds matches with a single hash probe and is
+// about as fast as Snappy; CompressHC() searches hash chains and defers
+// matches that a longer one overlaps, which costs several times the CPU
+// but compresses better.  Both are decoded by Uncompress().
+//
+// Either may also refer back into a dictionary: data like the input that
+// the decoder is given as well, so that small inputs compress about as
+// well as if they were part of a larger one.
+//
+// The output is the standard LZ4 block format, which the reference
+// library's LZ4_decompress_safe() and LZ4_decompress_safe_usingDict()
+// decode, and Uncompress() decodes what its compressors write.  The
+// reference lz4.c and lz4hc.c can take the place of this file without
+// changing what is stored in tables.  Compress() and CompressHC() compress
+// about as well as LZ4_compress_default() and LZ4_compress_HC().
+
+#ifndef STORAGE_LEVELDB_UTIL_LZ4_H_
+#define STORAGE_LEVELDB_UTIL_LZ4_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace leveldb
+{
+namespace lz4
+{
+
+// Return the largest number of bytes that compressing "length" bytes of
+// input can produce.
+extern size_t MaxCompressedLength(size_t length);
+
+// Compress input[0,length-1] into output, which must have room for
+// MaxCompressedLength(length) bytes.  Returns the number of bytes written.
+extern size_t Compress(const char* input, size_t length, char* output);
+extern size_t CompressHC(const char* input, size_t length, char* output);
+
+// Like Compress() and CompressHC(), but matches may also refer to the
+// "prefix_length" bytes in memory right before input, which must then be
+// passed to UncompressWithDictionary().  Only the last 64K bytes of the
+// prefix can be referred to.
+extern size_t CompressWithPrefix(const char* input, size_t length,
+                                 size_t prefix_length, char* output);
+extern size_t CompressHCWithPrefix(const char* input, size_t length,
+                                   size_t prefix_length, char* output);
+
+// Uncompress input[0,length-1] into output[0,output_length-1].  Returns
+// false unless the input is well formed and decodes to exactly
+// output_length bytes.
+extern bool Uncompress(const char* input, size_t length,
+                       char* output, size_t output_length);
+
+// Like Uncompress(), for input compressed against the prefix
+// dictionary[0,dictionary_length-1].
+extern bool UncompressWithDictionary(const char* input, size_t length,
+                                     const char* dictionary,
+                                     size_t dictionary_length,
+                                     char* output, size_t output_length);
+
+}
+}
+
+#endif  // STORAGE_LEVELDB_UTIL_LZ4_H_
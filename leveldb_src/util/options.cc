@@ -18,11 +18,30 @@ Options::Options()
       env(Env::Default()),
       info_log(NULL),
       write_buffer_size(4<<20),
+      allow_concurrent_memtable_write(false),
+      memtable_factory(NULL),
       max_open_files(1000),
+      max_background_compactions(1),
+      max_subcompactions(1),
+      level_compaction_dynamic_level_bytes(false),
+      delayed_write_rate(16 << 20),
+      soft_pending_compaction_bytes_limit(64ull << 30),
+      hard_pending_compaction_bytes_limit(256ull << 30),
+      max_mmap_read_bytes(0),
+      tail_prefetch_size(64 * 1024),
       block_cache(NULL),
+      cache_index_and_filter_blocks(false),
       block_size(4096),
+      data_block_hash_index(false),
+      index_partition_size(0),
       block_restart_interval(16),
-      compression(kSnappyCompression)
+      compression(kSnappyCompression),
+      compression_per_level(NULL),
+      compression_per_level_size(0),
+      compression_threads(1),
+      compression_dictionary_size(0),
+      filter_policy(NULL),
+      prefix_extractor(NULL)
 {
 }
 
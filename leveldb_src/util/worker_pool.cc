@@ -0,0 +1,102 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/worker_pool.h"
+
+#include <assert.h>
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+
+namespace leveldb
+{
+
+WorkerPool::WorkerPool(Env* env, int max_threads)
+    : env_(env),
+      work_cv_(&mu_),
+      exit_cv_(&mu_),
+      max_threads_(max_threads > 0 ? max_threads : 1),
+      threads_(0),
+      idle_(0),
+      shutting_down_(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    MutexLock l(&mu_);
+    shutting_down_ = true;
+    work_cv_.SignalAll();
+    while (threads_ > 0)
+    {
+        exit_cv_.Wait();
+    }
+}
+
+void WorkerPool::SetMaxThreads(int num)
+{
+    MutexLock l(&mu_);
+    if (num > max_threads_)
+    {
+        // Threads are started lazily by the next Schedule() call
+        max_threads_ = num;
+    }
+}
+
+void WorkerPool::Schedule(void (*function)(void* arg), void* arg)
+{
+    MutexLock l(&mu_);
+    assert(!shutting_down_);
+    Item item;
+    item.function = function;
+    item.arg = arg;
+    queue_.push_back(item);
+
+    // Start a thread unless an idle one can take the item
+    if (queue_.size() > static_cast<size_t>(idle_) &&
+            threads_ < max_threads_)
+    {
+        threads_++;
+        env_->StartThread(&WorkerPool::Run, this);
+    }
+    work_cv_.Signal();
+}
+
+int WorkerPool::NumThreads()
+{
+    MutexLock l(&mu_);
+    return threads_;
+}
+
+void WorkerPool::Run(void* pool)
+{
+    reinterpret_cast<WorkerPool*>(pool)->Work();
+}
+
+void WorkerPool::Work()
+{
+    mu_.Lock();
+    while (true)
+    {
+        while (queue_.empty() && !shutting_down_)
+        {
+            idle_++;
+            work_cv_.Wait();
+            idle_--;
+        }
+        if (queue_.empty())
+        {
+            break;
+        }
+        Item item = queue_.front();
+        queue_.pop_front();
+        mu_.Unlock();
+        (*item.function)(item.arg);
+        mu_.Lock();
+    }
+    threads_--;
+    exit_cv_.Signal();
+    mu_.Unlock();
+}
+
+}
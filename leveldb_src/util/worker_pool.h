@@ -0,0 +1,69 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// WorkerPool runs work items on a bounded set of threads that are started
+// as work arrives and kept until the pool is destroyed, so that code
+// handing out many short pieces of work does not start a thread for each.
+
+#ifndef STORAGE_LEVELDB_UTIL_WORKER_POOL_H_
+#define STORAGE_LEVELDB_UTIL_WORKER_POOL_H_
+
+#include <deque>
+#include "port/port.h"
+
+namespace leveldb
+{
+
+class Env;
+
+// Safe for concurrent use by multiple threads.
+class WorkerPool
+{
+public:
+    // Threads are started through env->StartThread(), never more than
+    // "max_threads" of them.
+    WorkerPool(Env* env, int max_threads);
+
+    // Runs the items that are still queued, then waits for the threads
+    // to exit.
+    ~WorkerPool();
+
+    // Allow up to "num" threads if that is more than the current limit.
+    void SetMaxThreads(int num);
+
+    // Arrange to run "(*function)(arg)" in one of the threads.  Items may
+    // run concurrently and in any order.
+    void Schedule(void (*function)(void* arg), void* arg);
+
+    // Return the number of threads started and not exited yet.
+    int NumThreads();
+
+private:
+    struct Item
+    {
+        void (*function)(void*);
+        void* arg;
+    };
+
+    Env* const env_;
+    port::Mutex mu_;
+    port::CondVar work_cv_;     // Signalled when there is work to take
+    port::CondVar exit_cv_;     // Signalled when a thread exits
+    std::deque<Item> queue_;    // Items not taken by a thread yet
+    int max_threads_;
+    int threads_;               // Started and not exited yet
+    int idle_;                  // Waiting for work
+    bool shutting_down_;
+
+    static void Run(void* pool);
+    void Work();
+
+    // No copying allowed
+    WorkerPool(const WorkerPool&);
+    void operator=(const WorkerPool&);
+};
+
+}
+
+#endif  // STORAGE_LEVELDB_UTIL_WORKER_POOL_H_
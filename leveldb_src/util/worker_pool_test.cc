@@ -0,0 +1,80 @@
+﻿// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/worker_pool.h"
+
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+#include "util/testharness.h"
+
+namespace leveldb
+{
+
+class WorkerPoolTest { };
+
+namespace
+{
+struct Counter
+{
+    port::Mutex mu;
+    int count;
+
+    Counter() : count(0) { }
+};
+}
+
+static void Increment(void* arg)
+{
+    Counter* counter = reinterpret_cast<Counter*>(arg);
+    Env::Default()->SleepForMicroseconds(10);
+    MutexLock l(&counter->mu);
+    counter->count++;
+}
+
+TEST(WorkerPoolTest, RunsEveryItemOnBoundedThreads)
+{
+    Counter counter;
+    {
+        WorkerPool pool(Env::Default(), 3);
+        for (int i = 0; i < 1000; i++)
+        {
+            pool.Schedule(&Increment, &counter);
+            ASSERT_LE(pool.NumThreads(), 3);
+        }
+        ASSERT_GT(pool.NumThreads(), 0);
+    }
+
+    // The destructor runs what is still queued
+    ASSERT_EQ(1000, counter.count);
+}
+
+TEST(WorkerPoolTest, ThreadsAreReused)
+{
+    Counter counter;
+    WorkerPool pool(Env::Default(), 4);
+    for (int round = 0; round < 50; round++)
+    {
+        pool.Schedule(&Increment, &counter);
+        while (true)
+        {
+            MutexLock l(&counter.mu);
+            if (counter.count == round + 1) break;
+        }
+    }
+    ASSERT_LE(pool.NumThreads(), 4);
+
+    pool.SetMaxThreads(8);
+    for (int i = 0; i < 100; i++)
+    {
+        pool.Schedule(&Increment, &counter);
+    }
+    ASSERT_LE(pool.NumThreads(), 8);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    return leveldb::test::RunAllTests();
+}
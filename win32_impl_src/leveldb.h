@@ -11,7 +11,12 @@
 #include "leveldb/write_batch.h"
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
+#include "leveldb/compressor.h"
 #include "leveldb/db.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/sst_file_writer.h"
 
 #endif
 
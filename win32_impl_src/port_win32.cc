@@ -8,6 +8,9 @@
 #include "snappy.h"
 #define USE_SNAPPY
 
+#include "zstd.h"
+#define USE_ZSTD
+
 namespace leveldb
 {
 
@@ -361,6 +364,24 @@ void CondVarNew::SignalAll()
 
 #endif
 
+// *once is 0 until a thread starts running the initializer, 1 while it
+// runs and 2 once it is done.  InitOnceExecuteOnce() would need Vista.
+void InitOnce(OnceType* once, void (*initializer)())
+{
+    if (InterlockedCompareExchange(once, 1, 0) == 0)
+    {
+        (*initializer)();
+        InterlockedExchange(once, 2);
+    }
+    else
+    {
+        while (InterlockedCompareExchange(once, 2, 2) != 2)
+        {
+            Sleep(0);
+        }
+    }
+}
+
 bool Snappy_Compress(const char* input, size_t length,std::string* output)
 {
 #if defined USE_SNAPPY
@@ -391,6 +412,70 @@ bool Snappy_Uncompress(const char* input, size_t length,char* output)
 #endif
 }
 
+bool Zstd_Compress(const char* input, size_t length,
+                   const char* dict, size_t dict_length, int level,
+                   std::string* output)
+{
+#if defined USE_ZSTD
+    ZSTD_CCtx* ctx = ZSTD_createCCtx();
+    if (ctx == NULL)
+    {
+        return false;
+    }
+    output->resize(ZSTD_compressBound(length));
+    const size_t outlen = ZSTD_compress_usingDict(ctx, &(*output)[0],
+                          output->size(), input, length,
+                          dict, dict_length, level);
+    ZSTD_freeCCtx(ctx);
+    if (ZSTD_isError(outlen))
+    {
+        return false;
+    }
+    output->resize(outlen);
+    return true;
+#endif
+    return false;
+}
+
+bool Zstd_GetUncompressedLength(const char* input, size_t length,size_t* result)
+{
+#ifdef USE_ZSTD
+    const unsigned long long n = ZSTD_getFrameContentSize(input, length);
+    if (n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR ||
+            static_cast<size_t>(n) != n)
+    {
+        return false;
+    }
+    *result = static_cast<size_t>(n);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Zstd_Uncompress(const char* input, size_t length,
+                     const char* dict, size_t dict_length, char* output)
+{
+#ifdef USE_ZSTD
+    size_t n;
+    if (!Zstd_GetUncompressedLength(input, length, &n))
+    {
+        return false;
+    }
+    ZSTD_DCtx* ctx = ZSTD_createDCtx();
+    if (ctx == NULL)
+    {
+        return false;
+    }
+    const size_t outlen = ZSTD_decompress_usingDict(ctx, output, n,
+                          input, length, dict, dict_length);
+    ZSTD_freeDCtx(ctx);
+    return outlen == n;
+#else
+    return false;
+#endif
+}
+
 }
 
 
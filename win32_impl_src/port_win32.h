@@ -232,12 +232,30 @@ typedef CondVarNew CondVar;
 typedef CondVarOld CondVar;
 #endif
 
+typedef volatile LONG OnceType;
+#define LEVELDB_ONCE_INIT 0
+void InitOnce(OnceType* once, void (*initializer)());
+
 bool Snappy_Compress(const char* input, size_t length,std::string* output);
 
 bool Snappy_GetUncompressedLength(const char* input, size_t length,size_t* result);
 
 bool Snappy_Uncompress(const char* input, size_t length,char* output);
 
+bool Zstd_Compress(const char* input, size_t length,
+                   const char* dict, size_t dict_length, int level,
+                   std::string* output);
+
+bool Zstd_GetUncompressedLength(const char* input, size_t length,size_t* result);
+
+bool Zstd_Uncompress(const char* input, size_t length,
+                     const char* dict, size_t dict_length, char* output);
+
+inline uint64_t ThreadIdentifier()
+{
+    return GetCurrentThreadId();
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg)
 {
     return false;